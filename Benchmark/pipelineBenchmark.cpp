@@ -0,0 +1,768 @@
+//
+//  pipelineBenchmark.cpp
+//  Benchmark
+//
+//  Times the stages of the liver and vessel pipelines, one at a time and
+//  end to end, on synthetic phantoms (Common/phantom.h) of several sizes
+//  and on reference volumes, and scores the results against the phantom
+//  ground truth. The report is JSON with a fixed layout, so the reports of
+//  two builds can be diffed.
+//
+//  INPUT:
+//    - output JSON file
+//    - optionally, comma-separated phantom edge lengths (default
+//      64,128,192; "" for the default, 0 for no phantoms)
+//    - optionally, repetitions of every stage (default 3; the fastest and
+//      the median are reported)
+//    - optionally, the number of threads (default 0, every core)
+//    - optionally, reference volumes in any format the tools read (e.g.
+//      frangi_filter_version2a/ExampleVolumeStent.mat)
+//
+//  Stages: Gaussian smoothing, Hessian, eigenvalues, vesselness (each in
+//  isolation, at one scale), the multiscale Frangi filter, anisotropic
+//  diffusion, gradient magnitude and sigmoid, fast marching, the initial
+//  level set, geodesic active contours, image I/O, and the fastmarching
+//  pipeline end to end. Reference volumes have no ground truth and run the
+//  vessel stages, diffusion and I/O only.
+//
+//  Compression: the input, the vesselness and, on the phantoms, the speed
+//  image are written and read as compressed MetaImage and as chunked
+//  volumes (Common/chunkedVolume.h) with every codec of the build. I/O
+//  stages report megabytes per second of the uncompressed image, and every
+//  case the compression ratio of each intermediate and format.
+//
+//  Accuracy on the phantoms: Dice of fast marching (thresholded at the
+//  arrival time that gives the true liver volume) and of geodesic active
+//  contours (started from that segmentation) against the liver; for the
+//  Frangi filter, the ROC area separating tube centerlines from voxels
+//  over 3 voxels from any tube, the centerline detection and background
+//  false positive rates at a tenth of the maximum response, and the mean
+//  selected sigma on the centerlines of each tube radius.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "itkImage.h"
+#include "itkCurvatureAnisotropicDiffusionImageFilter.h"
+#include "itkGradientMagnitudeRecursiveGaussianImageFilter.h"
+#include "itkSigmoidImageFilter.h"
+#include "itkFastMarchingImageFilter.h"
+#include "itkGeodesicActiveContourLevelSetImageFilter.h"
+#include "itkMultiThreader.h"
+#include "chunkedVolume.h"
+#include "compactImageIO.h"
+#include "distanceTransform.h"
+#include "hessian.h"
+#include "parallel.h"
+#include "phantom.h"
+#include "stageProfiler.h"
+#include "symmetricEigen3.h"
+#include "vesselness.h"
+
+
+typedef itk::Image< float, 3 > FloatImageType;
+typedef itk::Image< unsigned char, 3 > MaskImageType;
+
+// Settings of the timed stages
+const double StageSigma = 2.0;
+const double SpeedSigma = 1.0;
+const double SigmoidK1 = 40.0;     // gradient magnitude on the liver edge
+const double SigmoidK2 = 10.0;     // gradient magnitude inside
+const double InitialRadius = 5.0;
+const unsigned int ContourIterations = 50;
+
+
+// Wall times of the repetitions of one stage, with the CPU time and bytes
+// allocated of the fastest; Bytes is the size of the image an I/O stage
+// writes or reads, uncompressed, and 0 for other stages
+struct StageResult
+{
+	std::string Name;
+	std::vector<double> Wall;
+	double Cpu;
+	unsigned long long BytesAllocated;
+	double Bytes;
+
+	double Fastest() const { return *std::min_element( Wall.begin(), Wall.end() ); }
+	double Median() const
+	{
+		std::vector<double> sorted( Wall );
+		std::sort( sorted.begin(), sorted.end() );
+		const std::size_t n = sorted.size();
+		return n % 2 ? sorted[n / 2] : 0.5 * ( sorted[n / 2 - 1] + sorted[n / 2] );
+	}
+};
+
+struct CaseResult
+{
+	std::string Name;
+	medimg::Dims dims;
+	std::vector<StageResult> Stages;
+	std::vector< std::pair<std::string, double> > Accuracy;
+	// Uncompressed over file size, by intermediate and format
+	std::vector< std::pair<std::string, double> > Compression;
+	std::size_t PeakRSS;
+};
+
+
+// Runs stage repetitions times and records it under name
+static void TimeStage(CaseResult &result, const std::string &name, unsigned int repetitions,
+	const std::function<void ()> &stage)
+{
+	StageResult timing;
+	timing.Name = name;
+	timing.Cpu = 0.0;
+	timing.BytesAllocated = 0;
+	timing.Bytes = 0.0;
+	for( unsigned int r = 0; r < repetitions; ++r ) {
+		const double cpu = medimg::ProcessCpuSeconds();
+		const unsigned long long allocated = medimg::AllocatedBytes();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		stage();
+		const double wall = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+		if( timing.Wall.empty() || wall < timing.Fastest() ) {
+			timing.Cpu = medimg::ProcessCpuSeconds() - cpu;
+			timing.BytesAllocated = medimg::AllocatedBytes() - allocated;
+		}
+		timing.Wall.push_back( wall );
+	}
+	std::cout << "  " << name << ": " << timing.Fastest() << " s" << std::endl;
+	result.Stages.push_back( timing );
+}
+
+// Same for a stage that writes or reads an image of bytes
+static void TimeTransfer(CaseResult &result, const std::string &name, unsigned int repetitions,
+	double bytes, const std::function<void ()> &stage)
+{
+	TimeStage( result, name, repetitions, stage );
+	result.Stages.back().Bytes = bytes;
+}
+
+static double FileBytes(const std::string &filename)
+{
+	std::ifstream file( filename.c_str(), std::ios::binary | std::ios::ate );
+	return file ? static_cast<double>( file.tellg() ) : 0.0;
+}
+
+// Separable Gaussian smoothing of I into out, in z-slabs on all threads,
+// replicating the volume border
+static void GaussianSmooth(const float *I, const medimg::Dims &dims, double sigma, float *out,
+	unsigned int threads)
+{
+	const int radius = static_cast<int>( std::ceil( 3.0 * sigma ) );
+	const std::vector<float> kernel = medimg::GaussianDerivativeKernel( sigma, radius, 0 );
+	const std::size_t planes = 16;
+	medimg::ParallelFor( ( dims.nz + planes - 1 ) / planes, threads, [&](std::size_t s, unsigned int) {
+		medimg::Box box;
+		box.lo[0] = box.lo[1] = 0;
+		box.lo[2] = static_cast<long>( s * planes );
+		box.hi[0] = static_cast<long>( dims.nx );
+		box.hi[1] = static_cast<long>( dims.ny );
+		box.hi[2] = static_cast<long>( std::min( dims.nz, ( s + 1 ) * planes ) );
+		const medimg::Box grown = box.Grow( radius );
+		std::vector<float> a( grown.Voxels() ), b( grown.Voxels() );
+		medimg::GatherReplicate( I, dims, grown, &a[0] );
+		std::size_t size[3] = { grown.Size( 0 ), grown.Size( 1 ), grown.Size( 2 ) };
+		medimg::CorrelateAxis( &a[0], size, 0, kernel, &b[0] );
+		size[0] -= 2 * radius;
+		medimg::CorrelateAxis( &b[0], size, 1, kernel, &a[0] );
+		size[1] -= 2 * radius;
+		medimg::CorrelateAxis( &a[0], size, 2, kernel, out + dims.Index( 0, 0, box.lo[2] ) );
+	} );
+}
+
+// Scale-normalized eigenvalues of the Hessian H[0..5], ordered by
+// magnitude as FrangiFilter3D.m orders them, into L[0..2]
+static void HessianEigenvalues(float *const H[6], std::size_t n, double sigma, float *const L[3],
+	unsigned int threads)
+{
+	const double c = sigma * sigma;
+	const std::size_t block = 65536;
+	medimg::ParallelFor( ( n + block - 1 ) / block, threads, [&](std::size_t b, unsigned int) {
+		for( std::size_t i = b * block; i < std::min( n, ( b + 1 ) * block ); ++i ) {
+			const double M[3][3] = {
+				{ c * H[0][i], c * H[3][i], c * H[4][i] },
+				{ c * H[3][i], c * H[1][i], c * H[5][i] },
+				{ c * H[4][i], c * H[5][i], c * H[2][i] } };
+			double d[3];
+			medimg::SymmetricEigenvalues3( M, d );
+			std::sort( d, d + 3, [](double u, double v) { return std::fabs( u ) < std::fabs( v ); } );
+			for( int k = 0; k < 3; ++k ) {
+				L[k][i] = static_cast<float>( d[k] );
+			}
+		}
+	} );
+}
+
+// Frangi vesselness of the eigenvalues L[0..2], as in vesselness.cpp
+static void FrangiMeasure(float *const L[3], std::size_t n, const medimg::FrangiOptions &options,
+	float *out, unsigned int threads)
+{
+	const double A = 2 * options.FrangiAlpha * options.FrangiAlpha;
+	const double B = 2 * options.FrangiBeta * options.FrangiBeta;
+	const double C = 2 * options.FrangiC * options.FrangiC;
+	const std::size_t block = 65536;
+	medimg::ParallelFor( ( n + block - 1 ) / block, threads, [&](std::size_t b, unsigned int) {
+		for( std::size_t i = b * block; i < std::min( n, ( b + 1 ) * block ); ++i ) {
+			const double l1 = std::fabs( L[0][i] ), l2 = std::fabs( L[1][i] ), l3 = std::fabs( L[2][i] );
+			const double Ra = l2 / l3;
+			const double Rb = l1 / std::sqrt( l2 * l3 );
+			const double S2 = l1 * l1 + l2 * l2 + l3 * l3;
+			double v = ( 1 - std::exp( -( Ra * Ra / A ) ) ) * std::exp( -( Rb * Rb / B ) )
+				* ( 1 - std::exp( -S2 / C ) );
+			if( options.BlackWhite ? L[1][i] < 0 || L[2][i] < 0 : L[1][i] > 0 || L[2][i] > 0 ) {
+				v = 0;
+			}
+			out[i] = std::isfinite( v ) ? static_cast<float>( v ) : 0.0f;
+		}
+	} );
+}
+
+template< class TImage >
+static typename TImage::Pointer ImageFromBuffer(const typename TImage::PixelType *buffer,
+	const medimg::Geometry &geometry)
+{
+	typename TImage::Pointer image = medimg::AllocateImage< TImage >( geometry );
+	std::copy( buffer, buffer + geometry.dims.Voxels(), image->GetBufferPointer() );
+	return image;
+}
+
+// Voxels with values up to the n-th smallest, i.e. the n earliest arrivals
+static std::vector<unsigned char> SmallestVoxels(const float *values, std::size_t voxels, std::size_t n)
+{
+	std::vector<unsigned char> mask( voxels, 0 );
+	if( n == 0 ) {
+		return mask;
+	}
+	std::vector<float> sorted( values, values + voxels );
+	std::nth_element( sorted.begin(), sorted.begin() + ( n - 1 ), sorted.end() );
+	const float threshold = sorted[n - 1];
+	for( std::size_t i = 0; i < voxels; ++i ) {
+		mask[i] = values[i] <= threshold;
+	}
+	return mask;
+}
+
+// Probability that a positive scores above a negative, ties counting half
+static double AreaUnderROC(std::vector<float> positives, std::vector<float> negatives)
+{
+	if( positives.empty() || negatives.empty() ) {
+		return 0.0;
+	}
+	std::sort( negatives.begin(), negatives.end() );
+	double area = 0.0;
+	for( std::size_t p = 0; p < positives.size(); ++p ) {
+		const std::vector<float>::const_iterator lower =
+			std::lower_bound( negatives.begin(), negatives.end(), positives[p] );
+		const std::vector<float>::const_iterator upper =
+			std::upper_bound( lower, negatives.cend(), positives[p] );
+		area += ( lower - negatives.cbegin() ) + 0.5 * ( upper - lower );
+	}
+	return area / ( static_cast<double>( positives.size() ) * negatives.size() );
+}
+
+
+// Writes and reads image, the intermediate called name, as compressed
+// MetaImage and as a chunked volume with every codec of the build, with
+// and without shuffling, and records the compression ratios
+static void CompressionStages(const std::string &name, const FloatImageType *image,
+	unsigned int repetitions, unsigned int threads, const std::string &scratch, CaseResult &result)
+{
+	const medimg::Geometry geometry = medimg::ImageGeometry( image );
+	const std::size_t n = geometry.dims.Voxels();
+	const double bytes = n * sizeof(float);
+
+	const std::string mha = scratch + "-" + name + ".mha";
+	TimeTransfer( result, "write " + name + " compressed mha", repetitions, bytes, [&]() {
+		medimg::WriteImageFile( image, mha, true );
+	} );
+	TimeTransfer( result, "read " + name + " compressed mha", repetitions, bytes, [&]() {
+		medimg::ReadImageFile< FloatImageType >( mha );
+	} );
+	result.Compression.push_back( std::make_pair( name + " mha", bytes / FileBytes( mha ) ) );
+	std::remove( mha.c_str() );
+
+	const std::string zvol = scratch + "-" + name + ".zvol";
+	const medimg::VolumeCodec codecs[3] = { medimg::DeflateCodec, medimg::ZstdCodec, medimg::LZ4Codec };
+	for( int f = 0; f < 6; ++f ) {
+		medimg::ChunkedVolumeOptions options;
+		options.Codec = codecs[f / 2];
+		options.Shuffle = f % 2 == 1;
+		options.NumberOfThreads = threads;
+		if( !medimg::CodecAvailable( options.Codec ) ) {
+			continue;
+		}
+		const std::string format = std::string( "zvol " ) + medimg::CodecName( options.Codec )
+			+ ( options.Shuffle ? " shuffled" : "" );
+		std::vector<float> read( n );
+		std::string error;
+		bool done = true;
+		TimeTransfer( result, "write " + name + " " + format, repetitions, bytes, [&]() {
+			done = medimg::WriteChunkedVolume( zvol, geometry, image->GetBufferPointer(), options, error ) && done;
+		} );
+		TimeTransfer( result, "read " + name + " " + format, repetitions, bytes, [&]() {
+			done = medimg::ReadChunkedVolume( zvol, &read[0], threads, error ) && done;
+		} );
+		if( !done ) {
+			std::cerr << "Error: " << error << std::endl;
+		}
+		else if( !std::equal( read.begin(), read.end(), image->GetBufferPointer() ) ) {
+			std::cerr << "Error: " << zvol << " does not read back as written" << std::endl;
+		}
+		result.Compression.push_back( std::make_pair( name + " " + format, bytes / FileBytes( zvol ) ) );
+		std::remove( zvol.c_str() );
+	}
+}
+
+
+// Stages shared by phantoms and reference volumes: vessel filtering,
+// diffusion and I/O of image
+static void VesselAndIOStages(const FloatImageType *image, const medimg::FrangiOptions &frangi,
+	unsigned int repetitions, unsigned int threads, const std::string &scratch, CaseResult &result,
+	std::vector<float> &vesselness, std::vector<float> &scale)
+{
+	const medimg::Geometry geometry = medimg::ImageGeometry( image );
+	const medimg::Dims &dims = geometry.dims;
+	const std::size_t n = dims.Voxels();
+	const float *I = image->GetBufferPointer();
+
+	std::vector<float> smoothed( n );
+	TimeStage( result, "gaussian", repetitions, [&]() {
+		GaussianSmooth( I, dims, StageSigma, &smoothed[0], threads );
+	} );
+
+	std::vector<float> hessian( 6 * n );
+	float *const H[6] = { &hessian[0], &hessian[n], &hessian[2 * n], &hessian[3 * n],
+		&hessian[4 * n], &hessian[5 * n] };
+	TimeStage( result, "hessian", repetitions, [&]() {
+		medimg::Hessian3D( I, dims, StageSigma, H, threads );
+	} );
+
+	std::vector<float> eigenvalues( 3 * n );
+	float *const L[3] = { &eigenvalues[0], &eigenvalues[n], &eigenvalues[2 * n] };
+	TimeStage( result, "eigen", repetitions, [&]() {
+		HessianEigenvalues( H, n, StageSigma, L, threads );
+	} );
+	std::vector<float>().swap( hessian );
+
+	std::vector<float> measure( n );
+	TimeStage( result, "vesselness", repetitions, [&]() {
+		FrangiMeasure( L, n, frangi, &measure[0], threads );
+	} );
+	std::vector<float>().swap( eigenvalues );
+
+	vesselness.resize( n );
+	scale.resize( n );
+	TimeStage( result, "frangi", repetitions, [&]() {
+		medimg::FrangiFilter3D( I, dims, frangi, &vesselness[0], &scale[0] );
+	} );
+
+	typedef itk::CurvatureAnisotropicDiffusionImageFilter< FloatImageType, FloatImageType >
+		SmoothingFilterType;
+	TimeStage( result, "diffusion", repetitions, [&]() {
+		SmoothingFilterType::Pointer smoothing = SmoothingFilterType::New();
+		smoothing->SetInput( image );
+		smoothing->SetTimeStep( 0.04 );
+		smoothing->SetNumberOfIterations( 5 );
+		smoothing->SetConductanceParameter( 9.0 );
+		smoothing->Update();
+	} );
+
+	const std::string raw = scratch + ".mha";
+	const double bytes = n * sizeof(float);
+	TimeTransfer( result, "write mha", repetitions, bytes, [&]() {
+		medimg::WriteImageFile( image, raw );
+	} );
+	TimeTransfer( result, "read mha", repetitions, bytes, [&]() {
+		medimg::ReadImageFile< FloatImageType >( raw );
+	} );
+	std::remove( raw.c_str() );
+	CompressionStages( "input", image, repetitions, threads, scratch, result );
+	CompressionStages( "vesselness", ImageFromBuffer< FloatImageType >( &vesselness[0], geometry ),
+		repetitions, threads, scratch, result );
+}
+
+
+static CaseResult RunPhantom(std::size_t size, unsigned int repetitions, unsigned int threads,
+	const std::string &scratch)
+{
+	CaseResult result;
+	std::ostringstream name;
+	name << "phantom-" << size;
+	result.Name = name.str();
+	result.dims = medimg::Dims( size, size, size );
+	std::cout << result.Name << std::endl;
+	medimg::ResetPeakResident();
+
+	medimg::PhantomOptions options;
+	options.dims = result.dims;
+	options.NumberOfThreads = threads;
+	medimg::Phantom phantom;
+	TimeStage( result, "phantom", 1, [&]() { medimg::MakePhantom( options, phantom ); } );
+	const medimg::Geometry &geometry = phantom.geometry;
+	const std::size_t n = geometry.dims.Voxels();
+	const FloatImageType::Pointer image = ImageFromBuffer< FloatImageType >( &phantom.Image[0], geometry );
+
+	////////////////////////////////////////////////
+	// Vessel stages, diffusion and I/O
+
+	medimg::FrangiOptions frangi;
+	frangi.FrangiScaleRange[0] = 1.0;
+	frangi.FrangiScaleRange[1] = 4.0;
+	frangi.FrangiScaleRatio = 1.0;
+	frangi.FrangiC = 50.0;
+	frangi.BlackWhite = false;
+	frangi.verbose = false;
+	frangi.NumberOfThreads = threads;
+	std::vector<float> vesselness, scale;
+	VesselAndIOStages( image, frangi, repetitions, threads, scratch, result, vesselness, scale );
+
+	const MaskImageType::Pointer liver = ImageFromBuffer< MaskImageType >( &phantom.Liver[0], geometry );
+	const std::string bits = scratch + ".bits";
+	TimeStage( result, "write bits", repetitions, [&]() { medimg::WriteImageFile( liver.GetPointer(), bits ); } );
+	TimeStage( result, "read bits", repetitions, [&]() { medimg::ReadImageFile< MaskImageType >( bits ); } );
+	std::remove( bits.c_str() );
+
+	////////////////////////////////////////////////
+	// Liver stages
+
+	typedef itk::CurvatureAnisotropicDiffusionImageFilter< FloatImageType, FloatImageType >
+		SmoothingFilterType;
+	typedef itk::GradientMagnitudeRecursiveGaussianImageFilter< FloatImageType, FloatImageType >
+		GradientFilterType;
+	typedef itk::SigmoidImageFilter< FloatImageType, FloatImageType > SigmoidFilterType;
+	typedef itk::FastMarchingImageFilter< FloatImageType, FloatImageType > FastMarchingFilterType;
+	typedef itk::GeodesicActiveContourLevelSetImageFilter< FloatImageType, FloatImageType >
+		GeodesicActiveContourFilterType;
+
+	SmoothingFilterType::Pointer smoothing = SmoothingFilterType::New();
+	smoothing->SetInput( image );
+	smoothing->SetTimeStep( 0.04 );
+	smoothing->SetNumberOfIterations( 5 );
+	smoothing->SetConductanceParameter( 9.0 );
+	smoothing->Update();
+	FloatImageType::Pointer smoothed = smoothing->GetOutput();
+	smoothed->DisconnectPipeline();
+
+	FloatImageType::Pointer speed;
+	TimeStage( result, "gradient magnitude and sigmoid", repetitions, [&]() {
+		GradientFilterType::Pointer gradientMagnitude = GradientFilterType::New();
+		gradientMagnitude->SetInput( smoothed );
+		gradientMagnitude->SetSigma( SpeedSigma );
+		SigmoidFilterType::Pointer sigmoid = SigmoidFilterType::New();
+		sigmoid->SetInput( gradientMagnitude->GetOutput() );
+		sigmoid->SetOutputMinimum( 0.0 );
+		sigmoid->SetOutputMaximum( 1.0 );
+		sigmoid->SetAlpha( ( SigmoidK2 - SigmoidK1 ) / 6 );
+		sigmoid->SetBeta( ( SigmoidK1 + SigmoidK2 ) / 2 );
+		sigmoid->Update();
+		speed = sigmoid->GetOutput();
+		speed->DisconnectPipeline();
+	} );
+	CompressionStages( "speed", speed, repetitions, threads, scratch, result );
+
+	FastMarchingFilterType::NodeType node;
+	FastMarchingFilterType::NodeContainer::Pointer seeds = FastMarchingFilterType::NodeContainer::New();
+	FloatImageType::IndexType seedIndex;
+	for( int a = 0; a < 3; ++a ) {
+		seedIndex[a] = phantom.Seed[a];
+	}
+	node.SetValue( 0.0 );
+	node.SetIndex( seedIndex );
+	seeds->Initialize();
+	seeds->InsertElement( 0, node );
+	// Bounds the arrival times computed: the front crosses the volume long
+	// before
+	const double extent = geometry.dims.nx * geometry.Spacing[0] + geometry.dims.ny * geometry.Spacing[1]
+		+ geometry.dims.nz * geometry.Spacing[2];
+
+	FloatImageType::Pointer arrival;
+	TimeStage( result, "fast marching", repetitions, [&]() {
+		FastMarchingFilterType::Pointer fastMarching = FastMarchingFilterType::New();
+		fastMarching->SetInput( speed );
+		fastMarching->SetTrialPoints( seeds );
+		fastMarching->SetOutputSize( speed->GetBufferedRegion().GetSize() );
+		fastMarching->SetStoppingValue( extent );
+		fastMarching->Update();
+		arrival = fastMarching->GetOutput();
+		arrival->DisconnectPipeline();
+	} );
+	std::size_t liverVoxels = 0;
+	for( std::size_t i = 0; i < n; ++i ) {
+		liverVoxels += phantom.Liver[i];
+	}
+	const std::vector<unsigned char> marched =
+		SmallestVoxels( arrival->GetBufferPointer(), n, liverVoxels );
+	result.Accuracy.push_back( std::make_pair( std::string( "fastMarchingDice" ),
+		medimg::DiceCoefficient( &marched[0], &phantom.Liver[0], n ) ) );
+
+	FloatImageType::Pointer initial = medimg::AllocateImage< FloatImageType >( geometry );
+	std::vector<medimg::DistanceSeed> distanceSeeds( 1 );
+	distanceSeeds[0].x = phantom.Seed[0];
+	distanceSeeds[0].y = phantom.Seed[1];
+	distanceSeeds[0].z = phantom.Seed[2];
+	distanceSeeds[0].Radius = InitialRadius;
+	std::string error;
+	bool seeded = true;
+	TimeStage( result, "initial level set", repetitions, [&]() {
+		seeded = medimg::SignedDistanceFromSeeds( distanceSeeds, geometry.dims, geometry.Spacing,
+			initial->GetBufferPointer(), error, threads ) && seeded;
+	} );
+	if( !seeded ) {
+		std::cerr << "Error: " << error << std::endl;
+	}
+
+	// Refines the fast marching segmentation
+	medimg::SignedDistanceMap( &marched[0], geometry.dims, geometry.Spacing,
+		initial->GetBufferPointer(), threads );
+	FloatImageType::Pointer levelSet;
+	TimeStage( result, "geodesic active contour", repetitions, [&]() {
+		GeodesicActiveContourFilterType::Pointer geodesicActiveContour = GeodesicActiveContourFilterType::New();
+		geodesicActiveContour->SetPropagationScaling( 1.0 );
+		geodesicActiveContour->SetCurvatureScaling( 0.2 );
+		geodesicActiveContour->SetAdvectionScaling( 4.0 );
+		geodesicActiveContour->SetMaximumRMSError( 0.01 );
+		geodesicActiveContour->SetNumberOfIterations( ContourIterations );
+		geodesicActiveContour->SetInput( initial );
+		geodesicActiveContour->SetFeatureImage( speed );
+		geodesicActiveContour->Update();
+		levelSet = geodesicActiveContour->GetOutput();
+		levelSet->DisconnectPipeline();
+	} );
+	std::vector<unsigned char> contour( n );
+	for( std::size_t i = 0; i < n; ++i ) {
+		contour[i] = levelSet->GetBufferPointer()[i] <= 0.0f;
+	}
+	result.Accuracy.push_back( std::make_pair( std::string( "geodesicActiveContourDice" ),
+		medimg::DiceCoefficient( &contour[0], &phantom.Liver[0], n ) ) );
+
+	TimeStage( result, "fastmarching end to end", repetitions, [&]() {
+		SmoothingFilterType::Pointer smoothing = SmoothingFilterType::New();
+		smoothing->SetInput( image );
+		smoothing->SetTimeStep( 0.04 );
+		smoothing->SetNumberOfIterations( 5 );
+		smoothing->SetConductanceParameter( 9.0 );
+		GradientFilterType::Pointer gradientMagnitude = GradientFilterType::New();
+		gradientMagnitude->SetInput( smoothing->GetOutput() );
+		gradientMagnitude->SetSigma( SpeedSigma );
+		SigmoidFilterType::Pointer sigmoid = SigmoidFilterType::New();
+		sigmoid->SetInput( gradientMagnitude->GetOutput() );
+		sigmoid->SetOutputMinimum( 0.0 );
+		sigmoid->SetOutputMaximum( 1.0 );
+		sigmoid->SetAlpha( ( SigmoidK2 - SigmoidK1 ) / 6 );
+		sigmoid->SetBeta( ( SigmoidK1 + SigmoidK2 ) / 2 );
+		FastMarchingFilterType::Pointer fastMarching = FastMarchingFilterType::New();
+		fastMarching->SetInput( sigmoid->GetOutput() );
+		fastMarching->SetTrialPoints( seeds );
+		fastMarching->SetOutputSize( image->GetBufferedRegion().GetSize() );
+		fastMarching->SetStoppingValue( extent );
+		fastMarching->Update();
+	} );
+
+	////////////////////////////////////////////////
+	// Vessel accuracy
+
+	std::vector<float> distance( n );
+	medimg::SquaredDistanceTransform( &phantom.Vessels[0], geometry.dims, geometry.Spacing,
+		&distance[0], threads );
+	const float maximum = *std::max_element( vesselness.begin(), vesselness.end() );
+	const float threshold = 0.1f * maximum;
+	std::vector<float> centerline, background;
+	std::size_t detected = 0, falsePositives = 0;
+	std::map< float, std::pair<double, std::size_t> > scaleByRadius;
+	for( std::size_t i = 0; i < n; ++i ) {
+		if( phantom.CenterlineRadius[i] > 0.0f ) {
+			centerline.push_back( vesselness[i] );
+			detected += vesselness[i] > threshold;
+			std::pair<double, std::size_t> &selected = scaleByRadius[phantom.CenterlineRadius[i]];
+			selected.first += frangi.FrangiScaleRange[0] + ( scale[i] - 1 ) * frangi.FrangiScaleRatio;
+			++selected.second;
+		}
+		else if( distance[i] > 9.0f ) {
+			background.push_back( vesselness[i] );
+			falsePositives += vesselness[i] > threshold;
+		}
+	}
+	result.Accuracy.push_back( std::make_pair( std::string( "vesselnessAUC" ),
+		AreaUnderROC( centerline, background ) ) );
+	result.Accuracy.push_back( std::make_pair( std::string( "centerlineDetection" ),
+		centerline.empty() ? 0.0 : static_cast<double>( detected ) / centerline.size() ) );
+	result.Accuracy.push_back( std::make_pair( std::string( "backgroundFalsePositives" ),
+		background.empty() ? 0.0 : static_cast<double>( falsePositives ) / background.size() ) );
+	for( std::map< float, std::pair<double, std::size_t> >::const_iterator r = scaleByRadius.begin();
+		r != scaleByRadius.end(); ++r ) {
+		std::ostringstream key;
+		key << "meanSigmaAtRadius" << r->first;
+		result.Accuracy.push_back( std::make_pair( key.str(), r->second.first / r->second.second ) );
+	}
+
+	result.PeakRSS = medimg::PeakResidentBytes();
+	return result;
+}
+
+
+static bool RunReference(const std::string &filename, unsigned int repetitions, unsigned int threads,
+	const std::string &scratch, CaseResult &result)
+{
+	result.Name = filename.substr( filename.find_last_of( "/\\" ) + 1 );
+	std::cout << result.Name << std::endl;
+	medimg::ResetPeakResident();
+	FloatImageType::Pointer image;
+	try {
+		TimeStage( result, "read", 1, [&]() { image = medimg::ReadImageFile< FloatImageType >( filename ); } );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return false;
+	}
+	result.dims = medimg::ImageGeometry( image.GetPointer() ).dims;
+
+	// The options of the FrangiFilter3D.m example on the stent volume
+	medimg::FrangiOptions frangi;
+	frangi.FrangiScaleRange[0] = frangi.FrangiScaleRange[1] = 1.0;
+	frangi.BlackWhite = false;
+	frangi.verbose = false;
+	frangi.NumberOfThreads = threads;
+	std::vector<float> vesselness, scale;
+	VesselAndIOStages( image, frangi, repetitions, threads, scratch, result, vesselness, scale );
+	result.PeakRSS = medimg::PeakResidentBytes();
+	return true;
+}
+
+
+static std::string EscapeJSON(const std::string &text)
+{
+	std::string escaped;
+	for( std::size_t c = 0; c < text.size(); ++c ) {
+		if( text[c] == '"' || text[c] == '\\' ) {
+			escaped += '\\';
+		}
+		escaped += text[c];
+	}
+	return escaped;
+}
+
+static bool WriteReport(const std::string &filename, const std::vector<CaseResult> &cases,
+	unsigned int repetitions, unsigned int threads)
+{
+	std::ofstream json( filename.c_str() );
+	json.precision( 6 );
+	json << "{\n  \"benchmark\": \"pipeline_benchmark\",\n  \"build\": {\"compiler\": \""
+#if defined(__VERSION__)
+		<< EscapeJSON( __VERSION__ )
+#endif
+		<< "\", \"optimized\": "
+#if defined(NDEBUG)
+		<< "true"
+#else
+		<< "false"
+#endif
+		<< "},\n  \"threads\": " << ( threads ? threads : medimg::DefaultNumberOfThreads() )
+		<< ",\n  \"repetitions\": " << repetitions << ",\n"
+		<< "  \"parameters\": {\"stageSigma\": " << StageSigma << ", \"speedSigma\": " << SpeedSigma
+		<< ", \"sigmoidK1\": " << SigmoidK1 << ", \"sigmoidK2\": " << SigmoidK2
+		<< ", \"initialRadius\": " << InitialRadius << ", \"contourIterations\": " << ContourIterations
+		<< "},\n  \"cases\": [";
+	for( std::size_t c = 0; c < cases.size(); ++c ) {
+		const CaseResult &result = cases[c];
+		const double megavoxels = result.dims.Voxels() / 1e6;
+		json << ( c ? "," : "" ) << "\n    {\n      \"name\": \"" << EscapeJSON( result.Name ) << "\",\n"
+			<< "      \"dims\": [" << result.dims.nx << ", " << result.dims.ny << ", " << result.dims.nz << "],\n"
+			<< "      \"peakRSS\": " << result.PeakRSS << ",\n      \"stages\": {";
+		for( std::size_t s = 0; s < result.Stages.size(); ++s ) {
+			const StageResult &stage = result.Stages[s];
+			json << ( s ? "," : "" ) << "\n        \"" << EscapeJSON( stage.Name ) << "\": {"
+				<< "\"fastest\": " << stage.Fastest() << ", \"median\": " << stage.Median()
+				<< ", \"cpu\": " << stage.Cpu << ", \"megavoxelsPerSecond\": "
+				<< ( stage.Fastest() > 0 ? megavoxels / stage.Fastest() : 0.0 )
+				<< ", \"bytesAllocated\": " << stage.BytesAllocated;
+			if( stage.Bytes > 0 ) {
+				json << ", \"megabytesPerSecond\": "
+					<< ( stage.Fastest() > 0 ? stage.Bytes / 1e6 / stage.Fastest() : 0.0 );
+			}
+			json << "}";
+		}
+		json << "\n      },\n      \"compression\": {";
+		for( std::size_t f = 0; f < result.Compression.size(); ++f ) {
+			json << ( f ? "," : "" ) << "\n        \"" << result.Compression[f].first << "\": "
+				<< result.Compression[f].second;
+		}
+		json << ( result.Compression.empty() ? "}," : "\n      }," ) << "\n      \"accuracy\": {";
+		for( std::size_t a = 0; a < result.Accuracy.size(); ++a ) {
+			json << ( a ? "," : "" ) << "\n        \"" << result.Accuracy[a].first << "\": "
+				<< result.Accuracy[a].second;
+		}
+		json << ( result.Accuracy.empty() ? "}" : "\n      }" ) << "\n    }";
+	}
+	json << "\n  ]\n}\n";
+	return static_cast<bool>( json );
+}
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if( argc < 2 ) {
+		std::cerr << "Usage: " << argv[0]
+			<< " <Output.json> [sizes, e.g. 64,128,192] [repetitions] [threads]"
+			<< " [ReferenceVolume ...]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string output( argv[1] );
+	std::vector<std::size_t> sizes;
+	if( argc > 2 && argv[2][0] != '\0' ) {
+		for( const char *p = argv[2]; *p; ) {
+			char *end;
+			const long size = std::strtol( p, &end, 10 );
+			if( size > 0 ) {
+				sizes.push_back( size );
+			}
+			p = *end == ',' ? end + 1 : end + std::strlen( end );
+		}
+	}
+	else {
+		sizes.push_back( 64 );
+		sizes.push_back( 128 );
+		sizes.push_back( 192 );
+	}
+	const unsigned int repetitions = argc > 3 && atoi( argv[3] ) > 0 ? atoi( argv[3] ) : 3;
+	const unsigned int threads = argc > 4 ? atoi( argv[4] ) : 0;
+	if( threads > 0 ) {
+		itk::MultiThreader::SetGlobalDefaultNumberOfThreads( threads );
+	}
+	// Temporary files of the I/O stages go next to the report
+	const std::string scratch = output + ".scratch";
+
+	std::vector<CaseResult> cases;
+	try {
+		for( std::size_t s = 0; s < sizes.size(); ++s ) {
+			cases.push_back( RunPhantom( sizes[s], repetitions, threads, scratch ) );
+		}
+		for( int r = 5; r < argc; ++r ) {
+			CaseResult result;
+			if( !RunReference( argv[r], repetitions, threads, scratch, result ) ) {
+				return EXIT_FAILURE;
+			}
+			cases.push_back( result );
+		}
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if( !WriteReport( output, cases, repetitions, threads ) ) {
+		std::cerr << "Cannot write " << output << std::endl;
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
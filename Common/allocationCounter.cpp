@@ -0,0 +1,38 @@
+//
+//  allocationCounter.cpp
+//  Common
+//
+//  Counting replacements of the global allocation functions, feeding
+//  AllocatedBytes (stageProfiler.h). Not part of medimg: replacing
+//  operator new is a whole-program choice, so only the profiled tools
+//  compile these in, through the medimg_allocation_counter objects.
+//
+
+#include <cstdlib>
+#include <new>
+#include "stageProfiler.h"
+
+
+// The array and nothrow forms of the standard library call these
+void *operator new(std::size_t size)
+{
+	medimg::CountAllocation( size );
+	if( size == 0 ) {
+		size = 1;
+	}
+	for( ;; ) {
+		if( void *p = std::malloc( size ) ) {
+			return p;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if( !handler ) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free( p );
+}
@@ -0,0 +1,40 @@
+//
+//  brickSummary.cpp
+//  Common
+//
+
+#include "brickSummary.h"
+
+
+namespace medimg
+{
+
+BrickStats BrickSummary::Query(const Box &box) const
+{
+	const Box clipped = box.Grow( 0L, &m_Grid.dims );
+	const std::size_t t = m_Grid.tile;
+	const std::size_t first[3] = { clipped.lo[0] / t, clipped.lo[1] / t, clipped.lo[2] / t };
+	const std::size_t last[3] = { (clipped.hi[0] - 1) / t, (clipped.hi[1] - 1) / t,
+		(clipped.hi[2] - 1) / t };
+
+	BrickStats q = m_Stats[first[0] + m_Grid.tilesX * (first[1] + m_Grid.tilesY * first[2])];
+	double sum = 0.0;
+	std::size_t voxels = 0;
+	for( std::size_t bz = first[2]; bz <= last[2]; ++bz ) {
+		for( std::size_t by = first[1]; by <= last[1]; ++by ) {
+			for( std::size_t bx = first[0]; bx <= last[0]; ++bx ) {
+				const std::size_t b = bx + m_Grid.tilesX * (by + m_Grid.tilesY * bz);
+				const BrickStats &s = m_Stats[b];
+				const std::size_t n = m_Grid[b].Voxels();
+				q.Min = std::min( q.Min, s.Min );
+				q.Max = std::max( q.Max, s.Max );
+				sum += static_cast<double>( s.Mean ) * n;
+				voxels += n;
+			}
+		}
+	}
+	q.Mean = static_cast<float>( sum / voxels );
+	return q;
+}
+
+} // end namespace medimg
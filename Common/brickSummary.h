@@ -0,0 +1,105 @@
+//
+//  brickSummary.h
+//  Common
+//
+//  Minimum, maximum and mean intensity of every 16^3 brick of a volume,
+//  computed once after loading. Large parts of the abdominal ROIs are air
+//  or fat; a filter can look up the range of the input under a tile plus
+//  its kernel support and, when the range proves the output there (e.g.
+//  a constant neighbourhood has a zero Hessian), skip the tile without
+//  reading a voxel of it.
+//
+
+#ifndef MEDIMG_BRICKSUMMARY_H
+#define MEDIMG_BRICKSUMMARY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "parallel.h"
+#include "volume.h"
+
+
+namespace medimg
+{
+
+struct BrickStats
+{
+	float Min, Max, Mean;
+};
+
+class BrickSummary
+{
+public:
+	static const unsigned int DefaultBrickSize = 16;
+
+	template< class TPixel >
+	BrickSummary(const TPixel *I, const Dims &dims,
+		unsigned int brickSize = DefaultBrickSize, unsigned int threads = 0)
+		: m_Grid( dims, brickSize ), m_Stats( m_Grid.Count() )
+	{
+		ParallelFor( m_Grid.Count(), threads, [&](std::size_t b, unsigned int) {
+			const Box box = m_Grid[b];
+			float lo = static_cast<float>( I[dims.Index( box.lo[0], box.lo[1], box.lo[2] )] );
+			float hi = lo;
+			double sum = 0.0;
+			for( long z = box.lo[2]; z < box.hi[2]; ++z ) {
+				for( long y = box.lo[1]; y < box.hi[1]; ++y ) {
+					const TPixel *row = I + dims.Index( 0, y, z );
+					for( long x = box.lo[0]; x < box.hi[0]; ++x ) {
+						const float v = static_cast<float>( row[x] );
+						lo = std::min( lo, v );
+						hi = std::max( hi, v );
+						sum += v;
+					}
+				}
+			}
+			m_Stats[b].Min = lo;
+			m_Stats[b].Max = hi;
+			m_Stats[b].Mean = static_cast<float>( sum / box.Voxels() );
+		} );
+	}
+
+	const TileGrid &Grid() const { return m_Grid; }
+	std::size_t Count() const { return m_Stats.size(); }
+	const BrickStats &operator[](std::size_t b) const { return m_Stats[b]; }
+
+	// Range and voxel-weighted mean of the bricks overlapping box, which is
+	// clipped to the volume first. The range can only be wider than the
+	// exact range of box, so tests against it are conservative.
+	BrickStats Query(const Box &box) const;
+
+	// Index of the brick holding voxel (x, y, z)
+	std::size_t BrickOf(std::size_t x, std::size_t y, std::size_t z) const
+	{
+		return x / m_Grid.tile + m_Grid.tilesX * (y / m_Grid.tile
+			+ m_Grid.tilesY * (z / m_Grid.tile));
+	}
+
+private:
+	TileGrid m_Grid;
+	std::vector<BrickStats> m_Stats;
+};
+
+// Whether no intensity of stats lies strictly inside (window[0],
+// window[1]): all are at or below window[0], or all at or above window[1].
+// Clamped to the window, such a brick is constant.
+inline bool OutsideWindow(const BrickStats &stats, const float window[2])
+{
+	return stats.Max <= window[0] || stats.Min >= window[1];
+}
+
+// Outcome of consulting a BrickSummary during one run
+struct SkipStatistics
+{
+	std::size_t Tiles;
+	std::size_t SkippedTiles;
+	std::size_t Voxels;
+	std::size_t SkippedVoxels;
+
+	SkipStatistics() : Tiles(0), SkippedTiles(0), Voxels(0), SkippedVoxels(0) {}
+};
+
+} // end namespace medimg
+
+#endif
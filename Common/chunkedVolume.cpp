@@ -0,0 +1,559 @@
+//
+//  chunkedVolume.cpp
+//  Common
+//
+
+#include "chunkedVolume.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+#ifdef MEDIMG_USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef MEDIMG_USE_LZ4
+#include <lz4.h>
+#endif
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const char ChunkedVolumeMagic[8] = { 'M', 'E', 'D', 'Z', 'V', 'O', 'L', '1' };
+
+// Chunks compressed (or read) before they are written (or decompressed):
+// enough to keep every worker busy without holding the whole file
+const std::size_t ChunksPerWorker = 4;
+
+bool EndsWith(const std::string &s, const char *suffix)
+{
+	const std::size_t n = std::strlen( suffix );
+	return s.size() >= n && s.compare( s.size() - n, n, suffix ) == 0;
+}
+
+// Closes the file when leaving scope
+struct File
+{
+	std::FILE *f;
+
+	File(const std::string &filename, const char *mode) : f( std::fopen( filename.c_str(), mode ) ) {}
+	~File() { if( f ) std::fclose( f ); }
+
+	template< class T >
+	bool Write(const T *values, std::size_t n = 1)
+	{
+		return std::fwrite( values, sizeof(T), n, f ) == n;
+	}
+	template< class T >
+	bool Read(T *values, std::size_t n = 1)
+	{
+		return std::fread( values, sizeof(T), n, f ) == n;
+	}
+	// Bytes from the current position to the end of the file
+	std::uint64_t Remaining()
+	{
+		const off_t position = ftello( f );
+		if( position < 0 || fseeko( f, 0, SEEK_END ) != 0 ) {
+			return 0;
+		}
+		const off_t end = ftello( f );
+		fseeko( f, position, SEEK_SET );
+		return end > position ? static_cast<std::uint64_t>( end - position ) : 0;
+	}
+	bool Close()
+	{
+		const bool closed = std::fclose( f ) == 0;
+		f = 0;
+		return closed;
+	}
+};
+
+// Byte k of value i goes to k * n + i
+void Shuffle(const unsigned char *in, std::size_t n, std::size_t bytes, unsigned char *out)
+{
+	for( std::size_t i = 0; i < n; ++i ) {
+		for( std::size_t k = 0; k < bytes; ++k ) {
+			out[k * n + i] = in[i * bytes + k];
+		}
+	}
+}
+
+void Unshuffle(const unsigned char *in, std::size_t n, std::size_t bytes, unsigned char *out)
+{
+	for( std::size_t k = 0; k < bytes; ++k ) {
+		const unsigned char *plane = in + k * n;
+		for( std::size_t i = 0; i < n; ++i ) {
+			out[i * bytes + k] = plane[i];
+		}
+	}
+}
+
+bool Compress(const ChunkedVolumeOptions &options, const unsigned char *raw, std::size_t rawBytes,
+	std::vector<unsigned char> &packed)
+{
+	switch( options.Codec ) {
+	case DeflateCodec: {
+		uLongf packedBytes = compressBound( static_cast<uLong>( rawBytes ) );
+		packed.resize( packedBytes );
+		if( compress2( packed.data(), &packedBytes, raw, static_cast<uLong>( rawBytes ),
+			options.Level > 0 ? options.Level : Z_DEFAULT_COMPRESSION ) != Z_OK ) {
+			return false;
+		}
+		packed.resize( packedBytes );
+		return true;
+	}
+#ifdef MEDIMG_USE_ZSTD
+	case ZstdCodec: {
+		packed.resize( ZSTD_compressBound( rawBytes ) );
+		const std::size_t packedBytes = ZSTD_compress( packed.data(), packed.size(), raw, rawBytes,
+			options.Level > 0 ? options.Level : 3 );
+		if( ZSTD_isError( packedBytes ) ) {
+			return false;
+		}
+		packed.resize( packedBytes );
+		return true;
+	}
+#endif
+#ifdef MEDIMG_USE_LZ4
+	case LZ4Codec: {
+		packed.resize( LZ4_compressBound( static_cast<int>( rawBytes ) ) );
+		const int packedBytes = LZ4_compress_fast( reinterpret_cast<const char *>( raw ),
+			reinterpret_cast<char *>( packed.data() ), static_cast<int>( rawBytes ),
+			static_cast<int>( packed.size() ), options.Level > 0 ? options.Level : 1 );
+		if( packedBytes <= 0 ) {
+			return false;
+		}
+		packed.resize( packedBytes );
+		return true;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+// True when packed decompresses to exactly rawBytes
+bool Decompress(VolumeCodec codec, const unsigned char *packed, std::size_t packedBytes,
+	unsigned char *raw, std::size_t rawBytes)
+{
+	switch( codec ) {
+	case DeflateCodec: {
+		uLongf n = static_cast<uLongf>( rawBytes );
+		return uncompress( raw, &n, packed, static_cast<uLong>( packedBytes ) ) == Z_OK && n == rawBytes;
+	}
+#ifdef MEDIMG_USE_ZSTD
+	case ZstdCodec:
+		return ZSTD_decompress( raw, rawBytes, packed, packedBytes ) == rawBytes;
+#endif
+#ifdef MEDIMG_USE_LZ4
+	case LZ4Codec:
+		return LZ4_decompress_safe( reinterpret_cast<const char *>( packed ),
+			reinterpret_cast<char *>( raw ), static_cast<int>( packedBytes ),
+			static_cast<int>( rawBytes ) ) == static_cast<int>( rawBytes );
+#endif
+	default:
+		return false;
+	}
+}
+
+template< class TOut, class TIn >
+void ConvertValues(const TIn *in, std::size_t n, TOut *out)
+{
+	for( std::size_t i = 0; i < n; ++i ) {
+		out[i] = static_cast<TOut>( in[i] );
+	}
+}
+
+template< class TIn >
+void ConvertFrom(const TIn *in, std::size_t n, void *out, VolumePixelType type)
+{
+	switch( type ) {
+	case UInt8Pixel: ConvertValues( in, n, static_cast<unsigned char *>( out ) ); break;
+	case Int8Pixel: ConvertValues( in, n, static_cast<signed char *>( out ) ); break;
+	case UInt16Pixel: ConvertValues( in, n, static_cast<unsigned short *>( out ) ); break;
+	case Int16Pixel: ConvertValues( in, n, static_cast<short *>( out ) ); break;
+	case UInt32Pixel: ConvertValues( in, n, static_cast<unsigned int *>( out ) ); break;
+	case Int32Pixel: ConvertValues( in, n, static_cast<int *>( out ) ); break;
+	case FloatPixel: ConvertValues( in, n, static_cast<float *>( out ) ); break;
+	case DoublePixel: ConvertValues( in, n, static_cast<double *>( out ) ); break;
+	}
+}
+
+// n values stored as `stored` to type, as a static_cast of each value
+void Convert(const void *in, VolumePixelType stored, std::size_t n, void *out, VolumePixelType type)
+{
+	switch( stored ) {
+	case UInt8Pixel: ConvertFrom( static_cast<const unsigned char *>( in ), n, out, type ); break;
+	case Int8Pixel: ConvertFrom( static_cast<const signed char *>( in ), n, out, type ); break;
+	case UInt16Pixel: ConvertFrom( static_cast<const unsigned short *>( in ), n, out, type ); break;
+	case Int16Pixel: ConvertFrom( static_cast<const short *>( in ), n, out, type ); break;
+	case UInt32Pixel: ConvertFrom( static_cast<const unsigned int *>( in ), n, out, type ); break;
+	case Int32Pixel: ConvertFrom( static_cast<const int *>( in ), n, out, type ); break;
+	case FloatPixel: ConvertFrom( static_cast<const float *>( in ), n, out, type ); break;
+	case DoublePixel: ConvertFrom( static_cast<const double *>( in ), n, out, type ); break;
+	}
+}
+
+struct Header
+{
+	Geometry geometry;
+	std::uint32_t Fields[4];	// pixel type, codec, shuffle, planes per chunk
+	std::vector<std::uint64_t> ChunkBytes;
+};
+
+std::size_t ChunkCount(const Dims &dims, std::size_t planesPerChunk)
+{
+	return dims.nz == 0 ? 0 : ( dims.nz + planesPerChunk - 1 ) / planesPerChunk;
+}
+
+bool ReadHeader(File &file, const std::string &filename, Header &header, std::string &error)
+{
+	char magic[8];
+	std::uint32_t size[3];
+	if( !file.Read( magic, 8 ) || std::memcmp( magic, ChunkedVolumeMagic, 8 ) != 0 ) {
+		error = filename + " is not a chunked volume";
+		return false;
+	}
+	if( !file.Read( size, 3 ) || !file.Read( header.geometry.Spacing, 3 )
+		|| !file.Read( header.geometry.Origin, 3 ) || !file.Read( header.geometry.Direction, 9 )
+		|| !file.Read( header.Fields, 4 ) ) {
+		error = "Error reading " + filename;
+		return false;
+	}
+	header.geometry.dims = Dims( size[0], size[1], size[2] );
+	if( header.Fields[0] > DoublePixel || header.Fields[1] > LZ4Codec || header.Fields[2] > 1
+		|| header.Fields[3] == 0 ) {
+		error = filename + ": corrupt chunked volume header";
+		return false;
+	}
+	// The table and the chunks it lists must fit in the file, checked
+	// before anything is allocated from their sizes
+	const std::size_t chunks = ChunkCount( header.geometry.dims, header.Fields[3] );
+	if( chunks > file.Remaining() / sizeof(std::uint64_t) ) {
+		error = filename + ": corrupt chunked volume header";
+		return false;
+	}
+	header.ChunkBytes.resize( chunks );
+	if( !file.Read( header.ChunkBytes.data(), header.ChunkBytes.size() ) ) {
+		error = "Error reading " + filename;
+		return false;
+	}
+	std::uint64_t left = file.Remaining();
+	for( std::size_t c = 0; c < chunks; ++c ) {
+		if( header.ChunkBytes[c] > left ) {
+			error = filename + ": corrupt chunked volume header";
+			return false;
+		}
+		left -= header.ChunkBytes[c];
+	}
+	return true;
+}
+
+} // end anonymous namespace
+
+
+std::size_t PixelBytes(VolumePixelType type)
+{
+	switch( type ) {
+	case UInt8Pixel:
+	case Int8Pixel:
+		return 1;
+	case UInt16Pixel:
+	case Int16Pixel:
+		return 2;
+	case UInt32Pixel:
+	case Int32Pixel:
+	case FloatPixel:
+		return 4;
+	default:
+		return 8;
+	}
+}
+
+
+bool CodecAvailable(VolumeCodec codec)
+{
+	switch( codec ) {
+	case DeflateCodec:
+		return true;
+#ifdef MEDIMG_USE_ZSTD
+	case ZstdCodec:
+		return true;
+#endif
+#ifdef MEDIMG_USE_LZ4
+	case LZ4Codec:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+
+const char *CodecName(VolumeCodec codec)
+{
+	switch( codec ) {
+	case ZstdCodec:
+		return "zstd";
+	case LZ4Codec:
+		return "lz4";
+	default:
+		return "zlib";
+	}
+}
+
+
+bool CodecFromName(const std::string &name, VolumeCodec &codec)
+{
+	const VolumeCodec codecs[3] = { DeflateCodec, ZstdCodec, LZ4Codec };
+	for( int c = 0; c < 3; ++c ) {
+		if( name == CodecName( codecs[c] ) ) {
+			codec = codecs[c];
+			return true;
+		}
+	}
+	return false;
+}
+
+
+ChunkedVolumeOptions ChunkedVolumeOptionsFromEnvironment()
+{
+	ChunkedVolumeOptions options;
+	const char *value = std::getenv( "MEDIMG_CODEC" );
+	if( value ) {
+		const std::string setting( value );
+		std::size_t colon = setting.find( ':' );
+		VolumeCodec codec;
+		if( CodecFromName( setting.substr( 0, colon ), codec ) && CodecAvailable( codec ) ) {
+			options.Codec = codec;
+		}
+		else {
+			std::fprintf( stderr, "MEDIMG_CODEC=%s is not available, using zlib\n", value );
+		}
+		while( colon != std::string::npos ) {
+			const std::size_t next = setting.find( ':', colon + 1 );
+			const std::string field = setting.substr( colon + 1, next - colon - 1 );
+			if( field == "shuffle" ) {
+				options.Shuffle = true;
+			}
+			else {
+				options.Level = std::atoi( field.c_str() );
+			}
+			colon = next;
+		}
+	}
+	return options;
+}
+
+
+bool WriteChunkedVolume(const std::string &filename, const Geometry &geometry, const void *voxels,
+	VolumePixelType type, const ChunkedVolumeOptions &options, std::string &error)
+{
+	if( !CodecAvailable( options.Codec ) ) {
+		error = std::string( "This build cannot write " ) + CodecName( options.Codec );
+		return false;
+	}
+	const Dims &dims = geometry.dims;
+	const std::size_t valueBytes = PixelBytes( type );
+	const std::size_t planeValues = dims.nx * dims.ny;
+	const std::size_t planeBytes = planeValues * valueBytes;
+	const std::size_t planesPerChunk = planeBytes > 0
+		? std::max<std::size_t>( 1, std::min( dims.nz, options.ChunkBytes / planeBytes ) ) : 1;
+	const std::size_t chunks = ChunkCount( dims, planesPerChunk );
+	const bool shuffle = options.Shuffle && valueBytes > 1;
+	const unsigned int threads = options.NumberOfThreads > 0 ? options.NumberOfThreads : DefaultNumberOfThreads();
+
+	// Written to filename.part, which replaces filename once complete, so
+	// an interrupted write leaves any previous volume intact
+	const std::string part = filename + ".part";
+	File file( part, "wb" );
+	if( !file.f ) {
+		error = "Cannot create " + part;
+		return false;
+	}
+	const std::uint32_t size[3] = { static_cast<std::uint32_t>( dims.nx ),
+		static_cast<std::uint32_t>( dims.ny ), static_cast<std::uint32_t>( dims.nz ) };
+	const std::uint32_t fields[4] = { static_cast<std::uint32_t>( type ),
+		static_cast<std::uint32_t>( options.Codec ), shuffle ? 1u : 0u,
+		static_cast<std::uint32_t>( planesPerChunk ) };
+	// The table of chunk sizes is filled in once they are known
+	std::vector<std::uint64_t> chunkBytes( chunks, 0 );
+	if( !file.Write( ChunkedVolumeMagic, 8 ) || !file.Write( size, 3 ) || !file.Write( geometry.Spacing, 3 )
+		|| !file.Write( geometry.Origin, 3 ) || !file.Write( geometry.Direction, 9 )
+		|| !file.Write( fields, 4 ) ) {
+		error = "Error writing " + part;
+		return false;
+	}
+	const long table = std::ftell( file.f );
+	if( !file.Write( chunkBytes.data(), chunks ) ) {
+		error = "Error writing " + part;
+		return false;
+	}
+
+	// Chunks are compressed a batch at a time and written in order
+	const unsigned char *raw = static_cast<const unsigned char *>( voxels );
+	const std::size_t batch = std::min<std::size_t>( chunks, threads * ChunksPerWorker );
+	std::vector< std::vector<unsigned char> > packed( batch );
+	std::vector< std::vector<unsigned char> > scratch( threads );
+	for( std::size_t first = 0; first < chunks; first += batch ) {
+		const std::size_t count = std::min( batch, chunks - first );
+		std::atomic<bool> failed( false );
+		ParallelFor( count, threads, [&](std::size_t i, unsigned int worker) {
+			const std::size_t c = first + i;
+			const std::size_t planes = std::min( planesPerChunk, dims.nz - c * planesPerChunk );
+			const unsigned char *chunk = raw + c * planesPerChunk * planeBytes;
+			if( shuffle ) {
+				scratch[worker].resize( planes * planeBytes );
+				Shuffle( chunk, planes * planeValues, valueBytes, scratch[worker].data() );
+				chunk = scratch[worker].data();
+			}
+			if( !Compress( options, chunk, planes * planeBytes, packed[i] ) ) {
+				failed = true;
+			}
+		} );
+		if( failed ) {
+			error = "Cannot compress " + filename;
+			return false;
+		}
+		for( std::size_t i = 0; i < count; ++i ) {
+			chunkBytes[first + i] = packed[i].size();
+			if( !file.Write( packed[i].data(), packed[i].size() ) ) {
+				error = "Error writing " + part;
+				return false;
+			}
+		}
+	}
+	if( std::fseek( file.f, table, SEEK_SET ) != 0 || !file.Write( chunkBytes.data(), chunks )
+		|| !file.Close() ) {
+		error = "Error writing " + part;
+		return false;
+	}
+	if( std::rename( part.c_str(), filename.c_str() ) != 0 ) {
+		error = "Cannot replace " + filename;
+		return false;
+	}
+	return true;
+}
+
+
+bool ReadChunkedVolumeInfo(const std::string &filename, ChunkedVolumeInfo &info, std::string &error)
+{
+	File file( filename, "rb" );
+	if( !file.f ) {
+		error = "Cannot open " + filename;
+		return false;
+	}
+	Header header;
+	if( !ReadHeader( file, filename, header, error ) ) {
+		return false;
+	}
+	info.geometry = header.geometry;
+	info.PixelType = static_cast<VolumePixelType>( header.Fields[0] );
+	info.Codec = static_cast<VolumeCodec>( header.Fields[1] );
+	info.Shuffle = header.Fields[2] != 0;
+	info.PlanesPerChunk = header.Fields[3];
+	info.CompressedBytes = 0;
+	for( std::size_t c = 0; c < header.ChunkBytes.size(); ++c ) {
+		info.CompressedBytes += header.ChunkBytes[c];
+	}
+	return true;
+}
+
+
+bool ReadChunkedVolume(const std::string &filename, void *voxels, VolumePixelType type,
+	unsigned int threads, std::string &error)
+{
+	File file( filename, "rb" );
+	if( !file.f ) {
+		error = "Cannot open " + filename;
+		return false;
+	}
+	Header header;
+	if( !ReadHeader( file, filename, header, error ) ) {
+		return false;
+	}
+	const VolumeCodec codec = static_cast<VolumeCodec>( header.Fields[1] );
+	if( !CodecAvailable( codec ) ) {
+		error = filename + " is compressed with " + CodecName( codec ) + ", which this build cannot read";
+		return false;
+	}
+	const Dims &dims = header.geometry.dims;
+	const VolumePixelType stored = static_cast<VolumePixelType>( header.Fields[0] );
+	const std::size_t valueBytes = PixelBytes( stored );
+	const std::size_t planeValues = dims.nx * dims.ny;
+	const std::size_t planeBytes = planeValues * valueBytes;
+	const std::size_t planesPerChunk = header.Fields[3];
+	const std::size_t chunks = header.ChunkBytes.size();
+	const bool shuffle = header.Fields[2] != 0;
+	// Chunks decompress straight into voxels unless they need unshuffling
+	// or converting
+	const bool direct = !shuffle && stored == type;
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+
+	unsigned char *out = static_cast<unsigned char *>( voxels );
+	const std::size_t outPlaneBytes = planeValues * PixelBytes( type );
+	const std::size_t batch = std::min<std::size_t>( chunks, threads * ChunksPerWorker );
+	std::vector< std::vector<unsigned char> > packed( batch );
+	std::vector< std::vector<unsigned char> > raw( threads ), values( threads );
+	for( std::size_t first = 0; first < chunks; first += batch ) {
+		const std::size_t count = std::min( batch, chunks - first );
+		for( std::size_t i = 0; i < count; ++i ) {
+			packed[i].resize( header.ChunkBytes[first + i] );
+			if( !file.Read( packed[i].data(), packed[i].size() ) ) {
+				error = "Error reading " + filename;
+				return false;
+			}
+		}
+		std::atomic<bool> failed( false );
+		ParallelFor( count, threads, [&](std::size_t i, unsigned int worker) {
+			const std::size_t c = first + i;
+			const std::size_t planes = std::min( planesPerChunk, dims.nz - c * planesPerChunk );
+			const std::size_t n = planes * planeValues;
+			unsigned char *target = out + c * planesPerChunk * outPlaneBytes;
+			unsigned char *chunk = target;
+			if( !direct ) {
+				raw[worker].resize( planes * planeBytes );
+				chunk = raw[worker].data();
+			}
+			if( !Decompress( codec, packed[i].data(), packed[i].size(), chunk, planes * planeBytes ) ) {
+				failed = true;
+				return;
+			}
+			if( shuffle ) {
+				unsigned char *unshuffled = target;
+				if( stored != type ) {
+					values[worker].resize( planes * planeBytes );
+					unshuffled = values[worker].data();
+				}
+				Unshuffle( chunk, n, valueBytes, unshuffled );
+				chunk = unshuffled;
+			}
+			if( stored != type ) {
+				Convert( chunk, stored, n, target, type );
+			}
+		} );
+		if( failed ) {
+			error = filename + ": corrupt chunked volume";
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool IsChunkedVolumeName(const std::string &filename)
+{
+	return EndsWith( filename, ".zvol" );
+}
+
+} // end namespace medimg
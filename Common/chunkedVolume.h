@@ -0,0 +1,147 @@
+//
+//  chunkedVolume.h
+//  Common
+//
+//  Compressed volumes written and read on all cores. ITK's writer deflates
+//  a whole image as one zlib stream on one thread, a visible part of the
+//  wall time for float intermediates such as the speed image, while
+//  uncompressed they are huge. Here the volume is cut into chunks of whole
+//  z-planes, about ChunkBytes each, that are compressed independently and
+//  in parallel, and decompressed the same way straight into the image
+//  buffer. Before compression the bytes of each chunk can be shuffled by
+//  significance (the first byte of every value, then the second, ...),
+//  which turns the slowly varying high bytes of intensity images into
+//  runs: about a third smaller for the CT volumes, but larger for sparse
+//  ones such as vesselness, hence off by default.
+//
+//  Codecs: zlib always, zstd and LZ4 when built with MEDIMG_USE_ZSTD and
+//  MEDIMG_USE_LZ4 (see CMakeLists.txt). Every file names its codec, so a
+//  reader built without it says so.
+//
+//  File layout, native byte order (little endian on all our machines):
+//
+//    char[8]   "MEDZVOL1"
+//    uint32[3] volume size, double[3] spacing, double[3] origin,
+//    double[9] direction (row-major)
+//    uint32    pixel type, codec, shuffle (0 or 1), planes per chunk
+//    uint64[chunks] compressed bytes of every chunk, then the chunks
+//
+//  Files with the extension .zvol are read and written in this format by
+//  the tools (see compactImageIO.h).
+//
+
+#ifndef MEDIMG_CHUNKEDVOLUME_H
+#define MEDIMG_CHUNKEDVOLUME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+enum VolumePixelType
+{
+	UInt8Pixel,
+	Int8Pixel,
+	UInt16Pixel,
+	Int16Pixel,
+	UInt32Pixel,
+	Int32Pixel,
+	FloatPixel,
+	DoublePixel
+};
+
+std::size_t PixelBytes(VolumePixelType type);
+
+// VolumePixelTypeOf<T>::Type for the pixel types the tools use
+template< class T > struct VolumePixelTypeOf;
+template<> struct VolumePixelTypeOf< unsigned char > { static const VolumePixelType Type = UInt8Pixel; };
+template<> struct VolumePixelTypeOf< signed char > { static const VolumePixelType Type = Int8Pixel; };
+template<> struct VolumePixelTypeOf< unsigned short > { static const VolumePixelType Type = UInt16Pixel; };
+template<> struct VolumePixelTypeOf< short > { static const VolumePixelType Type = Int16Pixel; };
+template<> struct VolumePixelTypeOf< unsigned int > { static const VolumePixelType Type = UInt32Pixel; };
+template<> struct VolumePixelTypeOf< int > { static const VolumePixelType Type = Int32Pixel; };
+template<> struct VolumePixelTypeOf< float > { static const VolumePixelType Type = FloatPixel; };
+template<> struct VolumePixelTypeOf< double > { static const VolumePixelType Type = DoublePixel; };
+
+enum VolumeCodec
+{
+	DeflateCodec,
+	ZstdCodec,
+	LZ4Codec
+};
+
+// Whether this build can write and read codec
+bool CodecAvailable(VolumeCodec codec);
+// "zlib", "zstd" or "lz4"
+const char *CodecName(VolumeCodec codec);
+// False for names not listed above
+bool CodecFromName(const std::string &name, VolumeCodec &codec);
+
+struct ChunkedVolumeOptions
+{
+	VolumeCodec Codec;
+	// Compression level of the codec, 0 for its default (zlib 6, zstd 3;
+	// for LZ4 the acceleration, 1)
+	int Level;
+	bool Shuffle;
+	// Target size of a chunk before compression; chunks hold whole planes
+	std::size_t ChunkBytes;
+	unsigned int NumberOfThreads;
+
+	ChunkedVolumeOptions()
+		: Codec( DeflateCodec ), Level( 0 ), Shuffle( false ), ChunkBytes( 1 << 20 ),
+		  NumberOfThreads( 0 ) {}
+};
+
+// The options in MEDIMG_CODEC, the codec name followed by a level and or
+// shuffle ("zstd", "lz4:4", "zlib:shuffle", "zstd:9:shuffle"); zlib at its
+// default level when it is not set
+ChunkedVolumeOptions ChunkedVolumeOptionsFromEnvironment();
+
+struct ChunkedVolumeInfo
+{
+	Geometry geometry;
+	VolumePixelType PixelType;
+	VolumeCodec Codec;
+	bool Shuffle;
+	std::size_t PlanesPerChunk;
+	// Of the chunks, without the header
+	std::uint64_t CompressedBytes;
+};
+
+// WriteChunkedVolume goes through filename.part, which replaces filename
+// once complete. Reads check the chunk table against the file size before
+// allocating from it. False with a message in error on failure.
+bool WriteChunkedVolume(const std::string &filename, const Geometry &geometry, const void *voxels,
+	VolumePixelType type, const ChunkedVolumeOptions &options, std::string &error);
+bool ReadChunkedVolumeInfo(const std::string &filename, ChunkedVolumeInfo &info, std::string &error);
+// Reads the volume into voxels (geometry.dims.Voxels() values of type),
+// converting from the pixel type stored; threads = 0 uses every core
+bool ReadChunkedVolume(const std::string &filename, void *voxels, VolumePixelType type,
+	unsigned int threads, std::string &error);
+
+template< class T >
+bool WriteChunkedVolume(const std::string &filename, const Geometry &geometry, const T *voxels,
+	const ChunkedVolumeOptions &options, std::string &error)
+{
+	return WriteChunkedVolume( filename, geometry, static_cast<const void *>( voxels ),
+		VolumePixelTypeOf<T>::Type, options, error );
+}
+
+template< class T >
+bool ReadChunkedVolume(const std::string &filename, T *voxels, unsigned int threads, std::string &error)
+{
+	return ReadChunkedVolume( filename, static_cast<void *>( voxels ), VolumePixelTypeOf<T>::Type,
+		threads, error );
+}
+
+// Whether filename ends in .zvol
+bool IsChunkedVolumeName(const std::string &filename);
+
+} // end namespace medimg
+
+#endif
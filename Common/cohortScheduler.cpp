@@ -0,0 +1,93 @@
+//
+//  cohortScheduler.cpp
+//  Common
+//
+
+#include "cohortScheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+double Seconds(const Clock::time_point &from)
+{
+	return std::chrono::duration<double>( Clock::now() - from ).count();
+}
+
+} // end anonymous namespace
+
+
+CohortScheduler::CohortScheduler(unsigned int threads, unsigned int casesAtOnce)
+	: m_Pool( new ThreadPool( threads ) ), m_Makespan( 0.0 )
+{
+	m_CasesAtOnce = casesAtOnce > 0 && casesAtOnce < m_Pool->NumberOfThreads()
+		? casesAtOnce : m_Pool->NumberOfThreads();
+}
+
+
+bool CohortScheduler::Run(std::size_t cases, const CohortCase &run)
+{
+	m_Timings.assign( cases, CohortCaseTiming() );
+	const Clock::time_point begin = Clock::now();
+
+	std::atomic<std::size_t> next( 0 );
+	std::mutex mutex;
+	std::condition_variable finished;
+	unsigned int runners = m_CasesAtOnce;
+	if( runners > cases ) {
+		runners = cases > 0 ? static_cast<unsigned int>( cases ) : 1;
+	}
+	unsigned int running = runners;
+
+	// Takes cases until none are left; its worker then helps the others
+	const std::function<void(unsigned int)> runner = [&](unsigned int worker) {
+		for( std::size_t c = next++; c < cases; c = next++ ) {
+			CohortCaseTiming &timing = m_Timings[c];
+			timing.Start = Seconds( begin );
+			timing.Worker = worker;
+			try {
+				timing.Voxels = run( c, *m_Pool );
+			} catch (std::exception &exception) {
+				timing.Error = exception.what();
+			} catch (...) {
+				timing.Error = "unknown error";
+			}
+			timing.Wall = Seconds( begin ) - timing.Start;
+		}
+		std::lock_guard<std::mutex> lock( mutex );
+		if( --running == 0 ) {
+			finished.notify_all();
+		}
+	};
+
+	// The calling thread runs cases as well
+	for( unsigned int r = 1; r < runners; ++r ) {
+		m_Pool->Post( runner );
+	}
+	runner( m_Pool->NumberOfThreads() - 1 );
+	{
+		std::unique_lock<std::mutex> lock( mutex );
+		finished.wait( lock, [&running]() { return running == 0; } );
+	}
+	m_Makespan = Seconds( begin );
+
+	for( std::size_t c = 0; c < cases; ++c ) {
+		if( !m_Timings[c].Error.empty() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // end namespace medimg
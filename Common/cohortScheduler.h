@@ -0,0 +1,78 @@
+//
+//  cohortScheduler.h
+//  Common
+//
+//  Runs the same processing on every case of a cohort within one thread
+//  budget. Starting a tool per case with default threading either
+//  oversubscribes the machine (every tool takes every core) or leaves
+//  cores idle while a case is in a serial stage such as fast marching.
+//  Here a single ThreadPool owns all threads: several cases run at once,
+//  each on one worker, and the parallel loops of their native kernels
+//  (Hessian, eigenvalues, vesselness) are shared with every worker that
+//  has no case of its own, i.e. those beyond casesAtOnce and those whose
+//  cases are done while the last ones run (threadPool.h).
+//
+
+#ifndef MEDIMG_COHORTSCHEDULER_H
+#define MEDIMG_COHORTSCHEDULER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "threadPool.h"
+
+
+namespace medimg
+{
+
+// Runs case index on the shared pool; returns the voxels it processed, for
+// the throughput. Failures are reported by throwing an exception derived
+// from std::exception.
+typedef std::function< double(std::size_t index, ThreadPool &pool) > CohortCase;
+
+// What Run() observed of one case
+struct CohortCaseTiming
+{
+	double Start, Wall;      // seconds from the start of the run
+	unsigned int Worker;
+	double Voxels;
+	std::string Error;       // empty when the case succeeded
+
+	CohortCaseTiming() : Start( 0.0 ), Wall( 0.0 ), Worker( 0 ), Voxels( 0.0 ) {}
+
+	// Voxels per second
+	double Throughput() const { return Wall > 0.0 ? Voxels / Wall : 0.0; }
+};
+
+class CohortScheduler
+{
+public:
+	// threads in all (0 uses every core), of which up to casesAtOnce run
+	// cases (0 for as many as threads); fewer cases at once bound the
+	// memory and leave more workers to the parallel stages
+	explicit CohortScheduler(unsigned int threads = 0, unsigned int casesAtOnce = 0);
+
+	ThreadPool &Pool() { return *m_Pool; }
+	unsigned int CasesAtOnce() const { return m_CasesAtOnce; }
+
+	// Runs every case in [0, cases), in order of index as workers free up.
+	// A failed case does not stop the others; returns false if any failed.
+	bool Run(std::size_t cases, const CohortCase &run);
+
+	// Of the last Run(), by case index
+	const std::vector<CohortCaseTiming> &Timings() const { return m_Timings; }
+	// Seconds from the start of the first case to the end of the last
+	double Makespan() const { return m_Makespan; }
+
+private:
+	std::unique_ptr<ThreadPool> m_Pool;
+	unsigned int m_CasesAtOnce;
+	std::vector<CohortCaseTiming> m_Timings;
+	double m_Makespan;
+};
+
+} // end namespace medimg
+
+#endif
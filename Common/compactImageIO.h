@@ -0,0 +1,246 @@
+//
+//  compactImageIO.h
+//  Common
+//
+//  Reading and writing ITK images in the compact mask and label map
+//  formats of compactLabels.h, chosen by the file extension (.bits for
+//  binary masks, .rle for label maps); any other file goes through ITK's
+//  readers and writers as before. MATLAB .mat volumes are read with
+//  matFile.h, and .zvol files are chunked volumes compressed on all cores
+//  (chunkedVolume.h). Requires ITK (header only, not part of medimg).
+//
+
+#ifndef MEDIMG_COMPACTIMAGEIO_H
+#define MEDIMG_COMPACTIMAGEIO_H
+
+#include <limits>
+#include <string>
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "chunkedVolume.h"
+#include "compactLabels.h"
+#include "matFile.h"
+
+
+namespace medimg
+{
+
+// Size, spacing, origin and direction of image
+template< class TImage >
+Geometry ImageGeometry(const TImage *image)
+{
+	Geometry geometry;
+	const typename TImage::SizeType size = image->GetBufferedRegion().GetSize();
+	geometry.dims = Dims( size[0], size[1], size[2] );
+	for( int a = 0; a < 3; ++a ) {
+		geometry.Spacing[a] = image->GetSpacing()[a];
+		geometry.Origin[a] = image->GetOrigin()[a];
+		for( int b = 0; b < 3; ++b ) {
+			geometry.Direction[3 * a + b] = image->GetDirection()[a][b];
+		}
+	}
+	return geometry;
+}
+
+// New image allocated with geometry
+template< class TImage >
+typename TImage::Pointer AllocateImage(const Geometry &geometry)
+{
+	typename TImage::Pointer image = TImage::New();
+	typename TImage::SizeType size;
+	typename TImage::SpacingType spacing;
+	typename TImage::PointType origin;
+	typename TImage::DirectionType direction;
+	size[0] = geometry.dims.nx;
+	size[1] = geometry.dims.ny;
+	size[2] = geometry.dims.nz;
+	for( int a = 0; a < 3; ++a ) {
+		spacing[a] = geometry.Spacing[a];
+		origin[a] = geometry.Origin[a];
+		for( int b = 0; b < 3; ++b ) {
+			direction[a][b] = geometry.Direction[3 * a + b];
+		}
+	}
+	image->SetRegions( size );
+	image->SetSpacing( spacing );
+	image->SetOrigin( origin );
+	image->SetDirection( direction );
+	image->Allocate();
+	return image;
+}
+
+// Writes image, which must be up to date, to filename: as a bit mask for
+// .bits (all nonzero voxels must share one value, which is stored), as runs
+// for .rle (integer pixels only), as a chunked volume for .zvol, with the
+// codec set in MEDIMG_CODEC, and with ITK's writer otherwise, which
+// compresses if compress is set. Throws itk::ExceptionObject on failure.
+template< class TImage >
+void WriteImageFile(const TImage *image, const std::string &filename, bool compress = false)
+{
+	typedef typename TImage::PixelType PixelType;
+	if( IsChunkedVolumeName( filename ) ) {
+		std::string error;
+		if( !WriteChunkedVolume( filename, ImageGeometry( image ), image->GetBufferPointer(),
+			ChunkedVolumeOptionsFromEnvironment(), error ) ) {
+			throw itk::ExceptionObject( __FILE__, __LINE__, error.c_str(), "medimg::WriteImageFile" );
+		}
+		return;
+	}
+	const CompactFormat format = CompactFormatOf( filename );
+	if( format == NotCompact ) {
+		typedef itk::ImageFileWriter< TImage > WriterType;
+		typename WriterType::Pointer writer = WriterType::New();
+		writer->SetInput( image );
+		writer->SetFileName( filename );
+		writer->SetUseCompression( compress );
+		writer->Update();
+		return;
+	}
+
+	const Geometry geometry = ImageGeometry( image );
+	const PixelType *buffer = image->GetBufferPointer();
+	std::string error;
+	bool written;
+	if( !std::numeric_limits<PixelType>::is_integer ) {
+		error = filename + ": compact formats need integer pixels";
+		written = false;
+	}
+	else if( format == BitMaskFormat ) {
+		PixelType inside = PixelType( 0 );
+		for( std::size_t i = 0; i < geometry.dims.Voxels(); ++i ) {
+			if( buffer[i] != PixelType( 0 ) ) {
+				if( inside != PixelType( 0 ) && buffer[i] != inside ) {
+					error = filename + ": a bit mask cannot hold more than one label";
+					break;
+				}
+				inside = buffer[i];
+			}
+		}
+		written = error.empty() && WriteBitMask( filename, geometry,
+			BitMask( buffer, geometry.dims ), static_cast<std::uint32_t>( inside ), error );
+	}
+	else {
+		written = WriteRunLengthLabels( filename, geometry,
+			RunLengthLabels( buffer, geometry.dims ), error );
+	}
+	if( !written ) {
+		throw itk::ExceptionObject( __FILE__, __LINE__, error.c_str(), "medimg::WriteImageFile" );
+	}
+}
+
+// Reads the largest numeric array of a MAT-file as TImage, straight into
+// the image buffer; spacing 1 and origin 0, as MAT-files carry neither.
+// Throws itk::ExceptionObject on failure.
+template< class TImage >
+typename TImage::Pointer ReadMatImage(const std::string &filename)
+{
+	MatFile file;
+	std::string error;
+	Geometry geometry;
+	typename TImage::Pointer image;
+	if( file.Open( filename, error ) ) {
+		const int array = file.Find();
+		if( array < 0 ) {
+			error = filename + " holds no numeric array";
+		}
+		else if( file.Arrays()[array].Complex ) {
+			error = filename + ": complex arrays are not supported";
+		}
+		else if( !file.Arrays()[array].VolumeDims( geometry.dims ) ) {
+			error = filename + ": array " + file.Arrays()[array].Name + " has more than 3 dimensions";
+		}
+		else {
+			image = AllocateImage< TImage >( geometry );
+			if( !file.Read( array, image->GetBufferPointer(), error ) ) {
+				image = 0;
+			}
+		}
+	}
+	if( !image ) {
+		throw itk::ExceptionObject( __FILE__, __LINE__, error.c_str(), "medimg::ReadMatImage" );
+	}
+	return image;
+}
+
+// Whether filename is read here rather than by ITK's readers: compact
+// masks and label maps, MAT-files and chunked volumes. ITK cannot read
+// their header alone, so tools that plan from it read these whole.
+inline bool IsNativeImageName(const std::string &filename)
+{
+	return CompactFormatOf( filename ) != NotCompact || IsMatFileName( filename )
+		|| IsChunkedVolumeName( filename );
+}
+
+// Reads a chunked volume as TImage, decompressing on all cores straight
+// into the image buffer. Throws itk::ExceptionObject on failure.
+template< class TImage >
+typename TImage::Pointer ReadChunkedImage(const std::string &filename)
+{
+	ChunkedVolumeInfo info;
+	std::string error;
+	typename TImage::Pointer image;
+	if( ReadChunkedVolumeInfo( filename, info, error ) ) {
+		image = AllocateImage< TImage >( info.geometry );
+		if( !ReadChunkedVolume( filename, image->GetBufferPointer(), 0, error ) ) {
+			image = 0;
+		}
+	}
+	if( !image ) {
+		throw itk::ExceptionObject( __FILE__, __LINE__, error.c_str(), "medimg::ReadChunkedImage" );
+	}
+	return image;
+}
+
+// Reads filename, in the compact format its extension selects, from a
+// MAT-file, a chunked volume or with ITK's reader, as an image of TImage.
+// Bit masks are read with their stored inside value. Throws
+// itk::ExceptionObject on failure.
+template< class TImage >
+typename TImage::Pointer ReadImageFile(const std::string &filename)
+{
+	typedef typename TImage::PixelType PixelType;
+	if( IsMatFileName( filename ) ) {
+		return ReadMatImage< TImage >( filename );
+	}
+	if( IsChunkedVolumeName( filename ) ) {
+		return ReadChunkedImage< TImage >( filename );
+	}
+	const CompactFormat format = CompactFormatOf( filename );
+	if( format == NotCompact ) {
+		typedef itk::ImageFileReader< TImage > ReaderType;
+		typename ReaderType::Pointer reader = ReaderType::New();
+		reader->SetFileName( filename );
+		reader->Update();
+		typename TImage::Pointer image = reader->GetOutput();
+		image->DisconnectPipeline();
+		return image;
+	}
+
+	Geometry geometry;
+	std::string error;
+	typename TImage::Pointer image;
+	if( format == BitMaskFormat ) {
+		BitMask mask;
+		std::uint32_t inside;
+		if( ReadBitMask( filename, geometry, mask, inside, error ) ) {
+			image = AllocateImage< TImage >( geometry );
+			mask.ToDense( image->GetBufferPointer(), static_cast<PixelType>( inside ) );
+		}
+	}
+	else {
+		RunLengthLabels labels;
+		if( ReadRunLengthLabels( filename, geometry, labels, error ) ) {
+			image = AllocateImage< TImage >( geometry );
+			labels.ToDense( image->GetBufferPointer() );
+		}
+	}
+	if( !image ) {
+		throw itk::ExceptionObject( __FILE__, __LINE__, error.c_str(), "medimg::ReadImageFile" );
+	}
+	return image;
+}
+
+} // end namespace medimg
+
+#endif
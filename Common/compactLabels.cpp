@@ -0,0 +1,233 @@
+//
+//  compactLabels.cpp
+//  Common
+//
+
+#include "compactLabels.h"
+
+#include <cstdio>
+#include <cstring>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const char BitMaskMagic[8] = { 'M', 'E', 'D', 'B', 'I', 'T', 'S', '1' };
+const char RunLengthMagic[8] = { 'M', 'E', 'D', 'R', 'L', 'E', '0', '1' };
+
+bool EndsWith(const std::string &s, const char *suffix)
+{
+	const std::size_t n = std::strlen( suffix );
+	return s.size() >= n && s.compare( s.size() - n, n, suffix ) == 0;
+}
+
+// Closes the file when leaving scope
+struct File
+{
+	std::FILE *f;
+
+	File(const std::string &filename, const char *mode) : f( std::fopen( filename.c_str(), mode ) ) {}
+	~File() { if( f ) std::fclose( f ); }
+
+	template< class T >
+	bool Write(const T *values, std::size_t n = 1)
+	{
+		return std::fwrite( values, sizeof(T), n, f ) == n;
+	}
+	template< class T >
+	bool Read(T *values, std::size_t n = 1)
+	{
+		return std::fread( values, sizeof(T), n, f ) == n;
+	}
+	bool Close()
+	{
+		const bool closed = std::fclose( f ) == 0;
+		f = 0;
+		return closed;
+	}
+};
+
+bool WriteHeader(File &file, const char magic[8], const Geometry &geometry)
+{
+	const std::uint32_t size[3] = { static_cast<std::uint32_t>( geometry.dims.nx ),
+		static_cast<std::uint32_t>( geometry.dims.ny ), static_cast<std::uint32_t>( geometry.dims.nz ) };
+	return file.Write( magic, 8 ) && file.Write( size, 3 ) && file.Write( geometry.Spacing, 3 )
+		&& file.Write( geometry.Origin, 3 ) && file.Write( geometry.Direction, 9 );
+}
+
+bool ReadHeader(File &file, const char magic[8], Geometry &geometry)
+{
+	char m[8];
+	std::uint32_t size[3];
+	if( !file.Read( m, 8 ) || std::memcmp( m, magic, 8 ) != 0 || !file.Read( size, 3 )
+		|| !file.Read( geometry.Spacing, 3 ) || !file.Read( geometry.Origin, 3 )
+		|| !file.Read( geometry.Direction, 9 ) ) {
+		return false;
+	}
+	geometry.dims = Dims( size[0], size[1], size[2] );
+	return true;
+}
+
+} // end anonymous namespace
+
+
+std::size_t BitMask::Count() const
+{
+	std::size_t n = 0;
+	for( std::size_t w = 0; w < m_Words.size(); ++w ) {
+		n += __builtin_popcountll( m_Words[w] );
+	}
+	return n;
+}
+
+
+std::uint32_t RunLengthLabels::Get(std::size_t x, std::size_t y, std::size_t z) const
+{
+	const LabelRun *begin = RowBegin( y, z ), *end = RowEnd( y, z );
+	// First run ending after x
+	const LabelRun *run = std::upper_bound( begin, end, x,
+		[](std::size_t v, const LabelRun &r) { return v < r.x1; } );
+	return run != end && run->x0 <= x ? run->Label : 0;
+}
+
+void RunLengthLabels::Assign(const Dims &dims, const std::vector<std::uint32_t> &runsPerRow,
+	std::vector<LabelRun> &runs)
+{
+	m_Dims = dims;
+	m_RowStart.resize( runsPerRow.size() + 1 );
+	m_RowStart[0] = 0;
+	for( std::size_t r = 0; r < runsPerRow.size(); ++r ) {
+		m_RowStart[r + 1] = m_RowStart[r] + runsPerRow[r];
+	}
+	m_Runs.swap( runs );
+}
+
+void RunLengthLabels::RunsPerRow(std::vector<std::uint32_t> &counts) const
+{
+	counts.resize( Rows() );
+	for( std::size_t r = 0; r < Rows(); ++r ) {
+		counts[r] = static_cast<std::uint32_t>( m_RowStart[r + 1] - m_RowStart[r] );
+	}
+}
+
+
+CompactFormat CompactFormatOf(const std::string &filename)
+{
+	if( EndsWith( filename, ".bits" ) ) {
+		return BitMaskFormat;
+	}
+	if( EndsWith( filename, ".rle" ) ) {
+		return RunLengthFormat;
+	}
+	return NotCompact;
+}
+
+
+bool WriteBitMask(const std::string &filename, const Geometry &geometry, const BitMask &mask,
+	std::uint32_t insideValue, std::string &error)
+{
+	File file( filename, "wb" );
+	if( !file.f ) {
+		error = "Cannot create " + filename;
+		return false;
+	}
+	const std::vector<std::uint64_t> &words = mask.Words();
+	if( !WriteHeader( file, BitMaskMagic, geometry ) || !file.Write( &insideValue )
+		|| !file.Write( words.data(), words.size() ) || !file.Close() ) {
+		error = "Error writing " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool ReadBitMask(const std::string &filename, Geometry &geometry, BitMask &mask,
+	std::uint32_t &insideValue, std::string &error)
+{
+	File file( filename, "rb" );
+	if( !file.f ) {
+		error = "Cannot open " + filename;
+		return false;
+	}
+	if( !ReadHeader( file, BitMaskMagic, geometry ) || !file.Read( &insideValue ) ) {
+		error = filename + " is not a bit mask";
+		return false;
+	}
+	mask = BitMask( geometry.dims );
+	std::vector<std::uint64_t> &words = mask.Words();
+	if( !file.Read( words.data(), words.size() ) ) {
+		error = filename + " is truncated";
+		return false;
+	}
+	return true;
+}
+
+bool WriteRunLengthLabels(const std::string &filename, const Geometry &geometry,
+	const RunLengthLabels &labels, std::string &error)
+{
+	File file( filename, "wb" );
+	if( !file.f ) {
+		error = "Cannot create " + filename;
+		return false;
+	}
+	std::vector<std::uint32_t> counts;
+	labels.RunsPerRow( counts );
+	const std::vector<LabelRun> &runs = labels.AllRuns();
+	bool good = WriteHeader( file, RunLengthMagic, geometry )
+		&& file.Write( counts.data(), counts.size() );
+	for( std::size_t k = 0; good && k < runs.size(); ++k ) {
+		const std::uint32_t run[3] = { runs[k].x0, runs[k].x1, runs[k].Label };
+		good = file.Write( run, 3 );
+	}
+	if( !good || !file.Close() ) {
+		error = "Error writing " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool ReadRunLengthLabels(const std::string &filename, Geometry &geometry,
+	RunLengthLabels &labels, std::string &error)
+{
+	File file( filename, "rb" );
+	if( !file.f ) {
+		error = "Cannot open " + filename;
+		return false;
+	}
+	if( !ReadHeader( file, RunLengthMagic, geometry ) ) {
+		error = filename + " is not a run-length label map";
+		return false;
+	}
+	const Dims &dims = geometry.dims;
+	std::vector<std::uint32_t> counts( dims.ny * dims.nz );
+	if( !file.Read( counts.data(), counts.size() ) ) {
+		error = filename + " is truncated";
+		return false;
+	}
+	std::size_t total = 0;
+	for( std::size_t r = 0; r < counts.size(); ++r ) {
+		total += counts[r];
+	}
+	std::vector<std::uint32_t> values( 3 * total );
+	if( !file.Read( values.data(), values.size() ) ) {
+		error = filename + " is truncated";
+		return false;
+	}
+	std::vector<LabelRun> runs( total );
+	for( std::size_t k = 0; k < total; ++k ) {
+		LabelRun &run = runs[k];
+		run.x0 = values[3 * k];
+		run.x1 = values[3 * k + 1];
+		run.Label = values[3 * k + 2];
+		if( run.x0 >= run.x1 || run.x1 > dims.nx ) {
+			error = filename + " holds a run outside its rows";
+			return false;
+		}
+	}
+	labels.Assign( dims, counts, runs );
+	return true;
+}
+
+} // end namespace medimg
@@ -0,0 +1,226 @@
+//
+//  compactLabels.h
+//  Common
+//
+//  Compact in-memory and on-disk forms of segmentation results, which
+//  otherwise spend a byte (masks) or two (label maps) per voxel on one bit
+//  or a handful of labels. Binary masks are packed 64 voxels to a word;
+//  label maps are kept as runs of equal nonzero labels along x, per row.
+//
+//  Both are written with the geometry of the volume they came from, native
+//  byte order (little endian on all our machines):
+//
+//    char[8]   "MEDBITS1" (mask) or "MEDRLE01" (label map)
+//    uint32[3] volume size, double[3] spacing, double[3] origin,
+//    double[9] direction (row-major)
+//    mask:      uint32 inside value, uint64[ceil(voxels / 64)] words
+//    label map: uint32[rows] runs per row (rows = size[1] * size[2]),
+//               then per run uint32 x0, x1 (exclusive), label
+//
+//  Files with the extensions .bits and .rle are read and written in these
+//  formats by the tools (see compactImageIO.h).
+//
+
+#ifndef MEDIMG_COMPACTLABELS_H
+#define MEDIMG_COMPACTLABELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+class BitMask
+{
+public:
+	BitMask() {}
+	explicit BitMask(const Dims &dims) : m_Dims( dims ), m_Words( (dims.Voxels() + 63) / 64, 0 ) {}
+
+	// Nonzero voxels of mask (dims.Voxels() values)
+	template< class T >
+	BitMask(const T *mask, const Dims &dims);
+
+	const Dims &GetDims() const { return m_Dims; }
+
+	void Set(std::size_t i) { m_Words[i >> 6] |= std::uint64_t( 1 ) << (i & 63); }
+	void Reset(std::size_t i) { m_Words[i >> 6] &= ~( std::uint64_t( 1 ) << (i & 63) ); }
+	bool Test(std::size_t i) const { return ( m_Words[i >> 6] >> (i & 63) ) & 1; }
+
+	// Number of voxels set
+	std::size_t Count() const;
+
+	// Calls body(i) for every voxel index i set, in increasing order;
+	// empty words are skipped 64 voxels at a time
+	template< class TBody >
+	void ForEachSet(TBody body) const
+	{
+		for( std::size_t w = 0; w < m_Words.size(); ++w ) {
+			for( std::uint64_t bits = m_Words[w]; bits; bits &= bits - 1 ) {
+				body( (w << 6) + __builtin_ctzll( bits ) );
+			}
+		}
+	}
+
+	// Voxels set get insideValue in out (dims.Voxels() values), others 0
+	template< class T >
+	void ToDense(T *out, T insideValue) const;
+
+	std::vector<std::uint64_t> &Words() { return m_Words; }
+	const std::vector<std::uint64_t> &Words() const { return m_Words; }
+
+private:
+	Dims m_Dims;
+	std::vector<std::uint64_t> m_Words;
+};
+
+// Voxels [x0, x1) of a row with the same nonzero label
+struct LabelRun
+{
+	std::uint32_t x0, x1;
+	std::uint32_t Label;
+};
+
+class RunLengthLabels
+{
+public:
+	RunLengthLabels() {}
+
+	// Runs of the label map labels (dims.Voxels() values, 0 = background)
+	template< class T >
+	RunLengthLabels(const T *labels, const Dims &dims);
+
+	const Dims &GetDims() const { return m_Dims; }
+	std::size_t Rows() const { return m_Dims.ny * m_Dims.nz; }
+
+	// Label of voxel (x, y, z), by binary search in its row
+	std::uint32_t Get(std::size_t x, std::size_t y, std::size_t z) const;
+
+	const LabelRun *RowBegin(std::size_t y, std::size_t z) const
+	{
+		return m_Runs.data() + m_RowStart[y + m_Dims.ny * z];
+	}
+	const LabelRun *RowEnd(std::size_t y, std::size_t z) const
+	{
+		return m_Runs.data() + m_RowStart[y + m_Dims.ny * z + 1];
+	}
+	std::size_t Runs() const { return m_Runs.size(); }
+
+	template< class T >
+	void ToDense(T *out) const;
+
+	// For the reader: rows and runs as stored
+	void Assign(const Dims &dims, const std::vector<std::uint32_t> &runsPerRow,
+		std::vector<LabelRun> &runs);
+	void RunsPerRow(std::vector<std::uint32_t> &counts) const;
+	const std::vector<LabelRun> &AllRuns() const { return m_Runs; }
+
+private:
+	Dims m_Dims;
+	// Index of the first run of every row, and one past the last row
+	std::vector<std::size_t> m_RowStart;
+	std::vector<LabelRun> m_Runs;
+};
+
+enum CompactFormat
+{
+	NotCompact,
+	BitMaskFormat,
+	RunLengthFormat
+};
+
+// Format selected by the extension of filename (.bits, .rle)
+CompactFormat CompactFormatOf(const std::string &filename);
+
+// False with a message in error on failure
+bool WriteBitMask(const std::string &filename, const Geometry &geometry, const BitMask &mask,
+	std::uint32_t insideValue, std::string &error);
+bool ReadBitMask(const std::string &filename, Geometry &geometry, BitMask &mask,
+	std::uint32_t &insideValue, std::string &error);
+bool WriteRunLengthLabels(const std::string &filename, const Geometry &geometry,
+	const RunLengthLabels &labels, std::string &error);
+bool ReadRunLengthLabels(const std::string &filename, Geometry &geometry,
+	RunLengthLabels &labels, std::string &error);
+
+
+template< class T >
+BitMask::BitMask(const T *mask, const Dims &dims)
+	: m_Dims( dims ), m_Words( (dims.Voxels() + 63) / 64, 0 )
+{
+	const std::size_t n = dims.Voxels();
+	for( std::size_t w = 0; w < m_Words.size(); ++w ) {
+		const std::size_t first = w << 6;
+		const std::size_t count = n - first < 64 ? n - first : 64;
+		std::uint64_t bits = 0;
+		for( std::size_t b = 0; b < count; ++b ) {
+			bits |= std::uint64_t( mask[first + b] != 0 ) << b;
+		}
+		m_Words[w] = bits;
+	}
+}
+
+template< class T >
+void BitMask::ToDense(T *out, T insideValue) const
+{
+	const std::size_t n = m_Dims.Voxels();
+	for( std::size_t w = 0; w < m_Words.size(); ++w ) {
+		const std::size_t first = w << 6;
+		const std::size_t count = n - first < 64 ? n - first : 64;
+		const std::uint64_t bits = m_Words[w];
+		if( bits == 0 ) {
+			std::fill( out + first, out + first + count, T( 0 ) );
+			continue;
+		}
+		for( std::size_t b = 0; b < count; ++b ) {
+			out[first + b] = ( bits >> b ) & 1 ? insideValue : T( 0 );
+		}
+	}
+}
+
+template< class T >
+RunLengthLabels::RunLengthLabels(const T *labels, const Dims &dims)
+	: m_Dims( dims ), m_RowStart( dims.ny * dims.nz + 1, 0 )
+{
+	for( std::size_t r = 0; r < Rows(); ++r ) {
+		m_RowStart[r] = m_Runs.size();
+		const T *row = labels + r * dims.nx;
+		for( std::size_t x = 0; x < dims.nx; ) {
+			const T label = row[x];
+			std::size_t end = x + 1;
+			while( end < dims.nx && row[end] == label ) {
+				++end;
+			}
+			if( label != T( 0 ) ) {
+				LabelRun run = { static_cast<std::uint32_t>( x ), static_cast<std::uint32_t>( end ),
+					static_cast<std::uint32_t>( label ) };
+				m_Runs.push_back( run );
+			}
+			x = end;
+		}
+	}
+	m_RowStart[Rows()] = m_Runs.size();
+}
+
+template< class T >
+void RunLengthLabels::ToDense(T *out) const
+{
+	for( std::size_t r = 0; r < Rows(); ++r ) {
+		T *row = out + r * m_Dims.nx;
+		std::size_t x = 0;
+		for( std::size_t k = m_RowStart[r]; k < m_RowStart[r + 1]; ++k ) {
+			const LabelRun &run = m_Runs[k];
+			std::fill( row + x, row + run.x0, T( 0 ) );
+			std::fill( row + run.x0, row + run.x1, static_cast<T>( run.Label ) );
+			x = run.x1;
+		}
+		std::fill( row + x, row + m_Dims.nx, T( 0 ) );
+	}
+}
+
+} // end namespace medimg
+
+#endif
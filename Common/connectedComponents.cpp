@@ -0,0 +1,374 @@
+//
+//  connectedComponents.cpp
+//  Common
+//
+
+#include "connectedComponents.h"
+
+#include <algorithm>
+#include <atomic>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Neighbours scanned before a voxel in raster order (half of the
+// neighbourhood), as offsets
+struct BackwardNeighbours
+{
+	long Offset[13][3];
+	int Count;
+	// The first Previous of them lie in the previous z plane
+	int Previous;
+
+	explicit BackwardNeighbours(Connectivity connectivity)
+	{
+		Count = Previous = 0;
+		for( long dz = -1; dz <= 0; ++dz ) {
+			for( long dy = -1; dy <= 1; ++dy ) {
+				for( long dx = -1; dx <= 1; ++dx ) {
+					if( dz == 0 && ( dy > 0 || ( dy == 0 && dx >= 0 ) ) ) {
+						continue;
+					}
+					const int nonzero = (dx != 0) + (dy != 0) + (dz != 0);
+					if( ( connectivity == Connect6 && nonzero > 1 )
+						|| ( connectivity == Connect18 && nonzero > 2 ) ) {
+						continue;
+					}
+					Offset[Count][0] = dx;
+					Offset[Count][1] = dy;
+					Offset[Count][2] = dz;
+					++Count;
+					Previous += dz < 0;
+				}
+			}
+		}
+	}
+};
+
+// Union-find over the provisional labels of one slab; a root is always
+// smaller than the labels below it
+unsigned int Find(std::vector<unsigned int> &parent, unsigned int l)
+{
+	while( parent[l] != l ) {
+		parent[l] = parent[parent[l]];
+		l = parent[l];
+	}
+	return l;
+}
+
+unsigned int Union(std::vector<unsigned int> &parent, unsigned int a, unsigned int b)
+{
+	a = Find( parent, a );
+	b = Find( parent, b );
+	if( a < b ) {
+		parent[b] = a;
+		return a;
+	}
+	parent[a] = b;
+	return b;
+}
+
+// The same across slabs, where several threads link at once
+unsigned int Find(const std::vector< std::atomic<unsigned int> > &parent, unsigned int l)
+{
+	for( unsigned int p = parent[l].load(); p != l; p = parent[l].load() ) {
+		l = p;
+	}
+	return l;
+}
+
+void Union(std::vector< std::atomic<unsigned int> > &parent, unsigned int a, unsigned int b)
+{
+	for( ;; ) {
+		a = Find( parent, a );
+		b = Find( parent, b );
+		if( a == b ) {
+			return;
+		}
+		if( a < b ) {
+			std::swap( a, b );
+		}
+		// Fails when a was linked by another thread meanwhile: retry
+		unsigned int expected = a;
+		if( parent[a].compare_exchange_strong( expected, b ) ) {
+			return;
+		}
+	}
+}
+
+void Accumulate(ComponentStats &s, long x, long y, long z, double value)
+{
+	const long p[3] = { x, y, z };
+	if( s.Voxels == 0 ) {
+		for( int a = 0; a < 3; ++a ) {
+			s.Bounds.lo[a] = p[a];
+			s.Bounds.hi[a] = p[a] + 1;
+		}
+	}
+	else {
+		for( int a = 0; a < 3; ++a ) {
+			s.Bounds.lo[a] = std::min( s.Bounds.lo[a], p[a] );
+			s.Bounds.hi[a] = std::max( s.Bounds.hi[a], p[a] + 1 );
+		}
+	}
+	++s.Voxels;
+	s.Sum += value;
+}
+
+void Merge(ComponentStats &s, const ComponentStats &t)
+{
+	if( t.Voxels == 0 ) {
+		return;
+	}
+	if( s.Voxels == 0 ) {
+		s = t;
+		return;
+	}
+	for( int a = 0; a < 3; ++a ) {
+		s.Bounds.lo[a] = std::min( s.Bounds.lo[a], t.Bounds.lo[a] );
+		s.Bounds.hi[a] = std::max( s.Bounds.hi[a], t.Bounds.hi[a] );
+	}
+	s.Voxels += t.Voxels;
+	s.Sum += t.Sum;
+}
+
+ComponentStats EmptyStats()
+{
+	ComponentStats s;
+	s.Voxels = 0;
+	s.Sum = 0.0;
+	for( int a = 0; a < 3; ++a ) {
+		s.Bounds.lo[a] = s.Bounds.hi[a] = 0;
+	}
+	return s;
+}
+
+} // end anonymous namespace
+
+
+unsigned int LabelConnectedComponents(const unsigned char *B, const Dims &dims,
+	Connectivity connectivity, unsigned int *labels,
+	std::vector<ComponentStats> *stats, const float *values, unsigned int threads)
+{
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+	const BackwardNeighbours neighbours( connectivity );
+	std::ptrdiff_t step[13];
+	for( int k = 0; k < neighbours.Count; ++k ) {
+		const long *o = neighbours.Offset[k];
+		step[k] = o[0] + static_cast<std::ptrdiff_t>( dims.nx ) * ( o[1]
+			+ static_cast<std::ptrdiff_t>( dims.ny ) * o[2] );
+	}
+	// A few slabs per thread balance uneven slabs without many faces to merge
+	const std::size_t slabs = std::max<std::size_t>( 1,
+		std::min<std::size_t>( dims.nz, 4 * threads ) );
+	std::vector<std::size_t> slabBegin( slabs + 1 );
+	for( std::size_t b = 0; b <= slabs; ++b ) {
+		slabBegin[b] = dims.nz * b / slabs;
+	}
+
+	////////////////////////////////////////////////
+	// 1) Provisional labels within every slab
+
+	// Local label -> index of its component among the slab's components
+	std::vector< std::vector<unsigned int> > local( slabs );
+	ParallelFor( slabs, threads, [&](std::size_t b, unsigned int) {
+		std::vector<unsigned int> &parent = local[b];
+		parent.assign( 1, 0 );
+		const long z0 = static_cast<long>( slabBegin[b] );
+		for( long z = z0; z < static_cast<long>( slabBegin[b + 1] ); ++z ) {
+			for( long y = 0; y < static_cast<long>( dims.ny ); ++y ) {
+				const bool innerRow = z > z0 && y > 0 && y + 1 < static_cast<long>( dims.ny );
+				std::size_t i = dims.Index( 0, y, z );
+				for( long x = 0; x < static_cast<long>( dims.nx ); ++x, ++i ) {
+					if( !B[i] ) {
+						labels[i] = 0;
+						continue;
+					}
+					const bool inner = innerRow && x > 0 && x + 1 < static_cast<long>( dims.nx );
+					unsigned int l = 0;
+					for( int k = 0; k < neighbours.Count; ++k ) {
+						if( !inner ) {
+							const long *o = neighbours.Offset[k];
+							const long qx = x + o[0], qy = y + o[1], qz = z + o[2];
+							if( qz < z0 || qy < 0 || qy >= static_cast<long>( dims.ny ) || qx < 0
+								|| qx >= static_cast<long>( dims.nx ) ) {
+								continue;
+							}
+						}
+						const unsigned int lq = labels[i + step[k]];
+						if( lq && lq != l ) {
+							l = l ? Union( parent, l, lq ) : Find( parent, lq );
+						}
+					}
+					if( !l ) {
+						l = static_cast<unsigned int>( parent.size() );
+						parent.push_back( l );
+					}
+					labels[i] = l;
+				}
+			}
+		}
+		// Roots come before the labels below them
+		unsigned int components = 0;
+		for( std::size_t l = 1; l < parent.size(); ++l ) {
+			parent[l] = parent[l] == l ? components++ : parent[parent[l]];
+		}
+		parent[0] = components;
+	} );
+
+	// Slab components are numbered consecutively across slabs
+	std::vector<unsigned int> base( slabs + 1, 0 );
+	for( std::size_t b = 0; b < slabs; ++b ) {
+		base[b + 1] = base[b] + local[b][0];
+	}
+	const unsigned int provisional = base[slabs];
+
+	////////////////////////////////////////////////
+	// 2) Global provisional labels and their statistics
+
+	std::vector< std::vector<ComponentStats> > slabStats( stats ? slabs : 0 );
+	ParallelFor( slabs, threads, [&](std::size_t b, unsigned int) {
+		const std::vector<unsigned int> &component = local[b];
+		if( stats ) {
+			slabStats[b].assign( component[0], EmptyStats() );
+		}
+		for( std::size_t z = slabBegin[b]; z < slabBegin[b + 1]; ++z ) {
+			for( std::size_t y = 0; y < dims.ny; ++y ) {
+				std::size_t i = dims.Index( 0, y, z );
+				for( std::size_t x = 0; x < dims.nx; ++x, ++i ) {
+					if( !labels[i] ) {
+						continue;
+					}
+					const unsigned int c = component[labels[i]];
+					labels[i] = base[b] + c + 1;
+					if( stats ) {
+						Accumulate( slabStats[b][c], x, y, z, values ? values[i] : 0.0 );
+					}
+				}
+			}
+		}
+		std::vector<unsigned int>().swap( local[b] );
+	} );
+
+	////////////////////////////////////////////////
+	// 3) Merge across the slab faces
+
+	std::vector< std::atomic<unsigned int> > parent( provisional );
+	for( unsigned int l = 0; l < provisional; ++l ) {
+		parent[l].store( l, std::memory_order_relaxed );
+	}
+	ParallelFor( slabs - 1, threads, [&](std::size_t face, unsigned int) {
+		const long z = static_cast<long>( slabBegin[face + 1] );
+		if( z == 0 || z >= static_cast<long>( dims.nz ) ) {
+			return;
+		}
+		for( long y = 0; y < static_cast<long>( dims.ny ); ++y ) {
+			std::size_t i = dims.Index( 0, y, z );
+			for( long x = 0; x < static_cast<long>( dims.nx ); ++x, ++i ) {
+				if( !labels[i] ) {
+					continue;
+				}
+				for( int k = 0; k < neighbours.Previous; ++k ) {
+					const long *o = neighbours.Offset[k];
+					const long qx = x + o[0], qy = y + o[1];
+					if( qy < 0 || qy >= static_cast<long>( dims.ny ) || qx < 0
+						|| qx >= static_cast<long>( dims.nx ) ) {
+						continue;
+					}
+					const unsigned int lq = labels[dims.Index( qx, qy, z - 1 )];
+					if( lq ) {
+						Union( parent, labels[i] - 1, lq - 1 );
+					}
+				}
+			}
+		}
+	} );
+
+	// Roots are the smallest provisional label of their component, i.e.
+	// the one of its first voxel in raster order
+	std::vector<unsigned int> numbering( provisional );
+	unsigned int components = 0;
+	for( unsigned int l = 0; l < provisional; ++l ) {
+		const unsigned int root = parent[l].load( std::memory_order_relaxed );
+		numbering[l] = root == l ? ++components : numbering[Find( parent, root )];
+	}
+	std::vector< std::atomic<unsigned int> >().swap( parent );
+
+	if( stats ) {
+		stats->assign( components, EmptyStats() );
+		for( std::size_t b = 0; b < slabs; ++b ) {
+			for( std::size_t c = 0; c < slabStats[b].size(); ++c ) {
+				Merge( (*stats)[numbering[base[b] + c] - 1], slabStats[b][c] );
+			}
+		}
+	}
+
+	////////////////////////////////////////////////
+	// 4) Final labels
+
+	ParallelFor( slabs, threads, [&](std::size_t b, unsigned int) {
+		const std::size_t end = dims.Index( 0, 0, slabBegin[b + 1] );
+		for( std::size_t i = dims.Index( 0, 0, slabBegin[b] ); i < end; ++i ) {
+			if( labels[i] ) {
+				labels[i] = numbering[labels[i] - 1];
+			}
+		}
+	} );
+	return components;
+}
+
+
+void RelabelComponents(unsigned int *labels, const Dims &dims,
+	const std::vector<unsigned int> &map, unsigned int threads)
+{
+	ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+		const std::size_t end = dims.Index( 0, 0, z + 1 );
+		for( std::size_t i = dims.Index( 0, 0, z ); i < end; ++i ) {
+			labels[i] = labels[i] < map.size() ? map[labels[i]] : 0;
+		}
+	} );
+}
+
+
+std::size_t ConnectedThreshold(const float *I, const Dims &dims, float lower, float upper,
+	const std::vector<std::size_t> &seeds, Connectivity connectivity, unsigned char *out,
+	unsigned char insideValue, unsigned int threads)
+{
+	ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+		const std::size_t end = dims.Index( 0, 0, z + 1 );
+		for( std::size_t i = dims.Index( 0, 0, z ); i < end; ++i ) {
+			out[i] = I[i] >= lower && I[i] <= upper;
+		}
+	} );
+
+	std::vector<unsigned int> labels( dims.Voxels() );
+	std::vector<ComponentStats> stats;
+	const unsigned int components = LabelConnectedComponents( out, dims, connectivity,
+		&labels[0], &stats, 0, threads );
+
+	std::vector<unsigned int> keep( components + 1, 0 );
+	std::size_t voxels = 0;
+	for( std::size_t s = 0; s < seeds.size(); ++s ) {
+		const unsigned int l = seeds[s] < dims.Voxels() ? labels[seeds[s]] : 0;
+		if( l && !keep[l] ) {
+			keep[l] = 1;
+			voxels += stats[l - 1].Voxels;
+		}
+	}
+	ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+		const std::size_t end = dims.Index( 0, 0, z + 1 );
+		for( std::size_t i = dims.Index( 0, 0, z ); i < end; ++i ) {
+			out[i] = keep[labels[i]] ? insideValue : 0;
+		}
+	} );
+	return voxels;
+}
+
+} // end namespace medimg
@@ -0,0 +1,68 @@
+//
+//  connectedComponents.h
+//  Common
+//
+//  Connected-component labeling of binary volumes and connected-threshold
+//  region growing built on it. The volume is cut into z-slabs that are
+//  labeled in parallel by a raster scan with a small union-find per slab;
+//  the slabs' provisional labels are then merged across the slab faces,
+//  again in parallel, by a lock-free union-find (compare-and-swap linking
+//  of the larger root to the smaller). Components are numbered 1, 2, ...
+//  in raster order of their first voxel, whatever the number of threads.
+//
+
+#ifndef MEDIMG_CONNECTEDCOMPONENTS_H
+#define MEDIMG_CONNECTEDCOMPONENTS_H
+
+#include <cstddef>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Number of neighbours a voxel is connected to: faces (6), faces and
+// edges (18) or faces, edges and corners (26)
+enum Connectivity
+{
+	Connect6 = 6,
+	Connect18 = 18,
+	Connect26 = 26
+};
+
+struct ComponentStats
+{
+	std::size_t Voxels;
+	// Bounding box [lo, hi)
+	Box Bounds;
+	// Sum of the values over the component (0 without values)
+	double Sum;
+
+	double Mean() const { return Voxels > 0 ? Sum / Voxels : 0.0; }
+};
+
+// Labels the nonzero voxels of B (dims.Voxels() values) into labels,
+// 0 for background. When stats is given it is filled with one entry per
+// component (stats[k] describes label k + 1), summing values, e.g. the
+// vesselness, when those are given. Returns the number of components.
+unsigned int LabelConnectedComponents(const unsigned char *B, const Dims &dims,
+	Connectivity connectivity, unsigned int *labels,
+	std::vector<ComponentStats> *stats = 0, const float *values = 0,
+	unsigned int threads = 0);
+
+// Renumbers labels through map (map[l] is the new label of l, 0 removes
+// it), e.g. to drop components by their statistics
+void RelabelComponents(unsigned int *labels, const Dims &dims,
+	const std::vector<unsigned int> &map, unsigned int threads = 0);
+
+// The voxels with lower <= I <= upper connected to any of the seeds
+// (voxel indices) are set to insideValue in out, all others to 0, as
+// ITK's ConnectedThresholdImageFilter does. Returns their number.
+std::size_t ConnectedThreshold(const float *I, const Dims &dims, float lower, float upper,
+	const std::vector<std::size_t> &seeds, Connectivity connectivity, unsigned char *out,
+	unsigned char insideValue = 255, unsigned int threads = 0);
+
+} // end namespace medimg
+
+#endif
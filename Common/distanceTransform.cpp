@@ -0,0 +1,235 @@
+//
+//  distanceTransform.cpp
+//  Common
+//
+
+#include "distanceTransform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const float Infinity = std::numeric_limits<float>::infinity();
+
+// Scratch space of one worker for lines of up to n voxels
+struct LineBuffers
+{
+	std::vector<float> f, d;
+	std::vector<std::size_t> v;
+	std::vector<double> z;
+
+	void Reserve(std::size_t n)
+	{
+		f.resize( n );
+		d.resize( n );
+		v.resize( n );
+		z.resize( n + 1 );
+	}
+};
+
+// 1D squared distance transform of f (n samples spacing s apart) into d:
+// d[q] = min over p of (s (q - p))^2 + f[p], from the lower envelope of the
+// parabolas rooted at the finite samples
+void TransformLine(std::size_t n, double s, LineBuffers &b)
+{
+	const float *f = &b.f[0];
+	float *d = &b.d[0];
+	std::size_t *v = &b.v[0];
+	double *z = &b.z[0];
+
+	std::size_t k = 0;
+	bool any = false;
+	for( std::size_t q = 0; q < n; ++q ) {
+		if( f[q] == Infinity ) {
+			continue;
+		}
+		if( !any ) {
+			any = true;
+			v[0] = q;
+			z[0] = -std::numeric_limits<double>::infinity();
+			z[1] = std::numeric_limits<double>::infinity();
+			continue;
+		}
+		// Drop the parabolas q's hides; z[0] = -infinity stops at the first
+		const double pq = s * q;
+		double intersection;
+		for( ;; ) {
+			const double pv = s * v[k];
+			intersection = ( (f[q] + pq * pq) - (f[v[k]] + pv * pv) ) / ( 2.0 * (pq - pv) );
+			if( intersection > z[k] ) {
+				break;
+			}
+			--k;
+		}
+		++k;
+		v[k] = q;
+		z[k] = intersection;
+		z[k + 1] = std::numeric_limits<double>::infinity();
+	}
+	if( !any ) {
+		std::fill( d, d + n, Infinity );
+		return;
+	}
+	k = 0;
+	for( std::size_t q = 0; q < n; ++q ) {
+		const double p = s * q;
+		while( z[k + 1] < p ) {
+			++k;
+		}
+		const double delta = p - s * v[k];
+		d[q] = static_cast<float>( delta * delta + f[v[k]] );
+	}
+}
+
+// Squared distances along x from the features, then along y and z
+template< class TFeature >
+void Transform(TFeature isFeature, const Dims &dims, const double spacing[3], float *out,
+	unsigned int threads)
+{
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+	const std::size_t nx = dims.nx, ny = dims.ny, nz = dims.nz, slice = nx * ny;
+	std::vector<LineBuffers> buffers( threads );
+	const std::size_t longest = std::max( nx, std::max( ny, nz ) );
+	for( unsigned int w = 0; w < threads; ++w ) {
+		buffers[w].Reserve( longest );
+	}
+	const double sx = std::fabs( spacing[0] ), sy = std::fabs( spacing[1] ), sz = std::fabs( spacing[2] );
+
+	ParallelFor( nz, threads, [&](std::size_t z, unsigned int worker) {
+		LineBuffers &b = buffers[worker];
+		for( std::size_t y = 0; y < ny; ++y ) {
+			const std::size_t row = nx * (y + ny * z);
+			for( std::size_t x = 0; x < nx; ++x ) {
+				b.f[x] = isFeature( row + x ) ? 0.0f : Infinity;
+			}
+			TransformLine( nx, sx, b );
+			std::copy( b.d.begin(), b.d.begin() + nx, out + row );
+		}
+		for( std::size_t x = 0; x < nx; ++x ) {
+			float *column = out + x + slice * z;
+			for( std::size_t y = 0; y < ny; ++y ) {
+				b.f[y] = column[nx * y];
+			}
+			TransformLine( ny, sy, b );
+			for( std::size_t y = 0; y < ny; ++y ) {
+				column[nx * y] = b.d[y];
+			}
+		}
+	} );
+
+	if( nz < 2 ) {
+		return;
+	}
+	ParallelFor( ny, threads, [&](std::size_t y, unsigned int worker) {
+		LineBuffers &b = buffers[worker];
+		for( std::size_t x = 0; x < nx; ++x ) {
+			float *column = out + x + nx * y;
+			for( std::size_t z = 0; z < nz; ++z ) {
+				b.f[z] = column[slice * z];
+			}
+			TransformLine( nz, sz, b );
+			for( std::size_t z = 0; z < nz; ++z ) {
+				column[slice * z] = b.d[z];
+			}
+		}
+	} );
+}
+
+} // end anonymous namespace
+
+
+template< class T >
+void SquaredDistanceTransform(const T *feature, const Dims &dims, const double spacing[3],
+	float *out, unsigned int threads)
+{
+	Transform( [feature](std::size_t i) { return feature[i] != T( 0 ); }, dims, spacing, out, threads );
+}
+
+template< class T >
+void SignedDistanceMap(const T *mask, const Dims &dims, const double spacing[3],
+	float *out, unsigned int threads)
+{
+	// Distance to the inside for outside voxels, then to the outside for
+	// inside voxels
+	std::vector<float> inside( dims.Voxels() );
+	Transform( [mask](std::size_t i) { return mask[i] != T( 0 ); }, dims, spacing, out, threads );
+	Transform( [mask](std::size_t i) { return mask[i] == T( 0 ); }, dims, spacing, &inside[0], threads );
+	ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+		const std::size_t first = dims.nx * dims.ny * z, last = first + dims.nx * dims.ny;
+		for( std::size_t i = first; i < last; ++i ) {
+			out[i] = mask[i] != T( 0 ) ? -std::sqrt( inside[i] ) : std::sqrt( out[i] );
+		}
+	} );
+}
+
+bool SignedDistanceFromSeeds(const std::vector<DistanceSeed> &seeds, const Dims &dims,
+	const double spacing[3], float *out, std::string &error, unsigned int threads)
+{
+	for( std::size_t s = 0; s < seeds.size(); ++s ) {
+		if( seeds[s].x >= dims.nx || seeds[s].y >= dims.ny || seeds[s].z >= dims.nz ) {
+			std::ostringstream message;
+			message << "Seed (" << seeds[s].x << ", " << seeds[s].y << ", " << seeds[s].z
+				<< ") lies outside the " << dims.nx << " x " << dims.ny << " x " << dims.nz << " image";
+			error = message.str();
+			return false;
+		}
+	}
+
+	// One transform from the centers of the seeds of every radius; with a
+	// single radius (the usual case) the result is written directly
+	std::vector<double> radii;
+	for( std::size_t s = 0; s < seeds.size(); ++s ) {
+		radii.push_back( seeds[s].Radius );
+	}
+	std::sort( radii.begin(), radii.end() );
+	radii.erase( std::unique( radii.begin(), radii.end() ), radii.end() );
+	if( radii.empty() ) {
+		std::fill( out, out + dims.Voxels(), Infinity );
+		return true;
+	}
+
+	std::vector<unsigned char> centers( dims.Voxels() );
+	std::vector<float> group( radii.size() > 1 ? dims.Voxels() : 0 );
+	for( std::size_t r = 0; r < radii.size(); ++r ) {
+		std::fill( centers.begin(), centers.end(), 0 );
+		for( std::size_t s = 0; s < seeds.size(); ++s ) {
+			if( seeds[s].Radius == radii[r] ) {
+				centers[dims.Index( seeds[s].x, seeds[s].y, seeds[s].z )] = 1;
+			}
+		}
+		float *distance = r == 0 ? out : &group[0];
+		SquaredDistanceTransform( &centers[0], dims, spacing, distance, threads );
+		const float radius = static_cast<float>( radii[r] );
+		ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+			const std::size_t first = dims.nx * dims.ny * z, last = first + dims.nx * dims.ny;
+			for( std::size_t i = first; i < last; ++i ) {
+				const float phi = std::sqrt( distance[i] ) - radius;
+				out[i] = r == 0 ? phi : std::min( out[i], phi );
+			}
+		} );
+	}
+	return true;
+}
+
+template void SquaredDistanceTransform(const unsigned char *, const Dims &, const double *, float *, unsigned int);
+template void SquaredDistanceTransform(const short *, const Dims &, const double *, float *, unsigned int);
+template void SquaredDistanceTransform(const unsigned short *, const Dims &, const double *, float *, unsigned int);
+template void SquaredDistanceTransform(const float *, const Dims &, const double *, float *, unsigned int);
+
+template void SignedDistanceMap(const unsigned char *, const Dims &, const double *, float *, unsigned int);
+template void SignedDistanceMap(const short *, const Dims &, const double *, float *, unsigned int);
+template void SignedDistanceMap(const unsigned short *, const Dims &, const double *, float *, unsigned int);
+template void SignedDistanceMap(const float *, const Dims &, const double *, float *, unsigned int);
+
+} // end namespace medimg
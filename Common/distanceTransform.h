@@ -0,0 +1,61 @@
+//
+//  distanceTransform.h
+//  Common
+//
+//  Exact Euclidean distance transforms in linear time, by the separable
+//  algorithm of Felzenszwalb and Huttenlocher (2012; the same lower
+//  envelope of parabolas as Maurer et al. 2003): squared distances are
+//  propagated along x, then y, then z, each line independently, so every
+//  pass runs in parallel over slices. Distances are in physical units of
+//  the (possibly anisotropic) voxel spacing.
+//
+//  The level-set tools start from signed distance maps built here instead
+//  of a fast marching pass from their seeds.
+//
+
+#ifndef MEDIMG_DISTANCETRANSFORM_H
+#define MEDIMG_DISTANCETRANSFORM_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Squared distance from every voxel to the nearest voxel with
+// feature[i] != 0 into out (dims.Voxels() values); infinity when there is
+// no such voxel. Instantiated for unsigned char, short, unsigned short and
+// float.
+template< class T >
+void SquaredDistanceTransform(const T *feature, const Dims &dims, const double spacing[3],
+	float *out, unsigned int threads = 0);
+
+// Signed distance to the boundary of the nonzero voxels of mask: the
+// distance to the nearest inside voxel for voxels outside, minus the
+// distance to the nearest outside voxel for voxels inside, so the zero
+// level lies halfway between the two. Instantiated as above.
+template< class T >
+void SignedDistanceMap(const T *mask, const Dims &dims, const double spacing[3],
+	float *out, unsigned int threads = 0);
+
+// A ball of radius Radius (physical units) around voxel (x, y, z)
+struct DistanceSeed
+{
+	std::size_t x, y, z;
+	double Radius;
+};
+
+// min over the seeds of (distance to the seed - Radius): the signed
+// distance to the union of the balls outside it, and the level set a fast
+// marching front started at the seeds with value -Radius approximates.
+// Costs one transform per distinct radius. Fails, leaving out untouched,
+// when a seed lies outside dims.
+bool SignedDistanceFromSeeds(const std::vector<DistanceSeed> &seeds, const Dims &dims,
+	const double spacing[3], float *out, std::string &error, unsigned int threads = 0);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,250 @@
+//
+//  hessian.cpp
+//  Common
+//
+
+#include "hessian.h"
+
+#include <algorithm>
+#include <cmath>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+std::vector<float> GaussianDerivativeKernel(double sigma, int radius, int order)
+{
+	const int length = 2 * radius + 1;
+	std::vector<float> k( length, 0.0f );
+	if( sigma <= 0 ) {
+		if( order == 0 ) {
+			k[radius] = 1.0f;
+		}
+		else if( order == 1 ) {
+			k[radius - 1] = -0.5f; k[radius + 1] = 0.5f;
+		}
+		else {
+			k[radius - 1] = 1.0f; k[radius] = -2.0f; k[radius + 1] = 1.0f;
+		}
+		return k;
+	}
+
+	std::vector<double> g( length );
+	double sum = 0.0;
+	for( int i = 0; i < length; ++i ) {
+		const double x = i - radius;
+		g[i] = std::exp( -(x * x) / (2.0 * sigma * sigma) );
+		sum += g[i];
+	}
+
+	std::vector<double> h( length );
+	if( order == 0 ) {
+		for( int i = 0; i < length; ++i ) { h[i] = g[i] / sum; }
+	}
+	else if( order == 1 ) {
+		double moment = 0.0;
+		for( int i = 0; i < length; ++i ) {
+			const double x = i - radius;
+			h[i] = x * g[i];
+			moment += x * h[i];
+		}
+		for( int i = 0; i < length; ++i ) { h[i] /= moment; }
+	}
+	else {
+		double mean = 0.0;
+		for( int i = 0; i < length; ++i ) {
+			const double x = i - radius;
+			h[i] = (x * x - sigma * sigma) * g[i];
+			mean += h[i];
+		}
+		mean /= length;
+		double moment = 0.0;
+		for( int i = 0; i < length; ++i ) {
+			const double x = i - radius;
+			h[i] -= mean;
+			moment += x * x * h[i];
+		}
+		for( int i = 0; i < length; ++i ) { h[i] *= 2.0 / moment; }
+	}
+	for( int i = 0; i < length; ++i ) { k[i] = static_cast<float>( h[i] ); }
+	return k;
+}
+
+
+HessianKernels::HessianKernels(double sigma)
+	: Sigma(sigma)
+{
+	const int radius = std::max( 1, static_cast<int>( std::ceil( 3.0 * sigma ) ) );
+	for( int a = 0; a < 3; ++a ) {
+		Radius[a] = radius;
+		for( int order = 0; order < 3; ++order ) {
+			G[a][order] = GaussianDerivativeKernel( sigma, radius, order );
+		}
+	}
+}
+
+
+HessianKernels::HessianKernels(double sigma, const double spacing[3])
+	: Sigma(sigma)
+{
+	for( int a = 0; a < 3; ++a ) {
+		const double s = sigma / spacing[a];
+		Radius[a] = std::max( 1, static_cast<int>( std::ceil( 3.0 * s ) ) );
+		double scale = 1.0;
+		for( int order = 0; order < 3; ++order, scale /= spacing[a] ) {
+			G[a][order] = GaussianDerivativeKernel( s, Radius[a], order );
+			for( std::size_t i = 0; i < G[a][order].size(); ++i ) {
+				G[a][order][i] *= static_cast<float>( scale );
+			}
+		}
+	}
+}
+
+
+void CorrelateAxis(const float *src, const std::size_t size[3], int axis,
+	const std::vector<float> &kernel, float *dst)
+{
+	const std::size_t taps = kernel.size();
+	std::size_t osize[3] = { size[0], size[1], size[2] };
+	osize[axis] -= taps - 1;
+	const std::size_t stride = axis == 0 ? 1 : ( axis == 1 ? size[0] : size[0] * size[1] );
+
+	for( std::size_t z = 0; z < osize[2]; ++z ) {
+		for( std::size_t y = 0; y < osize[1]; ++y ) {
+			const float *in = src + size[0] * (y + size[1] * z);
+			float *out = dst + osize[0] * (y + osize[1] * z);
+			if( axis == 0 ) {
+				for( std::size_t x = 0; x < osize[0]; ++x ) {
+					float acc = 0.0f;
+					for( std::size_t t = 0; t < taps; ++t ) {
+						acc += kernel[t] * in[x + t];
+					}
+					out[x] = acc;
+				}
+			}
+			else {
+				// Whole rows at a time so the inner loop is contiguous
+				std::fill( out, out + osize[0], 0.0f );
+				for( std::size_t t = 0; t < taps; ++t ) {
+					const float *row = in + t * stride;
+					const float w = kernel[t];
+					for( std::size_t x = 0; x < osize[0]; ++x ) {
+						out[x] += w * row[x];
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void GatherReplicate(const float *I, const Dims &dims, const Box &box, float *dst)
+{
+	const long ext[3] = { static_cast<long>( dims.nx ), static_cast<long>( dims.ny ),
+		static_cast<long>( dims.nz ) };
+	const std::size_t width = box.Size(0);
+	for( long z = box.lo[2]; z < box.hi[2]; ++z ) {
+		const long cz = std::min( std::max( z, 0L ), ext[2] - 1 );
+		for( long y = box.lo[1]; y < box.hi[1]; ++y ) {
+			const long cy = std::min( std::max( y, 0L ), ext[1] - 1 );
+			const float *row = I + dims.Index( 0, cy, cz );
+			float *out = dst + box.Offset( box.lo[0], y, z );
+			for( std::size_t x = 0; x < width; ++x ) {
+				const long cx = std::min( std::max( box.lo[0] + static_cast<long>( x ), 0L ), ext[0] - 1 );
+				out[x] = row[cx];
+			}
+		}
+	}
+}
+
+
+void HessianOfBox(const float *I, const Dims &dims, const Box &box,
+	const HessianKernels &kernels, ScratchArena &arena, float *const H[6],
+	const float *window)
+{
+	arena.Reset();
+	const long radius[3] = { kernels.Radius[0], kernels.Radius[1], kernels.Radius[2] };
+	const Box halo = box.Grow( radius );
+	float *in = arena.Allocate( halo.Voxels() );
+	GatherReplicate( I, dims, halo, in );
+	if( window ) {
+		for( std::size_t i = 0; i < halo.Voxels(); ++i ) {
+			in[i] = std::min( std::max( in[i], window[0] ), window[1] );
+		}
+	}
+
+	const std::size_t size[3] = { halo.Size(0), halo.Size(1), halo.Size(2) };
+	const std::size_t sizeX[3] = { box.Size(0), size[1], size[2] };
+	const std::size_t sizeY[3] = { box.Size(0), box.Size(1), size[2] };
+	const std::size_t nx = sizeX[0] * sizeX[1] * sizeX[2];
+	const std::size_t ny = sizeY[0] * sizeY[1] * sizeY[2];
+	const std::vector<float> *Gx = kernels.G[0];
+	const std::vector<float> *Gy = kernels.G[1];
+	const std::vector<float> *Gz = kernels.G[2];
+
+	// x passes: G, G', G''
+	float *x0 = arena.Allocate( nx );
+	float *x1 = arena.Allocate( nx );
+	float *x2 = arena.Allocate( nx );
+	CorrelateAxis( in, size, 0, Gx[0], x0 );
+	CorrelateAxis( in, size, 0, Gx[1], x1 );
+	CorrelateAxis( in, size, 0, Gx[2], x2 );
+
+	// y passes, named by the derivative order along x then y
+	float *y00 = arena.Allocate( ny );
+	float *y01 = arena.Allocate( ny );
+	float *y02 = arena.Allocate( ny );
+	float *y10 = arena.Allocate( ny );
+	float *y11 = arena.Allocate( ny );
+	float *y20 = arena.Allocate( ny );
+	CorrelateAxis( x0, sizeX, 1, Gy[0], y00 );
+	CorrelateAxis( x0, sizeX, 1, Gy[1], y01 );
+	CorrelateAxis( x0, sizeX, 1, Gy[2], y02 );
+	CorrelateAxis( x1, sizeX, 1, Gy[0], y10 );
+	CorrelateAxis( x1, sizeX, 1, Gy[1], y11 );
+	CorrelateAxis( x2, sizeX, 1, Gy[0], y20 );
+
+	// z passes straight into the outputs
+	CorrelateAxis( y20, sizeY, 2, Gz[0], H[0] );
+	CorrelateAxis( y02, sizeY, 2, Gz[0], H[1] );
+	CorrelateAxis( y00, sizeY, 2, Gz[2], H[2] );
+	CorrelateAxis( y11, sizeY, 2, Gz[0], H[3] );
+	CorrelateAxis( y10, sizeY, 2, Gz[1], H[4] );
+	CorrelateAxis( y01, sizeY, 2, Gz[1], H[5] );
+}
+
+
+void Hessian3D(const float *I, const Dims &dims, double sigma,
+	float *const H[6], unsigned int threads, unsigned int tileSize)
+{
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+	const HessianKernels kernels( sigma );
+	const TileGrid grid( dims, tileSize );
+	std::vector<ScratchArena> arenas( threads );
+	std::vector< std::vector<float> > tiles( threads );
+
+	ParallelFor( grid.Count(), threads, [&](std::size_t t, unsigned int worker) {
+		const Box box = grid[t];
+		const std::size_t n = box.Voxels();
+		std::vector<float> &out = tiles[worker];
+		out.resize( 6 * n );
+		float *const tileH[6] = { &out[0], &out[n], &out[2 * n], &out[3 * n],
+			&out[4 * n], &out[5 * n] };
+		HessianOfBox( I, dims, box, kernels, arenas[worker], tileH );
+
+		for( int h = 0; h < 6; ++h ) {
+			const float *src = tileH[h];
+			for( long z = box.lo[2]; z < box.hi[2]; ++z ) {
+				for( long y = box.lo[1]; y < box.hi[1]; ++y ) {
+					std::copy( src, src + box.Size(0), H[h] + dims.Index( box.lo[0], y, z ) );
+					src += box.Size(0);
+				}
+			}
+		}
+	} );
+}
+
+} // end namespace medimg
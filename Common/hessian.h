@@ -0,0 +1,113 @@
+//
+//  hessian.h
+//  Common
+//
+//  Hessian by separable Gaussian-derivative convolution. Hessian3D.m
+//  smooths with imgaussian and then applies gradient3 twice per component,
+//  sweeping temporary Dx, Dy, Dz volumes; here every second derivative is a
+//  product of 1D kernels G, G' and G'' along x, y and z instead. The x
+//  passes (G, G', G'') and y passes are shared between the components that
+//  need them, so the six components take 3 + 6 + 6 = 15 line passes rather
+//  than 18, and all intermediate blocks come from a ScratchArena that is
+//  reused from tile to tile and scale to scale.
+//
+
+#ifndef MEDIMG_HESSIAN_H
+#define MEDIMG_HESSIAN_H
+
+#include <cstddef>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Bump allocator for per-thread temporaries. Allocations stay valid until
+// the next Reset(); if a cycle needed more than the current block, the
+// block grows to that high-water mark at Reset() so later cycles (tiles,
+// scales) run without touching the heap.
+class ScratchArena
+{
+public:
+	ScratchArena() : m_Used(0) {}
+
+	float *Allocate(std::size_t n)
+	{
+		float *p;
+		if( m_Used + n <= m_Block.size() ) {
+			p = &m_Block[0] + m_Used;
+		}
+		else {
+			m_Overflow.push_back( std::vector<float>( n ) );
+			p = &m_Overflow.back()[0];
+		}
+		m_Used += n;
+		return p;
+	}
+
+	void Reset()
+	{
+		if( !m_Overflow.empty() ) {
+			m_Overflow.clear();
+			m_Block.resize( m_Used );
+		}
+		m_Used = 0;
+	}
+
+	std::size_t Capacity() const { return m_Block.size(); }
+
+private:
+	std::vector<float> m_Block;
+	std::vector< std::vector<float> > m_Overflow;
+	std::size_t m_Used;
+};
+
+// Sampled Gaussian derivative of the given order as a correlation kernel of
+// 2*radius+1 taps, normalized on the discrete grid so that constants, ramps
+// and parabolas are differentiated exactly. For sigma <= 0 plain finite
+// differences are returned.
+std::vector<float> GaussianDerivativeKernel(double sigma, int radius, int order);
+
+// G, G' and G'' for one scale along each axis, with a support of
+// ceil(3 sigma) like imgaussian's default kernel size.
+struct HessianKernels
+{
+	double Sigma;
+	// Support along x, y and z in voxels
+	int Radius[3];
+	// G[axis][order]
+	std::vector<float> G[3][3];
+
+	// sigma in voxels, the same along every axis
+	explicit HessianKernels(double sigma);
+	// sigma in physical units on a grid of the given voxel spacing, with
+	// derivatives taken per physical unit as the ITK Hessian filters do
+	HessianKernels(double sigma, const double spacing[3]);
+};
+
+// Correlates src (size[0] x size[1] x size[2], x fastest) with kernel along
+// one axis, keeping only the positions with full support: that axis shrinks
+// by the kernel length minus one in dst.
+void CorrelateAxis(const float *src, const std::size_t size[3], int axis,
+	const std::vector<float> &kernel, float *dst);
+
+// Copies box from I into dst, replicating the volume border for the parts
+// of box outside the volume (imfilter's 'replicate' option).
+void GatherReplicate(const float *I, const Dims &dims, const Box &box, float *dst);
+
+// Dxx, Dyy, Dzz, Dxy, Dxz, Dyz of I over box into H[0..5], each holding
+// box.Voxels() values. Temporaries come from arena, which is Reset() first.
+// Given window, I is clamped to [window[0], window[1]] first.
+void HessianOfBox(const float *I, const Dims &dims, const Box &box,
+	const HessianKernels &kernels, ScratchArena &arena, float *const H[6],
+	const float *window = 0);
+
+// Whole-volume Hessian at one scale, computed tile by tile on all cores
+// (threads = 0) into the six caller-owned volumes H[0..5].
+void Hessian3D(const float *I, const Dims &dims, double sigma,
+	float *const H[6], unsigned int threads = 0, unsigned int tileSize = 32);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,236 @@
+//
+//  hessianMeasure.h
+//  Common
+//
+//  Tiled multiscale driver shared by the eigenvalue-based measures (Sato,
+//  objectness). Each tile runs through all scales before the next tile is
+//  started and the responses are reduced into the running maximum and the
+//  index of the winning scale as they are computed, so no per-scale volume
+//  is ever allocated. With a mask, tiles outside the dilated mask are
+//  skipped and only the spans inside it are decomposed. Tiles whose input
+//  is constant over their kernel support have a zero Hessian and are
+//  skipped from the brick summary without being read, which leaves the
+//  output unchanged. Clamping the input (IntensityClamp) is a separate,
+//  explicit choice that changes the output; the skip then applies to the
+//  clamped input.
+//
+
+#ifndef MEDIMG_HESSIANMEASURE_H
+#define MEDIMG_HESSIANMEASURE_H
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "brickSummary.h"
+#include "hessian.h"
+#include "maskRuns.h"
+#include "symmetricEigen3.h"
+#include "threadPool.h"
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Settings common to the measures run by MultiscaleHessianMeasure
+struct HessianMeasureOptions
+{
+	// Scales in physical units
+	std::vector<double> Sigmas;
+	// Voxel spacing of the input
+	double Spacing[3];
+	// Multiply the Hessian by sigma^2 so responses of different scales can
+	// be compared
+	bool NormalizeAcrossScale;
+	// Optional mask of dims.Voxels() values. Only voxels within the kernel
+	// support of a nonzero voxel are computed; the others are set to 0.
+	const unsigned char *Mask;
+	// Intensities are clamped to [IntensityClamp[0], IntensityClamp[1]]
+	// before the Hessian when IntensityClamp[0] < IntensityClamp[1], e.g.
+	// to the range of contrast-enhanced vessels. Off by default. This
+	// changes the measure wherever the input leaves the range; tiles whose
+	// neighbourhood lies entirely below or above it are then constant and
+	// skipped.
+	float IntensityClamp[2];
+	// Brick summary of the input; computed by the filter when not given
+	const BrickSummary *Summary;
+	// Filled with the number of tiles skipped for a constant input
+	SkipStatistics *Skipped;
+	bool verbose;
+
+	// Edge length of the cubic tiles processed by one thread at a time
+	unsigned int TileSize;
+	// Used when no pool is given; 0 uses every core
+	unsigned int NumberOfThreads;
+
+	HessianMeasureOptions()
+	{
+		Spacing[0] = Spacing[1] = Spacing[2] = 1.0;
+		NormalizeAcrossScale = true;
+		Mask = 0;
+		IntensityClamp[0] = IntensityClamp[1] = 0.0f;
+		Summary = 0;
+		Skipped = 0;
+		verbose = true;
+		TileSize = 32;
+		NumberOfThreads = 0;
+	}
+};
+
+namespace detail
+{
+
+struct MeasureScratch
+{
+	ScratchArena arena;
+	std::vector<float> h;
+};
+
+} // end namespace detail
+
+// Maximum over options.Sigmas of measure(l0, l1, l2), called with the
+// eigenvalues of the Hessian in ascending order, into Iout and, when
+// given, the 1-based index of the winning sigma into whatScale.
+template< class TMeasure >
+void MultiscaleHessianMeasure(const float *I, const Dims &dims,
+	const HessianMeasureOptions &options, TMeasure measure,
+	float *Iout, float *whatScale = 0, ThreadPool *pool = 0)
+{
+	const std::vector<double> &sigmas = options.Sigmas;
+	if( sigmas.empty() ) {
+		return;
+	}
+	std::unique_ptr<ThreadPool> localPool;
+	if( !pool ) {
+		localPool.reset( new ThreadPool( options.NumberOfThreads ) );
+		pool = localPool.get();
+	}
+
+	std::vector<HessianKernels> kernels;
+	kernels.reserve( sigmas.size() );
+	for( std::size_t s = 0; s < sigmas.size(); ++s ) {
+		kernels.push_back( HessianKernels( sigmas[s], options.Spacing ) );
+	}
+
+	const TileGrid grid( dims, options.TileSize );
+	// Support of the largest kernel
+	const HessianKernels &largest = *std::max_element( kernels.begin(), kernels.end(),
+		[](const HessianKernels &a, const HessianKernels &b) { return a.Sigma < b.Sigma; } );
+	const long supportRadius[3] = { largest.Radius[0], largest.Radius[1], largest.Radius[2] };
+
+	std::unique_ptr<MaskRuns> mask;
+	std::vector<char> occupied;
+	if( options.Mask ) {
+		mask.reset( new MaskRuns( options.Mask, dims, supportRadius ) );
+		occupied.resize( grid.Count() );
+		pool->ParallelFor( grid.Count(), [&](std::size_t t, unsigned int) {
+			occupied[t] = mask->Intersects( grid[t] );
+		} );
+		std::fill( Iout, Iout + dims.Voxels(), 0.0f );
+		if( whatScale ) {
+			std::fill( whatScale, whatScale + dims.Voxels(), 0.0f );
+		}
+		if( options.verbose ) {
+			const std::size_t tiles = std::count( occupied.begin(), occupied.end(), 1 );
+			std::cout << "Mask: " << tiles << " of " << grid.Count() << " tiles, "
+				<< 100.0 * mask->Voxels() / dims.Voxels() << "% of voxels" << std::endl;
+		}
+	}
+
+	// Tiles with a constant (clamped) input over the largest support
+	const bool clamp = options.IntensityClamp[0] < options.IntensityClamp[1];
+	const float *window = clamp ? options.IntensityClamp : 0;
+	std::unique_ptr<BrickSummary> localSummary;
+	const BrickSummary *summary = options.Summary;
+	if( !summary ) {
+		localSummary.reset( new BrickSummary( I, dims, BrickSummary::DefaultBrickSize,
+			pool->NumberOfThreads() ) );
+		summary = localSummary.get();
+	}
+	std::vector<char> constant( grid.Count() );
+	pool->ParallelFor( grid.Count(), [&](std::size_t t, unsigned int) {
+		if( mask && !occupied[t] ) {
+			return;
+		}
+		const BrickStats q = summary->Query( grid[t].Grow( supportRadius ) );
+		constant[t] = q.Min == q.Max || ( clamp && OutsideWindow( q, window ) );
+	} );
+	SkipStatistics skipped;
+	for( std::size_t t = 0; t < grid.Count(); ++t ) {
+		if( mask && !occupied[t] ) {
+			continue;
+		}
+		++skipped.Tiles;
+		skipped.Voxels += grid[t].Voxels();
+		if( constant[t] ) {
+			++skipped.SkippedTiles;
+			skipped.SkippedVoxels += grid[t].Voxels();
+		}
+	}
+	if( options.Skipped ) {
+		*options.Skipped = skipped;
+	}
+	if( options.verbose ) {
+		std::cout << "Skipped " << skipped.SkippedTiles << " of " << skipped.Tiles
+			<< " tiles (" << 100.0 * skipped.SkippedVoxels / std::max<std::size_t>( skipped.Voxels, 1 )
+			<< "% of voxels) with a constant input" << std::endl;
+	}
+
+	std::vector<detail::MeasureScratch> scratch( pool->NumberOfThreads() );
+	pool->ParallelFor( grid.Count(), [&](std::size_t t, unsigned int worker) {
+		if( mask && !occupied[t] ) {
+			return;
+		}
+		const Box box = grid[t];
+		if( constant[t] ) {
+			// A zero Hessian gives 0 at every scale, first found at scale 1
+			ForEachSpan( mask.get(), box, [&](long y, long z, long x0, long x1) {
+				std::fill( Iout + dims.Index( x0, y, z ), Iout + dims.Index( x1, y, z ), 0.0f );
+				if( whatScale ) {
+					std::fill( whatScale + dims.Index( x0, y, z ),
+						whatScale + dims.Index( x1, y, z ), 1.0f );
+				}
+			} );
+			return;
+		}
+		detail::MeasureScratch &buf = scratch[worker];
+		const std::size_t n = box.Voxels();
+		buf.h.resize( 6 * n );
+		float *const H[6] = { &buf.h[0], &buf.h[n], &buf.h[2 * n], &buf.h[3 * n],
+			&buf.h[4 * n], &buf.h[5 * n] };
+
+		for( std::size_t s = 0; s < sigmas.size(); ++s ) {
+			HessianOfBox( I, dims, box, kernels[s], buf.arena, H, window );
+			const double c = options.NormalizeAcrossScale ? sigmas[s] * sigmas[s] : 1.0;
+			const float scale = static_cast<float>( s + 1 );
+
+			ForEachSpan( mask.get(), box, [&](long y, long z, long x0, long x1) {
+				float *out = Iout + dims.Index( 0, y, z );
+				float *outScale = whatScale ? whatScale + dims.Index( 0, y, z ) : 0;
+				std::size_t l = box.Offset( x0, y, z );
+				for( long x = x0; x < x1; ++x, ++l ) {
+					const double Dxx = c * H[0][l], Dyy = c * H[1][l], Dzz = c * H[2][l];
+					const double Dxy = c * H[3][l], Dxz = c * H[4][l], Dyz = c * H[5][l];
+					const double M[3][3] = {
+						{ Dxx, Dxy, Dxz }, { Dxy, Dyy, Dyz }, { Dxz, Dyz, Dzz }
+					};
+					double lambda[3];
+					SymmetricEigenvalues3( M, lambda );
+					const float v = static_cast<float>( measure( lambda[0], lambda[1], lambda[2] ) );
+
+					if( s == 0 || v > out[x] ) {
+						out[x] = v;
+						if( outScale ) {
+							outScale[x] = scale;
+						}
+					}
+				}
+			} );
+		}
+	} );
+}
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,289 @@
+//
+//  levelSetCheckpoint.cpp
+//  Common
+//
+
+#include "levelSetCheckpoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const char CheckpointMagic[8] = { 'M', 'E', 'D', 'L', 'S', 'C', 'P', '1' };
+
+enum RunClass
+{
+	Outside = 0,
+	Band = 1,
+	Inside = 2
+};
+
+// Longest run a uint32 holds next to its class
+const std::size_t MaximumRun = ( std::size_t( 1 ) << 30 ) - 1;
+
+// Deflate shrinks its input at most about 1032 times (zlib FAQ)
+const std::uint64_t MaximumDeflateRatio = 1032;
+
+// Closes the file when leaving scope
+struct File
+{
+	std::FILE *f;
+
+	File(const std::string &filename, const char *mode) : f( std::fopen( filename.c_str(), mode ) ) {}
+	~File() { if( f ) std::fclose( f ); }
+
+	template< class T >
+	bool Write(const T *values, std::size_t n = 1)
+	{
+		return std::fwrite( values, sizeof(T), n, f ) == n;
+	}
+	template< class T >
+	bool Read(T *values, std::size_t n = 1)
+	{
+		return std::fread( values, sizeof(T), n, f ) == n;
+	}
+	// Bytes from the current position to the end of the file
+	std::uint64_t Remaining()
+	{
+		const off_t position = ftello( f );
+		if( position < 0 || fseeko( f, 0, SEEK_END ) != 0 ) {
+			return 0;
+		}
+		const off_t end = ftello( f );
+		fseeko( f, position, SEEK_SET );
+		return end > position ? static_cast<std::uint64_t>( end - position ) : 0;
+	}
+	bool Close()
+	{
+		const bool closed = std::fclose( f ) == 0;
+		f = 0;
+		return closed;
+	}
+};
+
+} // end anonymous namespace
+
+
+void LevelSetCheckpoint::Capture(const float *phi, const Dims &dims, float band)
+{
+	m_Dims = dims;
+	m_Band = band;
+	m_Runs.clear();
+	m_Values.clear();
+	const std::size_t n = dims.Voxels();
+	for( std::size_t i = 0; i < n; ) {
+		const RunClass c = phi[i] >= band ? Outside : phi[i] <= -band ? Inside : Band;
+		std::size_t end = i + 1;
+		if( c == Band ) {
+			m_Values.push_back( phi[i] );
+			while( end < n && end - i < MaximumRun && phi[end] < band && phi[end] > -band ) {
+				m_Values.push_back( phi[end++] );
+			}
+		}
+		else if( c == Outside ) {
+			while( end < n && end - i < MaximumRun && phi[end] >= band ) {
+				++end;
+			}
+		}
+		else {
+			while( end < n && end - i < MaximumRun && phi[end] <= -band ) {
+				++end;
+			}
+		}
+		m_Runs.push_back( static_cast<std::uint32_t>( ( end - i ) << 2 | c ) );
+		i = end;
+	}
+	m_BandVoxels = m_Values.size();
+}
+
+
+void LevelSetCheckpoint::Capture(const float *phi, const Dims &dims)
+{
+	float band = 0.0f;
+	const std::size_t n = dims.Voxels();
+	for( std::size_t i = 0; i < n; ++i ) {
+		band = std::max( band, std::fabs( phi[i] ) );
+	}
+	Capture( phi, dims, band );
+}
+
+
+void LevelSetCheckpoint::Restore(float *phi) const
+{
+	const float *value = m_Values.data();
+	for( std::size_t r = 0; r < m_Runs.size(); ++r ) {
+		const std::size_t length = m_Runs[r] >> 2;
+		switch( m_Runs[r] & 3 ) {
+		case Outside:
+			std::fill( phi, phi + length, m_Band );
+			break;
+		case Inside:
+			std::fill( phi, phi + length, -m_Band );
+			break;
+		default:
+			std::copy( value, value + length, phi );
+			value += length;
+		}
+		phi += length;
+	}
+}
+
+
+bool LevelSetCheckpoint::Write(const std::string &filename, std::string &error) const
+{
+	// Runs and band values deflated together, at the fastest level: the
+	// point is a checkpoint every minute, not the smallest file
+	const std::size_t rawBytes = m_Runs.size() * sizeof(std::uint32_t) + m_Values.size() * sizeof(float);
+	std::vector<unsigned char> raw( rawBytes );
+	if( !m_Runs.empty() ) {
+		std::memcpy( raw.data(), m_Runs.data(), m_Runs.size() * sizeof(std::uint32_t) );
+	}
+	if( !m_Values.empty() ) {
+		std::memcpy( raw.data() + m_Runs.size() * sizeof(std::uint32_t), m_Values.data(),
+			m_Values.size() * sizeof(float) );
+	}
+	uLongf packedBytes = compressBound( static_cast<uLong>( rawBytes ) );
+	std::vector<unsigned char> packed( packedBytes );
+	if( compress2( packed.data(), &packedBytes, raw.data(), static_cast<uLong>( rawBytes ),
+		Z_BEST_SPEED ) != Z_OK ) {
+		error = "Cannot compress the checkpoint";
+		return false;
+	}
+
+	const std::string part = filename + ".part";
+	{
+		File file( part, "wb" );
+		if( !file.f ) {
+			error = "Cannot create " + part;
+			return false;
+		}
+		const std::uint32_t size[3] = { static_cast<std::uint32_t>( m_Dims.nx ),
+			static_cast<std::uint32_t>( m_Dims.ny ), static_cast<std::uint32_t>( m_Dims.nz ) };
+		const std::uint32_t iterations = Iterations;
+		const std::uint32_t history = static_cast<std::uint32_t>( RMSHistory.size() );
+		const std::uint64_t counts[3] = { m_Runs.size(), m_Values.size(), packedBytes };
+		if( !file.Write( CheckpointMagic, 8 ) || !file.Write( size, 3 ) || !file.Write( &SpeedHash )
+			|| !file.Write( &iterations ) || !file.Write( &m_Band ) || !file.Write( &history )
+			|| !file.Write( RMSHistory.data(), RMSHistory.size() ) || !file.Write( counts, 3 )
+			|| !file.Write( packed.data(), packedBytes ) || !file.Close() ) {
+			error = "Error writing " + part;
+			return false;
+		}
+	}
+	if( std::rename( part.c_str(), filename.c_str() ) != 0 ) {
+		error = "Cannot replace " + filename;
+		return false;
+	}
+	return true;
+}
+
+
+bool LevelSetCheckpoint::Read(const std::string &filename, std::string &error)
+{
+	File file( filename, "rb" );
+	if( !file.f ) {
+		error = "Cannot open " + filename;
+		return false;
+	}
+	char magic[8];
+	std::uint32_t size[3], iterations, history;
+	std::uint64_t counts[3];
+	if( !file.Read( magic, 8 ) || std::memcmp( magic, CheckpointMagic, 8 ) != 0 ) {
+		error = filename + " is not a level set checkpoint";
+		return false;
+	}
+	if( !file.Read( size, 3 ) || !file.Read( &SpeedHash ) || !file.Read( &iterations )
+		|| !file.Read( &m_Band ) || !file.Read( &history ) ) {
+		error = "Error reading " + filename;
+		return false;
+	}
+	// Sizes are checked against the file and the volume before anything is
+	// allocated from them, so a damaged file is reported rather than
+	// exhausting memory
+	if( history > file.Remaining() / sizeof(double) ) {
+		error = filename + ": corrupt checkpoint";
+		return false;
+	}
+	RMSHistory.resize( history );
+	if( !file.Read( RMSHistory.data(), history ) || !file.Read( counts, 3 ) ) {
+		error = "Error reading " + filename;
+		return false;
+	}
+	if( counts[2] > file.Remaining() ) {
+		error = filename + ": corrupt checkpoint";
+		return false;
+	}
+	// Every run covers at least one voxel, and so does every band value;
+	// together they cannot inflate beyond what deflate could have packed
+	const double volume = static_cast<double>( size[0] ) * size[1] * size[2];
+	const std::uint64_t inflated = counts[2] * MaximumDeflateRatio / sizeof(float) + 64;
+	if( counts[0] > volume || counts[1] > volume || counts[0] > inflated
+		|| counts[1] > inflated - counts[0] ) {
+		error = filename + ": corrupt checkpoint";
+		return false;
+	}
+	std::vector<unsigned char> packed( counts[2] );
+	if( !file.Read( packed.data(), packed.size() ) ) {
+		error = "Error reading " + filename;
+		return false;
+	}
+	m_Dims = Dims( size[0], size[1], size[2] );
+	Iterations = iterations;
+	m_Runs.resize( counts[0] );
+	m_Values.resize( counts[1] );
+	m_BandVoxels = m_Values.size();
+
+	const std::size_t runBytes = m_Runs.size() * sizeof(std::uint32_t);
+	std::vector<unsigned char> raw( runBytes + m_Values.size() * sizeof(float) );
+	uLongf rawBytes = static_cast<uLongf>( raw.size() );
+	if( uncompress( raw.data(), &rawBytes, packed.data(), static_cast<uLong>( packed.size() ) ) != Z_OK
+		|| rawBytes != raw.size() ) {
+		error = filename + ": corrupt checkpoint";
+		return false;
+	}
+	if( !m_Runs.empty() ) {
+		std::memcpy( m_Runs.data(), raw.data(), runBytes );
+	}
+	if( !m_Values.empty() ) {
+		std::memcpy( m_Values.data(), raw.data() + runBytes, m_Values.size() * sizeof(float) );
+	}
+
+	// The runs must cover the volume and account for every band value
+	std::size_t voxels = 0, band = 0;
+	bool classes = true;
+	for( std::size_t r = 0; r < m_Runs.size(); ++r ) {
+		voxels += m_Runs[r] >> 2;
+		if( ( m_Runs[r] & 3 ) == Band ) {
+			band += m_Runs[r] >> 2;
+		}
+		classes = classes && ( m_Runs[r] & 3 ) <= Inside;
+	}
+	if( !classes || voxels != m_Dims.Voxels() || band != m_Values.size() ) {
+		error = filename + ": corrupt checkpoint";
+		return false;
+	}
+	return true;
+}
+
+
+std::uint64_t HashVoxels(const float *values, std::size_t n)
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	for( std::size_t i = 0; i < n; ++i ) {
+		std::uint32_t bits;
+		std::memcpy( &bits, values + i, sizeof(bits) );
+		hash = ( hash ^ bits ) * 1099511628211ull;
+	}
+	return hash;
+}
+
+} // end namespace medimg
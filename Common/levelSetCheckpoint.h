@@ -0,0 +1,83 @@
+//
+//  levelSetCheckpoint.h
+//  Common
+//
+//  Snapshot of a level set evolution from which it can be resumed, e.g. by
+//  a batch job that was preempted. Only the narrow band is kept with its
+//  values, |phi| < band; elsewhere the sign is enough, since the sparse
+//  field filters rebuild their layers from the zero crossing. Voxels are
+//  stored as runs of outside, band and inside along the flat buffer, so a
+//  checkpoint costs about the band rather than the volume.
+//
+//  File layout, native byte order:
+//
+//    char[8]   "MEDLSCP1"
+//    uint32[3] volume size
+//    uint64    hash of the speed image the evolution depends on
+//    uint32    iterations done, float band
+//    uint32    n, double[n] RMS change of every iteration done
+//    uint64    runs, uint64 band voxels, uint64 compressed bytes
+//    zlib stream of uint32[runs] (length << 2 | 0 outside, 1 band,
+//    2 inside), then float[band voxels] in buffer order
+//
+
+#ifndef MEDIMG_LEVELSETCHECKPOINT_H
+#define MEDIMG_LEVELSETCHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+class LevelSetCheckpoint
+{
+public:
+	LevelSetCheckpoint() : SpeedHash( 0 ), Iterations( 0 ), m_Band( 0.0f ), m_BandVoxels( 0 ) {}
+
+	std::uint64_t SpeedHash;
+	unsigned int Iterations;
+	std::vector<double> RMSHistory;
+
+	// Keeps phi (dims.Voxels() values): the values below band in magnitude
+	// and the sign of the others
+	void Capture(const float *phi, const Dims &dims, float band);
+	// As above, with band the largest |phi|: the background value a sparse
+	// field level set filter holds beyond its outermost layer, (layers + 1)
+	// times its constant gradient, which is the smallest voxel spacing
+	// unless the filter ignores the spacing. Restore then gives phi back
+	// exactly.
+	void Capture(const float *phi, const Dims &dims);
+	// phi (dims.Voxels() values) from the band values, +band outside and
+	// -band inside
+	void Restore(float *phi) const;
+
+	const Dims &GetDims() const { return m_Dims; }
+	std::size_t BandVoxels() const { return m_BandVoxels; }
+
+	// Write() goes through filename.part, which replaces filename once
+	// complete, so an interrupted write leaves the previous checkpoint.
+	// Read() checks the sizes it finds against the file and the volume
+	// before allocating, so a damaged file fails rather than exhausting
+	// memory. False with a message in error on failure.
+	bool Write(const std::string &filename, std::string &error) const;
+	bool Read(const std::string &filename, std::string &error);
+
+private:
+	Dims m_Dims;
+	float m_Band;
+	std::size_t m_BandVoxels;
+	std::vector<std::uint32_t> m_Runs;
+	std::vector<float> m_Values;
+};
+
+// FNV-1a over the values, to tell whether a checkpoint belongs to an image
+std::uint64_t HashVoxels(const float *values, std::size_t n);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,107 @@
+//
+//  maskRuns.cpp
+//  Common
+//
+
+#include "maskRuns.h"
+
+#include <algorithm>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Box dilation of n values at stride by radius, through a running count of
+// set values in the window; line holds one line of scratch space.
+void DilateLine(unsigned char *v, std::size_t n, std::size_t stride, long radius,
+	std::vector<unsigned char> &line)
+{
+	line.resize( n );
+	for( std::size_t i = 0; i < n; ++i ) {
+		line[i] = v[i * stride] != 0;
+	}
+	const long len = static_cast<long>( n );
+	long count = 0;
+	for( long i = 0; i < radius && i < len; ++i ) {
+		count += line[i];
+	}
+	for( long i = 0; i < len; ++i ) {
+		if( i + radius < len ) {
+			count += line[i + radius];
+		}
+		if( i - radius - 1 >= 0 ) {
+			count -= line[i - radius - 1];
+		}
+		v[i * stride] = count > 0;
+	}
+}
+
+} // end anonymous namespace
+
+
+MaskRuns::MaskRuns(const unsigned char *mask, const Dims &dims, const long radius[3])
+	: m_Dims(dims), m_Voxels(0)
+{
+	std::vector<unsigned char> dilated( mask, mask + dims.Voxels() );
+	std::vector<unsigned char> line;
+	const std::size_t n[3] = { dims.nx, dims.ny, dims.nz };
+	const std::size_t stride[3] = { 1, dims.nx, dims.nx * dims.ny };
+	for( int a = 0; a < 3; ++a ) {
+		if( radius[a] <= 0 ) {
+			continue;
+		}
+		// Every line along axis a starts at a voxel with coordinate 0 there
+		const int b = a == 0 ? 1 : 0;
+		const int c = a == 2 ? 1 : 2;
+		for( std::size_t j = 0; j < n[c]; ++j ) {
+			for( std::size_t i = 0; i < n[b]; ++i ) {
+				DilateLine( &dilated[i * stride[b] + j * stride[c]], n[a], stride[a],
+					radius[a], line );
+			}
+		}
+	}
+
+	m_RowStart.reserve( dims.ny * dims.nz + 1 );
+	for( std::size_t z = 0; z < dims.nz; ++z ) {
+		for( std::size_t y = 0; y < dims.ny; ++y ) {
+			m_RowStart.push_back( m_Runs.size() );
+			const unsigned char *row = &dilated[dims.Index( 0, y, z )];
+			for( std::size_t x = 0; x < dims.nx; ) {
+				if( !row[x] ) {
+					++x;
+					continue;
+				}
+				Run r;
+				r.x0 = static_cast<long>( x );
+				while( x < dims.nx && row[x] ) {
+					++x;
+				}
+				r.x1 = static_cast<long>( x );
+				m_Runs.push_back( r );
+				m_Voxels += static_cast<std::size_t>( r.x1 - r.x0 );
+			}
+		}
+	}
+	m_RowStart.push_back( m_Runs.size() );
+}
+
+
+bool MaskRuns::Intersects(const Box &box) const
+{
+	for( long z = box.lo[2]; z < box.hi[2]; ++z ) {
+		for( long y = box.lo[1]; y < box.hi[1]; ++y ) {
+			const Run *end = RowEnd( y, z );
+			for( const Run *r = RowBegin( y, z ); r != end && r->x0 < box.hi[0]; ++r ) {
+				if( r->x1 > box.lo[0] ) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+} // end namespace medimg
@@ -0,0 +1,86 @@
+//
+//  maskRuns.h
+//  Common
+//
+//  Compact voxel set for restricting the native filters to an organ mask.
+//  The mask is dilated by the support of the largest kernel (so responses
+//  near the organ boundary are complete) and stored as sorted x-runs per
+//  row rather than as another volume. Filters ask it whether a tile holds
+//  any voxel at all, skipping empty tiles entirely, and walk only the
+//  spans inside the set in the others.
+//
+
+#ifndef MEDIMG_MASKRUNS_H
+#define MEDIMG_MASKRUNS_H
+
+#include <cstddef>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Voxels [x0, x1) of one row
+struct Run
+{
+	long x0, x1;
+};
+
+class MaskRuns
+{
+public:
+	// Nonzero voxels of mask (dims.Voxels() values), dilated by radius[a]
+	// voxels on both sides along axis a (a box structuring element)
+	MaskRuns(const unsigned char *mask, const Dims &dims, const long radius[3]);
+
+	const Dims &GetDims() const { return m_Dims; }
+	// Number of voxels in the set
+	std::size_t Voxels() const { return m_Voxels; }
+
+	// Runs of row (y, z), sorted and disjoint
+	const Run *RowBegin(std::size_t y, std::size_t z) const
+	{
+		return m_Runs.data() + m_RowStart[y + m_Dims.ny * z];
+	}
+	const Run *RowEnd(std::size_t y, std::size_t z) const
+	{
+		return m_Runs.data() + m_RowStart[y + m_Dims.ny * z + 1];
+	}
+
+	// Whether any voxel of box (inside the volume) is in the set
+	bool Intersects(const Box &box) const;
+
+private:
+	Dims m_Dims;
+	std::vector<std::size_t> m_RowStart;
+	std::vector<Run> m_Runs;
+	std::size_t m_Voxels;
+};
+
+// Calls body(y, z, x0, x1) for the spans of box that are in mask, or for
+// every row of box when mask is null.
+template< class TBody >
+void ForEachSpan(const MaskRuns *mask, const Box &box, TBody body)
+{
+	for( long z = box.lo[2]; z < box.hi[2]; ++z ) {
+		for( long y = box.lo[1]; y < box.hi[1]; ++y ) {
+			if( !mask ) {
+				body( y, z, box.lo[0], box.hi[0] );
+				continue;
+			}
+			const Run *end = mask->RowEnd( y, z );
+			for( const Run *r = mask->RowBegin( y, z ); r != end && r->x0 < box.hi[0]; ++r ) {
+				const long x0 = r->x0 > box.lo[0] ? r->x0 : box.lo[0];
+				const long x1 = r->x1 < box.hi[0] ? r->x1 : box.hi[0];
+				if( x0 < x1 ) {
+					body( y, z, x0, x1 );
+				}
+			}
+		}
+	}
+}
+
+} // end namespace medimg
+
+#endif
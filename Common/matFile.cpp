@@ -0,0 +1,488 @@
+//
+//  matFile.cpp
+//  Common
+//
+
+#include "matFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Data types of MAT-file elements
+enum
+{
+	miINT8 = 1, miUINT8 = 2, miINT16 = 3, miUINT16 = 4, miINT32 = 5, miUINT32 = 6,
+	miSINGLE = 7, miDOUBLE = 9, miINT64 = 12, miUINT64 = 13, miMATRIX = 14,
+	miCOMPRESSED = 15
+};
+
+std::size_t SizeOfType(std::uint32_t type)
+{
+	switch( type ) {
+		case miINT8: case miUINT8: return 1;
+		case miINT16: case miUINT16: return 2;
+		case miINT32: case miUINT32: case miSINGLE: return 4;
+		case miDOUBLE: case miINT64: case miUINT64: return 8;
+		default: return 0;
+	}
+}
+
+template< class T >
+T SwapBytes(T value)
+{
+	unsigned char *bytes = reinterpret_cast<unsigned char *>( &value );
+	std::reverse( bytes, bytes + sizeof(T) );
+	return value;
+}
+
+// Bytes of the data of one top-level element, read from the file or
+// inflated from it
+class ByteSource
+{
+public:
+	virtual ~ByteSource() {}
+	// Exactly n bytes into destination
+	virtual bool Read(void *destination, std::size_t n) = 0;
+
+	bool Skip(std::size_t n)
+	{
+		char buffer[4096];
+		while( n > 0 ) {
+			const std::size_t chunk = std::min( n, sizeof(buffer) );
+			if( !Read( buffer, chunk ) ) {
+				return false;
+			}
+			n -= chunk;
+		}
+		return true;
+	}
+};
+
+class FileSource : public ByteSource
+{
+public:
+	FileSource(std::FILE *file, std::uint64_t size) : m_File( file ), m_Remaining( size ) {}
+
+	bool Read(void *destination, std::size_t n)
+	{
+		if( n > m_Remaining || std::fread( destination, 1, n, m_File ) != n ) {
+			return false;
+		}
+		m_Remaining -= n;
+		return true;
+	}
+
+private:
+	std::FILE *m_File;
+	std::uint64_t m_Remaining;
+};
+
+class InflateSource : public ByteSource
+{
+public:
+	InflateSource(std::FILE *file, std::uint64_t size)
+		: m_File( file ), m_Remaining( size ), m_Input( 256 * 1024 ), m_Valid( true )
+	{
+		std::memset( &m_Stream, 0, sizeof(m_Stream) );
+		m_Valid = inflateInit( &m_Stream ) == Z_OK;
+	}
+	~InflateSource() { inflateEnd( &m_Stream ); }
+
+	bool Read(void *destination, std::size_t n)
+	{
+		unsigned char *out = static_cast<unsigned char *>( destination );
+		while( m_Valid && n > 0 ) {
+			// avail_out is 32 bits wide
+			const std::size_t chunk = std::min<std::size_t>( n, 1u << 30 );
+			m_Stream.next_out = out;
+			m_Stream.avail_out = static_cast<uInt>( chunk );
+			while( m_Stream.avail_out > 0 ) {
+				if( m_Stream.avail_in == 0 ) {
+					const std::size_t size = static_cast<std::size_t>(
+						std::min<std::uint64_t>( m_Remaining, m_Input.size() ) );
+					if( size == 0 || std::fread( &m_Input[0], 1, size, m_File ) != size ) {
+						return m_Valid = false;
+					}
+					m_Remaining -= size;
+					m_Stream.next_in = &m_Input[0];
+					m_Stream.avail_in = static_cast<uInt>( size );
+				}
+				const int status = inflate( &m_Stream, Z_NO_FLUSH );
+				if( ( status != Z_OK && status != Z_STREAM_END )
+					|| ( status == Z_STREAM_END && m_Stream.avail_out > 0 ) ) {
+					return m_Valid = false;
+				}
+			}
+			out += chunk;
+			n -= chunk;
+		}
+		return m_Valid;
+	}
+
+private:
+	std::FILE *m_File;
+	std::uint64_t m_Remaining;
+	std::vector<unsigned char> m_Input;
+	z_stream m_Stream;
+	bool m_Valid;
+};
+
+// Tag of a subelement; the data of small elements (up to 4 bytes) is
+// packed into the tag
+struct Tag
+{
+	std::uint32_t Type, Bytes;
+	bool Small;
+	unsigned char Data[4];
+};
+
+bool ReadTag(ByteSource &source, bool swap, Tag &tag)
+{
+	unsigned char raw[8];
+	if( !source.Read( raw, 8 ) ) {
+		return false;
+	}
+	std::uint32_t first;
+	std::memcpy( &first, raw, 4 );
+	if( swap ) {
+		first = SwapBytes( first );
+	}
+	tag.Small = ( first >> 16 ) != 0;
+	if( tag.Small ) {
+		tag.Type = first & 0xffff;
+		tag.Bytes = first >> 16;
+		std::memcpy( tag.Data, raw + 4, 4 );
+		return tag.Bytes <= 4;
+	}
+	tag.Type = first;
+	std::memcpy( &tag.Bytes, raw + 4, 4 );
+	if( swap ) {
+		tag.Bytes = SwapBytes( tag.Bytes );
+	}
+	return true;
+}
+
+// Data of a subelement that is not part of an array's values, with the
+// padding to 8 bytes skipped
+bool ReadSubelement(ByteSource &source, bool swap, std::uint32_t type, std::vector<unsigned char> &data)
+{
+	Tag tag;
+	if( !ReadTag( source, swap, tag ) || tag.Type != type ) {
+		return false;
+	}
+	if( tag.Small ) {
+		data.assign( tag.Data, tag.Data + tag.Bytes );
+		return true;
+	}
+	data.resize( tag.Bytes );
+	return ( tag.Bytes == 0 || source.Read( &data[0], tag.Bytes ) )
+		&& source.Skip( ( 8 - tag.Bytes % 8 ) % 8 );
+}
+
+// Array flags, dimensions and name of a miMATRIX element, up to its real
+// part; false if it is not a numeric array (or malformed)
+bool ReadArrayHeader(ByteSource &source, bool swap, MatArrayInfo &info)
+{
+	std::vector<unsigned char> data;
+	if( !ReadSubelement( source, swap, miUINT32, data ) || data.size() != 8 ) {
+		return false;
+	}
+	std::uint32_t flags;
+	std::memcpy( &flags, &data[0], 4 );
+	if( swap ) {
+		flags = SwapBytes( flags );
+	}
+	const std::uint32_t mxClass = flags & 0xff;
+	if( mxClass < MatDouble || mxClass > MatUInt64 ) {
+		return false;
+	}
+	info.Class = static_cast<MatClass>( mxClass );
+	info.Complex = ( flags & 0x0800 ) != 0;
+	info.Logical = ( flags & 0x0200 ) != 0;
+
+	if( !ReadSubelement( source, swap, miINT32, data ) || data.size() % 4 != 0 ) {
+		return false;
+	}
+	info.Size.clear();
+	for( std::size_t d = 0; d < data.size(); d += 4 ) {
+		std::int32_t size;
+		std::memcpy( &size, &data[d], 4 );
+		if( swap ) {
+			size = SwapBytes( size );
+		}
+		if( size < 0 ) {
+			return false;
+		}
+		info.Size.push_back( size );
+	}
+
+	if( !ReadSubelement( source, swap, miINT8, data ) ) {
+		return false;
+	}
+	info.Name.assign( data.begin(), data.end() );
+	return true;
+}
+
+// Converts count values of the stored type S to T
+template< class S, class T >
+void ConvertValues(const unsigned char *raw, std::size_t count, bool swap, T *out)
+{
+	for( std::size_t i = 0; i < count; ++i ) {
+		S value;
+		std::memcpy( &value, raw + i * sizeof(S), sizeof(S) );
+		if( swap ) {
+			value = SwapBytes( value );
+		}
+		out[i] = static_cast<T>( value );
+	}
+}
+
+template< class T >
+void Convert(std::uint32_t type, const unsigned char *raw, std::size_t count, bool swap, T *out)
+{
+	switch( type ) {
+		case miINT8: ConvertValues< std::int8_t >( raw, count, swap, out ); break;
+		case miUINT8: ConvertValues< std::uint8_t >( raw, count, swap, out ); break;
+		case miINT16: ConvertValues< std::int16_t >( raw, count, swap, out ); break;
+		case miUINT16: ConvertValues< std::uint16_t >( raw, count, swap, out ); break;
+		case miINT32: ConvertValues< std::int32_t >( raw, count, swap, out ); break;
+		case miUINT32: ConvertValues< std::uint32_t >( raw, count, swap, out ); break;
+		case miSINGLE: ConvertValues< float >( raw, count, swap, out ); break;
+		case miDOUBLE: ConvertValues< double >( raw, count, swap, out ); break;
+		case miINT64: ConvertValues< std::int64_t >( raw, count, swap, out ); break;
+		case miUINT64: ConvertValues< std::uint64_t >( raw, count, swap, out ); break;
+	}
+}
+
+// Element type holding T unchanged
+template< class T > std::uint32_t TypeOf() { return 0; }
+template<> std::uint32_t TypeOf< unsigned char >() { return miUINT8; }
+template<> std::uint32_t TypeOf< short >() { return miINT16; }
+template<> std::uint32_t TypeOf< unsigned short >() { return miUINT16; }
+template<> std::uint32_t TypeOf< float >() { return miSINGLE; }
+template<> std::uint32_t TypeOf< double >() { return miDOUBLE; }
+
+// Closes the file when leaving scope
+struct FileCloser
+{
+	std::FILE *file;
+	~FileCloser() { if( file ) { std::fclose( file ); } }
+};
+
+} // end anonymous namespace
+
+
+std::size_t MatArrayInfo::Elements() const
+{
+	std::size_t n = 1;
+	for( std::size_t d = 0; d < Size.size(); ++d ) {
+		n *= Size[d];
+	}
+	return n;
+}
+
+bool MatArrayInfo::VolumeDims(Dims &dims) const
+{
+	std::size_t size[3] = { 1, 1, 1 };
+	for( std::size_t d = 0; d < Size.size(); ++d ) {
+		if( d < 3 ) {
+			size[d] = Size[d];
+		}
+		else if( Size[d] != 1 ) {
+			return false;
+		}
+	}
+	dims = Dims( size[0], size[1], size[2] );
+	return true;
+}
+
+
+bool MatFile::Open(const std::string &filename, std::string &error)
+{
+	m_Filename = filename;
+	m_Arrays.clear();
+	m_Locations.clear();
+	std::FILE *file = std::fopen( filename.c_str(), "rb" );
+	FileCloser closer = { file };
+	if( !file ) {
+		error = "Cannot open " + filename;
+		return false;
+	}
+	unsigned char header[128];
+	if( std::fread( header, 1, 128, file ) != 128 ) {
+		error = filename + " is not a MAT-file";
+		return false;
+	}
+	if( std::memcmp( header, "MATLAB 7.3", 10 ) == 0 ) {
+		error = filename + " is a version 7.3 (HDF5) MAT-file; save it with -v7";
+		return false;
+	}
+	// "IM" in the file's byte order
+	std::uint16_t endian;
+	std::memcpy( &endian, header + 126, 2 );
+	if( endian != ( 'M' << 8 | 'I' ) && endian != ( 'I' << 8 | 'M' ) ) {
+		error = filename + " is not a level 5 MAT-file";
+		return false;
+	}
+	m_Swap = endian != ( 'M' << 8 | 'I' );
+
+	std::fseek( file, 0, SEEK_END );
+	const std::uint64_t fileSize = ftello( file );
+	std::uint64_t offset = 128;
+	while( offset + 8 <= fileSize ) {
+		fseeko( file, offset, SEEK_SET );
+		FileSource tags( file, fileSize - offset );
+		Tag tag;
+		if( !ReadTag( tags, m_Swap, tag ) ) {
+			error = filename + " is truncated";
+			return false;
+		}
+		Location location;
+		location.Offset = offset;
+		location.Size = tag.Small ? 4 : tag.Bytes;
+		location.Compressed = tag.Type == miCOMPRESSED;
+		if( !tag.Small && offset + 8 + location.Size > fileSize ) {
+			error = filename + " is truncated";
+			return false;
+		}
+
+		MatArrayInfo info;
+		bool numeric = false;
+		if( location.Compressed ) {
+			InflateSource source( file, location.Size );
+			Tag inner;
+			numeric = ReadTag( source, m_Swap, inner ) && inner.Type == miMATRIX && inner.Bytes > 0
+				&& ReadArrayHeader( source, m_Swap, info );
+		}
+		else if( tag.Type == miMATRIX && tag.Bytes > 0 ) {
+			FileSource source( file, location.Size );
+			numeric = ReadArrayHeader( source, m_Swap, info );
+		}
+		if( numeric ) {
+			m_Arrays.push_back( info );
+			m_Locations.push_back( location );
+		}
+
+		// Compressed elements are not padded
+		offset += 8 + ( tag.Small ? 0 : location.Size );
+		if( !location.Compressed ) {
+			offset = ( offset + 7 ) / 8 * 8;
+		}
+	}
+	return true;
+}
+
+int MatFile::Find(const std::string &name) const
+{
+	int found = -1;
+	for( std::size_t a = 0; a < m_Arrays.size(); ++a ) {
+		if( name.empty() ? found < 0 || m_Arrays[a].Elements() > m_Arrays[found].Elements()
+			: m_Arrays[a].Name == name ) {
+			found = static_cast<int>( a );
+			if( !name.empty() ) {
+				break;
+			}
+		}
+	}
+	return found;
+}
+
+template< class T >
+bool MatFile::Read(int a, T *out, std::string &error) const
+{
+	if( a < 0 || a >= static_cast<int>( m_Arrays.size() ) ) {
+		error = "No such array in " + m_Filename;
+		return false;
+	}
+	const MatArrayInfo &info = m_Arrays[a];
+	const Location &location = m_Locations[a];
+	std::FILE *file = std::fopen( m_Filename.c_str(), "rb" );
+	FileCloser closer = { file };
+	if( !file || fseeko( file, location.Offset + 8, SEEK_SET ) != 0 ) {
+		error = "Cannot open " + m_Filename;
+		return false;
+	}
+	FileSource fileSource( file, location.Size );
+	InflateSource inflateSource( file, location.Compressed ? location.Size : 0 );
+	ByteSource &source = location.Compressed ? static_cast<ByteSource &>( inflateSource )
+		: static_cast<ByteSource &>( fileSource );
+
+	// Skip to the real part
+	Tag tag;
+	MatArrayInfo header;
+	if( location.Compressed && !ReadTag( source, m_Swap, tag ) ) {
+		error = m_Filename + ": corrupt compressed element";
+		return false;
+	}
+	if( !ReadArrayHeader( source, m_Swap, header ) || !ReadTag( source, m_Swap, tag ) ) {
+		error = m_Filename + ": cannot read array " + info.Name;
+		return false;
+	}
+	const std::size_t count = info.Elements();
+	const std::size_t size = SizeOfType( tag.Type );
+	if( size == 0 || tag.Bytes != count * size ) {
+		error = m_Filename + ": unexpected data of array " + info.Name;
+		return false;
+	}
+
+	if( tag.Small ) {
+		Convert( tag.Type, tag.Data, count, m_Swap, out );
+		return true;
+	}
+	if( tag.Type == TypeOf<T>() && !m_Swap ) {
+		// Straight into the output
+		if( !source.Read( out, tag.Bytes ) ) {
+			error = m_Filename + ": cannot read array " + info.Name;
+			return false;
+		}
+		return true;
+	}
+	std::vector<unsigned char> chunk( 64 * 1024 );
+	const std::size_t perChunk = chunk.size() / size;
+	for( std::size_t i = 0; i < count; i += perChunk ) {
+		const std::size_t n = std::min( perChunk, count - i );
+		if( !source.Read( &chunk[0], n * size ) ) {
+			error = m_Filename + ": cannot read array " + info.Name;
+			return false;
+		}
+		Convert( tag.Type, &chunk[0], n, m_Swap, out + i );
+	}
+	return true;
+}
+
+template bool MatFile::Read(int, char *, std::string &) const;
+template bool MatFile::Read(int, signed char *, std::string &) const;
+template bool MatFile::Read(int, unsigned char *, std::string &) const;
+template bool MatFile::Read(int, short *, std::string &) const;
+template bool MatFile::Read(int, unsigned short *, std::string &) const;
+template bool MatFile::Read(int, int *, std::string &) const;
+template bool MatFile::Read(int, unsigned int *, std::string &) const;
+template bool MatFile::Read(int, long *, std::string &) const;
+template bool MatFile::Read(int, unsigned long *, std::string &) const;
+template bool MatFile::Read(int, float *, std::string &) const;
+template bool MatFile::Read(int, double *, std::string &) const;
+
+
+bool IsMatFileName(const std::string &filename)
+{
+	if( filename.size() < 4 ) {
+		return false;
+	}
+	std::string extension = filename.substr( filename.size() - 4 );
+	for( std::size_t i = 0; i < extension.size(); ++i ) {
+		extension[i] = static_cast<char>( std::tolower( static_cast<unsigned char>( extension[i] ) ) );
+	}
+	return extension == ".mat";
+}
+
+} // end namespace medimg
@@ -0,0 +1,101 @@
+//
+//  matFile.h
+//  Common
+//
+//  Reader for the numeric arrays of MATLAB MAT-files, level 5 (save -v6)
+//  and 7 (the default of save, with zlib-compressed miCOMPRESSED
+//  elements), so that ExampleVolumeStent.mat and the volumes saved from
+//  DICOM2mat.m can go through the C++ tools. Version 7.3 files are HDF5
+//  and are not read.
+//
+//  Open() walks the elements once and only inflates the headers of the
+//  arrays (class, size, name). Read() then streams the real part of one
+//  array into the caller's buffer: compressed data is inflated straight
+//  into it when the stored type is the requested one, and converted in
+//  small chunks otherwise (MATLAB stores doubles with integer values as
+//  the smallest integer type that holds them). MATLAB arrays are
+//  column-major, so the first dimension varies fastest, as x does in our
+//  volumes.
+//
+
+#ifndef MEDIMG_MATFILE_H
+#define MEDIMG_MATFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// mxClassID of the array; only numeric classes are listed by MatFile
+enum MatClass
+{
+	MatDouble = 6,
+	MatSingle = 7,
+	MatInt8 = 8,
+	MatUInt8 = 9,
+	MatInt16 = 10,
+	MatUInt16 = 11,
+	MatInt32 = 12,
+	MatUInt32 = 13,
+	MatInt64 = 14,
+	MatUInt64 = 15
+};
+
+struct MatArrayInfo
+{
+	std::string Name;
+	MatClass Class;
+	std::vector<std::size_t> Size;
+	bool Complex, Logical;
+
+	std::size_t Elements() const;
+	// The first three dimensions, 1 past the last one; trailing
+	// dimensions must be 1
+	bool VolumeDims(Dims &dims) const;
+};
+
+class MatFile
+{
+public:
+	MatFile() : m_Swap( false ) {}
+
+	bool Open(const std::string &filename, std::string &error);
+
+	// Numeric arrays in the order of the file
+	const std::vector<MatArrayInfo> &Arrays() const { return m_Arrays; }
+
+	// Index of the array called name, or of the largest numeric array when
+	// name is empty; -1 if there is none
+	int Find(const std::string &name = std::string()) const;
+
+	// Real part of array a as T into out (Arrays()[a].Elements() values).
+	// Instantiated for the integer types from char to unsigned long, float
+	// and double.
+	template< class T >
+	bool Read(int a, T *out, std::string &error) const;
+
+private:
+	struct Location
+	{
+		std::uint64_t Offset;     // of the element in the file
+		std::uint64_t Size;       // of its data
+		bool Compressed;
+	};
+
+	std::string m_Filename;
+	bool m_Swap;
+	std::vector<MatArrayInfo> m_Arrays;
+	std::vector<Location> m_Locations;
+};
+
+// Whether filename ends with .mat (any case)
+bool IsMatFileName(const std::string &filename);
+
+} // end namespace medimg
+
+#endif
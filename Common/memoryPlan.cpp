@@ -0,0 +1,62 @@
+//
+//  memoryPlan.cpp
+//  Common
+//
+
+#include "memoryPlan.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const double MB = 1024.0 * 1024.0;
+
+} // end anonymous namespace
+
+
+void MemoryPlan::Add(const std::string &name, double allocated, double kept, double released)
+{
+	Stage stage;
+	stage.Name = name;
+	stage.During = m_Held + allocated;
+	m_Held += kept - released;
+	stage.After = m_Held;
+	if( stage.During > m_Peak || m_Stages.empty() ) {
+		m_Peak = stage.During;
+		m_PeakStage = name;
+	}
+	m_Stages.push_back( stage );
+}
+
+void MemoryPlan::Report(std::ostream &out, double measured) const
+{
+	char line[128];
+	std::snprintf( line, sizeof(line), "%-28s %12s %12s\n", "stage", "during MB", "after MB" );
+	out << line;
+	for( std::size_t s = 0; s < m_Stages.size(); ++s ) {
+		std::snprintf( line, sizeof(line), "%-28s %12.1f %12.1f\n", m_Stages[s].Name.c_str(),
+			m_Stages[s].During / MB, m_Stages[s].After / MB );
+		out << line;
+	}
+	std::snprintf( line, sizeof(line), "Predicted peak %.1f MB (%s)", m_Peak / MB, m_PeakStage.c_str() );
+	out << line;
+	if( measured >= 0.0 ) {
+		std::snprintf( line, sizeof(line), ", measured %.1f MB", measured / MB );
+		out << line;
+	}
+	out << std::endl;
+}
+
+double BudgetBytes(const char *megabytes)
+{
+	const double budget = megabytes ? std::atof( megabytes ) : 0.0;
+	return budget > 0.0 ? budget * MB : 0.0;
+}
+
+} // end namespace medimg
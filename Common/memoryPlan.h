@@ -0,0 +1,58 @@
+//
+//  memoryPlan.h
+//  Common
+//
+//  Predicted memory of a pipeline run stage by stage, so that a tool can
+//  check it against a budget before anything is allocated and report it
+//  next to the measured peak afterwards. Each stage allocates its output
+//  and temporaries on top of what earlier stages still hold, keeps part of
+//  that, and may release earlier outputs when it ends.
+//
+
+#ifndef MEDIMG_MEMORYPLAN_H
+#define MEDIMG_MEMORYPLAN_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace medimg
+{
+
+class MemoryPlan
+{
+public:
+	MemoryPlan() : m_Held( 0.0 ), m_Peak( 0.0 ) {}
+
+	// Stage allocating allocated bytes while it runs, of which kept bytes
+	// remain held after it, and releasing released bytes held before it
+	void Add(const std::string &name, double allocated, double kept, double released = 0.0);
+
+	// Highest total held, and the stage it is reached in
+	double Peak() const { return m_Peak; }
+	const std::string &PeakStage() const { return m_PeakStage; }
+
+	// The stages with the memory held during and after each, then the
+	// predicted peak next to measured bytes (e.g. the growth of the peak
+	// resident set over the run; left out when negative)
+	void Report(std::ostream &out, double measured) const;
+
+private:
+	struct Stage
+	{
+		std::string Name;
+		double During, After;
+	};
+	std::vector<Stage> m_Stages;
+	double m_Held, m_Peak;
+	std::string m_PeakStage;
+};
+
+// Megabytes of a budget given on the command line, in bytes; 0 for none
+double BudgetBytes(const char *megabytes);
+
+} // end namespace medimg
+
+#endif
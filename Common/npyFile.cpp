@@ -0,0 +1,189 @@
+//
+//  npyFile.cpp
+//  Common
+//
+
+#include "npyFile.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const char Magic[6] = { '\x93', 'N', 'U', 'M', 'P', 'Y' };
+
+// Value of key in the header dictionary, up to the next top-level comma
+// (or the closing parenthesis of a shape tuple), with quotes removed
+bool HeaderValue(const std::string &header, const char *key, std::string &value)
+{
+	const std::string quoted = std::string( "'" ) + key + "'";
+	std::size_t p = header.find( quoted );
+	if( p == std::string::npos || ( p = header.find( ':', p + quoted.size() ) ) == std::string::npos ) {
+		return false;
+	}
+	p = header.find_first_not_of( " ", p + 1 );
+	if( p == std::string::npos ) {
+		return false;
+	}
+	const std::size_t end = header[p] == '(' ? header.find( ')', p ) + 1 : header.find_first_of( ",}", p );
+	if( end == std::string::npos || end == 0 ) {
+		return false;
+	}
+	value = header.substr( p, end - p );
+	while( !value.empty() && ( value[value.size() - 1] == ' ' || value[value.size() - 1] == '\'' ) ) {
+		value.erase( value.size() - 1 );
+	}
+	if( !value.empty() && value[0] == '\'' ) {
+		value.erase( 0, 1 );
+	}
+	return true;
+}
+
+bool ParseType(const std::string &descr, NpyType &type)
+{
+	// Single-byte types have no byte order ('|'); wider ones must be
+	// little endian ('<', or '=' written on a little-endian machine)
+	if( descr.size() < 3 ) {
+		return false;
+	}
+	const char order = descr[0];
+	const std::string kind = descr.substr( 1 );
+	if( kind == "b1" ) type = NpyBool;
+	else if( kind == "i1" ) type = NpyInt8;
+	else if( kind == "u1" ) type = NpyUInt8;
+	else if( kind == "i2" ) type = NpyInt16;
+	else if( kind == "u2" ) type = NpyUInt16;
+	else if( kind == "i4" ) type = NpyInt32;
+	else if( kind == "u4" ) type = NpyUInt32;
+	else if( kind == "i8" ) type = NpyInt64;
+	else if( kind == "u8" ) type = NpyUInt64;
+	else if( kind == "f4" ) type = NpyFloat32;
+	else if( kind == "f8" ) type = NpyFloat64;
+	else return false;
+	return order == '<' || order == '|' || order == '=';
+}
+
+std::size_t TypeSize(NpyType type)
+{
+	switch( type ) {
+		case NpyInt16: case NpyUInt16: return 2;
+		case NpyInt32: case NpyUInt32: case NpyFloat32: return 4;
+		case NpyInt64: case NpyUInt64: case NpyFloat64: return 8;
+		default: return 1;
+	}
+}
+
+} // end anonymous namespace
+
+
+std::size_t MappedNpy::Elements() const
+{
+	std::size_t n = 1;
+	for( std::size_t k = 0; k < m_Shape.size(); ++k ) {
+		n *= m_Shape[k];
+	}
+	return n;
+}
+
+void MappedNpy::Close()
+{
+	if( m_Map ) {
+		munmap( m_Map, m_MapSize );
+	}
+	m_Map = 0;
+	m_MapSize = 0;
+	m_Data = 0;
+	m_Shape.clear();
+}
+
+bool MappedNpy::Open(const std::string &filename, std::string &error)
+{
+	Close();
+	const int fd = open( filename.c_str(), O_RDONLY );
+	if( fd < 0 ) {
+		error = "Cannot open " + filename;
+		return false;
+	}
+	struct stat info;
+	if( fstat( fd, &info ) != 0 || info.st_size < 16 ) {
+		close( fd );
+		error = filename + ": not a .npy file";
+		return false;
+	}
+	m_MapSize = static_cast<std::size_t>( info.st_size );
+	void *map = mmap( 0, m_MapSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( map == MAP_FAILED ) {
+		m_MapSize = 0;
+		error = "Cannot map " + filename;
+		return false;
+	}
+	m_Map = map;
+
+	const unsigned char *bytes = static_cast<const unsigned char *>( m_Map );
+	const unsigned int major = bytes[6];
+	std::size_t headerLength, headerStart;
+	if( std::memcmp( bytes, Magic, 6 ) != 0 || major < 1 || major > 3 ) {
+		Close();
+		error = filename + ": not a .npy file";
+		return false;
+	}
+	if( major == 1 ) {
+		headerLength = bytes[8] | ( bytes[9] << 8 );
+		headerStart = 10;
+	}
+	else {
+		headerLength = bytes[8] | ( bytes[9] << 8 ) | ( bytes[10] << 16 )
+			| ( static_cast<std::size_t>( bytes[11] ) << 24 );
+		headerStart = 12;
+	}
+	if( headerStart + headerLength > m_MapSize ) {
+		Close();
+		error = filename + ": truncated header";
+		return false;
+	}
+	const std::string header( reinterpret_cast<const char *>( bytes ) + headerStart, headerLength );
+
+	std::string descr, fortran, shape;
+	if( !HeaderValue( header, "descr", descr ) || !HeaderValue( header, "fortran_order", fortran )
+		|| !HeaderValue( header, "shape", shape ) ) {
+		Close();
+		error = filename + ": unreadable header " + header;
+		return false;
+	}
+	if( !ParseType( descr, m_Type ) ) {
+		Close();
+		error = filename + ": unsupported type " + descr;
+		return false;
+	}
+	m_FortranOrder = fortran == "True";
+	for( const char *p = shape.c_str(); *p; ) {
+		if( *p >= '0' && *p <= '9' ) {
+			char *end;
+			m_Shape.push_back( std::strtoul( p, &end, 10 ) );
+			p = end;
+		}
+		else {
+			++p;
+		}
+	}
+
+	m_Data = bytes + headerStart + headerLength;
+	if( headerStart + headerLength + Elements() * TypeSize( m_Type ) > m_MapSize ) {
+		Close();
+		error = filename + ": truncated data";
+		return false;
+	}
+	return true;
+}
+
+} // end namespace medimg
@@ -0,0 +1,140 @@
+//
+//  npyFile.h
+//  Common
+//
+//  Read-only memory mapping of NumPy .npy files, as saved by np.save from
+//  the slice-by-slice segmentation notebooks. Only the header is parsed on
+//  open; the array stays in the page cache until it is copied, so many
+//  slices can be opened and scattered in parallel without a read pass.
+//
+//  Format versions 1 to 3 are accepted, with little-endian or single-byte
+//  bool, integer and floating point types in C or Fortran order.
+//
+
+#ifndef MEDIMG_NPYFILE_H
+#define MEDIMG_NPYFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace medimg
+{
+
+enum NpyType
+{
+	NpyBool,
+	NpyInt8,
+	NpyUInt8,
+	NpyInt16,
+	NpyUInt16,
+	NpyInt32,
+	NpyUInt32,
+	NpyInt64,
+	NpyUInt64,
+	NpyFloat32,
+	NpyFloat64
+};
+
+class MappedNpy
+{
+public:
+	MappedNpy() : m_Map( 0 ), m_MapSize( 0 ), m_Data( 0 ), m_Type( NpyUInt8 ), m_FortranOrder( false ) {}
+	~MappedNpy() { Close(); }
+
+	// Maps filename and parses its header; false with a message in error
+	bool Open(const std::string &filename, std::string &error);
+	void Close();
+
+	NpyType Type() const { return m_Type; }
+	const std::vector<std::size_t> &Shape() const { return m_Shape; }
+	bool FortranOrder() const { return m_FortranOrder; }
+	std::size_t Elements() const;
+	const void *Data() const { return m_Data; }
+
+	// Copies a 2D array of shape (rows, columns) into out, converting to T,
+	// with columns varying fastest whatever the order in the file. False if
+	// the array is not 2D.
+	template< class T >
+	bool CopyRows(T *out) const;
+
+private:
+	MappedNpy(const MappedNpy &);
+	void operator=(const MappedNpy &);
+
+	template< class TIn, class T >
+	void Copy(const TIn *in, T *out) const;
+
+	void *m_Map;
+	std::size_t m_MapSize;
+	const void *m_Data;
+	NpyType m_Type;
+	bool m_FortranOrder;
+	std::vector<std::size_t> m_Shape;
+};
+
+
+template< class TIn, class T >
+void MappedNpy::Copy(const TIn *in, T *out) const
+{
+	const std::size_t rows = m_Shape[0], columns = m_Shape[1];
+	if( !m_FortranOrder ) {
+		for( std::size_t i = 0; i < rows * columns; ++i ) {
+			out[i] = static_cast<T>( in[i] );
+		}
+		return;
+	}
+	for( std::size_t c = 0; c < columns; ++c ) {
+		for( std::size_t r = 0; r < rows; ++r ) {
+			out[c + columns * r] = static_cast<T>( in[r + rows * c] );
+		}
+	}
+}
+
+template< class T >
+bool MappedNpy::CopyRows(T *out) const
+{
+	if( m_Shape.size() != 2 ) {
+		return false;
+	}
+	switch( m_Type ) {
+		case NpyBool:
+		case NpyUInt8:
+			Copy( static_cast<const std::uint8_t *>( m_Data ), out );
+			break;
+		case NpyInt8:
+			Copy( static_cast<const std::int8_t *>( m_Data ), out );
+			break;
+		case NpyInt16:
+			Copy( static_cast<const std::int16_t *>( m_Data ), out );
+			break;
+		case NpyUInt16:
+			Copy( static_cast<const std::uint16_t *>( m_Data ), out );
+			break;
+		case NpyInt32:
+			Copy( static_cast<const std::int32_t *>( m_Data ), out );
+			break;
+		case NpyUInt32:
+			Copy( static_cast<const std::uint32_t *>( m_Data ), out );
+			break;
+		case NpyInt64:
+			Copy( static_cast<const std::int64_t *>( m_Data ), out );
+			break;
+		case NpyUInt64:
+			Copy( static_cast<const std::uint64_t *>( m_Data ), out );
+			break;
+		case NpyFloat32:
+			Copy( static_cast<const float *>( m_Data ), out );
+			break;
+		case NpyFloat64:
+			Copy( static_cast<const double *>( m_Data ), out );
+			break;
+	}
+	return true;
+}
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,81 @@
+//
+//  objectness.cpp
+//  Common
+//
+
+#include "objectness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+namespace medimg
+{
+
+double ObjectnessMeasure(double l0, double l1, double l2, const ObjectnessOptions &options)
+{
+	// Sort by magnitude; a[0] is along the line
+	double e[3] = { l0, l1, l2 };
+	for( int i = 1; i < 3; ++i ) {
+		for( int j = i; j > 0 && std::fabs( e[j] ) < std::fabs( e[j - 1] ); --j ) {
+			std::swap( e[j], e[j - 1] );
+		}
+	}
+	for( int i = 1; i < 3; ++i ) {
+		if( options.BrightObject ? e[i] > 0 : e[i] < 0 ) {
+			return 0.0;
+		}
+	}
+	const double a[3] = { std::fabs( e[0] ), std::fabs( e[1] ), std::fabs( e[2] ) };
+
+	double measure = 1.0;
+	// Plate versus line
+	if( a[2] > 0 ) {
+		if( options.Alpha != 0 ) {
+			const double rA = a[1] / a[2];
+			measure *= 1.0 - std::exp( -0.5 * rA * rA / (options.Alpha * options.Alpha) );
+		}
+	}
+	else {
+		return 0.0;
+	}
+	// Blob versus line
+	const double rBDenominator = a[1] * a[2];
+	if( rBDenominator > 0 && options.Beta != 0 ) {
+		const double rB = a[0] / std::sqrt( rBDenominator );
+		measure *= std::exp( -0.5 * rB * rB / (options.Beta * options.Beta) );
+	}
+	else {
+		return 0.0;
+	}
+	// Second order structureness
+	if( options.Gamma != 0 ) {
+		const double S2 = a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+		measure *= 1.0 - std::exp( -0.5 * S2 / (options.Gamma * options.Gamma) );
+	}
+	if( options.ScaleObjectnessMeasure ) {
+		measure *= a[2];
+	}
+	return measure;
+}
+
+
+void ObjectnessFilter3D(const float *I, const Dims &dims, const ObjectnessOptions &options,
+	float *Iout, float *whatScale, ThreadPool *pool)
+{
+	if( options.verbose ) {
+		std::cout << "Objectness Filter Sigmas:";
+		for( std::size_t s = 0; s < options.Sigmas.size(); ++s ) {
+			std::cout << " " << options.Sigmas[s];
+		}
+		std::cout << std::endl;
+	}
+	MultiscaleHessianMeasure( I, dims, options,
+		[&options](double l0, double l1, double l2) {
+			return ObjectnessMeasure( l0, l1, l2, options );
+		},
+		Iout, whatScale, pool );
+}
+
+} // end namespace medimg
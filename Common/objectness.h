@@ -0,0 +1,46 @@
+//
+//  objectness.h
+//  Common
+//
+//  Native counterpart of the pipeline in frangifilter.cpp:
+//  itk::HessianToObjectnessMeasureImageFilter for line-like objects (the
+//  Antiga generalization of Frangi's vesselness) inside
+//  itk::MultiScaleHessianBasedMeasureImageFilter, run by the tiled driver
+//  in hessianMeasure.h so it can be restricted to a mask.
+//
+
+#ifndef MEDIMG_OBJECTNESS_H
+#define MEDIMG_OBJECTNESS_H
+
+#include "hessianMeasure.h"
+
+
+namespace medimg
+{
+
+// Named after the setters of the ITK filter, with its defaults
+struct ObjectnessOptions : public HessianMeasureOptions
+{
+	double Alpha;
+	double Beta;
+	double Gamma;
+	bool BrightObject;
+	// Multiply by the largest absolute eigenvalue
+	bool ScaleObjectnessMeasure;
+
+	ObjectnessOptions() : Alpha(0.5), Beta(0.5), Gamma(5.0), BrightObject(true),
+		ScaleObjectnessMeasure(true) {}
+};
+
+// Objectness of one Hessian with eigenvalues l0 <= l1 <= l2 (in any order
+// of magnitude) for a line-like object.
+double ObjectnessMeasure(double l0, double l1, double l2, const ObjectnessOptions &options);
+
+// Maximum objectness over options.Sigmas into Iout and, when given, the
+// 1-based index of the winning sigma into whatScale; see SatoFilter3D.
+void ObjectnessFilter3D(const float *I, const Dims &dims, const ObjectnessOptions &options,
+	float *Iout, float *whatScale = 0, ThreadPool *pool = 0);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,64 @@
+//
+//  parallel.h
+//  Common
+//
+//  Minimal parallel loop used by the native kernels. Work items are handed
+//  out one at a time from a shared counter so that tiles of uneven cost
+//  (volume borders, large halos) still balance across workers.
+//
+
+#ifndef MEDIMG_PARALLEL_H
+#define MEDIMG_PARALLEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+namespace medimg
+{
+
+inline unsigned int DefaultNumberOfThreads()
+{
+	const unsigned int n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+// Calls body(item, worker) for every item in [0, count). `worker` is in
+// [0, threads) and identifies the calling thread, so callers can keep one
+// scratch buffer per worker. A thread count of 0 uses all cores.
+template< class TBody >
+void ParallelFor(std::size_t count, unsigned int threads, TBody body)
+{
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+	if( threads > count ) {
+		threads = static_cast<unsigned int>( count );
+	}
+	if( threads <= 1 ) {
+		for( std::size_t i = 0; i < count; ++i ) {
+			body( i, 0u );
+		}
+		return;
+	}
+
+	std::atomic<std::size_t> next( 0 );
+	std::vector<std::thread> workers;
+	workers.reserve( threads );
+	for( unsigned int w = 0; w < threads; ++w ) {
+		workers.push_back( std::thread( [&next, count, w, &body]() {
+			for( std::size_t i = next++; i < count; i = next++ ) {
+				body( i, w );
+			}
+		} ) );
+	}
+	for( std::size_t w = 0; w < workers.size(); ++w ) {
+		workers[w].join();
+	}
+}
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,314 @@
+//
+//  phantom.cpp
+//  Common
+//
+
+#include "phantom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const double Pi = 3.14159265358979323846;
+
+// Lobed ellipsoid: negative inside, roughly the distance to the surface
+// in units of the semi-axes
+struct Blob
+{
+	double Center[3], Axes[3];
+
+	double Value(const double p[3]) const
+	{
+		double q[3], rho2 = 0.0;
+		for( int a = 0; a < 3; ++a ) {
+			q[a] = ( p[a] - Center[a] ) / Axes[a];
+			rho2 += q[a] * q[a];
+		}
+		const double theta = std::atan2( q[1], q[0] );
+		const double lobes = 1.0 + 0.10 * std::sin( 3.0 * theta + 0.5 ) * std::cos( 1.5 * q[2] )
+			+ 0.05 * std::sin( Pi * q[0] + 1.0 ) * std::cos( Pi * q[2] );
+		return std::sqrt( rho2 ) - lobes;
+	}
+};
+
+double Dot(const double u[3], const double v[3])
+{
+	return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+}
+
+// Distance from p to the axis of segment
+double AxisDistance(const TubeSegment &segment, const double p[3])
+{
+	double ab[3], ap[3];
+	for( int a = 0; a < 3; ++a ) {
+		ab[a] = segment.b[a] - segment.a[a];
+		ap[a] = p[a] - segment.a[a];
+	}
+	const double length2 = Dot( ab, ab );
+	double t = length2 > 0 ? Dot( ap, ab ) / length2 : 0.0;
+	t = std::max( 0.0, std::min( 1.0, t ) );
+	double d2 = 0.0;
+	for( int a = 0; a < 3; ++a ) {
+		const double d = ap[a] - t * ab[a];
+		d2 += d * d;
+	}
+	return std::sqrt( d2 );
+}
+
+// v rotated by angle about the unit axis u (Rodrigues)
+void Rotate(const double v[3], const double u[3], double angle, double out[3])
+{
+	const double c = std::cos( angle ), s = std::sin( angle ), d = Dot( u, v );
+	const double cross[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+		u[0] * v[1] - u[1] * v[0] };
+	for( int a = 0; a < 3; ++a ) {
+		out[a] = v[a] * c + cross[a] * s + u[a] * d * ( 1.0 - c );
+	}
+}
+
+// Appends the segment from start along direction and its descendants
+void GrowTree(const double start[3], const double direction[3], double length,
+	unsigned int generation, const PhantomOptions &options, std::mt19937 &random,
+	std::vector<TubeSegment> &tubes)
+{
+	TubeSegment segment;
+	for( int a = 0; a < 3; ++a ) {
+		segment.a[a] = start[a];
+		segment.b[a] = start[a] + length * direction[a];
+	}
+	segment.Radius = options.TubeRadii.empty() ? 1.0
+		: options.TubeRadii[std::min<std::size_t>( generation, options.TubeRadii.size() - 1 )];
+	segment.Generation = generation;
+	tubes.push_back( segment );
+	if( generation + 1 >= options.Generations ) {
+		return;
+	}
+
+	// Children fan out by about 30 degrees in alternating planes
+	const double reference[3] = { generation % 2 ? 1.0 : 0.0, generation % 2 ? 0.0 : 1.0, 0.0 };
+	double axis[3] = { direction[1] * reference[2] - direction[2] * reference[1],
+		direction[2] * reference[0] - direction[0] * reference[2],
+		direction[0] * reference[1] - direction[1] * reference[0] };
+	double norm = std::sqrt( Dot( axis, axis ) );
+	if( norm < 1e-6 ) {
+		axis[0] = 0.0;
+		axis[1] = 0.0;
+		axis[2] = 1.0;
+		norm = 1.0;
+	}
+	for( int a = 0; a < 3; ++a ) {
+		axis[a] /= norm;
+	}
+	std::uniform_real_distribution<double> jitter( -0.15, 0.15 );
+	for( int side = -1; side <= 1; side += 2 ) {
+		double child[3];
+		Rotate( direction, axis, side * ( Pi / 6 + jitter( random ) ), child );
+		GrowTree( segment.b, child, 0.72 * length, generation + 1, options, random, tubes );
+	}
+}
+
+// In-place [1 2 1] / 4 smoothing of the lines of n values stride apart,
+// replicating the ends
+void SmoothLine(float *line, std::size_t n, std::size_t stride, std::vector<float> &buffer)
+{
+	if( n < 2 ) {
+		return;
+	}
+	buffer.resize( n );
+	for( std::size_t i = 0; i < n; ++i ) {
+		buffer[i] = line[i * stride];
+	}
+	for( std::size_t i = 0; i < n; ++i ) {
+		const float previous = buffer[i > 0 ? i - 1 : 0];
+		const float next = buffer[i + 1 < n ? i + 1 : n - 1];
+		line[i * stride] = 0.25f * ( previous + 2.0f * buffer[i] + next );
+	}
+}
+
+// Unit-variance Gaussian noise correlated over about a voxel, like the
+// noise of reconstructed CT, into noise (dims.Voxels() values)
+void CorrelatedNoise(const Dims &dims, unsigned int seed, unsigned int threads, float *noise)
+{
+	const std::size_t slice = dims.nx * dims.ny;
+	ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+		std::mt19937 random( seed * 1000003u + static_cast<unsigned int>( z ) );
+		std::normal_distribution<float> normal( 0.0f, 1.0f );
+		float *plane = noise + z * slice;
+		for( std::size_t i = 0; i < slice; ++i ) {
+			plane[i] = normal( random );
+		}
+		std::vector<float> buffer;
+		for( std::size_t y = 0; y < dims.ny; ++y ) {
+			SmoothLine( plane + y * dims.nx, dims.nx, 1, buffer );
+		}
+		for( std::size_t x = 0; x < dims.nx; ++x ) {
+			SmoothLine( plane + x, dims.ny, dims.nx, buffer );
+		}
+	} );
+	ParallelFor( dims.ny, threads, [&](std::size_t y, unsigned int) {
+		std::vector<float> buffer;
+		for( std::size_t x = 0; x < dims.nx; ++x ) {
+			SmoothLine( noise + dims.Index( x, y, 0 ), dims.nz, slice, buffer );
+		}
+	} );
+
+	// Each pass scales the variance by (1 + 4 + 1) / 16 away from the
+	// borders
+	const float scale = static_cast<float>( std::pow( 16.0 / 6.0, 1.5 ) );
+	for( std::size_t i = 0; i < dims.Voxels(); ++i ) {
+		noise[i] *= scale;
+	}
+}
+
+} // end anonymous namespace
+
+
+void MakePhantom(const PhantomOptions &options, Phantom &phantom)
+{
+	const Dims &dims = options.dims;
+	phantom.geometry = Geometry();
+	phantom.geometry.dims = dims;
+	double extent[3], h = std::numeric_limits<double>::max();
+	for( int a = 0; a < 3; ++a ) {
+		phantom.geometry.Spacing[a] = options.Spacing[a];
+		h = std::min( h, options.Spacing[a] );
+	}
+	extent[0] = dims.nx * options.Spacing[0];
+	extent[1] = dims.ny * options.Spacing[1];
+	extent[2] = dims.nz * options.Spacing[2];
+
+	Blob blob;
+	const double axes[3] = { 0.36, 0.30, 0.34 };
+	double minAxis = std::numeric_limits<double>::max();
+	for( int a = 0; a < 3; ++a ) {
+		blob.Center[a] = 0.5 * extent[a];
+		blob.Axes[a] = axes[a] * extent[a];
+		minAxis = std::min( minAxis, blob.Axes[a] );
+	}
+
+	// Tube tree rising through the blob from below its center
+	phantom.Tubes.clear();
+	std::mt19937 random( options.RandomSeed );
+	const double start[3] = { blob.Center[0], blob.Center[1], blob.Center[2] - 0.8 * blob.Axes[2] };
+	const double up[3] = { 0.0, 0.0, 1.0 };
+	if( options.Generations > 0 ) {
+		GrowTree( start, up, 0.6 * blob.Axes[2], 0, options, random, phantom.Tubes );
+	}
+
+	phantom.Image.assign( dims.Voxels(), 0.0f );
+	phantom.Liver.assign( dims.Voxels(), 0 );
+	phantom.Vessels.assign( dims.Voxels(), 0 );
+	phantom.CenterlineRadius.assign( dims.Voxels(), 0.0f );
+
+	const std::size_t slice = dims.nx * dims.ny;
+	ParallelFor( dims.nz, options.NumberOfThreads, [&](std::size_t z, unsigned int) {
+		// Distance outside the nearest tube wall, per voxel of the slice
+		std::vector<double> wall( slice, std::numeric_limits<double>::max() );
+		const double pz = z * options.Spacing[2];
+		for( std::size_t s = 0; s < phantom.Tubes.size(); ++s ) {
+			const TubeSegment &tube = phantom.Tubes[s];
+			const double margin = tube.Radius + 2.0 * h;
+			if( pz < std::min( tube.a[2], tube.b[2] ) - margin || pz > std::max( tube.a[2], tube.b[2] ) + margin ) {
+				continue;
+			}
+			long lo[2], hi[2];
+			for( int a = 0; a < 2; ++a ) {
+				const std::size_t n = a == 0 ? dims.nx : dims.ny;
+				lo[a] = std::max( 0L, static_cast<long>( std::floor(
+					( std::min( tube.a[a], tube.b[a] ) - margin ) / options.Spacing[a] ) ) );
+				hi[a] = std::min( static_cast<long>( n ) - 1, static_cast<long>( std::ceil(
+					( std::max( tube.a[a], tube.b[a] ) + margin ) / options.Spacing[a] ) ) );
+			}
+			for( long y = lo[1]; y <= hi[1]; ++y ) {
+				for( long x = lo[0]; x <= hi[0]; ++x ) {
+					const double p[3] = { x * options.Spacing[0], y * options.Spacing[1], pz };
+					const double axis = AxisDistance( tube, p );
+					const std::size_t i = x + dims.nx * y;
+					wall[i] = std::min( wall[i], axis - tube.Radius );
+					float &centerline = phantom.CenterlineRadius[z * slice + i];
+					if( axis <= 0.5 * h && tube.Radius > centerline ) {
+						centerline = static_cast<float>( tube.Radius );
+					}
+				}
+			}
+		}
+
+		for( std::size_t y = 0; y < dims.ny; ++y ) {
+			for( std::size_t x = 0; x < dims.nx; ++x ) {
+				const double p[3] = { x * options.Spacing[0], y * options.Spacing[1], pz };
+				const std::size_t i = x + dims.nx * y;
+				// Partial volume over one voxel across either surface
+				const double inside = blob.Value( p ) * minAxis;
+				const double liver = std::max( 0.0, std::min( 1.0, 0.5 - inside / h ) );
+				const double vessel = std::max( 0.0, std::min( 1.0, 0.5 - wall[i] / h ) );
+				const double base = options.BackgroundHU + liver * ( options.LiverHU - options.BackgroundHU );
+				phantom.Image[z * slice + i] = static_cast<float>( base + vessel * ( options.VesselHU - base ) );
+				phantom.Liver[z * slice + i] = inside < 0.0;
+				phantom.Vessels[z * slice + i] = wall[i] <= 0.0;
+			}
+		}
+	} );
+
+	if( options.NoiseSigma > 0.0 ) {
+		std::vector<float> noise( dims.Voxels() );
+		CorrelatedNoise( dims, options.RandomSeed, options.NumberOfThreads, &noise[0] );
+		const float sigma = static_cast<float>( options.NoiseSigma );
+		for( std::size_t i = 0; i < dims.Voxels(); ++i ) {
+			phantom.Image[i] += sigma * noise[i];
+		}
+	}
+
+	// Seed: the lattice point deepest in the blob and farthest from the
+	// tube walls
+	double best = -std::numeric_limits<double>::max();
+	for( int a = 0; a < 3; ++a ) {
+		phantom.Seed[a] = static_cast<std::size_t>( blob.Center[a] / options.Spacing[a] );
+	}
+	for( int k = -2; k <= 2; ++k ) {
+		for( int j = -2; j <= 2; ++j ) {
+			for( int i = -2; i <= 2; ++i ) {
+				const int offset[3] = { i, j, k };
+				std::size_t voxel[3];
+				double p[3];
+				for( int a = 0; a < 3; ++a ) {
+					const double c = blob.Center[a] + 0.25 * offset[a] * blob.Axes[a];
+					voxel[a] = static_cast<std::size_t>( c / options.Spacing[a] + 0.5 );
+					p[a] = voxel[a] * options.Spacing[a];
+				}
+				double clearance = -blob.Value( p ) * minAxis;
+				for( std::size_t s = 0; s < phantom.Tubes.size(); ++s ) {
+					clearance = std::min( clearance,
+						AxisDistance( phantom.Tubes[s], p ) - phantom.Tubes[s].Radius );
+				}
+				if( clearance > best ) {
+					best = clearance;
+					for( int a = 0; a < 3; ++a ) {
+						phantom.Seed[a] = voxel[a];
+					}
+				}
+			}
+		}
+	}
+}
+
+double DiceCoefficient(const unsigned char *a, const unsigned char *b, std::size_t n)
+{
+	std::size_t both = 0, total = 0;
+	for( std::size_t i = 0; i < n; ++i ) {
+		const bool inA = a[i] != 0, inB = b[i] != 0;
+		both += inA && inB;
+		total += inA + inB;
+	}
+	return total > 0 ? 2.0 * both / total : 1.0;
+}
+
+} // end namespace medimg
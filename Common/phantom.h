@@ -0,0 +1,93 @@
+//
+//  phantom.h
+//  Common
+//
+//  Synthetic CT-like volumes with a known ground truth, for benchmarking
+//  and checking the segmentation and vessel pipelines: a liver-like blob
+//  (a lobed ellipsoid) crossed by a binary tree of contrast-filled tubes
+//  whose radii are set per generation, in fat, with spatially correlated
+//  Gaussian noise. Edges are partial-volume blurred over one voxel. The
+//  volume depends only on the options, not on the number of threads.
+//
+
+#ifndef MEDIMG_PHANTOM_H
+#define MEDIMG_PHANTOM_H
+
+#include <cstddef>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+struct PhantomOptions
+{
+	Dims dims;
+	double Spacing[3];
+	// Intensities in HU
+	double BackgroundHU, LiverHU, VesselHU;
+	// Standard deviation of the noise in HU; 0 for none
+	double NoiseSigma;
+	// Radius of the tubes of each generation in physical units, from the
+	// trunk down; generations past the end of the list keep the last one
+	std::vector<double> TubeRadii;
+	// Generations of the tube tree (1 is a single trunk)
+	unsigned int Generations;
+	unsigned int RandomSeed;
+	// 0 uses every core
+	unsigned int NumberOfThreads;
+
+	PhantomOptions()
+	{
+		dims = Dims( 128, 128, 128 );
+		for( int a = 0; a < 3; ++a ) {
+			Spacing[a] = 1.0;
+		}
+		BackgroundHU = -100.0;
+		LiverHU = 60.0;
+		VesselHU = 180.0;
+		NoiseSigma = 15.0;
+		TubeRadii.push_back( 4.0 );
+		TubeRadii.push_back( 3.0 );
+		TubeRadii.push_back( 2.0 );
+		TubeRadii.push_back( 1.5 );
+		TubeRadii.push_back( 1.0 );
+		Generations = 5;
+		RandomSeed = 1;
+		NumberOfThreads = 0;
+	}
+};
+
+// Straight piece of a tube, endpoints in physical coordinates (origin 0)
+struct TubeSegment
+{
+	double a[3], b[3];
+	double Radius;
+	unsigned int Generation;
+};
+
+struct Phantom
+{
+	Geometry geometry;
+	std::vector<float> Image;
+	// Ground truth, 1 inside
+	std::vector<unsigned char> Liver, Vessels;
+	// Radius of the tube whose axis passes through the voxel, 0 off the
+	// centerlines
+	std::vector<float> CenterlineRadius;
+	std::vector<TubeSegment> Tubes;
+	// A voxel well inside the liver and away from the tubes, to start
+	// region growing or level sets from
+	std::size_t Seed[3];
+};
+
+void MakePhantom(const PhantomOptions &options, Phantom &phantom);
+
+// 2 |A n B| / (|A| + |B|) of the nonzero voxels of two masks; 1 when both
+// are empty
+double DiceCoefficient(const unsigned char *a, const unsigned char *b, std::size_t n);
+
+} // end namespace medimg
+
+#endif
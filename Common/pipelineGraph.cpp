@@ -0,0 +1,360 @@
+//
+//  pipelineGraph.cpp
+//  Common
+//
+
+#include "pipelineGraph.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+std::vector<std::string> SplitList(const std::string &list)
+{
+	std::vector<std::string> items;
+	std::istringstream fields( list );
+	std::string item;
+	while( std::getline( fields, item, ',' ) ) {
+		items.push_back( item );
+	}
+	return items;
+}
+
+double ToNumber(const PipelineStage &stage, const std::string &key, const std::string &text)
+{
+	char *end;
+	const double value = std::strtod( text.c_str(), &end );
+	if( text.empty() || *end != '\0' ) {
+		throw std::runtime_error( stage.Name + ": " + key + "=" + text + " is not a number" );
+	}
+	return value;
+}
+
+} // end anonymous namespace
+
+
+std::string PipelineStage::Parameter(const std::string &key, const char *fallback) const
+{
+	std::map< std::string, std::string >::const_iterator found = Parameters.find( key );
+	if( found != Parameters.end() ) {
+		return found->second;
+	}
+	if( !fallback ) {
+		throw std::runtime_error( Name + ": missing parameter " + key );
+	}
+	return fallback;
+}
+
+double PipelineStage::Number(const std::string &key, double fallback) const
+{
+	return Parameters.count( key ) ? Number( key ) : fallback;
+}
+
+double PipelineStage::Number(const std::string &key) const
+{
+	return ToNumber( *this, key, Parameter( key ) );
+}
+
+std::vector<double> PipelineStage::Numbers(const std::string &key) const
+{
+	const std::vector<std::string> items = SplitList( Parameter( key ) );
+	std::vector<double> numbers;
+	for( std::size_t i = 0; i < items.size(); ++i ) {
+		numbers.push_back( ToNumber( *this, key, items[i] ) );
+	}
+	return numbers;
+}
+
+
+void PipelineGraph::AddOperation(const std::string &name, const std::vector<std::string> &inputKeys,
+	const PipelineOperation &operation)
+{
+	Operation &entry = m_Operations[name];
+	entry.InputKeys = inputKeys;
+	entry.Run = operation;
+}
+
+bool PipelineGraph::Read(const char *filename, std::string &error)
+{
+	std::ifstream file( filename );
+	if( !file ) {
+		error = std::string( "Cannot open pipeline " ) + filename;
+		return false;
+	}
+	std::ostringstream text;
+	text << file.rdbuf();
+	if( !Parse( text.str(), error ) ) {
+		error = std::string( filename ) + ": " + error;
+		return false;
+	}
+	return true;
+}
+
+bool PipelineGraph::Parse(const std::string &text, std::string &error)
+{
+	m_Stages.clear();
+	std::istringstream lines( text );
+	std::string line;
+	for( std::size_t number = 1; std::getline( lines, line ); ++number ) {
+		std::ostringstream where;
+		where << "line " << number << ": ";
+		std::istringstream fields( line.substr( 0, line.find( '#' ) ) );
+		PipelineStage stage;
+		stage.Line = number;
+		if( !( fields >> stage.Name ) ) {
+			continue;
+		}
+		if( !( fields >> stage.Operation ) ) {
+			error = where.str() + "expected \"name operation key=value ...\"";
+			return false;
+		}
+		std::map< std::string, Operation >::const_iterator operation
+			= m_Operations.find( stage.Operation );
+		if( operation == m_Operations.end() ) {
+			error = where.str() + "unknown operation " + stage.Operation;
+			return false;
+		}
+		for( std::size_t s = 0; s < m_Stages.size(); ++s ) {
+			if( m_Stages[s].Name == stage.Name ) {
+				error = where.str() + "stage " + stage.Name + " is already defined";
+				return false;
+			}
+		}
+		std::string field;
+		while( fields >> field ) {
+			const std::size_t equals = field.find( '=' );
+			if( equals == std::string::npos || equals == 0 ) {
+				error = where.str() + "expected key=value, not " + field;
+				return false;
+			}
+			const std::string key = field.substr( 0, equals );
+			const std::string value = field.substr( equals + 1 );
+			if( stage.Inputs.count( key ) || stage.Parameters.count( key ) ) {
+				error = where.str() + key + " is given twice";
+				return false;
+			}
+			const std::vector<std::string> &inputKeys = operation->second.InputKeys;
+			bool input = false;
+			for( std::size_t k = 0; k < inputKeys.size(); ++k ) {
+				input = input || inputKeys[k] == key;
+			}
+			if( input ) {
+				stage.Inputs[key] = SplitList( value );
+			}
+			else {
+				stage.Parameters[key] = value;
+			}
+		}
+		m_Stages.push_back( stage );
+	}
+	return Order( error );
+}
+
+bool PipelineGraph::Order(std::string &error)
+{
+	// Kahn's algorithm, keeping the order of the file among ready stages
+	const std::size_t n = m_Stages.size();
+	std::map< std::string, std::size_t > index;
+	for( std::size_t s = 0; s < n; ++s ) {
+		index[m_Stages[s].Name] = s;
+	}
+	std::vector<std::size_t> pending( n, 0 );
+	std::vector< std::vector<std::size_t> > consumers( n );
+	for( std::size_t s = 0; s < n; ++s ) {
+		const PipelineStage &stage = m_Stages[s];
+		std::map< std::string, std::vector<std::string> >::const_iterator key;
+		for( key = stage.Inputs.begin(); key != stage.Inputs.end(); ++key ) {
+			for( std::size_t i = 0; i < key->second.size(); ++i ) {
+				std::map< std::string, std::size_t >::const_iterator found = index.find( key->second[i] );
+				if( found == index.end() ) {
+					std::ostringstream message;
+					message << "line " << stage.Line << ": no stage named " << key->second[i];
+					error = message.str();
+					return false;
+				}
+				consumers[found->second].push_back( s );
+				++pending[s];
+			}
+		}
+	}
+	std::vector<PipelineStage> ordered;
+	std::vector<bool> placed( n, false );
+	while( ordered.size() < n ) {
+		std::size_t s = 0;
+		while( s < n && ( placed[s] || pending[s] > 0 ) ) {
+			++s;
+		}
+		if( s == n ) {
+			error = "stages";
+			for( std::size_t c = 0; c < n; ++c ) {
+				if( !placed[c] ) {
+					error += " " + m_Stages[c].Name;
+				}
+			}
+			error += " depend on each other";
+			return false;
+		}
+		placed[s] = true;
+		ordered.push_back( m_Stages[s] );
+		for( std::size_t c = 0; c < consumers[s].size(); ++c ) {
+			--pending[consumers[s][c]];
+		}
+	}
+	m_Stages.swap( ordered );
+	return true;
+}
+
+bool PipelineGraph::Run(unsigned int threads, std::string &error)
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point begin = Clock::now();
+	const std::size_t n = m_Stages.size();
+
+	// Stages are ordered, so inputs precede their readers
+	std::map< std::string, std::size_t > index;
+	std::vector< std::vector<std::size_t> > consumers( n );
+	std::vector<std::size_t> pending( n, 0 ), readers( n, 0 );
+	for( std::size_t s = 0; s < n; ++s ) {
+		index[m_Stages[s].Name] = s;
+		std::map< std::string, std::vector<std::string> >::const_iterator key;
+		for( key = m_Stages[s].Inputs.begin(); key != m_Stages[s].Inputs.end(); ++key ) {
+			for( std::size_t i = 0; i < key->second.size(); ++i ) {
+				const std::size_t input = index[key->second[i]];
+				consumers[input].push_back( s );
+				++pending[s];
+				++readers[input];
+			}
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::size_t> ready;
+	std::vector<PipelineDataPointer> outputs( n );
+	std::vector<std::size_t> bytes( n, 0 );
+	std::size_t running = 0, liveBytes = 0;
+	bool failed = false;
+	m_Timings.assign( n, PipelineStageTiming() );
+	m_PeakBytes = 0;
+	for( std::size_t s = 0; s < n; ++s ) {
+		if( pending[s] == 0 ) {
+			ready.push_back( s );
+		}
+	}
+
+	const auto worker = [&](unsigned int w) {
+		std::unique_lock<std::mutex> lock( mutex );
+		for( ;; ) {
+			// Nothing ready and nothing running: done, or stopped by a failure
+			wake.wait( lock, [&]() { return !ready.empty() || running == 0; } );
+			if( ready.empty() ) {
+				return;
+			}
+			const std::size_t s = ready.front();
+			ready.pop_front();
+			++running;
+			const PipelineStage &stage = m_Stages[s];
+			PipelineInputs inputs;
+			std::map< std::string, std::vector<std::string> >::const_iterator key;
+			for( key = stage.Inputs.begin(); key != stage.Inputs.end(); ++key ) {
+				for( std::size_t i = 0; i < key->second.size(); ++i ) {
+					inputs[key->first].push_back( outputs[index[key->second[i]]] );
+				}
+			}
+			lock.unlock();
+
+			const Clock::time_point start = Clock::now();
+			PipelineDataPointer output;
+			std::string failure;
+			try {
+				output = m_Operations.find( stage.Operation )->second.Run( stage, inputs );
+			} catch (std::exception &exception) {
+				failure = exception.what();
+			} catch (...) {
+				failure = "unknown error";
+			}
+			const Clock::time_point end = Clock::now();
+			inputs.clear();
+			const std::size_t outputBytes = output ? output->Bytes() : 0;
+
+			// Outputs whose last reader this was are freed after unlocking
+			std::vector<PipelineDataPointer> released;
+			lock.lock();
+			--running;
+			PipelineStageTiming &timing = m_Timings[s];
+			timing.Start = std::chrono::duration<double>( start - begin ).count();
+			timing.Wall = std::chrono::duration<double>( end - start ).count();
+			timing.Worker = w;
+			if( !failure.empty() ) {
+				if( !failed ) {
+					error = stage.Name + " (" + stage.Operation + "): " + failure;
+				}
+				failed = true;
+				ready.clear();
+			}
+			if( readers[s] > 0 ) {
+				outputs[s] = output;
+				bytes[s] = outputBytes;
+				liveBytes += outputBytes;
+			}
+			else {
+				released.push_back( output );
+			}
+			if( liveBytes > m_PeakBytes ) {
+				m_PeakBytes = liveBytes;
+			}
+			for( key = stage.Inputs.begin(); key != stage.Inputs.end(); ++key ) {
+				for( std::size_t i = 0; i < key->second.size(); ++i ) {
+					const std::size_t input = index[key->second[i]];
+					if( --readers[input] == 0 ) {
+						released.push_back( outputs[input] );
+						outputs[input].reset();
+						liveBytes -= bytes[input];
+					}
+				}
+			}
+			timing.LiveBytes = liveBytes;
+			for( std::size_t c = 0; c < consumers[s].size(); ++c ) {
+				if( --pending[consumers[s][c]] == 0 && !failed ) {
+					ready.push_back( consumers[s][c] );
+				}
+			}
+			wake.notify_all();
+			lock.unlock();
+			released.clear();
+			lock.lock();
+		}
+	};
+
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+	if( threads > n ) {
+		threads = static_cast<unsigned int>( n );
+	}
+	std::vector<std::thread> workers;
+	for( unsigned int w = 1; w < threads; ++w ) {
+		workers.push_back( std::thread( worker, w ) );
+	}
+	worker( 0 );
+	for( std::size_t w = 0; w < workers.size(); ++w ) {
+		workers[w].join();
+	}
+	return !failed;
+}
+
+} // end namespace medimg
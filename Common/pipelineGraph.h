@@ -0,0 +1,133 @@
+//
+//  pipelineGraph.h
+//  Common
+//
+//  A pipeline of stages described in a text file and run in one process.
+//  Each line declares a stage:
+//
+//    # name     operation                parameters
+//    roi        read                     file=ROI.mha
+//    speed      speed_image              input=roi sigma=3.0 K1=-0.5 K2=3.0
+//    vessels    frangi                   input=roi scales=1,4
+//
+//  Parameters are key=value pairs without spaces. The keys an operation
+//  declares as inputs name the stages whose outputs it takes (several,
+//  comma-separated, for list inputs), so stages can be listed in any order
+//  and form a DAG; the other keys are passed to the operation as they are.
+//  Empty lines and text after # are ignored.
+//
+//  Run() starts every stage whose inputs are ready, up to a number of
+//  stages at once, so independent branches run concurrently. Outputs stay
+//  in memory and are released as soon as the last stage reading them has
+//  finished. Operations are registered by the tool, which knows the data;
+//  this file only schedules. Operations report failures by throwing an
+//  exception derived from std::exception (itk::ExceptionObject is one).
+//
+
+#ifndef MEDIMG_PIPELINEGRAPH_H
+#define MEDIMG_PIPELINEGRAPH_H
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace medimg
+{
+
+// Output of a stage
+class PipelineData
+{
+public:
+	virtual ~PipelineData() {}
+	// Memory held, for the report
+	virtual std::size_t Bytes() const = 0;
+};
+
+typedef std::shared_ptr<PipelineData> PipelineDataPointer;
+
+struct PipelineStage
+{
+	std::string Name, Operation;
+	// Input key to the stages it names
+	std::map< std::string, std::vector<std::string> > Inputs;
+	std::map< std::string, std::string > Parameters;
+	std::size_t Line;
+
+	// The parameter; fallback if it is not given, or std::runtime_error
+	// when fallback is null
+	std::string Parameter(const std::string &key, const char *fallback = 0) const;
+	double Number(const std::string &key, double fallback) const;
+	double Number(const std::string &key) const;
+	// Comma-separated numbers
+	std::vector<double> Numbers(const std::string &key) const;
+};
+
+// Outputs of the stages named by each input key, in the order given
+typedef std::map< std::string, std::vector<PipelineDataPointer> > PipelineInputs;
+
+// Runs stage on its inputs; returns its output, or null for stages that
+// only have side effects (writers)
+typedef std::function< PipelineDataPointer(const PipelineStage &stage,
+	const PipelineInputs &inputs) > PipelineOperation;
+
+// What Run() observed of one stage; all 0 for stages that did not run
+struct PipelineStageTiming
+{
+	double Start, Wall;      // seconds from the start of the run
+	unsigned int Worker;
+	// Outputs of all stages held in memory when the stage finished
+	std::size_t LiveBytes;
+
+	PipelineStageTiming() : Start( 0.0 ), Wall( 0.0 ), Worker( 0 ), LiveBytes( 0 ) {}
+};
+
+class PipelineGraph
+{
+public:
+	PipelineGraph() : m_PeakBytes( 0 ) {}
+
+	// Operation name with the keys that name input stages; required
+	// inputs are checked by the operation itself
+	void AddOperation(const std::string &name, const std::vector<std::string> &inputKeys,
+		const PipelineOperation &operation);
+
+	// Reads the stages from filename. Returns false with a message in error
+	// (and the line) for unknown operations, duplicate names, inputs naming
+	// no stage and cycles.
+	bool Read(const char *filename, std::string &error);
+	bool Parse(const std::string &text, std::string &error);
+
+	// In an order in which every stage follows its inputs
+	const std::vector<PipelineStage> &Stages() const { return m_Stages; }
+
+	// Runs the pipeline with up to threads stages at once (0 uses every
+	// core). On failure the stages already running are finished, no new
+	// ones are started and error names the stage that failed.
+	bool Run(unsigned int threads, std::string &error);
+
+	// Of the last Run(), in the order of Stages()
+	const std::vector<PipelineStageTiming> &Timings() const { return m_Timings; }
+	// Highest total of the outputs held at once
+	std::size_t PeakBytes() const { return m_PeakBytes; }
+
+private:
+	bool Order(std::string &error);
+
+	struct Operation
+	{
+		std::vector<std::string> InputKeys;
+		PipelineOperation Run;
+	};
+	std::map< std::string, Operation > m_Operations;
+	std::vector<PipelineStage> m_Stages;
+	std::vector<PipelineStageTiming> m_Timings;
+	std::size_t m_PeakBytes;
+};
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,86 @@
+//
+//  pipelineProfiler.h
+//  Common
+//
+//  Attaches ITK filters to a StageProfiler (stageProfiler.h): each filter
+//  becomes a stage from its StartEvent to its EndEvent, so the stages of a
+//  pipeline run by a single writer->Update() are still told apart. A
+//  filter's inputs are brought up to date before its StartEvent, so its
+//  stage covers only its own work; writers are the exception, and the
+//  filters they pull on show as stages nested in theirs. Requires ITK
+//  (header only, not part of medimg).
+//
+
+#ifndef MEDIMG_PIPELINEPROFILER_H
+#define MEDIMG_PIPELINEPROFILER_H
+
+#include <string>
+#include "itkCommand.h"
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+#include "stageProfiler.h"
+
+
+namespace medimg
+{
+
+// Begins and ends a stage on the start and end events of a filter
+class StageCommand : public itk::Command
+{
+public:
+	typedef StageCommand Self;
+	typedef itk::Command Superclass;
+	typedef itk::SmartPointer< Self > Pointer;
+	itkNewMacro( Self );
+
+	void SetStage(StageProfiler *profiler, const std::string &name)
+	{
+		m_Profiler = profiler;
+		m_Name = name;
+	}
+
+	void Execute(itk::Object *caller, const itk::EventObject &event)
+	{
+		Execute( const_cast< const itk::Object * >( caller ), event );
+	}
+
+	void Execute(const itk::Object *, const itk::EventObject &event)
+	{
+		if( itk::StartEvent().CheckEvent( &event ) ) {
+			m_Profiler->Begin( m_Name );
+		}
+		else if( itk::EndEvent().CheckEvent( &event ) ) {
+			m_Profiler->End();
+		}
+	}
+
+protected:
+	StageCommand() : m_Profiler( 0 ) {}
+
+private:
+	StageProfiler *m_Profiler;
+	std::string m_Name;
+};
+
+// Records every run of filter as the stage name; nothing is attached when
+// profiling is off
+inline void ProfileFilter(StageProfiler &profiler, itk::Object *filter, const std::string &name)
+{
+	if( !profiler.Enabled() ) {
+		return;
+	}
+	StageCommand::Pointer command = StageCommand::New();
+	command->SetStage( &profiler, name );
+	filter->AddObserver( itk::StartEvent(), command );
+	filter->AddObserver( itk::EndEvent(), command );
+}
+
+// Utilization is reported against the threads ITK filters use
+inline void UseITKThreads(StageProfiler &profiler)
+{
+	profiler.SetThreads( itk::MultiThreader::GetGlobalDefaultNumberOfThreads() );
+}
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,157 @@
+//
+//  pixelTypeDispatch.h
+//  Common
+//
+//  Runtime selection of a pipeline instantiation from the pixel type stored
+//  in an image file. The tools are written as templates over their input
+//  pixel type; instead of reading every file as unsigned short or float
+//  (a full-volume cast on load), the header is read first and the matching
+//  instantiation is run. Requires ITK (header only, not part of medimg).
+//
+
+#ifndef MEDIMG_PIXELTYPEDISPATCH_H
+#define MEDIMG_PIXELTYPEDISPATCH_H
+
+#include <cstdlib>
+#include <iostream>
+#include "itkImageIOBase.h"
+#include "itkImageIOFactory.h"
+#include "chunkedVolume.h"
+#include "compactLabels.h"
+#include "matFile.h"
+
+
+namespace medimg
+{
+
+// Calls functor.template Run<TPixel>() for the scalar type described by io,
+// whose image information must already have been read. The instantiated
+// types are the ones our CT/MR series and intermediates actually use;
+// anything else is read as float.
+template< class TFunctor >
+int DispatchOnComponentType(const itk::ImageIOBase *io, const TFunctor &functor)
+{
+	if( io->GetNumberOfComponents() != 1 ) {
+		std::cerr << "Only scalar images are supported" << std::endl;
+		return EXIT_FAILURE;
+	}
+	switch( io->GetComponentType() ) {
+		case itk::ImageIOBase::UCHAR:
+			return functor.template Run< unsigned char >();
+		case itk::ImageIOBase::SHORT:
+			return functor.template Run< short >();
+		case itk::ImageIOBase::USHORT:
+			return functor.template Run< unsigned short >();
+		case itk::ImageIOBase::DOUBLE:
+			return functor.template Run< double >();
+		case itk::ImageIOBase::FLOAT:
+			return functor.template Run< float >();
+		default:
+			std::cerr << "Reading "
+				<< itk::ImageIOBase::GetComponentTypeAsString( io->GetComponentType() )
+				<< " pixels as float" << std::endl;
+			return functor.template Run< float >();
+	}
+}
+
+// Same for the class of the array a MAT-file is read as (see
+// compactImageIO.h); logical arrays are unsigned char
+template< class TFunctor >
+int DispatchOnMatClass(const char *filename, const TFunctor &functor)
+{
+	MatFile file;
+	std::string error;
+	if( !file.Open( filename, error ) ) {
+		std::cerr << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	const int array = file.Find();
+	if( array < 0 ) {
+		std::cerr << filename << " holds no numeric array" << std::endl;
+		return EXIT_FAILURE;
+	}
+	switch( file.Arrays()[array].Class ) {
+		case MatUInt8:
+			return functor.template Run< unsigned char >();
+		case MatInt16:
+			return functor.template Run< short >();
+		case MatUInt16:
+			return functor.template Run< unsigned short >();
+		case MatDouble:
+			return functor.template Run< double >();
+		case MatSingle:
+			return functor.template Run< float >();
+		default:
+			std::cerr << "Reading array " << file.Arrays()[array].Name
+				<< " as float" << std::endl;
+			return functor.template Run< float >();
+	}
+}
+
+// Same for the pixel type stored in a chunked volume (chunkedVolume.h)
+template< class TFunctor >
+int DispatchOnChunkedVolume(const char *filename, const TFunctor &functor)
+{
+	ChunkedVolumeInfo info;
+	std::string error;
+	if( !ReadChunkedVolumeInfo( filename, info, error ) ) {
+		std::cerr << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	switch( info.PixelType ) {
+		case UInt8Pixel:
+			return functor.template Run< unsigned char >();
+		case Int16Pixel:
+			return functor.template Run< short >();
+		case UInt16Pixel:
+			return functor.template Run< unsigned short >();
+		case DoublePixel:
+			return functor.template Run< double >();
+		case FloatPixel:
+			return functor.template Run< float >();
+		default:
+			std::cerr << "Reading " << filename << " as float" << std::endl;
+			return functor.template Run< float >();
+	}
+}
+
+// Same, reading only the header of filename. Compact masks and label maps
+// (compactLabels.h) carry no ITK header: bit masks run as unsigned char,
+// run-length label maps as unsigned short.
+template< class TFunctor >
+int DispatchOnPixelType(const char *filename, const TFunctor &functor)
+{
+	switch( CompactFormatOf( filename ) ) {
+		case BitMaskFormat:
+			return functor.template Run< unsigned char >();
+		case RunLengthFormat:
+			return functor.template Run< unsigned short >();
+		default:
+			break;
+	}
+	if( IsMatFileName( filename ) ) {
+		return DispatchOnMatClass( filename, functor );
+	}
+	if( IsChunkedVolumeName( filename ) ) {
+		return DispatchOnChunkedVolume( filename, functor );
+	}
+	itk::ImageIOBase::Pointer io = itk::ImageIOFactory::CreateImageIO(
+		filename, itk::ImageIOFactory::ReadMode );
+	if( !io ) {
+		std::cerr << "Could not find an ImageIO for " << filename << std::endl;
+		return EXIT_FAILURE;
+	}
+	try {
+		io->SetFileName( filename );
+		io->ReadImageInformation();
+	} catch (itk::ExceptionObject &excp) {
+		std::cerr << "Exception thrown while reading the image header" << std::endl;
+		std::cerr << excp << std::endl;
+		return EXIT_FAILURE;
+	}
+	return DispatchOnComponentType( io.GetPointer(), functor );
+}
+
+} // end namespace medimg
+
+#endif
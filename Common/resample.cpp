@@ -0,0 +1,325 @@
+//
+//  resample.cpp
+//  Common
+//
+
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Values of a row handed to a worker at once along y and z
+const std::size_t BlockValues = 1024;
+
+const double Pi = 3.14159265358979323846;
+
+// Sample i of a line of n, mirrored across its ends
+std::size_t Mirror(long i, long n)
+{
+	if( n == 1 ) {
+		return 0;
+	}
+	const long period = 2 * n - 2;
+	i = std::labs( i ) % period;
+	return static_cast<std::size_t>( i < n ? i : period - i );
+}
+
+double Sinc(double x)
+{
+	return x == 0.0 ? 1.0 : std::sin( Pi * x ) / ( Pi * x );
+}
+
+double CubicBSpline(double x)
+{
+	x = std::fabs( x );
+	if( x < 1.0 ) {
+		return 2.0 / 3.0 - x * x + 0.5 * x * x * x;
+	}
+	if( x < 2.0 ) {
+		const double t = 2.0 - x;
+		return t * t * t / 6.0;
+	}
+	return 0.0;
+}
+
+// Output sample j of an axis is the sum over the taps t of
+// Weights[j * Taps + t] times input sample Index[j * Taps + t]
+struct AxisWeights
+{
+	std::size_t Taps;
+	std::vector<std::size_t> Index;
+	std::vector<float> Weights;
+};
+
+// Weights of the output samples j = 0..nOut-1 of an axis, which lie at
+// offset + j * step in input samples
+AxisWeights KernelWeights(const ResampleOptions &options, std::size_t nIn, std::size_t nOut,
+	double offset, double step)
+{
+	AxisWeights weights;
+	if( options.Kernel == NearestKernel ) {
+		weights.Taps = 1;
+		weights.Weights.assign( nOut, 1.0f );
+		weights.Index.resize( nOut );
+		for( std::size_t j = 0; j < nOut; ++j ) {
+			const double u = std::floor( offset + j * step + 0.5 );
+			weights.Index[j] = static_cast<std::size_t>( std::min( std::max( u, 0.0 ),
+				static_cast<double>( nIn - 1 ) ) );
+		}
+		return weights;
+	}
+
+	// Widened where the output is coarser, to average what it skips
+	const double scale = options.Kernel == BSplineKernel ? 1.0 : std::max( 1.0, step );
+	const double radius = options.Kernel == LinearKernel ? scale
+		: options.Kernel == BSplineKernel ? 2.0 : options.SincRadius * scale;
+	weights.Taps = static_cast<std::size_t>( std::ceil( 2.0 * radius ) );
+	weights.Index.resize( nOut * weights.Taps );
+	weights.Weights.resize( nOut * weights.Taps );
+	for( std::size_t j = 0; j < nOut; ++j ) {
+		const double u = offset + j * step;
+		const long first = static_cast<long>( std::floor( u - radius ) ) + 1;
+		double sum = 0.0;
+		for( std::size_t t = 0; t < weights.Taps; ++t ) {
+			const double x = u - ( first + static_cast<long>( t ) );
+			double w;
+			if( options.Kernel == LinearKernel ) {
+				w = std::max( 0.0, 1.0 - std::fabs( x ) / scale );
+			}
+			else if( options.Kernel == BSplineKernel ) {
+				w = CubicBSpline( x );
+			}
+			else {
+				w = std::fabs( x ) < radius ? Sinc( x / scale ) * Sinc( x / radius ) : 0.0;
+			}
+			weights.Index[j * weights.Taps + t] = Mirror( first + static_cast<long>( t ),
+				static_cast<long>( nIn ) );
+			weights.Weights[j * weights.Taps + t] = static_cast<float>( w );
+			sum += w;
+		}
+		// The sinc weights do not sum to 1 between samples
+		if( sum != 0.0 ) {
+			for( std::size_t t = 0; t < weights.Taps; ++t ) {
+				weights.Weights[j * weights.Taps + t] /= static_cast<float>( sum );
+			}
+		}
+	}
+	return weights;
+}
+
+// Cubic B-spline coefficients of the lines of n samples, in place, by the
+// recursive filter of Unser (1999) with mirrored ends. Sample i of line
+// (o, k) is values[( o * n + i ) * inner + k].
+void BSplinePrefilter(float *values, std::size_t outer, std::size_t n, std::size_t inner,
+	unsigned int threads)
+{
+	if( n < 2 ) {
+		return;
+	}
+	const float z = static_cast<float>( std::sqrt( 3.0 ) - 2.0 );
+	const float gain = 6.0f;
+	// |z|^16 < 1e-9: the causal sum starting the recursion is cut there
+	const std::size_t horizon = std::min<std::size_t>( n, 16 );
+	const std::size_t blocks = ( inner + BlockValues - 1 ) / BlockValues;
+	ParallelFor( outer * blocks, threads, [&](std::size_t item, unsigned int) {
+		const std::size_t k0 = item % blocks * BlockValues;
+		const std::size_t length = std::min( BlockValues, inner - k0 );
+		float *line = values + item / blocks * n * inner + k0;
+
+		std::vector<float> first( length, 0.0f );
+		float zk = 1.0f;
+		for( std::size_t i = 0; i < horizon; ++i, zk *= z ) {
+			const float *row = line + i * inner;
+			for( std::size_t k = 0; k < length; ++k ) {
+				first[k] += zk * row[k];
+			}
+		}
+		for( std::size_t k = 0; k < length; ++k ) {
+			line[k] = gain * first[k];
+		}
+		for( std::size_t i = 1; i < n; ++i ) {
+			float *row = line + i * inner;
+			const float *previous = row - inner;
+			for( std::size_t k = 0; k < length; ++k ) {
+				row[k] = gain * row[k] + z * previous[k];
+			}
+		}
+		float *last = line + ( n - 1 ) * inner;
+		for( std::size_t k = 0; k < length; ++k ) {
+			last[k] = z / ( z * z - 1.0f ) * ( last[k] + z * ( last - inner )[k] );
+		}
+		for( std::size_t i = n - 1; i-- > 0; ) {
+			float *row = line + i * inner;
+			const float *next = row + inner;
+			for( std::size_t k = 0; k < length; ++k ) {
+				row[k] = z * ( next[k] - row[k] );
+			}
+		}
+	} );
+}
+
+// One separable pass: the lines of nIn samples of in (laid out as in
+// BSplinePrefilter) resampled to nOut samples into out
+void ResampleLines(const float *in, std::size_t outer, std::size_t nIn, std::size_t inner,
+	const AxisWeights &weights, std::size_t nOut, float *out, unsigned int threads)
+{
+	const std::size_t taps = weights.Taps;
+	if( inner == 1 ) {
+		// Along x: one dot product per output sample
+		ParallelFor( outer, threads, [&](std::size_t o, unsigned int) {
+			const float *line = in + o * nIn;
+			float *row = out + o * nOut;
+			for( std::size_t j = 0; j < nOut; ++j ) {
+				const std::size_t *index = &weights.Index[j * taps];
+				const float *w = &weights.Weights[j * taps];
+				float sum = 0.0f;
+				for( std::size_t t = 0; t < taps; ++t ) {
+					sum += w[t] * line[index[t]];
+				}
+				row[j] = sum;
+			}
+		} );
+		return;
+	}
+
+	// Along y and z: whole rows are scaled and added, contiguous in memory
+	const std::size_t blocks = ( inner + BlockValues - 1 ) / BlockValues;
+	ParallelFor( outer * blocks, threads, [&](std::size_t item, unsigned int) {
+		const std::size_t o = item / blocks;
+		const std::size_t k0 = item % blocks * BlockValues;
+		const std::size_t length = std::min( BlockValues, inner - k0 );
+		const float *line = in + o * nIn * inner + k0;
+		for( std::size_t j = 0; j < nOut; ++j ) {
+			float *row = out + ( o * nOut + j ) * inner + k0;
+			std::fill( row, row + length, 0.0f );
+			for( std::size_t t = 0; t < taps; ++t ) {
+				const float w = weights.Weights[j * taps + t];
+				if( w == 0.0f ) {
+					continue;
+				}
+				const float *source = line + weights.Index[j * taps + t] * inner;
+				for( std::size_t k = 0; k < length; ++k ) {
+					row[k] += w * source[k];
+				}
+			}
+		}
+	} );
+}
+
+} // end anonymous namespace
+
+
+bool ResampleKernelFromName(const std::string &name, ResampleKernel &kernel)
+{
+	const char *names[4] = { "nearest", "linear", "bspline", "sinc" };
+	const ResampleKernel kernels[4] = { NearestKernel, LinearKernel, BSplineKernel, WindowedSincKernel };
+	for( int k = 0; k < 4; ++k ) {
+		if( name == names[k] ) {
+			kernel = kernels[k];
+			return true;
+		}
+	}
+	return false;
+}
+
+
+Geometry IsotropicGeometry(const Geometry &geometry, double spacing)
+{
+	if( spacing <= 0.0 ) {
+		spacing = std::min( geometry.Spacing[0], std::min( geometry.Spacing[1], geometry.Spacing[2] ) );
+	}
+	Geometry isotropic( geometry );
+	const std::size_t n[3] = { geometry.dims.nx, geometry.dims.ny, geometry.dims.nz };
+	std::size_t m[3];
+	for( int a = 0; a < 3; ++a ) {
+		isotropic.Spacing[a] = spacing;
+		m[a] = n[a] == 0 ? 0 : static_cast<std::size_t>(
+			std::floor( ( n[a] - 1 ) * geometry.Spacing[a] / spacing + 1e-6 ) ) + 1;
+	}
+	isotropic.dims = Dims( m[0], m[1], m[2] );
+	return isotropic;
+}
+
+
+bool Resample(const float *in, const Geometry &from, float *out, const Geometry &to,
+	const ResampleOptions &options, std::string &error)
+{
+	for( int i = 0; i < 9; ++i ) {
+		if( std::fabs( from.Direction[i] - to.Direction[i] ) > 1e-6 ) {
+			error = "Cannot resample between grids of different directions";
+			return false;
+		}
+	}
+	std::size_t sizes[3] = { from.dims.nx, from.dims.ny, from.dims.nz };
+	const std::size_t nOut[3] = { to.dims.nx, to.dims.ny, to.dims.nz };
+	if( to.dims.Voxels() == 0 ) {
+		return true;
+	}
+	if( from.dims.Voxels() == 0 ) {
+		error = "Cannot resample an empty volume";
+		return false;
+	}
+	const unsigned int threads = options.NumberOfThreads > 0 ? options.NumberOfThreads
+		: DefaultNumberOfThreads();
+
+	// Input samples of the output along each axis: the origins differ by
+	// Direction * offset
+	std::vector<int> axes;
+	AxisWeights weights[3];
+	for( int a = 0; a < 3; ++a ) {
+		double offset = 0.0;
+		for( int b = 0; b < 3; ++b ) {
+			offset += from.Direction[3 * b + a] * ( to.Origin[b] - from.Origin[b] );
+		}
+		offset /= from.Spacing[a];
+		const double step = to.Spacing[a] / from.Spacing[a];
+		// Axes that stay on the same samples are left alone
+		if( sizes[a] != nOut[a] || std::fabs( offset ) > 1e-6 || std::fabs( step - 1.0 ) > 1e-9 ) {
+			weights[a] = KernelWeights( options, sizes[a], nOut[a], offset, step );
+			axes.push_back( a );
+		}
+	}
+	if( axes.empty() ) {
+		std::copy( in, in + from.dims.Voxels(), out );
+		return true;
+	}
+
+	const float *source = in;
+	std::vector<float> coefficients, passes[2];
+	for( std::size_t q = 0; q < axes.size(); ++q ) {
+		const int a = axes[q];
+		std::size_t inner = 1, outer = 1;
+		for( int b = 0; b < a; ++b ) {
+			inner *= sizes[b];
+		}
+		for( int b = a + 1; b < 3; ++b ) {
+			outer *= sizes[b];
+		}
+		if( options.Kernel == BSplineKernel ) {
+			coefficients.assign( source, source + inner * sizes[a] * outer );
+			BSplinePrefilter( &coefficients[0], outer, sizes[a], inner, threads );
+			source = &coefficients[0];
+		}
+		float *destination = out;
+		if( q + 1 < axes.size() ) {
+			passes[q % 2].resize( inner * nOut[a] * outer );
+			destination = &passes[q % 2][0];
+		}
+		ResampleLines( source, outer, sizes[a], inner, weights[a], nOut[a], destination, threads );
+		sizes[a] = nOut[a];
+		source = destination;
+	}
+	return true;
+}
+
+} // end namespace medimg
@@ -0,0 +1,66 @@
+//
+//  resample.h
+//  Common
+//
+//  Resampling between grids that share their direction, e.g. of a
+//  0.7x0.7x2.5 mm series onto an isotropic grid before the Hessian filters
+//  and level sets, and of their results back onto the series. The kernels
+//  are separable, so the volume is resampled along x, then y, then z; each
+//  pass has its own weights per output line, computed once, and runs in
+//  parallel over blocks of whole rows, where the inner loop over x is a
+//  plain multiply-add the compiler vectorizes.
+//
+//  Kernels: nearest neighbour (for label maps), linear, cubic B-spline
+//  (interpolating: the samples are prefiltered into spline coefficients
+//  along each axis first) and Lanczos windowed sinc. Where the output is
+//  coarser than the input along an axis, the linear and sinc kernels are
+//  widened by the ratio of the spacings, so the input is averaged rather
+//  than aliased; nearest and B-spline only interpolate. Samples beyond the
+//  input are mirrored across its border (clamped for nearest).
+//
+
+#ifndef MEDIMG_RESAMPLE_H
+#define MEDIMG_RESAMPLE_H
+
+#include <string>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+enum ResampleKernel
+{
+	NearestKernel,
+	LinearKernel,
+	BSplineKernel,
+	WindowedSincKernel
+};
+
+// "nearest", "linear", "bspline" or "sinc"; false for other names
+bool ResampleKernelFromName(const std::string &name, ResampleKernel &kernel);
+
+struct ResampleOptions
+{
+	ResampleKernel Kernel;
+	// Lobes on either side of the windowed sinc
+	int SincRadius;
+	unsigned int NumberOfThreads;
+
+	ResampleOptions() : Kernel( LinearKernel ), SincRadius( 4 ), NumberOfThreads( 0 ) {}
+};
+
+// Grid of spacing along every axis with the origin and direction of
+// geometry, covering its voxels; spacing 0 is the finest spacing of
+// geometry
+Geometry IsotropicGeometry(const Geometry &geometry, double spacing = 0.0);
+
+// Resamples in (from.dims.Voxels() values on the grid from) onto the grid
+// to, into out (to.dims.Voxels() values). False with a message in error
+// when the grids differ in direction.
+bool Resample(const float *in, const Geometry &from, float *out, const Geometry &to,
+	const ResampleOptions &options, std::string &error);
+
+} // end namespace medimg
+
+#endif
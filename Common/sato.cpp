@@ -0,0 +1,47 @@
+//
+//  sato.cpp
+//  Common
+//
+
+#include "sato.h"
+
+#include <cmath>
+#include <iostream>
+
+
+namespace medimg
+{
+
+double SatoMeasure(double l1, double l2, double alpha1, double alpha2)
+{
+	// lambda_c = min(-l0, -l1), which is -l1 as l0 <= l1
+	const double lc = -l1;
+	if( lc <= 0 ) {
+		return 0.0;
+	}
+	const double alpha = l2 <= 0 ? alpha1 : alpha2;
+	const double r = l2 / (alpha * lc);
+	return lc * std::exp( -0.5 * r * r );
+}
+
+
+void SatoFilter3D(const float *I, const Dims &dims, const SatoOptions &options,
+	float *Iout, float *whatScale, ThreadPool *pool)
+{
+	if( options.verbose ) {
+		std::cout << "Sato Filter Sigmas:";
+		for( std::size_t s = 0; s < options.Sigmas.size(); ++s ) {
+			std::cout << " " << options.Sigmas[s];
+		}
+		std::cout << std::endl;
+	}
+	const double alpha1 = options.Alpha1;
+	const double alpha2 = options.Alpha2;
+	MultiscaleHessianMeasure( I, dims, options,
+		[alpha1, alpha2](double, double l1, double l2) {
+			return SatoMeasure( l1, l2, alpha1, alpha2 );
+		},
+		Iout, whatScale, pool );
+}
+
+} // end namespace medimg
@@ -0,0 +1,46 @@
+//
+//  sato.h
+//  Common
+//
+//  Native multiscale Sato line filter (Sato et al. 1998), the measure of
+//  itk::Hessian3DToVesselnessMeasureImageFilter evaluated over a list of
+//  sigmas by the tiled driver in hessianMeasure.h: only the maximum and
+//  the scale index are kept as volumes, and tiles are spread over a
+//  ThreadPool that the caller can share with other filters.
+//
+
+#ifndef MEDIMG_SATO_H
+#define MEDIMG_SATO_H
+
+#include "hessianMeasure.h"
+
+
+namespace medimg
+{
+
+// Sigmas are in physical units like the ITK filter's sigma. The single-
+// scale ITK filter does not normalize across scale.
+struct SatoOptions : public HessianMeasureOptions
+{
+	// Weights for lambda3 <= 0 and lambda3 > 0, the ITK defaults
+	double Alpha1;
+	double Alpha2;
+
+	SatoOptions() : Alpha1(0.5), Alpha2(2.0) {}
+};
+
+// Line measure of one Hessian with eigenvalues l0 <= l1 <= l2, for bright
+// tubes on a dark background; 0 unless l0 and l1 are negative, which only
+// depends on l1, so l0 is not passed.
+double SatoMeasure(double l1, double l2, double alpha1, double alpha2);
+
+// Maximum Sato response over options.Sigmas into Iout and, when given, the
+// 1-based index of the sigma at which it was found into whatScale. Both
+// hold dims.Voxels() values and are owned by the caller. pool = 0 runs on
+// a pool of options.NumberOfThreads created for the call.
+void SatoFilter3D(const float *I, const Dims &dims, const SatoOptions &options,
+	float *Iout, float *whatScale = 0, ThreadPool *pool = 0);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,88 @@
+//
+//  seedFile.cpp
+//  Common
+//
+
+#include "seedFile.h"
+
+#include <fstream>
+#include <sstream>
+
+
+namespace medimg
+{
+
+bool ReadSeedFile(const char *filename, const Dims &dims, std::vector<std::size_t> &seeds,
+	std::string &error)
+{
+	std::ifstream file( filename );
+	if( !file ) {
+		error = std::string( "Cannot open seed file " ) + filename;
+		return false;
+	}
+	std::string line;
+	for( int number = 1; std::getline( file, line ); ++number ) {
+		std::istringstream fields( line );
+		std::string first;
+		if( !( fields >> first ) || first[0] == '#' ) {
+			continue;
+		}
+		std::istringstream all( line );
+		long x, y, z;
+		std::ostringstream where;
+		where << filename << ":" << number << ": ";
+		if( !( all >> x >> y >> z ) ) {
+			error = where.str() + "expected a voxel index \"x y z\"";
+			return false;
+		}
+		if( x < 0 || y < 0 || z < 0 || x >= static_cast<long>( dims.nx )
+			|| y >= static_cast<long>( dims.ny ) || z >= static_cast<long>( dims.nz ) ) {
+			error = where.str() + "seed outside the volume";
+			return false;
+		}
+		seeds.push_back( dims.Index( x, y, z ) );
+	}
+	return true;
+}
+
+bool ReadSliceSeedFile(const char *filename, const Dims &dims,
+	std::vector< std::vector<SliceSeed> > &seeds, std::string &error)
+{
+	std::ifstream file( filename );
+	if( !file ) {
+		error = std::string( "Cannot open seed file " ) + filename;
+		return false;
+	}
+	seeds.assign( dims.nz, std::vector<SliceSeed>() );
+	std::string line;
+	for( int number = 1; std::getline( file, line ); ++number ) {
+		std::istringstream fields( line );
+		std::string first;
+		if( !( fields >> first ) || first[0] == '#' ) {
+			continue;
+		}
+		std::istringstream all( line );
+		long z, x, y;
+		double radius;
+		std::ostringstream where;
+		where << filename << ":" << number << ": ";
+		if( !( all >> z >> x >> y >> radius ) ) {
+			error = where.str() + "expected a slice seed \"z x y radius\"";
+			return false;
+		}
+		if( x < 0 || y < 0 || z < 0 || x >= static_cast<long>( dims.nx )
+			|| y >= static_cast<long>( dims.ny ) || z >= static_cast<long>( dims.nz ) ) {
+			error = where.str() + "seed outside the volume";
+			return false;
+		}
+		if( radius < 0 ) {
+			error = where.str() + "negative radius";
+			return false;
+		}
+		const SliceSeed seed = { static_cast<std::size_t>( x ), static_cast<std::size_t>( y ), radius };
+		seeds[z].push_back( seed );
+	}
+	return true;
+}
+
+} // end namespace medimg
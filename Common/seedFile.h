@@ -0,0 +1,46 @@
+//
+//  seedFile.h
+//  Common
+//
+//  Seed points for the region growing tools, as a text file with one seed
+//  per line given by its voxel index "x y z". Empty lines and lines
+//  starting with # are ignored.
+//
+//  The slice-by-slice segmentation takes seeds per slice instead, as lines
+//  "z x y radius": the slice, the pixel in it and the radius in pixels of
+//  the disk the initial level set starts from (as entered in
+//  liversegmentation.py).
+//
+
+#ifndef MEDIMG_SEEDFILE_H
+#define MEDIMG_SEEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Appends the seeds in filename as voxel indices into a volume of dims to
+// seeds. Returns false with a message in error if the file cannot be read,
+// a line does not hold three integers or a seed lies outside the volume.
+bool ReadSeedFile(const char *filename, const Dims &dims, std::vector<std::size_t> &seeds,
+	std::string &error);
+
+struct SliceSeed
+{
+	std::size_t x, y;
+	double Radius;
+};
+
+// Reads the per-slice seeds in filename into seeds[z] (resized to dims.nz
+// slices), with the same checks as ReadSeedFile and a nonnegative radius
+bool ReadSliceSeedFile(const char *filename, const Dims &dims,
+	std::vector< std::vector<SliceSeed> > &seeds, std::string &error);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,127 @@
+//
+//  seriesHeader.cpp
+//  Common
+//
+
+#include "seriesHeader.h"
+
+#include <fstream>
+#include <sstream>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// n numbers from the value of a header line
+bool ParseValues(const std::string &value, double *values, int n)
+{
+	std::istringstream fields( value );
+	for( int k = 0; k < n; ++k ) {
+		if( !( fields >> values[k] ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // end anonymous namespace
+
+
+bool ReadSeriesHeader(const std::string &filename, Geometry &geometry, std::string &source,
+	std::string &error)
+{
+	std::ifstream file( filename.c_str(), std::ios::binary );
+	if( !file ) {
+		error = "Cannot open series header " + filename;
+		return false;
+	}
+	geometry = Geometry();
+	source.clear();
+	bool haveSize = false, valid = true;
+	std::string line;
+	while( valid && std::getline( file, line ) ) {
+		const std::size_t equals = line.find( '=' );
+		if( equals == std::string::npos ) {
+			continue;
+		}
+		std::string key = line.substr( 0, equals );
+		key.erase( key.find_last_not_of( " \t" ) + 1 );
+		const std::size_t start = line.find_first_not_of( " \t", equals + 1 );
+		std::string value = start == std::string::npos ? std::string() : line.substr( start );
+		value.erase( value.find_last_not_of( " \t\r" ) + 1 );
+
+		if( key == "NDims" ) {
+			valid = value == "3";
+		}
+		else if( key == "DimSize" ) {
+			double size[3];
+			valid = haveSize = ParseValues( value, size, 3 );
+			geometry.dims = Dims( static_cast<std::size_t>( size[0] ),
+				static_cast<std::size_t>( size[1] ), static_cast<std::size_t>( size[2] ) );
+		}
+		else if( key == "ElementSpacing" ) {
+			valid = ParseValues( value, geometry.Spacing, 3 );
+		}
+		else if( key == "Offset" || key == "Position" || key == "Origin" ) {
+			valid = ParseValues( value, geometry.Origin, 3 );
+		}
+		else if( key == "TransformMatrix" || key == "Orientation" || key == "Rotation" ) {
+			double matrix[9];
+			valid = ParseValues( value, matrix, 9 );
+			for( int a = 0; a < 3; ++a ) {
+				for( int b = 0; b < 3; ++b ) {
+					geometry.Direction[3 * b + a] = matrix[3 * a + b];
+				}
+			}
+		}
+		else if( key == "SeriesSource" ) {
+			source = value;
+		}
+		else if( key == "ElementDataFile" ) {
+			// Image data follows in .mha files
+			break;
+		}
+		if( !valid ) {
+			error = filename + ": cannot read " + key + " of a 3D image";
+		}
+	}
+	if( valid && !haveSize ) {
+		error = filename + ": no DimSize";
+		valid = false;
+	}
+	return valid;
+}
+
+bool WriteSeriesHeader(const std::string &filename, const Geometry &geometry,
+	const std::string &source, std::string &error)
+{
+	std::ofstream file( filename.c_str() );
+	file.precision( 17 );
+	file << "NDims = 3\n";
+	file << "DimSize = " << geometry.dims.nx << " " << geometry.dims.ny << " " << geometry.dims.nz << "\n";
+	file << "ElementSpacing = " << geometry.Spacing[0] << " " << geometry.Spacing[1] << " "
+		<< geometry.Spacing[2] << "\n";
+	file << "Offset = " << geometry.Origin[0] << " " << geometry.Origin[1] << " "
+		<< geometry.Origin[2] << "\n";
+	file << "TransformMatrix =";
+	for( int a = 0; a < 3; ++a ) {
+		for( int b = 0; b < 3; ++b ) {
+			file << " " << geometry.Direction[3 * b + a];
+		}
+	}
+	file << "\n";
+	if( !source.empty() ) {
+		file << "SeriesSource = " << source << "\n";
+	}
+	file.close();
+	if( !file ) {
+		error = "Cannot write series header " + filename;
+		return false;
+	}
+	return true;
+}
+
+} // end namespace medimg
@@ -0,0 +1,42 @@
+//
+//  seriesHeader.h
+//  Common
+//
+//  Cached geometry of an image series, so that tools which only need the
+//  size and placement of a DICOM series (e.g. to assemble label maps) do
+//  not have to read it again. The cache is a text file of MetaImage header
+//  lines,
+//
+//    NDims = 3
+//    DimSize = 512 512 120
+//    ElementSpacing = 0.78 0.78 2.5
+//    Offset = -200 -180 -300
+//    TransformMatrix = 1 0 0 0 1 0 0 0 1
+//    SeriesSource = <DICOM directory> <series UID>
+//
+//  so the header of any .mha or .mhd image can be read as well. As in ITK's
+//  MetaImage IO, row a of TransformMatrix is the direction of image axis a,
+//  i.e. column a of Geometry::Direction.
+//
+
+#ifndef MEDIMG_SERIESHEADER_H
+#define MEDIMG_SERIESHEADER_H
+
+#include <string>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Reads the geometry (and the SeriesSource line, if any, into source) from
+// the header lines of filename; false with a message in error
+bool ReadSeriesHeader(const std::string &filename, Geometry &geometry, std::string &source,
+	std::string &error);
+
+bool WriteSeriesHeader(const std::string &filename, const Geometry &geometry,
+	const std::string &source, std::string &error);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,224 @@
+//
+//  skeleton.cpp
+//  Common
+//
+
+#include "skeleton.h"
+
+#include <vector>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Adjacency inside the 3x3x3 cube, position i = dx + 3 dy + 9 dz with
+// offsets in {0, 1, 2} and the center at 13
+struct CubeAdjacency
+{
+	std::vector<int> Adjacent26[27];
+	std::vector<int> Adjacent6[27];
+	bool InN18[27];
+
+	CubeAdjacency()
+	{
+		for( int i = 0; i < 27; ++i ) {
+			const int p[3] = { i % 3, (i / 3) % 3, i / 9 };
+			int offCenter = 0;
+			for( int a = 0; a < 3; ++a ) {
+				offCenter += p[a] != 1;
+			}
+			InN18[i] = offCenter < 3;
+			for( int j = 0; j < 27; ++j ) {
+				if( j == i ) {
+					continue;
+				}
+				const int q[3] = { j % 3, (j / 3) % 3, j / 9 };
+				int far = 0, differ = 0;
+				for( int a = 0; a < 3; ++a ) {
+					const int d = p[a] - q[a];
+					far += d > 1 || d < -1;
+					differ += d != 0;
+				}
+				if( far == 0 ) {
+					Adjacent26[i].push_back( j );
+					if( differ == 1 ) {
+						Adjacent6[i].push_back( j );
+					}
+				}
+			}
+		}
+	}
+};
+
+const CubeAdjacency &Cube()
+{
+	static const CubeAdjacency cube;
+	return cube;
+}
+
+const int Center = 13;
+const int FaceNeighbours[6] = { 12, 14, 10, 16, 4, 22 };
+
+// Gathers the neighbourhood of (x, y, z); outside the volume is background
+void Neighbourhood(const unsigned char *B, const Dims &dims, long x, long y, long z,
+	unsigned char nb[27])
+{
+	const long ext[3] = { static_cast<long>( dims.nx ), static_cast<long>( dims.ny ),
+		static_cast<long>( dims.nz ) };
+	const bool inner = x > 0 && y > 0 && z > 0 && x + 1 < ext[0] && y + 1 < ext[1]
+		&& z + 1 < ext[2];
+	int i = 0;
+	for( long dz = -1; dz <= 1; ++dz ) {
+		for( long dy = -1; dy <= 1; ++dy ) {
+			for( long dx = -1; dx <= 1; ++dx, ++i ) {
+				const long qx = x + dx, qy = y + dy, qz = z + dz;
+				if( !inner && ( qx < 0 || qy < 0 || qz < 0 || qx >= ext[0] || qy >= ext[1]
+					|| qz >= ext[2] ) ) {
+					nb[i] = 0;
+				}
+				else {
+					nb[i] = B[dims.Index( qx, qy, qz )] != 0;
+				}
+			}
+		}
+	}
+}
+
+int ObjectNeighbours(const unsigned char nb[27])
+{
+	int n = 0;
+	for( int i = 0; i < 27; ++i ) {
+		n += i != Center && nb[i];
+	}
+	return n;
+}
+
+} // end anonymous namespace
+
+
+bool IsSimplePoint(const unsigned char nb[27])
+{
+	const CubeAdjacency &cube = Cube();
+	bool seen[27] = { false };
+	int stack[27];
+
+	// Object components of the 26-neighbourhood, 26-connected
+	int components = 0;
+	for( int i = 0; i < 27; ++i ) {
+		if( i == Center || !nb[i] || seen[i] ) {
+			continue;
+		}
+		if( ++components > 1 ) {
+			return false;
+		}
+		int top = 0;
+		stack[top++] = i;
+		seen[i] = true;
+		while( top > 0 ) {
+			const int p = stack[--top];
+			const std::vector<int> &adj = cube.Adjacent26[p];
+			for( std::size_t k = 0; k < adj.size(); ++k ) {
+				const int q = adj[k];
+				if( q != Center && nb[q] && !seen[q] ) {
+					seen[q] = true;
+					stack[top++] = q;
+				}
+			}
+		}
+	}
+	if( components != 1 ) {
+		return false;
+	}
+
+	// Background components of the 18-neighbourhood, 6-connected, that are
+	// 6-adjacent to the center
+	components = 0;
+	for( int f = 0; f < 6; ++f ) {
+		const int i = FaceNeighbours[f];
+		if( nb[i] || seen[i] ) {
+			continue;
+		}
+		if( ++components > 1 ) {
+			return false;
+		}
+		int top = 0;
+		stack[top++] = i;
+		seen[i] = true;
+		while( top > 0 ) {
+			const int p = stack[--top];
+			const std::vector<int> &adj = cube.Adjacent6[p];
+			for( std::size_t k = 0; k < adj.size(); ++k ) {
+				const int q = adj[k];
+				if( q != Center && cube.InN18[q] && !nb[q] && !seen[q] ) {
+					seen[q] = true;
+					stack[top++] = q;
+				}
+			}
+		}
+	}
+	return components == 1;
+}
+
+
+std::size_t Skeletonize3D(unsigned char *B, const Dims &dims, unsigned int threads)
+{
+	// Border direction of each sub-iteration
+	const long directions[6][3] = {
+		{ 0, -1, 0 }, { 0, 1, 0 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+	};
+	std::vector< std::vector<std::size_t> > candidates( dims.nz );
+
+	for( bool changed = true; changed; ) {
+		changed = false;
+		for( int d = 0; d < 6; ++d ) {
+			const long *dir = directions[d];
+			ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+				std::vector<std::size_t> &plane = candidates[z];
+				plane.clear();
+				unsigned char nb[27];
+				for( std::size_t y = 0; y < dims.ny; ++y ) {
+					for( std::size_t x = 0; x < dims.nx; ++x ) {
+						const std::size_t i = dims.Index( x, y, z );
+						if( !B[i] ) {
+							continue;
+						}
+						Neighbourhood( B, dims, x, y, z, nb );
+						if( nb[Center + dir[0] + 3 * dir[1] + 9 * dir[2]] ) {
+							continue;
+						}
+						if( ObjectNeighbours( nb ) > 1 && IsSimplePoint( nb ) ) {
+							plane.push_back( i );
+						}
+					}
+				}
+			} );
+
+			// Earlier removals may have changed the neighbourhoods
+			unsigned char nb[27];
+			for( std::size_t z = 0; z < dims.nz; ++z ) {
+				const std::vector<std::size_t> &plane = candidates[z];
+				for( std::size_t c = 0; c < plane.size(); ++c ) {
+					const std::size_t i = plane[c];
+					const std::size_t x = i % dims.nx, y = (i / dims.nx) % dims.ny;
+					Neighbourhood( B, dims, x, y, z, nb );
+					if( ObjectNeighbours( nb ) > 1 && IsSimplePoint( nb ) ) {
+						B[i] = 0;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+
+	std::size_t voxels = 0;
+	for( std::size_t i = 0; i < dims.Voxels(); ++i ) {
+		voxels += B[i] != 0;
+	}
+	return voxels;
+}
+
+} // end namespace medimg
@@ -0,0 +1,41 @@
+//
+//  skeleton.h
+//  Common
+//
+//  Curve skeleton of a binary volume by directional thinning after Lee,
+//  Kashyap and Chu (1994), the algorithm behind ITK's BinaryThinning-
+//  ImageFilter3D and skimage's skeletonize_3d. Each of the six sub-
+//  iterations removes border voxels facing one direction. Finding the
+//  candidates (border voxels that are simple points and not line ends) is
+//  the expensive part and runs in parallel over z planes; the candidates
+//  are then re-checked and removed one by one, which keeps the result
+//  topologically equivalent to the input.
+//
+//  Topology is that of 26-connected objects on a 6-connected background.
+//  A voxel is simple when its 26-neighbourhood holds exactly one object
+//  component and exactly one background component 6-adjacent to it
+//  (Bertrand and Malandain 1994).
+//
+
+#ifndef MEDIMG_SKELETON_H
+#define MEDIMG_SKELETON_H
+
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Whether the center of the 3x3x3 neighbourhood nb (x fastest, nonzero =
+// object) can be removed without changing the topology.
+bool IsSimplePoint(const unsigned char nb[27]);
+
+// Thins the nonzero voxels of B (dims.Voxels() values, modified in place;
+// voxels on the volume border count as having background outside) to a
+// one voxel thick curve skeleton, keeping line ends. Returns the number of
+// skeleton voxels.
+std::size_t Skeletonize3D(unsigned char *B, const Dims &dims, unsigned int threads = 0);
+
+} // end namespace medimg
+
+#endif
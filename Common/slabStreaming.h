@@ -0,0 +1,119 @@
+//
+//  slabStreaming.h
+//  Common
+//
+//  Runs an ITK pipeline on overlapping z-slabs instead of the whole volume:
+//  the Hessian-based vessel filters, whose SymmetricSecondRankTensor<double,3>
+//  Hessian image costs 48 bytes per voxel before any output exists, which
+//  does not fit for a whole liver at full resolution, and the speed image
+//  of the liver tools under a memory budget (speedImage.h). Each slab is
+//  padded by a halo of planes sized from the largest sigma, filtered on its
+//  own, and only its core planes are copied into the output, so memory
+//  follows the slab size. Slabs span the full x-y extent, so only z is
+//  affected, and there the result approximates whole-volume processing
+//  rather than matching it: ITK's recursive Gaussians are IIR filters whose
+//  response decays exponentially but never reaches zero, so planes beyond
+//  the halo still contribute a little, and the recursion restarts at the
+//  end of each slab as at the border of the volume. The difference in the
+//  core planes shrinks exponentially with the halo, which is why it is
+//  several sigmas wide; slabs are not bit-identical to a whole-volume run.
+//
+
+#ifndef MEDIMG_SLABSTREAMING_H
+#define MEDIMG_SLABSTREAMING_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "itkExtractImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+
+
+// Rough footprint of one Hessian/vesselness pipeline per voxel of its
+// input: the slab copy, the double tensor Hessian image, the recursive
+// Gaussian intermediates and the per-scale and accumulated outputs.
+const double HessianPipelineBytesPerVoxel = 64.0;
+
+// Halo in planes covering supportInSigmas * sigmaMaximum (physical units,
+// as the ITK Hessian filters use image spacing) along z.
+template< class TImage >
+unsigned int SlabHalo(const TImage *image, double sigmaMaximum,
+	double supportInSigmas = 6.0)
+{
+	const double spacing = image->GetSpacing()[2];
+	return static_cast<unsigned int>( std::ceil( supportInSigmas * sigmaMaximum / spacing ) );
+}
+
+// Number of core planes per slab so that a padded slab stays within
+// budgetBytes at bytesPerVoxel. Returns 0 when not even one plane fits.
+template< class TImage >
+unsigned int SlabPlanes(const TImage *image, unsigned int halo,
+	double bytesPerVoxel, double budgetBytes)
+{
+	const typename TImage::SizeType size = image->GetLargestPossibleRegion().GetSize();
+	const double bytesPerPlane = bytesPerVoxel * size[0] * size[1];
+	const double planes = std::floor( budgetBytes / bytesPerPlane ) - 2.0 * halo;
+	if( planes < 1.0 ) {
+		return 0;
+	}
+	return static_cast<unsigned int>( std::min( planes, static_cast<double>( size[2] ) ) );
+}
+
+// Calls process(slab) on consecutive slabs of slabPlanes planes padded by
+// halo planes on each side (clipped to the volume), and assembles the core
+// planes of the returned images into one output image. process must return
+// an image covering the slab's region, e.g. the output of a filter whose
+// input was set to slab.
+template< class TInputImage, class TOutputImage, class TProcess >
+typename TOutputImage::Pointer ProcessInSlabs(const TInputImage *input,
+	unsigned int slabPlanes, unsigned int halo, TProcess process)
+{
+	typedef typename TInputImage::RegionType RegionType;
+	const RegionType whole = input->GetLargestPossibleRegion();
+	const long zBegin = whole.GetIndex()[2];
+	const long zEnd = zBegin + static_cast<long>( whole.GetSize()[2] );
+
+	typename TOutputImage::Pointer output = TOutputImage::New();
+	output->CopyInformation( input );
+	output->SetRegions( whole );
+	output->Allocate();
+
+	typedef itk::ExtractImageFilter< TInputImage, TInputImage > ExtractFilterType;
+	typename ExtractFilterType::Pointer extract = ExtractFilterType::New();
+	extract->SetInput( input );
+	extract->SetDirectionCollapseToSubmatrix();
+
+	unsigned int slab = 0;
+	for( long z0 = zBegin; z0 < zEnd; z0 += slabPlanes, ++slab ) {
+		const long z1 = std::min( z0 + static_cast<long>( slabPlanes ), zEnd );
+		const long p0 = std::max( z0 - static_cast<long>( halo ), zBegin );
+		const long p1 = std::min( z1 + static_cast<long>( halo ), zEnd );
+
+		RegionType padded = whole;
+		padded.GetModifiableIndex()[2] = p0;
+		padded.GetModifiableSize()[2] = static_cast<typename RegionType::SizeValueType>( p1 - p0 );
+		RegionType core = whole;
+		core.GetModifiableIndex()[2] = z0;
+		core.GetModifiableSize()[2] = static_cast<typename RegionType::SizeValueType>( z1 - z0 );
+
+		std::cout << "Slab " << slab << ": planes " << z0 << "-" << (z1 - 1)
+			<< " (with halo " << p0 << "-" << (p1 - 1) << ")" << std::endl;
+
+		extract->SetExtractionRegion( padded );
+		extract->Update();
+		typename TInputImage::Pointer slabImage = extract->GetOutput();
+		slabImage->DisconnectPipeline();
+
+		const typename TOutputImage::Pointer result = process( slabImage.GetPointer() );
+
+		itk::ImageRegionConstIterator< TOutputImage > in( result, core );
+		itk::ImageRegionIterator< TOutputImage > out( output, core );
+		for( ; !in.IsAtEnd(); ++in, ++out ) {
+			out.Set( in.Get() );
+		}
+	}
+	return output;
+}
+
+#endif
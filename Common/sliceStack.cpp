@@ -0,0 +1,106 @@
+//
+//  sliceStack.cpp
+//  Common
+//
+
+#include "sliceStack.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <mutex>
+#include <sstream>
+#include "npyFile.h"
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+bool FindNumberedSlices(const std::string &directory, const std::string &extension,
+	std::size_t slices, std::vector<std::string> &files, std::string &error)
+{
+	DIR *dir = opendir( directory.c_str() );
+	if( !dir ) {
+		error = "Cannot read directory " + directory;
+		return false;
+	}
+	const std::string prefix = directory.empty() || directory[directory.size() - 1] == '/' ?
+		directory : directory + "/";
+	files.assign( slices, std::string() );
+	bool found = true;
+	for( struct dirent *entry = readdir( dir ); entry && found; entry = readdir( dir ) ) {
+		const std::string name = entry->d_name;
+		if( name.size() <= extension.size()
+			|| name.compare( name.size() - extension.size(), extension.size(), extension ) != 0 ) {
+			continue;
+		}
+		const std::size_t digit = name.find_first_of( "0123456789" );
+		if( digit == std::string::npos ) {
+			continue;
+		}
+		std::istringstream number( name.substr( digit ) );
+		std::size_t z;
+		number >> z;
+		if( z >= slices ) {
+			error = prefix + name + ": slice number beyond the series";
+			found = false;
+		}
+		else if( !files[z].empty() ) {
+			error = prefix + name + ": slice number already taken by " + files[z];
+			found = false;
+		}
+		else {
+			files[z] = prefix + name;
+		}
+	}
+	closedir( dir );
+	return found;
+}
+
+template< class T >
+bool ScatterNpySlices(const std::vector<std::string> &files, const Dims &dims, T *out,
+	std::string &error, unsigned int threads)
+{
+	const std::size_t sliceSize = dims.nx * dims.ny;
+	std::mutex errorMutex;
+	bool failed = false;
+
+	ParallelFor( dims.nz, threads, [&](std::size_t z, unsigned int) {
+		T *slice = out + z * sliceSize;
+		if( z >= files.size() || files[z].empty() ) {
+			std::fill( slice, slice + sliceSize, T( 0 ) );
+			return;
+		}
+		MappedNpy npy;
+		std::string message;
+		bool read = npy.Open( files[z], message );
+		if( read && ( npy.Shape().size() != 2 || npy.Shape()[0] != dims.ny || npy.Shape()[1] != dims.nx ) ) {
+			std::ostringstream shape;
+			shape << files[z] << ": expected shape (" << dims.ny << ", " << dims.nx << ")";
+			message = shape.str();
+			read = false;
+		}
+		if( read ) {
+			npy.CopyRows( slice );
+			return;
+		}
+		std::fill( slice, slice + sliceSize, T( 0 ) );
+		std::lock_guard<std::mutex> lock( errorMutex );
+		if( !failed ) {
+			error = message;
+			failed = true;
+		}
+	} );
+	return !failed;
+}
+
+template bool ScatterNpySlices(const std::vector<std::string> &, const Dims &, unsigned char *,
+	std::string &, unsigned int);
+template bool ScatterNpySlices(const std::vector<std::string> &, const Dims &, short *,
+	std::string &, unsigned int);
+template bool ScatterNpySlices(const std::vector<std::string> &, const Dims &, unsigned short *,
+	std::string &, unsigned int);
+template bool ScatterNpySlices(const std::vector<std::string> &, const Dims &, unsigned int *,
+	std::string &, unsigned int);
+
+} // end namespace medimg
@@ -0,0 +1,43 @@
+//
+//  sliceStack.h
+//  Common
+//
+//  Assembly of per-slice 2D segmentations, saved by the notebooks as one
+//  .npy file per slice with the slice number in the file name (e.g.
+//  seg042.npy), into a 3D label map. This replaces build3Dlabelmap.py,
+//  which copied the slices one at a time: here every slice is memory
+//  mapped and converted straight into its place in the output volume, in
+//  parallel over slices.
+//
+
+#ifndef MEDIMG_SLICESTACK_H
+#define MEDIMG_SLICESTACK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Lists the files in directory ending in extension, numbered by the first
+// run of digits in their name, as files[z] for z in [0, slices); slices
+// without a file are left empty. False with a message in error if the
+// directory cannot be read, a number occurs twice or is not below slices.
+bool FindNumberedSlices(const std::string &directory, const std::string &extension,
+	std::size_t slices, std::vector<std::string> &files, std::string &error);
+
+// Copies files[z] (2D arrays of shape (dims.ny, dims.nx)) into slice z of
+// out (dims.Voxels() values), converting to T; slices without a file are
+// zeroed. False with a message in error if a file cannot be read or has
+// the wrong shape. Instantiated for unsigned char, short, unsigned short
+// and unsigned int.
+template< class T >
+bool ScatterNpySlices(const std::vector<std::string> &files, const Dims &dims, T *out,
+	std::string &error, unsigned int threads = 0);
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,114 @@
+//
+//  speedImage.h
+//  Common
+//
+//  The speed image of fastmarching and geodesic_active_contour: curvature
+//  anisotropic diffusion, gradient magnitude at sigma and a sigmoid mapping
+//  with alpha = (K2 - K1) / 6, beta = (K1 + K2) / 2. Under a memory budget
+//  each filter's output is released once the next filter has run and the
+//  sigmoid runs in place, so besides the filter running only its input is
+//  held. Requires ITK (header only, not part of medimg).
+//
+
+#ifndef MEDIMG_SPEEDIMAGE_H
+#define MEDIMG_SPEEDIMAGE_H
+
+#include "itkCurvatureAnisotropicDiffusionImageFilter.h"
+#include "itkGradientMagnitudeRecursiveGaussianImageFilter.h"
+#include "itkSigmoidImageFilter.h"
+#include "pipelineProfiler.h"
+#include "slabStreaming.h"
+
+
+namespace medimg
+{
+
+// Bytes per voxel the filters allocate on top of their input: the
+// diffusion output and its update buffer, then the gradient magnitude with
+// the recursive Gaussian intermediates. The sigmoid needs its own output
+// unless it runs in place.
+const double DiffusionBytesPerVoxel = 2.0 * sizeof(float);
+const double GradientBytesPerVoxel = 3.0 * sizeof(float);
+const double SigmoidBytesPerVoxel = sizeof(float);
+
+template< class TInputImage, class TOutputImage >
+struct SpeedImageFilters
+{
+	typedef itk::CurvatureAnisotropicDiffusionImageFilter< TInputImage, TOutputImage > SmoothingFilterType;
+	typedef itk::GradientMagnitudeRecursiveGaussianImageFilter< TOutputImage, TOutputImage > GradientFilterType;
+	typedef itk::SigmoidImageFilter< TOutputImage, TOutputImage > SigmoidFilterType;
+
+	typename SmoothingFilterType::Pointer smoothing;
+	typename GradientFilterType::Pointer gradientMagnitude;
+	typename SigmoidFilterType::Pointer sigmoid;
+
+	SpeedImageFilters(double sigma, double K1, double K2)
+	{
+		smoothing = SmoothingFilterType::New();
+		smoothing->SetTimeStep(0.04);
+		smoothing->SetNumberOfIterations(5);
+		smoothing->SetConductanceParameter(9.0);
+
+		gradientMagnitude = GradientFilterType::New();
+		gradientMagnitude->SetSigma( sigma );
+		gradientMagnitude->SetInput( smoothing->GetOutput() );
+
+		sigmoid = SigmoidFilterType::New();
+		sigmoid->SetOutputMinimum(0.0);
+		sigmoid->SetOutputMaximum(1.0);
+		sigmoid->SetAlpha( (K2 - K1)/6 );
+		sigmoid->SetBeta( (K1 + K2)/2 );
+		sigmoid->SetInput( gradientMagnitude->GetOutput() );
+	}
+
+	void SetInput(const TInputImage *input) { smoothing->SetInput( input ); }
+	TOutputImage *GetOutput() { return sigmoid->GetOutput(); }
+
+	void Profile(StageProfiler &profiler)
+	{
+		ProfileFilter( profiler, smoothing, "diffusion" );
+		ProfileFilter( profiler, gradientMagnitude, "gradient magnitude" );
+		ProfileFilter( profiler, sigmoid, "sigmoid" );
+	}
+
+	// Frees the diffusion and gradient outputs once read and maps the
+	// gradient magnitude to speed in place
+	void ReleaseIntermediates()
+	{
+		smoothing->ReleaseDataFlagOn();
+		gradientMagnitude->ReleaseDataFlagOn();
+		sigmoid->InPlaceOn();
+	}
+
+	// Planes each side of a slab that cover the diffusion (one voxel per
+	// iteration) and the Gaussian support of the gradient
+	unsigned int Halo(const TInputImage *image) const
+	{
+		return smoothing->GetNumberOfIterations()
+			+ SlabHalo( image, gradientMagnitude->GetSigma() );
+	}
+};
+
+// The speed image of input computed in z-slabs of slabPlanes planes, each
+// through its own filters with intermediates released. The diffusion's
+// conductance is scaled by the average gradient of each slab rather than
+// of the volume, so slab borders can differ slightly from a whole-volume
+// run.
+template< class TInputImage, class TOutputImage >
+typename TOutputImage::Pointer SpeedImageInSlabs(const TInputImage *input, double sigma,
+	double K1, double K2, unsigned int slabPlanes)
+{
+	SpeedImageFilters< TInputImage, TOutputImage > filters( sigma, K1, K2 );
+	return ProcessInSlabs< TInputImage, TOutputImage >( input, slabPlanes, filters.Halo( input ),
+		[&](TInputImage *slab) {
+			SpeedImageFilters< TInputImage, TOutputImage > slabFilters( sigma, K1, K2 );
+			slabFilters.ReleaseIntermediates();
+			slabFilters.SetInput( slab );
+			slabFilters.sigmoid->Update();
+			return typename TOutputImage::Pointer( slabFilters.GetOutput() );
+		} );
+}
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,289 @@
+//
+//  stageProfiler.cpp
+//  Common
+//
+
+#include "stageProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <time.h>
+#include <sys/resource.h>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Bytes counted by the operator new of allocationCounter.cpp; constant
+// initialized, so allocations made before main are counted too
+std::atomic<unsigned long long> allocated( 0 );
+
+std::string EscapeJSON(const std::string &text)
+{
+	std::string escaped;
+	for( std::size_t c = 0; c < text.size(); ++c ) {
+		const unsigned char ch = text[c];
+		if( ch == '"' || ch == '\\' ) {
+			escaped += '\\';
+			escaped += ch;
+		}
+		else if( ch < 0x20 ) {
+			char code[8];
+			std::snprintf( code, sizeof(code), "\\u%04x", ch );
+			escaped += code;
+		}
+		else {
+			escaped += ch;
+		}
+	}
+	return escaped;
+}
+
+double Seconds(std::chrono::steady_clock::duration d)
+{
+	return std::chrono::duration<double>( d ).count();
+}
+
+const char *EnvironmentValue(const char *name)
+{
+	const char *value = std::getenv( name );
+	return value && *value ? value : 0;
+}
+
+} // end anonymous namespace
+
+
+void CountAllocation(std::size_t size)
+{
+	allocated.fetch_add( size, std::memory_order_relaxed );
+}
+
+unsigned long long AllocatedBytes()
+{
+	return allocated.load( std::memory_order_relaxed );
+}
+
+double ProcessCpuSeconds()
+{
+	timespec t;
+	if( clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &t ) != 0 ) {
+		return 0.0;
+	}
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+std::size_t PeakResidentBytes()
+{
+#if defined(__linux__)
+	// VmHWM follows ResetPeakResident, unlike ru_maxrss
+	std::ifstream status( "/proc/self/status" );
+	std::string line;
+	while( std::getline( status, line ) ) {
+		if( line.compare( 0, 6, "VmHWM:" ) == 0 ) {
+			return static_cast<std::size_t>( std::strtoull( line.c_str() + 6, 0, 10 ) ) * 1024;
+		}
+	}
+#endif
+	rusage usage;
+	if( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+		return 0;
+	}
+#if defined(__APPLE__)
+	return usage.ru_maxrss;
+#else
+	return static_cast<std::size_t>( usage.ru_maxrss ) * 1024;
+#endif
+}
+
+bool ResetPeakResident()
+{
+#if defined(__linux__)
+	std::ofstream clear( "/proc/self/clear_refs" );
+	clear << "5";
+	clear.flush();
+	return static_cast<bool>( clear );
+#else
+	return false;
+#endif
+}
+
+
+StageProfiler::StageProfiler(const std::string &tool)
+	: m_Tool( tool ), m_Enabled( false ), m_Threads( std::thread::hardware_concurrency() ),
+	m_Created( std::chrono::steady_clock::now() ), m_CreatedCpu( ProcessCpuSeconds() ), m_PeakRSS( 0 )
+{
+	if( const char *report = EnvironmentValue( "MEDIMG_PROFILE" ) ) {
+		m_ReportFile = report;
+	}
+	if( const char *trace = EnvironmentValue( "MEDIMG_TRACE" ) ) {
+		m_TraceFile = trace;
+	}
+	m_Enabled = !m_ReportFile.empty() || !m_TraceFile.empty();
+	if( m_Threads == 0 ) {
+		m_Threads = 1;
+	}
+}
+
+StageProfiler::~StageProfiler()
+{
+	if( !m_Enabled ) {
+		return;
+	}
+	while( !m_Open.empty() ) {
+		End();
+	}
+	UpdatePeaks();
+
+	const double total = Seconds( std::chrono::steady_clock::now() - m_Created );
+	char line[160];
+	std::snprintf( line, sizeof(line), "%s stages (%.3f s, peak RSS %.1f MB):", m_Tool.c_str(), total,
+		m_PeakRSS / ( 1024.0 * 1024.0 ) );
+	std::cout << line << std::endl;
+	for( std::size_t s = 0; s < m_Stages.size(); ++s ) {
+		const StageRecord &stage = m_Stages[s];
+		const std::string name = std::string( 2 * stage.Depth, ' ' ) + stage.Name;
+		std::snprintf( line, sizeof(line), "  %-28s %9.3f s %5.1f%% %5.2f threads %9.1f MB allocated",
+			name.c_str(), stage.Wall,
+			total > 0 ? 100 * stage.Wall / total : 0.0, stage.Wall > 0 ? stage.Cpu / stage.Wall : 0.0,
+			stage.BytesAllocated / ( 1024.0 * 1024.0 ) );
+		std::cout << line << std::endl;
+	}
+
+	std::string error;
+	if( !m_ReportFile.empty() && !WriteReport( m_ReportFile, error ) ) {
+		std::cerr << error << std::endl;
+	}
+	if( !m_TraceFile.empty() && !WriteTrace( m_TraceFile, error ) ) {
+		std::cerr << error << std::endl;
+	}
+}
+
+void StageProfiler::UpdatePeaks()
+{
+	const std::size_t peak = PeakResidentBytes();
+	m_PeakRSS = std::max( m_PeakRSS, peak );
+	for( std::size_t o = 0; o < m_Open.size(); ++o ) {
+		StageRecord &stage = m_Stages[m_Open[o].Record];
+		stage.PeakRSS = std::max( stage.PeakRSS, peak );
+	}
+}
+
+std::size_t StageProfiler::PeakResident() const
+{
+	return std::max( m_PeakRSS, PeakResidentBytes() );
+}
+
+void StageProfiler::Begin(const std::string &name)
+{
+	if( !m_Enabled ) {
+		return;
+	}
+	// The enclosing stages keep the peak so far, and the new one starts
+	// from the current resident size
+	UpdatePeaks();
+	ResetPeakResident();
+
+	StageRecord stage;
+	stage.Name = name;
+	stage.Depth = m_Open.size();
+	stage.Start = Seconds( std::chrono::steady_clock::now() - m_Created );
+	stage.Wall = stage.Cpu = 0.0;
+	stage.BytesAllocated = 0;
+	stage.PeakRSS = 0;
+	m_Stages.push_back( stage );
+
+	OpenStage open;
+	open.Record = m_Stages.size() - 1;
+	open.Cpu = ProcessCpuSeconds();
+	open.Allocated = AllocatedBytes();
+	m_Open.push_back( open );
+}
+
+void StageProfiler::End()
+{
+	if( !m_Enabled || m_Open.empty() ) {
+		return;
+	}
+	const double now = Seconds( std::chrono::steady_clock::now() - m_Created );
+	const OpenStage open = m_Open.back();
+	UpdatePeaks();
+	m_Open.pop_back();
+
+	StageRecord &stage = m_Stages[open.Record];
+	stage.Wall = now - stage.Start;
+	stage.Cpu = ProcessCpuSeconds() - open.Cpu;
+	stage.BytesAllocated = AllocatedBytes() - open.Allocated;
+}
+
+bool StageProfiler::WriteReport(const std::string &filename, std::string &error) const
+{
+	const double total = Seconds( std::chrono::steady_clock::now() - m_Created );
+	std::ostringstream json;
+	json.precision( 6 );
+	json << "{\n  \"tool\": \"" << EscapeJSON( m_Tool ) << "\",\n"
+		<< "  \"threads\": " << m_Threads << ",\n"
+		<< "  \"wall\": " << total << ",\n"
+		<< "  \"cpu\": " << ProcessCpuSeconds() - m_CreatedCpu << ",\n"
+		<< "  \"bytesAllocated\": " << AllocatedBytes() << ",\n"
+		<< "  \"peakRSS\": " << std::max( m_PeakRSS, PeakResidentBytes() ) << ",\n"
+		<< "  \"stages\": [";
+	for( std::size_t s = 0; s < m_Stages.size(); ++s ) {
+		const StageRecord &stage = m_Stages[s];
+		const double busy = stage.Wall > 0 ? stage.Cpu / stage.Wall : 0.0;
+		json << ( s ? ",\n" : "\n" )
+			<< "    {\"name\": \"" << EscapeJSON( stage.Name ) << "\", \"depth\": " << stage.Depth
+			<< ", \"start\": " << stage.Start << ", \"wall\": " << stage.Wall
+			<< ", \"fraction\": " << ( total > 0 ? stage.Wall / total : 0.0 )
+			<< ", \"cpu\": " << stage.Cpu << ", \"busyThreads\": " << busy
+			<< ", \"utilization\": " << busy / m_Threads
+			<< ", \"bytesAllocated\": " << stage.BytesAllocated
+			<< ", \"peakRSS\": " << stage.PeakRSS << "}";
+	}
+	json << "\n  ]\n}\n";
+
+	std::ofstream file( filename.c_str() );
+	if( !( file << json.str() ) ) {
+		error = "Cannot write profile " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool StageProfiler::WriteTrace(const std::string &filename, std::string &error) const
+{
+	// Complete events in microseconds, nested by time on one track
+	std::ostringstream json;
+	json << std::fixed << std::setprecision( 1 );
+	json << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+		<< "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+		<< "\"args\": {\"name\": \"" << EscapeJSON( m_Tool ) << "\"}}";
+	for( std::size_t s = 0; s < m_Stages.size(); ++s ) {
+		const StageRecord &stage = m_Stages[s];
+		json << ",\n  {\"name\": \"" << EscapeJSON( stage.Name ) << "\", \"ph\": \"X\", "
+			<< "\"pid\": 1, \"tid\": 1, \"ts\": " << 1e6 * stage.Start << ", \"dur\": " << 1e6 * stage.Wall
+			<< ", \"args\": {\"cpu\": " << stage.Cpu
+			<< ", \"busyThreads\": " << ( stage.Wall > 0 ? stage.Cpu / stage.Wall : 0.0 )
+			<< ", \"allocatedMB\": " << stage.BytesAllocated / ( 1024.0 * 1024.0 )
+			<< ", \"peakRSSMB\": " << stage.PeakRSS / ( 1024.0 * 1024.0 ) << "}}";
+	}
+	json << "\n]}\n";
+
+	std::ofstream file( filename.c_str() );
+	if( !( file << json.str() ) ) {
+		error = "Cannot write trace " + filename;
+		return false;
+	}
+	return true;
+}
+
+} // end namespace medimg
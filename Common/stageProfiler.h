@@ -0,0 +1,131 @@
+//
+//  stageProfiler.h
+//  Common
+//
+//  Per-stage timing and memory of a tool run. Each stage records its wall
+//  and CPU time (all threads of the process), the average number of busy
+//  threads, the bytes allocated with operator new while it ran (in tools
+//  linked with allocationCounter.cpp) and the peak resident set size
+//  reached during it. Stages may nest; figures are inclusive of nested
+//  stages.
+//
+//  Profiling is off unless the environment names an output:
+//    MEDIMG_PROFILE=run.json    JSON report of the stages
+//    MEDIMG_TRACE=trace.json    Chrome trace (chrome://tracing, Perfetto)
+//  Both are written when the profiler is destroyed, and a summary is
+//  printed. When off, Begin and End return at once.
+//
+//  ITK filters are attached with ProfileFilter in pipelineProfiler.h;
+//  native steps are wrapped in a ScopedStage.
+//
+
+#ifndef MEDIMG_STAGEPROFILER_H
+#define MEDIMG_STAGEPROFILER_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace medimg
+{
+
+struct StageRecord
+{
+	std::string Name;
+	unsigned int Depth;     // number of enclosing stages
+	double Start;           // seconds since the profiler was created
+	double Wall, Cpu;       // seconds
+	unsigned long long BytesAllocated;
+	std::size_t PeakRSS;    // bytes
+};
+
+class StageProfiler
+{
+public:
+	// tool names the run in the reports
+	explicit StageProfiler(const std::string &tool);
+	~StageProfiler();
+
+	bool Enabled() const { return m_Enabled; }
+
+	// Threads the stages may use, for the utilization in the report;
+	// every core by default
+	void SetThreads(unsigned int threads) { m_Threads = threads; }
+
+	void Begin(const std::string &name);
+	// Ends the innermost open stage
+	void End();
+
+	const std::vector<StageRecord> &Stages() const { return m_Stages; }
+
+	// Peak resident set of the run so far, also when stages have restarted
+	// the kernel's high-water mark
+	std::size_t PeakResident() const;
+
+	bool WriteReport(const std::string &filename, std::string &error) const;
+	bool WriteTrace(const std::string &filename, std::string &error) const;
+
+private:
+	StageProfiler(const StageProfiler &);
+	StageProfiler &operator=(const StageProfiler &);
+
+	// Folds the current resident high-water mark into the open stages
+	void UpdatePeaks();
+
+	struct OpenStage
+	{
+		std::size_t Record;
+		double Cpu;
+		unsigned long long Allocated;
+	};
+
+	std::string m_Tool;
+	std::string m_ReportFile, m_TraceFile;
+	bool m_Enabled;
+	unsigned int m_Threads;
+	std::chrono::steady_clock::time_point m_Created;
+	double m_CreatedCpu;
+	std::size_t m_PeakRSS;
+	std::vector<StageRecord> m_Stages;
+	std::vector<OpenStage> m_Open;
+};
+
+// Stage lasting for the scope of the object
+class ScopedStage
+{
+public:
+	ScopedStage(StageProfiler &profiler, const std::string &name)
+		: m_Profiler( profiler ) { m_Profiler.Begin( name ); }
+	~ScopedStage() { m_Profiler.End(); }
+
+private:
+	ScopedStage(const ScopedStage &);
+	ScopedStage &operator=(const ScopedStage &);
+
+	StageProfiler &m_Profiler;
+};
+
+// Bytes allocated with operator new since the program started. Only
+// programs built with the counting operator new of allocationCounter.cpp
+// (the medimg_allocation_counter objects) count them; elsewhere this is 0.
+unsigned long long AllocatedBytes();
+
+// Adds size to AllocatedBytes; called by the counting operator new
+void CountAllocation(std::size_t size);
+
+// CPU seconds used by all threads of the process
+double ProcessCpuSeconds();
+
+// Peak resident set size of the process in bytes, since the start or the
+// last ResetPeakResident; 0 where unavailable
+std::size_t PeakResidentBytes();
+
+// Restarts the peak resident set size from the current one (Linux 4.0 and
+// later); false where unsupported, and the peak then covers the whole run
+bool ResetPeakResident();
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,511 @@
+//
+//  surfaceMesh.cpp
+//  Common
+//
+
+#include "surfaceMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Corner i of a cube is at (i & 1, (i >> 1) & 1, (i >> 2) & 1); edge e
+// joins Corners[e][0] to Corners[e][1] along Axis[e]
+struct CubeEdges
+{
+	int Corners[12][2];
+	int Axis[12];
+
+	CubeEdges()
+	{
+		int e = 0;
+		for( int axis = 0; axis < 3; ++axis ) {
+			for( int c = 0; c < 8; ++c ) {
+				if( !( c & (1 << axis) ) ) {
+					Corners[e][0] = c;
+					Corners[e][1] = c | (1 << axis);
+					Axis[e] = axis;
+					++e;
+				}
+			}
+		}
+	}
+
+	int Between(int a, int b) const
+	{
+		for( int e = 0; e < 12; ++e ) {
+			if( ( Corners[e][0] == a && Corners[e][1] == b )
+				|| ( Corners[e][0] == b && Corners[e][1] == a ) ) {
+				return e;
+			}
+		}
+		return -1;
+	}
+};
+
+// Triangles (as cube edges) of every corner configuration
+struct CaseTable
+{
+	CubeEdges edges;
+	// Loops fanned from one of their vertices
+	std::vector<signed char> Triangles[256];
+	// Loops fanned from their centroid, because every fan from one of their
+	// vertices would put a triangle edge on a cube face, where the
+	// neighbouring cube might triangulate differently
+	std::vector< std::vector<signed char> > CenterLoops[256];
+
+	CaseTable()
+	{
+		// Corners of the six faces, counterclockwise seen from outside
+		int faces[6][4];
+		for( int axis = 0; axis < 3; ++axis ) {
+			const int u = 1 << ( (axis + 1) % 3 ), v = 1 << ( (axis + 2) % 3 );
+			for( int side = 0; side < 2; ++side ) {
+				const int base = side ? 1 << axis : 0;
+				int *f = faces[2 * axis + side];
+				f[0] = base;
+				f[1] = base | u;
+				f[2] = base | u | v;
+				f[3] = base | v;
+				if( !side ) {
+					std::swap( f[1], f[3] );
+				}
+			}
+		}
+		// Faces of every edge, as bits
+		int edgeFaces[12] = { 0 };
+		for( int f = 0; f < 6; ++f ) {
+			for( int k = 0; k < 4; ++k ) {
+				edgeFaces[edges.Between( faces[f][k], faces[f][(k + 1) % 4] )] |= 1 << f;
+			}
+		}
+
+		for( int config = 0; config < 256; ++config ) {
+			// On every face the isoline leaves the inside corners where the
+			// counterclockwise walk leaves them and joins the edge where the
+			// walk entered that run of inside corners
+			int next[12];
+			std::fill( next, next + 12, -1 );
+			for( int f = 0; f < 6; ++f ) {
+				const int *p = faces[f];
+				for( int k = 0; k < 4; ++k ) {
+					const bool in = ( config >> p[k] ) & 1, after = ( config >> p[(k + 1) % 4] ) & 1;
+					if( !in || after ) {
+						continue;
+					}
+					int j = k;
+					while( ( config >> p[(j + 3) % 4] ) & 1 ) {
+						j = (j + 3) % 4;
+					}
+					next[edges.Between( p[k], p[(k + 1) % 4] )] = edges.Between( p[(j + 3) % 4], p[j] );
+				}
+			}
+			bool used[12] = { false };
+			for( int e = 0; e < 12; ++e ) {
+				if( next[e] < 0 || used[e] ) {
+					continue;
+				}
+				std::vector<signed char> loop;
+				for( int c = e; !used[c]; c = next[c] ) {
+					used[c] = true;
+					loop.push_back( static_cast<signed char>( c ) );
+				}
+				// A vertex none of whose diagonals lies on a face
+				const std::size_t n = loop.size();
+				std::size_t apex = n;
+				for( std::size_t r = 0; r < n && apex == n; ++r ) {
+					bool onFace = false;
+					for( std::size_t k = 2; k + 1 < n; ++k ) {
+						onFace = onFace || ( edgeFaces[loop[r]] & edgeFaces[loop[(r + k) % n]] );
+					}
+					if( !onFace ) {
+						apex = r;
+					}
+				}
+				if( apex == n ) {
+					CenterLoops[config].push_back( loop );
+					continue;
+				}
+				for( std::size_t k = 1; k + 1 < n; ++k ) {
+					Triangles[config].push_back( loop[apex] );
+					Triangles[config].push_back( loop[(apex + k) % n] );
+					Triangles[config].push_back( loop[(apex + k + 1) % n] );
+				}
+			}
+		}
+	}
+};
+
+const CaseTable &Cases()
+{
+	static const CaseTable cases;
+	return cases;
+}
+
+// Vertices and triangles of one slab, with the vertices on its bottom and
+// top planes listed by their edge in the plane
+struct Slab
+{
+	std::vector<float> Points;
+	std::vector<std::uint32_t> Triangles;
+	std::vector< std::pair<std::size_t, std::uint32_t> > Bottom, Top;
+	// Bottom vertices and the vertices of the slab below on the same edge
+	std::vector< std::pair<std::uint32_t, std::uint32_t> > Shared;
+	// Global index of every vertex
+	std::vector<std::uint32_t> Global;
+	std::size_t Owned;
+};
+
+const std::uint32_t None = ~std::uint32_t( 0 );
+
+template< class T >
+void TriangulateSlab(const T *I, const Geometry &geometry, double iso, long z0, long z1,
+	bool reverse, Slab &slab)
+{
+	const CaseTable &cases = Cases();
+	const Dims &dims = geometry.dims;
+	const long nx = static_cast<long>( dims.nx ), ny = static_cast<long>( dims.ny );
+	const std::size_t plane = dims.nx * dims.ny;
+	// Vertex of every x and y edge of the planes below and above the layer,
+	// and of the z edges between them
+	std::vector<std::uint32_t> below( 2 * plane, None ), above( 2 * plane, None ), vertical( plane, None );
+
+	// Index to physical coordinates
+	double M[9];
+	for( int r = 0; r < 3; ++r ) {
+		for( int c = 0; c < 3; ++c ) {
+			M[3 * r + c] = geometry.Direction[3 * r + c] * geometry.Spacing[c];
+		}
+	}
+
+	for( long z = z0; z < z1; ++z ) {
+		std::fill( above.begin(), above.end(), None );
+		std::fill( vertical.begin(), vertical.end(), None );
+		for( long y = 0; y + 1 < ny; ++y ) {
+			const T *row[4] = { I + dims.Index( 0, y, z ), I + dims.Index( 0, y + 1, z ),
+				I + dims.Index( 0, y, z + 1 ), I + dims.Index( 0, y + 1, z + 1 ) };
+			for( long x = 0; x + 1 < nx; ++x ) {
+				double value[8];
+				int config = 0;
+				for( int c = 0; c < 8; ++c ) {
+					value[c] = static_cast<double>( row[c >> 1][x + (c & 1)] );
+					config |= ( value[c] >= iso ) << c;
+				}
+				if( config == 0 || config == 255 ) {
+					continue;
+				}
+				const std::vector<signed char> &triangles = cases.Triangles[config];
+				const std::vector< std::vector<signed char> > &centerLoops = cases.CenterLoops[config];
+				std::uint32_t vertex[12];
+				std::fill( vertex, vertex + 12, None );
+				for( int e = 0; e < 12; ++e ) {
+					const int a = cases.edges.Corners[e][0], b = cases.edges.Corners[e][1];
+					if( ( ( config >> a ) & 1 ) == ( ( config >> b ) & 1 ) ) {
+						continue;
+					}
+					const int axis = cases.edges.Axis[e];
+					const long ex = x + (a & 1), ey = y + ((a >> 1) & 1), ez = z + ((a >> 2) & 1);
+					const std::size_t inPlane = ex + nx * ey;
+					std::uint32_t *slot;
+					if( axis == 2 ) {
+						slot = &vertical[inPlane];
+					}
+					else {
+						slot = &( ez == z ? below : above )[axis * plane + inPlane];
+					}
+					if( *slot == None ) {
+						const double t = ( iso - value[a] ) / ( value[b] - value[a] );
+						double p[3] = { static_cast<double>( ex ), static_cast<double>( ey ),
+							static_cast<double>( ez ) };
+						p[axis] += t;
+						*slot = static_cast<std::uint32_t>( slab.Points.size() / 3 );
+						for( int r = 0; r < 3; ++r ) {
+							slab.Points.push_back( static_cast<float>( geometry.Origin[r]
+								+ M[3 * r] * p[0] + M[3 * r + 1] * p[1] + M[3 * r + 2] * p[2] ) );
+						}
+						if( axis != 2 && ez == z0 ) {
+							slab.Bottom.push_back( std::make_pair( axis * plane + inPlane, *slot ) );
+						}
+						if( axis != 2 && ez == z1 ) {
+							slab.Top.push_back( std::make_pair( axis * plane + inPlane, *slot ) );
+						}
+					}
+					vertex[e] = *slot;
+				}
+				for( std::size_t k = 0; k < triangles.size(); k += 3 ) {
+					slab.Triangles.push_back( vertex[triangles[k]] );
+					slab.Triangles.push_back( vertex[triangles[k + ( reverse ? 2 : 1 )]] );
+					slab.Triangles.push_back( vertex[triangles[k + ( reverse ? 1 : 2 )]] );
+				}
+				for( std::size_t l = 0; l < centerLoops.size(); ++l ) {
+					const std::vector<signed char> &loop = centerLoops[l];
+					const std::uint32_t center = static_cast<std::uint32_t>( slab.Points.size() / 3 );
+					float c[3] = { 0.0f, 0.0f, 0.0f };
+					for( std::size_t k = 0; k < loop.size(); ++k ) {
+						for( int r = 0; r < 3; ++r ) {
+							c[r] += slab.Points[3 * vertex[loop[k]] + r] / loop.size();
+						}
+					}
+					slab.Points.insert( slab.Points.end(), c, c + 3 );
+					for( std::size_t k = 0; k < loop.size(); ++k ) {
+						const std::uint32_t u = vertex[loop[k]], v = vertex[loop[(k + 1) % loop.size()]];
+						slab.Triangles.push_back( center );
+						slab.Triangles.push_back( reverse ? v : u );
+						slab.Triangles.push_back( reverse ? u : v );
+					}
+				}
+			}
+		}
+		below.swap( above );
+	}
+	std::sort( slab.Bottom.begin(), slab.Bottom.end() );
+	std::sort( slab.Top.begin(), slab.Top.end() );
+}
+
+bool WriteAll(std::FILE *file, const void *data, std::size_t bytes)
+{
+	return std::fwrite( data, 1, bytes, file ) == bytes;
+}
+
+} // end anonymous namespace
+
+
+template< class T >
+void MarchingCubes(const T *I, const Geometry &geometry, double iso, TriangleMesh &mesh,
+	unsigned int threads)
+{
+	mesh.Points.clear();
+	mesh.Triangles.clear();
+	const Dims &dims = geometry.dims;
+	if( dims.nx < 2 || dims.ny < 2 || dims.nz < 2 ) {
+		return;
+	}
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+	// The loops of the case table run clockwise seen from the outside
+	// region, so they are reversed, unless the geometry mirrors them
+	const double *D = geometry.Direction;
+	const double det = D[0] * (D[4] * D[8] - D[5] * D[7]) - D[1] * (D[3] * D[8] - D[5] * D[6])
+		+ D[2] * (D[3] * D[7] - D[4] * D[6]);
+	const bool mirrored = ( det < 0 ) != ( geometry.Spacing[0] * geometry.Spacing[1] * geometry.Spacing[2] < 0 );
+
+	const std::size_t layers = dims.nz - 1;
+	const std::size_t slabs = std::min<std::size_t>( layers, 4 * threads );
+	std::vector<Slab> slab( slabs );
+	ParallelFor( slabs, threads, [&](std::size_t s, unsigned int) {
+		TriangulateSlab( I, geometry, iso, static_cast<long>( layers * s / slabs ),
+			static_cast<long>( layers * (s + 1) / slabs ), !mirrored, slab[s] );
+	} );
+
+	////////////////////////////////////////////////
+	// Join the slabs, merging the vertices on the planes between them
+
+	// Vertices on a slab's bottom plane belong to the slab below; both
+	// sides of a plane see the same crossing edges
+	ParallelFor( slabs, threads, [&](std::size_t s, unsigned int) {
+		Slab &b = slab[s];
+		b.Global.assign( b.Points.size() / 3, 0 );
+		if( s > 0 ) {
+			const Slab &a = slab[s - 1];
+			std::size_t j = 0;
+			for( std::size_t k = 0; k < b.Bottom.size(); ++k ) {
+				while( j < a.Top.size() && a.Top[j].first < b.Bottom[k].first ) {
+					++j;
+				}
+				if( j < a.Top.size() && a.Top[j].first == b.Bottom[k].first ) {
+					b.Global[b.Bottom[k].second] = None;
+					b.Shared.push_back( std::make_pair( b.Bottom[k].second, a.Top[j].second ) );
+				}
+			}
+		}
+		std::uint32_t owned = 0;
+		for( std::size_t v = 0; v < b.Global.size(); ++v ) {
+			if( b.Global[v] != None ) {
+				b.Global[v] = owned++;
+			}
+		}
+		b.Owned = owned;
+	} );
+	std::vector<std::size_t> vertexBase( slabs + 1, 0 ), triangleBase( slabs + 1, 0 );
+	for( std::size_t s = 0; s < slabs; ++s ) {
+		vertexBase[s + 1] = vertexBase[s] + slab[s].Owned;
+		triangleBase[s + 1] = triangleBase[s] + slab[s].Triangles.size();
+	}
+	ParallelFor( slabs, threads, [&](std::size_t s, unsigned int) {
+		Slab &b = slab[s];
+		for( std::size_t v = 0; v < b.Global.size(); ++v ) {
+			if( b.Global[v] != None ) {
+				b.Global[v] += static_cast<std::uint32_t>( vertexBase[s] );
+			}
+		}
+	} );
+	mesh.Points.resize( 3 * vertexBase[slabs] );
+	mesh.Triangles.resize( triangleBase[slabs] );
+	ParallelFor( slabs, threads, [&](std::size_t s, unsigned int) {
+		Slab &b = slab[s];
+		for( std::size_t v = 0; v < b.Global.size(); ++v ) {
+			const std::size_t g = b.Global[v];
+			if( g != None ) {
+				std::copy( &b.Points[3 * v], &b.Points[3 * v] + 3, &mesh.Points[3 * g] );
+			}
+		}
+		for( std::size_t k = 0; k < b.Shared.size(); ++k ) {
+			b.Global[b.Shared[k].first] = slab[s - 1].Global[b.Shared[k].second];
+		}
+		for( std::size_t k = 0; k < b.Triangles.size(); ++k ) {
+			mesh.Triangles[triangleBase[s] + k] = b.Global[b.Triangles[k]];
+		}
+	} );
+}
+
+template void MarchingCubes(const unsigned char *, const Geometry &, double, TriangleMesh &, unsigned int);
+template void MarchingCubes(const short *, const Geometry &, double, TriangleMesh &, unsigned int);
+template void MarchingCubes(const unsigned short *, const Geometry &, double, TriangleMesh &, unsigned int);
+template void MarchingCubes(const unsigned int *, const Geometry &, double, TriangleMesh &, unsigned int);
+template void MarchingCubes(const float *, const Geometry &, double, TriangleMesh &, unsigned int);
+template void MarchingCubes(const double *, const Geometry &, double, TriangleMesh &, unsigned int);
+
+
+void DecimateByClustering(TriangleMesh &mesh, double cellSize)
+{
+	const std::size_t n = mesh.Vertices();
+	if( n == 0 || cellSize <= 0 ) {
+		return;
+	}
+	float lo[3] = { mesh.Points[0], mesh.Points[1], mesh.Points[2] };
+	for( std::size_t v = 1; v < n; ++v ) {
+		for( int a = 0; a < 3; ++a ) {
+			lo[a] = std::min( lo[a], mesh.Points[3 * v + a] );
+		}
+	}
+
+	std::unordered_map<std::uint64_t, std::uint32_t> clusterOf;
+	std::vector<std::uint32_t> cluster( n );
+	std::vector<double> sum;
+	std::vector<std::uint32_t> count;
+	for( std::size_t v = 0; v < n; ++v ) {
+		std::uint64_t key = 0;
+		for( int a = 0; a < 3; ++a ) {
+			const std::uint64_t c = static_cast<std::uint64_t>( ( mesh.Points[3 * v + a] - lo[a] ) / cellSize );
+			key = (key << 21) | ( c & 0x1fffff );
+		}
+		std::unordered_map<std::uint64_t, std::uint32_t>::iterator it = clusterOf.find( key );
+		if( it == clusterOf.end() ) {
+			it = clusterOf.insert( std::make_pair( key, static_cast<std::uint32_t>( count.size() ) ) ).first;
+			sum.resize( sum.size() + 3, 0.0 );
+			count.push_back( 0 );
+		}
+		cluster[v] = it->second;
+		for( int a = 0; a < 3; ++a ) {
+			sum[3 * it->second + a] += mesh.Points[3 * v + a];
+		}
+		++count[it->second];
+	}
+
+	std::vector<float> points( sum.size() );
+	for( std::size_t c = 0; c < count.size(); ++c ) {
+		for( int a = 0; a < 3; ++a ) {
+			points[3 * c + a] = static_cast<float>( sum[3 * c + a] / count[c] );
+		}
+	}
+	std::vector<std::uint32_t> triangles;
+	triangles.reserve( mesh.Triangles.size() / 4 );
+	for( std::size_t t = 0; t < mesh.Triangles.size(); t += 3 ) {
+		const std::uint32_t a = cluster[mesh.Triangles[t]], b = cluster[mesh.Triangles[t + 1]],
+			c = cluster[mesh.Triangles[t + 2]];
+		if( a != b && b != c && a != c ) {
+			triangles.push_back( a );
+			triangles.push_back( b );
+			triangles.push_back( c );
+		}
+	}
+	mesh.Points.swap( points );
+	mesh.Triangles.swap( triangles );
+}
+
+
+double MeshVolume(const TriangleMesh &mesh)
+{
+	double volume = 0.0;
+	for( std::size_t t = 0; t < mesh.Triangles.size(); t += 3 ) {
+		const float *p = &mesh.Points[3 * mesh.Triangles[t]];
+		const float *q = &mesh.Points[3 * mesh.Triangles[t + 1]];
+		const float *r = &mesh.Points[3 * mesh.Triangles[t + 2]];
+		volume += p[0] * ( static_cast<double>( q[1] ) * r[2] - static_cast<double>( q[2] ) * r[1] )
+			- p[1] * ( static_cast<double>( q[0] ) * r[2] - static_cast<double>( q[2] ) * r[0] )
+			+ p[2] * ( static_cast<double>( q[0] ) * r[1] - static_cast<double>( q[1] ) * r[0] );
+	}
+	return volume / 6.0;
+}
+
+
+bool WriteSTL(const std::string &filename, const TriangleMesh &mesh, std::string &error)
+{
+	std::FILE *file = std::fopen( filename.c_str(), "wb" );
+	if( !file ) {
+		error = "Cannot create " + filename;
+		return false;
+	}
+	char header[80] = "medimg marching cubes";
+	const std::uint32_t faces = static_cast<std::uint32_t>( mesh.Faces() );
+	bool good = WriteAll( file, header, 80 ) && WriteAll( file, &faces, 4 );
+	for( std::size_t t = 0; good && t < mesh.Faces(); ++t ) {
+		float record[12];
+		const float *p[3];
+		for( int k = 0; k < 3; ++k ) {
+			p[k] = &mesh.Points[3 * mesh.Triangles[3 * t + k]];
+			std::copy( p[k], p[k] + 3, record + 3 + 3 * k );
+		}
+		const float u[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		const float v[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		float normal[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		const float length = std::sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+		for( int a = 0; a < 3; ++a ) {
+			record[a] = length > 0 ? normal[a] / length : 0.0f;
+		}
+		const std::uint16_t attributes = 0;
+		good = WriteAll( file, record, sizeof(record) ) && WriteAll( file, &attributes, 2 );
+	}
+	if( std::fclose( file ) != 0 || !good ) {
+		error = "Error writing " + filename;
+		return false;
+	}
+	return true;
+}
+
+
+bool WritePLY(const std::string &filename, const TriangleMesh &mesh, std::string &error)
+{
+	std::FILE *file = std::fopen( filename.c_str(), "wb" );
+	if( !file ) {
+		error = "Cannot create " + filename;
+		return false;
+	}
+	std::fprintf( file, "ply\nformat binary_little_endian 1.0\n"
+		"element vertex %lu\nproperty float x\nproperty float y\nproperty float z\n"
+		"element face %lu\nproperty list uchar int vertex_indices\nend_header\n",
+		static_cast<unsigned long>( mesh.Vertices() ), static_cast<unsigned long>( mesh.Faces() ) );
+	bool good = WriteAll( file, mesh.Points.data(), mesh.Points.size() * sizeof(float) );
+	for( std::size_t t = 0; good && t < mesh.Faces(); ++t ) {
+		const unsigned char three = 3;
+		good = WriteAll( file, &three, 1 )
+			&& WriteAll( file, &mesh.Triangles[3 * t], 3 * sizeof(std::uint32_t) );
+	}
+	if( std::fclose( file ) != 0 || !good ) {
+		error = "Error writing " + filename;
+		return false;
+	}
+	return true;
+}
+
+} // end namespace medimg
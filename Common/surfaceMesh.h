@@ -0,0 +1,71 @@
+//
+//  surfaceMesh.h
+//  Common
+//
+//  Triangle surfaces of segmentations and isosurfaces by marching cubes,
+//  for 3D models of the liver, its vessels and tumors.
+//
+//  The case table is generated rather than typed in: for each of the 256
+//  corner configurations the isoline segments on the six cube faces are
+//  chained into loops, which are fanned into triangles. Faces whose two
+//  diagonal corners are inside are always split between the corners, and
+//  since that only depends on the face, neighbouring cubes agree and the
+//  surface is closed. Loops are fanned from a vertex none of whose
+//  diagonals lies on a cube face, or else from an extra vertex at their
+//  centroid, so no triangle edge can disagree with the neighbouring cube.
+//
+//  Slabs of cube layers are triangulated in parallel, each with its own
+//  vertices; a vertex belongs to one grid edge, so the vertices on the
+//  plane between two slabs are matched by their edge and merged when the
+//  slabs are joined. Optional decimation clusters vertices on a coarser
+//  grid (Rossignac and Borrel 1993), which is fast and keeps the volume
+//  closed but not always the topology.
+//
+
+#ifndef MEDIMG_SURFACEMESH_H
+#define MEDIMG_SURFACEMESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+struct TriangleMesh
+{
+	// x, y, z of every vertex, in physical coordinates
+	std::vector<float> Points;
+	// Three vertex indices per triangle, counterclockwise seen from outside
+	std::vector<std::uint32_t> Triangles;
+
+	std::size_t Vertices() const { return Points.size() / 3; }
+	std::size_t Faces() const { return Triangles.size() / 3; }
+};
+
+// Isosurface of I (geometry.dims.Voxels() values) at iso: voxels with
+// I >= iso are inside. For a 0/255 mask an iso of 127.5 puts the vertices
+// halfway between voxel centers. Instantiated for unsigned char, short,
+// unsigned short, unsigned int, float and double.
+template< class T >
+void MarchingCubes(const T *I, const Geometry &geometry, double iso, TriangleMesh &mesh,
+	unsigned int threads = 0);
+
+// Merges the vertices that fall in the same cell of a grid with cells of
+// cellSize (physical units) into their mean and drops the triangles that
+// collapse
+void DecimateByClustering(TriangleMesh &mesh, double cellSize);
+
+// Enclosed volume (positive for outward facing triangles)
+double MeshVolume(const TriangleMesh &mesh);
+
+// Binary STL or binary little-endian PLY; false with a message in error
+bool WriteSTL(const std::string &filename, const TriangleMesh &mesh, std::string &error);
+bool WritePLY(const std::string &filename, const TriangleMesh &mesh, std::string &error);
+
+} // end namespace medimg
+
+#endif
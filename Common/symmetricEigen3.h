@@ -0,0 +1,233 @@
+//
+//  symmetricEigen3.h
+//  Common
+//
+//  Eigen decomposition of a symmetric 3x3 matrix, ported from eig3volume.c
+//  in frangi_filter_version2a (itself taken from the public domain JAMA
+//  library) so that the native filters order eigenvalues exactly like the
+//  MATLAB reference: ascending by absolute value.
+//
+
+#ifndef MEDIMG_SYMMETRICEIGEN3_H
+#define MEDIMG_SYMMETRICEIGEN3_H
+
+#include <cmath>
+
+
+namespace medimg
+{
+
+namespace detail
+{
+
+/* Symmetric Householder reduction to tridiagonal form. */
+inline void Tred2(double V[3][3], double d[3], double e[3])
+{
+	const int n = 3;
+	for( int j = 0; j < n; j++ ) { d[j] = V[n-1][j]; }
+
+	for( int i = n-1; i > 0; i-- ) {
+		double scale = 0.0;
+		double h = 0.0;
+		for( int k = 0; k < i; k++ ) { scale = scale + std::fabs(d[k]); }
+		if( scale == 0.0 ) {
+			e[i] = d[i-1];
+			for( int j = 0; j < i; j++ ) { d[j] = V[i-1][j]; V[i][j] = 0.0; V[j][i] = 0.0; }
+		} else {
+			for( int k = 0; k < i; k++ ) { d[k] /= scale; h += d[k] * d[k]; }
+			double f = d[i-1];
+			double g = std::sqrt(h);
+			if( f > 0 ) { g = -g; }
+			e[i] = scale * g;
+			h = h - f * g;
+			d[i-1] = f - g;
+			for( int j = 0; j < i; j++ ) { e[j] = 0.0; }
+
+			for( int j = 0; j < i; j++ ) {
+				f = d[j];
+				V[j][i] = f;
+				g = e[j] + V[j][j] * f;
+				for( int k = j+1; k <= i-1; k++ ) { g += V[k][j] * d[k]; e[k] += V[k][j] * f; }
+				e[j] = g;
+			}
+			f = 0.0;
+			for( int j = 0; j < i; j++ ) { e[j] /= h; f += e[j] * d[j]; }
+			const double hh = f / (h + h);
+			for( int j = 0; j < i; j++ ) { e[j] -= hh * d[j]; }
+			for( int j = 0; j < i; j++ ) {
+				f = d[j]; g = e[j];
+				for( int k = j; k <= i-1; k++ ) { V[k][j] -= (f * e[k] + g * d[k]); }
+				d[j] = V[i-1][j];
+				V[i][j] = 0.0;
+			}
+		}
+		d[i] = h;
+	}
+
+	/* Accumulate transformations. */
+	for( int i = 0; i < n-1; i++ ) {
+		V[n-1][i] = V[i][i];
+		V[i][i] = 1.0;
+		const double h = d[i+1];
+		if( h != 0.0 ) {
+			for( int k = 0; k <= i; k++ ) { d[k] = V[k][i+1] / h; }
+			for( int j = 0; j <= i; j++ ) {
+				double g = 0.0;
+				for( int k = 0; k <= i; k++ ) { g += V[k][i+1] * V[k][j]; }
+				for( int k = 0; k <= i; k++ ) { V[k][j] -= g * d[k]; }
+			}
+		}
+		for( int k = 0; k <= i; k++ ) { V[k][i+1] = 0.0; }
+	}
+	for( int j = 0; j < n; j++ ) { d[j] = V[n-1][j]; V[n-1][j] = 0.0; }
+	V[n-1][n-1] = 1.0;
+	e[0] = 0.0;
+}
+
+/* Symmetric tridiagonal QL algorithm. */
+inline void Tql2(double V[3][3], double d[3], double e[3])
+{
+	const int n = 3;
+	for( int i = 1; i < n; i++ ) { e[i-1] = e[i]; }
+	e[n-1] = 0.0;
+
+	double f = 0.0;
+	double tst1 = 0.0;
+	const double eps = std::pow(2.0, -52.0);
+	for( int l = 0; l < n; l++ ) {
+		/* Find small subdiagonal element */
+		tst1 = std::fmax(tst1, std::fabs(d[l]) + std::fabs(e[l]));
+		int m = l;
+		while( m < n ) {
+			if( std::fabs(e[m]) <= eps*tst1 ) { break; }
+			m++;
+		}
+		/* If m == l, d[l] is an eigenvalue, otherwise, iterate. */
+		if( m > l ) {
+			do {
+				/* Compute implicit shift */
+				double g = d[l];
+				double p = (d[l+1] - g) / (2.0 * e[l]);
+				double r = std::hypot(p, 1.0);
+				if( p < 0 ) { r = -r; }
+				d[l] = e[l] / (p + r);
+				d[l+1] = e[l] * (p + r);
+				const double dl1 = d[l+1];
+				double h = g - d[l];
+				for( int i = l+2; i < n; i++ ) { d[i] -= h; }
+				f = f + h;
+				/* Implicit QL transformation. */
+				p = d[m];
+				double c = 1.0, c2 = c, c3 = c;
+				const double el1 = e[l+1];
+				double s = 0.0, s2 = 0.0;
+				for( int i = m-1; i >= l; i-- ) {
+					c3 = c2;
+					c2 = c;
+					s2 = s;
+					g = c * e[i];
+					h = c * p;
+					r = std::hypot(p, e[i]);
+					e[i+1] = s * r;
+					s = e[i] / r;
+					c = p / r;
+					p = c * d[i] - s * g;
+					d[i+1] = h + s * (c * g + s * d[i]);
+					/* Accumulate transformation. */
+					for( int k = 0; k < n; k++ ) {
+						h = V[k][i+1];
+						V[k][i+1] = s * V[k][i] + c * h;
+						V[k][i] = c * V[k][i] - s * h;
+					}
+				}
+				p = -s * s2 * c3 * el1 * e[l] / dl1;
+				e[l] = s * p;
+				d[l] = c * p;
+				/* Check for convergence. */
+			} while( std::fabs(e[l]) > eps*tst1 );
+		}
+		d[l] = d[l] + f;
+		e[l] = 0.0;
+	}
+
+	/* Sort eigenvalues and corresponding vectors. */
+	for( int i = 0; i < n-1; i++ ) {
+		int k = i;
+		double p = d[i];
+		for( int j = i+1; j < n; j++ ) {
+			if( d[j] < p ) { k = j; p = d[j]; }
+		}
+		if( k != i ) {
+			d[k] = d[i];
+			d[i] = p;
+			for( int j = 0; j < n; j++ ) {
+				p = V[j][i]; V[j][i] = V[j][k]; V[j][k] = p;
+			}
+		}
+	}
+}
+
+inline void SwapEigenPair(double V[3][3], double d[3], double da[3], int a, int b)
+{
+	double t = d[a]; d[a] = d[b]; d[b] = t;
+	t = da[a]; da[a] = da[b]; da[b] = t;
+	for( int j = 0; j < 3; j++ ) { t = V[j][a]; V[j][a] = V[j][b]; V[j][b] = t; }
+}
+
+} // end namespace detail
+
+// Eigenvalues d and eigenvectors (columns of V) of the symmetric matrix A,
+// sorted so that |d[0]| <= |d[1]| <= |d[2]|. Column 0 of V is therefore
+// the direction along a tubular structure.
+inline void SymmetricEigen3(const double A[3][3], double V[3][3], double d[3])
+{
+	double e[3];
+	for( int i = 0; i < 3; i++ ) {
+		for( int j = 0; j < 3; j++ ) {
+			V[i][j] = A[i][j];
+		}
+	}
+	detail::Tred2(V, d, e);
+	detail::Tql2(V, d, e);
+
+	/* Sort the eigen values and vectors by abs eigen value */
+	double da[3] = { std::fabs(d[0]), std::fabs(d[1]), std::fabs(d[2]) };
+	if( (da[0] >= da[1]) && (da[0] > da[2]) ) {
+		detail::SwapEigenPair(V, d, da, 0, 2);
+	}
+	else if( (da[1] >= da[0]) && (da[1] > da[2]) ) {
+		detail::SwapEigenPair(V, d, da, 1, 2);
+	}
+	if( da[0] > da[1] ) {
+		detail::SwapEigenPair(V, d, da, 0, 1);
+	}
+}
+
+// Eigenvalues only, in ascending order d[0] <= d[1] <= d[2], from the
+// trigonometric solution of the characteristic cubic. Measures that need
+// no eigenvectors (Sato) use this instead of the iterative QL sweep.
+inline void SymmetricEigenvalues3(const double A[3][3], double d[3])
+{
+	const double p1 = A[0][1] * A[0][1] + A[0][2] * A[0][2] + A[1][2] * A[1][2];
+	const double q = (A[0][0] + A[1][1] + A[2][2]) / 3.0;
+	const double a = A[0][0] - q, b = A[1][1] - q, c = A[2][2] - q;
+	const double p2 = a * a + b * b + c * c + 2.0 * p1;
+	if( p2 <= 0.0 ) {
+		d[0] = d[1] = d[2] = q;
+		return;
+	}
+	const double p = std::sqrt( p2 / 6.0 );
+	// det((A - qI) / p) / 2, clamped against rounding
+	double r = ( a * (b * c - A[1][2] * A[1][2])
+		- A[0][1] * (A[0][1] * c - A[1][2] * A[0][2])
+		+ A[0][2] * (A[0][1] * A[1][2] - b * A[0][2]) ) / (2.0 * p * p * p);
+	r = r < -1.0 ? -1.0 : ( r > 1.0 ? 1.0 : r );
+	const double phi = std::acos( r ) / 3.0;
+	d[2] = q + 2.0 * p * std::cos( phi );
+	d[0] = q + 2.0 * p * std::cos( phi + 2.0943951023931955 );
+	d[1] = 3.0 * q - d[0] - d[2];
+}
+
+} // end namespace medimg
+
+#endif
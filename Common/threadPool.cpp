@@ -0,0 +1,139 @@
+//
+//  threadPool.cpp
+//  Common
+//
+
+#include "threadPool.h"
+
+#include <algorithm>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// Pool and index of the worker running on this thread, if any
+thread_local const ThreadPool *t_Pool = 0;
+thread_local unsigned int t_Worker = 0;
+
+} // end anonymous namespace
+
+
+ThreadPool::ThreadPool(unsigned int threads)
+	: m_Threads(threads > 0 ? threads : DefaultNumberOfThreads()),
+	  m_Stop(false)
+{
+	// The caller is worker m_Threads - 1
+	m_Workers.reserve( m_Threads - 1 );
+	for( unsigned int w = 0; w + 1 < m_Threads; ++w ) {
+		m_Workers.push_back( std::thread( &ThreadPool::WorkerLoop, this, w ) );
+	}
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		m_Stop = true;
+	}
+	m_Wake.notify_all();
+	for( std::size_t w = 0; w < m_Workers.size(); ++w ) {
+		m_Workers[w].join();
+	}
+}
+
+
+unsigned int ThreadPool::CallerWorker() const
+{
+	return t_Pool == this ? t_Worker : m_Threads - 1;
+}
+
+
+void ThreadPool::Post(const std::function<void(unsigned int)> &task)
+{
+	if( m_Workers.empty() ) {
+		task( CallerWorker() );
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		m_Tasks.push_back( task );
+	}
+	m_Wake.notify_one();
+}
+
+
+void ThreadPool::Run(const std::function<void(unsigned int)> &job,
+	const std::atomic<std::size_t> &next, std::size_t count)
+{
+	// Threads outside the pool share the last index, so take turns
+	std::unique_lock<std::mutex> run( m_RunMutex, std::defer_lock );
+	if( t_Pool != this ) {
+		run.lock();
+	}
+	Loop loop;
+	loop.Job = &job;
+	loop.Next = &next;
+	loop.Count = count;
+	loop.Helpers = 0;
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		m_Loops.push_back( &loop );
+	}
+	m_Wake.notify_all();
+
+	job( CallerWorker() );
+
+	// No worker joins once the loop is unlisted; wait for those inside
+	std::unique_lock<std::mutex> lock( m_Mutex );
+	m_Loops.erase( std::find( m_Loops.begin(), m_Loops.end(), &loop ) );
+	m_Done.wait( lock, [&loop]() { return loop.Helpers == 0; } );
+}
+
+
+void ThreadPool::WorkerLoop(unsigned int worker)
+{
+	t_Pool = this;
+	t_Worker = worker;
+	std::unique_lock<std::mutex> lock( m_Mutex );
+	for( ;; ) {
+		// The loop with the most items left
+		Loop *loop = 0;
+		std::size_t most = 0;
+		for( std::size_t l = 0; l < m_Loops.size(); ++l ) {
+			const std::size_t next = *m_Loops[l]->Next;
+			if( next < m_Loops[l]->Count && m_Loops[l]->Count - next > most ) {
+				most = m_Loops[l]->Count - next;
+				loop = m_Loops[l];
+			}
+		}
+		if( loop ) {
+			++loop->Helpers;
+			lock.unlock();
+			( *loop->Job )( worker );
+			lock.lock();
+			if( --loop->Helpers == 0 ) {
+				m_Done.notify_all();
+			}
+			continue;
+		}
+		if( !m_Tasks.empty() ) {
+			const std::function<void(unsigned int)> task = m_Tasks.front();
+			m_Tasks.pop_front();
+			lock.unlock();
+			task( worker );
+			lock.lock();
+			continue;
+		}
+		if( m_Stop ) {
+			return;
+		}
+		m_Wake.wait( lock );
+	}
+}
+
+} // end namespace medimg
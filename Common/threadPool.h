@@ -0,0 +1,110 @@
+//
+//  threadPool.h
+//  Common
+//
+//  Persistent worker threads for the native kernels. ParallelFor in
+//  parallel.h starts and joins a thread per worker on every call, which is
+//  fine for one long loop but adds up when a filter runs one loop per scale
+//  or several filters run back to back. A ThreadPool is created once and
+//  can be handed to every filter of a run; its workers sleep between loops.
+//
+//  Work can also be posted to the workers (Post), e.g. one task per case of
+//  a cohort (cohortScheduler.h). Loops started inside such tasks run at the
+//  same time, and a worker with nothing of its own joins the open loop with
+//  the most items left, so workers are lent to whichever loop needs them.
+//
+
+#ifndef MEDIMG_THREADPOOL_H
+#define MEDIMG_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace medimg
+{
+
+class ThreadPool
+{
+public:
+	// 0 uses every core. The calling thread takes part in every loop, so
+	// threads - 1 workers are started.
+	explicit ThreadPool(unsigned int threads = 0);
+	// Finishes the posted tasks first
+	~ThreadPool();
+
+	unsigned int NumberOfThreads() const { return m_Threads; }
+
+	// Same contract as ParallelFor: body(item, worker) for every item in
+	// [0, count), worker in [0, NumberOfThreads()), items handed out one at
+	// a time. Returns when all items are done. Loops from threads outside
+	// the pool are serialized, loops from posted tasks are not; body must
+	// not start a loop on the same pool.
+	template< class TBody >
+	void ParallelFor(std::size_t count, TBody body)
+	{
+		if( count == 0 ) {
+			return;
+		}
+		if( m_Workers.empty() || count == 1 ) {
+			const unsigned int worker = CallerWorker();
+			for( std::size_t i = 0; i < count; ++i ) {
+				body( i, worker );
+			}
+			return;
+		}
+		std::atomic<std::size_t> next( 0 );
+		const std::function<void(unsigned int)> job = [&next, count, &body](unsigned int w) {
+			for( std::size_t i = next++; i < count; i = next++ ) {
+				body( i, w );
+			}
+		};
+		Run( job, next, count );
+	}
+
+	// Runs task(worker) on a worker once one is free; loops in progress
+	// are helped first. task must not throw. Without workers it runs on
+	// the calling thread.
+	void Post(const std::function<void(unsigned int)> &task);
+
+private:
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+
+	// A loop in progress and the workers helping it
+	struct Loop
+	{
+		const std::function<void(unsigned int)> *Job;
+		const std::atomic<std::size_t> *Next;
+		std::size_t Count;
+		unsigned int Helpers;
+	};
+
+	// Index of the calling thread: its own for a worker, the last for
+	// threads outside the pool
+	unsigned int CallerWorker() const;
+	void Run(const std::function<void(unsigned int)> &job,
+		const std::atomic<std::size_t> &next, std::size_t count);
+	void WorkerLoop(unsigned int worker);
+
+	unsigned int m_Threads;
+	std::vector<std::thread> m_Workers;
+
+	std::mutex m_RunMutex;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Done;
+	std::vector<Loop *> m_Loops;
+	std::deque< std::function<void(unsigned int)> > m_Tasks;
+	bool m_Stop;
+};
+
+} // end namespace medimg
+
+#endif
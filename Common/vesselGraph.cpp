@@ -0,0 +1,460 @@
+//
+//  vesselGraph.cpp
+//  Common
+//
+
+#include "vesselGraph.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace medimg
+{
+
+namespace
+{
+
+const char Magic[8] = { 'V', 'E', 'S', 'S', 'G', 'R', 'F', '1' };
+
+template< class T >
+bool Read(std::FILE *file, T *values, std::size_t n = 1)
+{
+	return std::fread( values, sizeof(T), n, file ) == n;
+}
+
+template< class T >
+void Write(std::FILE *file, const T *values, std::size_t n = 1)
+{
+	std::fwrite( values, sizeof(T), n, file );
+}
+
+// Skeleton voxels 26-adjacent to voxel i; returns their number
+int SkeletonNeighbours(const unsigned char *S, const Dims &dims, std::size_t i,
+	std::size_t out[26])
+{
+	const long x = i % dims.nx, y = (i / dims.nx) % dims.ny, z = i / (dims.nx * dims.ny);
+	int n = 0;
+	for( long dz = -1; dz <= 1; ++dz ) {
+		const long qz = z + dz;
+		if( qz < 0 || qz >= static_cast<long>( dims.nz ) ) {
+			continue;
+		}
+		for( long dy = -1; dy <= 1; ++dy ) {
+			const long qy = y + dy;
+			if( qy < 0 || qy >= static_cast<long>( dims.ny ) ) {
+				continue;
+			}
+			for( long dx = -1; dx <= 1; ++dx ) {
+				const long qx = x + dx;
+				if( ( dx == 0 && dy == 0 && dz == 0 ) || qx < 0
+					|| qx >= static_cast<long>( dims.nx ) ) {
+					continue;
+				}
+				const std::size_t q = dims.Index( qx, qy, qz );
+				if( S[q] ) {
+					out[n++] = q;
+				}
+			}
+		}
+	}
+	return n;
+}
+
+class GraphTracer
+{
+public:
+	GraphTracer(const unsigned char *S, const Box &region, const Geometry &geometry,
+		const float *whatScale, const std::vector<double> &sigmas, double radiusPerSigma,
+		VesselGraphWriter &writer)
+		: m_S( S ), m_Region( region ), m_Dims( region.Size( 0 ), region.Size( 1 ), region.Size( 2 ) ),
+		m_Volume( geometry.dims ), m_Spacing( geometry.Spacing ), m_WhatScale( whatScale ), m_Sigmas( sigmas ),
+		m_RadiusPerSigma( radiusPerSigma ), m_Writer( writer ), m_NextId( 0 ) {}
+
+	void Run()
+	{
+		std::vector<std::size_t> skeleton, ends;
+		std::size_t nb[26];
+		for( std::size_t i = 0; i < m_Dims.Voxels(); ++i ) {
+			if( m_S[i] ) {
+				skeleton.push_back( i );
+				if( SkeletonNeighbours( m_S, m_Dims, i, nb ) == 1 ) {
+					ends.push_back( i );
+				}
+			}
+		}
+		for( std::size_t e = 0; e < ends.size(); ++e ) {
+			PruneSpur( ends[e] );
+		}
+		PruneCorners( skeleton );
+		std::vector<std::size_t> junctions;
+		for( std::size_t s = 0; s < skeleton.size(); ++s ) {
+			if( !m_Pruned.count( skeleton[s] ) && Neighbours( skeleton[s], nb ) != 2 ) {
+				junctions.push_back( skeleton[s] );
+			}
+		}
+
+		// Line ends and junctions; touching junction voxels form one node
+		std::vector<std::size_t> cluster;
+		for( std::size_t j = 0; j < junctions.size(); ++j ) {
+			if( m_NodeOf.count( junctions[j] ) ) {
+				continue;
+			}
+			cluster.assign( 1, junctions[j] );
+			m_NodeOf[junctions[j]] = m_NextId;
+			for( std::size_t c = 0; c < cluster.size(); ++c ) {
+				const int n = Neighbours( cluster[c], nb );
+				for( int k = 0; k < n; ++k ) {
+					if( !m_NodeOf.count( nb[k] ) && Neighbours( nb[k], m_Scratch ) != 2 ) {
+						m_NodeOf[nb[k]] = m_NextId;
+						cluster.push_back( nb[k] );
+					}
+				}
+			}
+			EmitNode( cluster );
+		}
+
+		// Branches leave every node voxel towards an untraced line voxel
+		for( std::size_t j = 0; j < junctions.size(); ++j ) {
+			TraceFrom( junctions[j] );
+		}
+
+		// What is left are closed loops without any junction
+		for( std::size_t s = 0; s < skeleton.size(); ++s ) {
+			const std::size_t i = skeleton[s];
+			if( m_NodeOf.count( i ) || m_Visited.count( i ) || m_Pruned.count( i ) ) {
+				continue;
+			}
+			m_NodeOf[i] = m_NextId;
+			cluster.assign( 1, i );
+			EmitNode( cluster );
+			TraceFrom( i );
+		}
+	}
+
+private:
+	// Skeleton voxels 26-adjacent to voxel i that are not pruned
+	int Neighbours(std::size_t i, std::size_t out[26]) const
+	{
+		const int n = SkeletonNeighbours( m_S, m_Dims, i, out );
+		if( m_Pruned.empty() ) {
+			return n;
+		}
+		int kept = 0;
+		for( int k = 0; k < n; ++k ) {
+			if( !m_Pruned.count( out[k] ) ) {
+				out[kept++] = out[k];
+			}
+		}
+		return kept;
+	}
+
+	// Thinning leaves an end branch from the centerline to every bump of
+	// the vessel surface and to the corners of a rounded vessel end, about
+	// the radius plus a voxel long. The line from an end voxel to the first
+	// junction is pruned when it is no longer than the radius there plus a
+	// diagonal voxel step, so a straight tube is one branch. Ends are pruned
+	// one at a time, so a junction that has lost all but two of its lines
+	// becomes part of a line before the next end is walked.
+	void PruneSpur(std::size_t end)
+	{
+		std::vector<std::size_t> spur( 1, end );
+		std::size_t nb[26];
+		double length = 0.0;
+		std::size_t previous = end, current = end;
+		int n = Neighbours( end, nb );
+		if( n != 1 ) {
+			return;
+		}
+		for( ;; ) {
+			const std::size_t ahead = nb[0] == previous && n > 1 ? nb[1] : nb[0];
+			length += StepLength( current, ahead );
+			previous = current;
+			current = ahead;
+			n = Neighbours( current, nb );
+			if( n != 2 ) {
+				break;
+			}
+			spur.push_back( current );
+		}
+		// A line with two ends is a vessel of its own
+		if( n < 3 ) {
+			return;
+		}
+		const double diagonal = std::sqrt( m_Spacing[0] * m_Spacing[0] + m_Spacing[1] * m_Spacing[1]
+			+ m_Spacing[2] * m_Spacing[2] );
+		if( length <= RadiusAt( current ) + diagonal ) {
+			m_Pruned.insert( spur.begin(), spur.end() );
+		}
+	}
+
+	// A voxel whose two neighbours touch each other does not connect them;
+	// such corners are left where a spur joined a line and would make the
+	// line voxels around them a junction. Their neighbours are checked again
+	// once they are pruned.
+	void PruneCorners(std::vector<std::size_t> candidates)
+	{
+		std::size_t nb[26];
+		while( !candidates.empty() ) {
+			const std::size_t i = candidates.back();
+			candidates.pop_back();
+			if( m_Pruned.count( i ) || Neighbours( i, nb ) != 2 || !Touch( nb[0], nb[1] ) ) {
+				continue;
+			}
+			m_Pruned.insert( i );
+			candidates.push_back( nb[0] );
+			candidates.push_back( nb[1] );
+		}
+	}
+
+	// Whether skeleton voxels i and j are 26-adjacent
+	bool Touch(std::size_t i, std::size_t j) const
+	{
+		long p[3], q[3];
+		Position( i, p );
+		Position( j, q );
+		return std::labs( p[0] - q[0] ) <= 1 && std::labs( p[1] - q[1] ) <= 1 && std::labs( p[2] - q[2] ) <= 1;
+	}
+
+	// Physical distance between skeleton voxels i and j
+	double StepLength(std::size_t i, std::size_t j) const
+	{
+		long p[3], q[3];
+		Position( i, p );
+		Position( j, q );
+		double sum = 0.0;
+		for( int a = 0; a < 3; ++a ) {
+			const double d = ( p[a] - q[a] ) * m_Spacing[a];
+			sum += d * d;
+		}
+		return std::sqrt( sum );
+	}
+
+	// Volume coordinates of skeleton voxel i
+	void Position(std::size_t i, long p[3]) const
+	{
+		p[0] = m_Region.lo[0] + static_cast<long>( i % m_Dims.nx );
+		p[1] = m_Region.lo[1] + static_cast<long>( (i / m_Dims.nx) % m_Dims.ny );
+		p[2] = m_Region.lo[2] + static_cast<long>( i / (m_Dims.nx * m_Dims.ny) );
+	}
+
+	float RadiusAt(std::size_t i) const
+	{
+		if( !m_WhatScale ) {
+			return 0.0f;
+		}
+		long p[3];
+		Position( i, p );
+		const long s = static_cast<long>( m_WhatScale[m_Volume.Index( p[0], p[1], p[2] )] + 0.5f ) - 1;
+		if( s < 0 || s >= static_cast<long>( m_Sigmas.size() ) ) {
+			return 0.0f;
+		}
+		return static_cast<float>( m_RadiusPerSigma * m_Sigmas[s] );
+	}
+
+	void EmitNode(const std::vector<std::size_t> &voxels)
+	{
+		GraphNode node;
+		node.Id = m_NextId++;
+		double sum[3] = { 0.0, 0.0, 0.0 }, radius = 0.0;
+		for( std::size_t c = 0; c < voxels.size(); ++c ) {
+			long p[3];
+			Position( voxels[c], p );
+			sum[0] += p[0];
+			sum[1] += p[1];
+			sum[2] += p[2];
+			radius += RadiusAt( voxels[c] );
+		}
+		for( int a = 0; a < 3; ++a ) {
+			node.Position[a] = static_cast<float>( sum[a] / voxels.size() );
+		}
+		node.Radius = static_cast<float>( radius / voxels.size() );
+		m_Writer.WriteNode( node );
+	}
+
+	void TraceFrom(std::size_t start)
+	{
+		std::size_t nb[26];
+		const int n = Neighbours( start, nb );
+		for( int k = 0; k < n; ++k ) {
+			if( m_NodeOf.count( nb[k] ) || m_Visited.count( nb[k] ) ) {
+				continue;
+			}
+			m_Branch.Nodes[0] = m_NodeOf[start];
+			m_Branch.Points.clear();
+			std::size_t previous = start, current = nb[k];
+			for( ;; ) {
+				m_Visited.insert( current );
+				AddPoint( current );
+				// A line voxel has exactly two neighbours
+				std::size_t next[26];
+				Neighbours( current, next );
+				const std::size_t ahead = next[0] == previous ? next[1] : next[0];
+				std::unordered_map<std::size_t, unsigned int>::const_iterator node = m_NodeOf.find( ahead );
+				if( node != m_NodeOf.end() ) {
+					m_Branch.Nodes[1] = node->second;
+					break;
+				}
+				previous = current;
+				current = ahead;
+			}
+			// Spurs that leave a junction and return to it right away
+			if( m_Branch.Nodes[0] != m_Branch.Nodes[1] || m_Branch.Points.size() > 2 ) {
+				m_Writer.WriteBranch( m_Branch );
+			}
+		}
+	}
+
+	void AddPoint(std::size_t i)
+	{
+		long q[3];
+		Position( i, q );
+		BranchPoint p;
+		for( int a = 0; a < 3; ++a ) {
+			p.Voxel[a] = static_cast<unsigned short>( q[a] );
+		}
+		p.Radius = RadiusAt( i );
+		m_Branch.Points.push_back( p );
+	}
+
+	const unsigned char *m_S;
+	const Box m_Region;
+	// Extent of the skeleton buffer and of the whole volume
+	const Dims m_Dims, m_Volume;
+	const double *m_Spacing;
+	const float *m_WhatScale;
+	const std::vector<double> &m_Sigmas;
+	double m_RadiusPerSigma;
+	VesselGraphWriter &m_Writer;
+
+	unsigned int m_NextId;
+	std::unordered_map<std::size_t, unsigned int> m_NodeOf;
+	std::unordered_set<std::size_t> m_Visited, m_Pruned;
+	GraphBranch m_Branch;
+	std::size_t m_Scratch[26];
+};
+
+} // end anonymous namespace
+
+
+bool VesselGraphWriter::Open(const char *filename, const Geometry &geometry)
+{
+	Close();
+	m_File = std::fopen( filename, "wb" );
+	if( !m_File ) {
+		return false;
+	}
+	m_Nodes = m_Branches = 0;
+	const unsigned int size[3] = { static_cast<unsigned int>( geometry.dims.nx ),
+		static_cast<unsigned int>( geometry.dims.ny ), static_cast<unsigned int>( geometry.dims.nz ) };
+	Write( m_File, Magic, 8 );
+	Write( m_File, size, 3 );
+	Write( m_File, geometry.Spacing, 3 );
+	Write( m_File, geometry.Origin, 3 );
+	Write( m_File, geometry.Direction, 9 );
+	return true;
+}
+
+void VesselGraphWriter::WriteNode(const GraphNode &node)
+{
+	const char tag = 'N';
+	Write( m_File, &tag );
+	Write( m_File, &node.Id );
+	Write( m_File, node.Position, 3 );
+	Write( m_File, &node.Radius );
+	++m_Nodes;
+}
+
+void VesselGraphWriter::WriteBranch(const GraphBranch &branch)
+{
+	const char tag = 'B';
+	const unsigned int count = static_cast<unsigned int>( branch.Points.size() );
+	Write( m_File, &tag );
+	Write( m_File, branch.Nodes, 2 );
+	Write( m_File, &count );
+	for( std::size_t p = 0; p < branch.Points.size(); ++p ) {
+		Write( m_File, branch.Points[p].Voxel, 3 );
+		Write( m_File, &branch.Points[p].Radius );
+	}
+	++m_Branches;
+}
+
+bool VesselGraphWriter::Close()
+{
+	if( !m_File ) {
+		return true;
+	}
+	const char tag = 'E';
+	const unsigned int counts[2] = { static_cast<unsigned int>( m_Nodes ),
+		static_cast<unsigned int>( m_Branches ) };
+	Write( m_File, &tag );
+	Write( m_File, counts, 2 );
+	const bool good = !std::ferror( m_File );
+	const bool closed = std::fclose( m_File ) == 0;
+	m_File = 0;
+	return good && closed;
+}
+
+
+bool ReadVesselGraph(const char *filename, VesselGraph &graph)
+{
+	std::FILE *file = std::fopen( filename, "rb" );
+	if( !file ) {
+		return false;
+	}
+	char magic[8];
+	unsigned int size[3];
+	bool good = Read( file, magic, 8 ) && std::memcmp( magic, Magic, 8 ) == 0
+		&& Read( file, size, 3 ) && Read( file, graph.geometry.Spacing, 3 )
+		&& Read( file, graph.geometry.Origin, 3 ) && Read( file, graph.geometry.Direction, 9 );
+	if( good ) {
+		graph.geometry.dims = Dims( size[0], size[1], size[2] );
+	}
+	graph.Nodes.clear();
+	graph.Branches.clear();
+
+	bool ended = false;
+	char tag;
+	while( good && !ended && Read( file, &tag ) ) {
+		if( tag == 'N' ) {
+			GraphNode node;
+			good = Read( file, &node.Id ) && Read( file, node.Position, 3 ) && Read( file, &node.Radius );
+			graph.Nodes.push_back( node );
+		}
+		else if( tag == 'B' ) {
+			GraphBranch branch;
+			unsigned int count = 0;
+			good = Read( file, branch.Nodes, 2 ) && Read( file, &count );
+			for( unsigned int p = 0; good && p < count; ++p ) {
+				BranchPoint point;
+				good = Read( file, point.Voxel, 3 ) && Read( file, &point.Radius );
+				branch.Points.push_back( point );
+			}
+			graph.Branches.push_back( branch );
+		}
+		else if( tag == 'E' ) {
+			unsigned int counts[2];
+			good = Read( file, counts, 2 ) && counts[0] == graph.Nodes.size()
+				&& counts[1] == graph.Branches.size();
+			ended = true;
+		}
+		else {
+			good = false;
+		}
+	}
+	std::fclose( file );
+	return good && ended;
+}
+
+
+void ExtractVesselGraph(const unsigned char *skeleton, const Box &region, const Geometry &geometry,
+	const float *whatScale, const std::vector<double> &sigmas, double radiusPerSigma,
+	VesselGraphWriter &writer)
+{
+	GraphTracer( skeleton, region, geometry, whatScale, sigmas, radiusPerSigma, writer ).Run();
+}
+
+} // end namespace medimg
@@ -0,0 +1,108 @@
+//
+//  vesselGraph.h
+//  Common
+//
+//  Vessel tree as a graph: nodes are line ends and junctions of a curve
+//  skeleton (see skeleton.h), branches are the chains of skeleton voxels
+//  between them, each voxel with the vessel radius estimated from the
+//  scale of the maximum vesselness response.
+//
+//  The graph is written as a stream of records while the skeleton is being
+//  traced, so nothing but the skeleton itself is held. File layout, native
+//  byte order (little endian on all our machines):
+//
+//    char[8]   "VESSGRF1"
+//    uint32[3] volume size, double[3] spacing, double[3] origin,
+//    double[9] direction (row-major)
+//    records, each starting with a uint8 tag:
+//      'N'  uint32 id, float[3] position (voxel coordinates), float radius
+//      'B'  uint32 node ids[2], uint32 count,
+//           count x { uint16[3] voxel, float radius }
+//      'E'  uint32 number of nodes, uint32 number of branches
+//
+//  A node record always precedes the branches that refer to it.
+//
+
+#ifndef MEDIMG_VESSELGRAPH_H
+#define MEDIMG_VESSELGRAPH_H
+
+#include <cstdio>
+#include <vector>
+#include "volume.h"
+
+
+namespace medimg
+{
+
+struct GraphNode
+{
+	unsigned int Id;
+	// Centroid of the node's skeleton voxels, in voxel coordinates
+	float Position[3];
+	float Radius;
+};
+
+struct BranchPoint
+{
+	unsigned short Voxel[3];
+	float Radius;
+};
+
+struct GraphBranch
+{
+	unsigned int Nodes[2];
+	// Skeleton voxels strictly between the two nodes, in order
+	std::vector<BranchPoint> Points;
+};
+
+class VesselGraphWriter
+{
+public:
+	VesselGraphWriter() : m_File(0), m_Nodes(0), m_Branches(0) {}
+	~VesselGraphWriter() { Close(); }
+
+	// False if the file cannot be created
+	bool Open(const char *filename, const Geometry &geometry);
+	void WriteNode(const GraphNode &node);
+	void WriteBranch(const GraphBranch &branch);
+	// Writes the end record; false if any write failed
+	bool Close();
+
+	std::size_t Nodes() const { return m_Nodes; }
+	std::size_t Branches() const { return m_Branches; }
+
+private:
+	VesselGraphWriter(const VesselGraphWriter &);
+	VesselGraphWriter &operator=(const VesselGraphWriter &);
+
+	std::FILE *m_File;
+	std::size_t m_Nodes, m_Branches;
+};
+
+// A whole graph in memory, for consumers of the files
+struct VesselGraph
+{
+	Geometry geometry;
+	std::vector<GraphNode> Nodes;
+	std::vector<GraphBranch> Branches;
+};
+
+// False if the file is missing, truncated or not a graph file
+bool ReadVesselGraph(const char *filename, VesselGraph &graph);
+
+// Traces the skeleton (nonzero voxels of skeleton, which covers region of a
+// volume of geometry, region.Voxels() values) and streams its nodes and
+// branches to writer in the coordinates of the volume. The radius of a
+// voxel is radiusPerSigma * sigmas[whatScale - 1], in the physical units of
+// sigmas, or 0 without whatScale (geometry.dims.Voxels() values). End
+// branches no longer than the radius at their junction, or than one voxel,
+// are spurs of the thinning and are dropped with their end node. Junction
+// voxels that touch are merged into one node; closed loops get a node
+// where they are first found.
+void ExtractVesselGraph(const unsigned char *skeleton, const Box &region, const Geometry &geometry,
+	const float *whatScale, const std::vector<double> &sigmas, double radiusPerSigma,
+	VesselGraphWriter &writer);
+
+} // end namespace medimg
+
+#endif
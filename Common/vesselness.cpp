@@ -0,0 +1,218 @@
+//
+//  vesselness.cpp
+//  Common
+//
+
+#include "vesselness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include "hessian.h"
+#include "symmetricEigen3.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+// gradient3 from Hessian3D.m: central differences inside the volume and
+// one-sided differences on its first and last plane. F is given on src and
+// D is computed on dst, which must lie within src grown by one voxel along
+// axis (or reach the volume edge).
+void Gradient3(const float *F, const Box &src, int axis, long n, const Box &dst, float *D)
+{
+	const std::size_t stride = axis == 0 ? 1 : ( axis == 1 ? src.Size(0) : src.Size(0) * src.Size(1) );
+	float *out = D;
+	for( long z = dst.lo[2]; z < dst.hi[2]; ++z ) {
+		for( long y = dst.lo[1]; y < dst.hi[1]; ++y ) {
+			for( long x = dst.lo[0]; x < dst.hi[0]; ++x ) {
+				const long p = axis == 0 ? x : ( axis == 1 ? y : z );
+				const float *f = F + src.Offset( x, y, z );
+				if( n < 2 ) {
+					*out++ = 0.0f;
+				}
+				else if( p == 0 ) {
+					*out++ = f[stride] - f[0];
+				}
+				else if( p == n - 1 ) {
+					*out++ = f[0] - f[-static_cast<long>( stride )];
+				}
+				else {
+					*out++ = (f[stride] - f[-static_cast<long>( stride )]) / 2;
+				}
+			}
+		}
+	}
+}
+
+// Hessian of the tile as computed by Hessian3D.m: imgaussian smoothing
+// followed by gradient3 applied twice
+void CentralDifferenceHessian(const float *I, const Dims &dims, const Box &tile,
+	int radius, const std::vector<float> &gaussian, ScratchArena &arena, float *const H[6])
+{
+	const long n[3] = { static_cast<long>( dims.nx ), static_cast<long>( dims.ny ),
+		static_cast<long>( dims.nz ) };
+	const Box r1 = tile.Grow( 1, &dims );
+	const Box r2 = tile.Grow( 2, &dims );
+	const Box halo = r2.Grow( radius );
+	arena.Reset();
+	float *in = arena.Allocate( halo.Voxels() );
+	GatherReplicate( I, dims, halo, in );
+
+	// F = imgaussian(Volume,Sigma) on r2
+	const std::size_t size[3] = { halo.Size(0), halo.Size(1), halo.Size(2) };
+	const std::size_t sizeX[3] = { r2.Size(0), size[1], size[2] };
+	const std::size_t sizeY[3] = { r2.Size(0), r2.Size(1), size[2] };
+	float *a = arena.Allocate( sizeX[0] * sizeX[1] * sizeX[2] );
+	float *b = arena.Allocate( sizeY[0] * sizeY[1] * sizeY[2] );
+	float *F = arena.Allocate( r2.Voxels() );
+	CorrelateAxis( in, size, 0, gaussian, a );
+	CorrelateAxis( a, sizeX, 1, gaussian, b );
+	CorrelateAxis( b, sizeY, 2, gaussian, F );
+
+	// Dx, Dy, Dz on r1, then the second derivatives on the tile
+	float *D[3];
+	for( int axis = 0; axis < 3; ++axis ) {
+		D[axis] = arena.Allocate( r1.Voxels() );
+		Gradient3( F, r2, axis, n[axis], r1, D[axis] );
+	}
+	Gradient3( D[0], r1, 0, n[0], tile, H[0] );
+	Gradient3( D[1], r1, 1, n[1], tile, H[1] );
+	Gradient3( D[2], r1, 2, n[2], tile, H[2] );
+	Gradient3( D[0], r1, 1, n[1], tile, H[3] );
+	Gradient3( D[0], r1, 2, n[2], tile, H[4] );
+	Gradient3( D[1], r1, 2, n[2], tile, H[5] );
+}
+
+// Per-thread buffers, kept across tiles and scales
+struct TileScratch
+{
+	ScratchArena arena;
+	std::vector<float> h;
+};
+
+} // end anonymous namespace
+
+
+std::vector<double> FrangiSigmas(const FrangiOptions &options)
+{
+	std::vector<double> sigmas;
+	const double step = options.FrangiScaleRatio;
+	const double last = options.FrangiScaleRange[1];
+	for( double s = options.FrangiScaleRange[0]; s <= last + 1e-9 * std::fabs(last);
+		s += step ) {
+		sigmas.push_back( s );
+		if( step <= 0 ) {
+			break;
+		}
+	}
+	std::sort( sigmas.begin(), sigmas.end() );
+	return sigmas;
+}
+
+
+void FrangiFilter3D(const float *I, const Dims &dims,
+	const FrangiOptions &options, const FrangiOutputs &outputs, ThreadPool *pool)
+{
+	const std::vector<double> sigmas = FrangiSigmas( options );
+	const TileGrid grid( dims, options.TileSize );
+
+	// One pool for all scales instead of new threads per scale
+	std::unique_ptr<ThreadPool> localPool;
+	if( !pool ) {
+		localPool.reset( new ThreadPool( options.NumberOfThreads ) );
+		pool = localPool.get();
+	}
+	std::vector<TileScratch> scratch( pool->NumberOfThreads() );
+
+	const double A = 2 * options.FrangiAlpha * options.FrangiAlpha;
+	const double B = 2 * options.FrangiBeta * options.FrangiBeta;
+	const double C = 2 * options.FrangiC * options.FrangiC;
+	const bool directions = outputs.Vx && outputs.Vy && outputs.Vz;
+
+	for( std::size_t s = 0; s < sigmas.size(); ++s ) {
+		const double sigma = sigmas[s];
+		if( options.verbose ) {
+			std::cout << "Current Frangi Filter Sigma: " << sigma << std::endl;
+		}
+		const HessianKernels kernels( sigma );
+		const int imgaussianRadius = sigma > 0 ? static_cast<int>( std::ceil( 3.0 * sigma ) ) : 0;
+		const std::vector<float> imgaussianKernel =
+			GaussianDerivativeKernel( sigma, imgaussianRadius, 0 );
+		// Correct for scaling
+		const double c = sigma > 0 ? sigma * sigma : 1.0;
+
+		pool->ParallelFor( grid.Count(), [&](std::size_t t, unsigned int worker) {
+			TileScratch &buf = scratch[worker];
+			const Box box = grid[t];
+			const std::size_t n = box.Voxels();
+			buf.h.resize( 6 * n );
+			float *const H[6] = { &buf.h[0], &buf.h[n], &buf.h[2 * n], &buf.h[3 * n],
+				&buf.h[4 * n], &buf.h[5 * n] };
+
+			if( options.CentralDifferenceHessian ) {
+				CentralDifferenceHessian( I, dims, box, imgaussianRadius, imgaussianKernel,
+					buf.arena, H );
+			}
+			else {
+				HessianOfBox( I, dims, box, kernels, buf.arena, H );
+			}
+
+			// Eigenvalues, vesselness and max-reduction into the outputs
+			std::size_t l = 0;
+			for( long z = box.lo[2]; z < box.hi[2]; ++z ) {
+				for( long y = box.lo[1]; y < box.hi[1]; ++y ) {
+					for( long x = box.lo[0]; x < box.hi[0]; ++x, ++l ) {
+						const double Dxx = c * H[0][l], Dyy = c * H[1][l], Dzz = c * H[2][l];
+						const double Dxy = c * H[3][l], Dxz = c * H[4][l], Dyz = c * H[5][l];
+						const double M[3][3] = {
+							{ Dxx, Dxy, Dxz }, { Dxy, Dyy, Dyz }, { Dxz, Dyz, Dzz }
+						};
+						double V[3][3], lambda[3];
+						SymmetricEigen3( M, V, lambda );
+
+						const double LambdaAbs1 = std::fabs( lambda[0] );
+						const double LambdaAbs2 = std::fabs( lambda[1] );
+						const double LambdaAbs3 = std::fabs( lambda[2] );
+						const double Ra = LambdaAbs2 / LambdaAbs3;
+						const double Rb = LambdaAbs1 / std::sqrt( LambdaAbs2 * LambdaAbs3 );
+						const double S2 = LambdaAbs1 * LambdaAbs1 + LambdaAbs2 * LambdaAbs2
+							+ LambdaAbs3 * LambdaAbs3;
+						double v = (1 - std::exp( -(Ra * Ra / A) ))
+							* std::exp( -(Rb * Rb / B) )
+							* (1 - std::exp( -S2 / C ));
+						if( options.BlackWhite ) {
+							if( lambda[1] < 0 || lambda[2] < 0 ) { v = 0; }
+						}
+						else {
+							if( lambda[1] > 0 || lambda[2] > 0 ) { v = 0; }
+						}
+						if( !std::isfinite( v ) ) {
+							v = 0;
+						}
+
+						const std::size_t g = dims.Index( x, y, z );
+						const float vf = static_cast<float>( v );
+						if( s == 0 || vf > outputs.Iout[g] ) {
+							outputs.Iout[g] = vf;
+							if( outputs.whatScale ) {
+								outputs.whatScale[g] = static_cast<float>( s + 1 );
+							}
+							if( directions ) {
+								outputs.Vx[g] = static_cast<float>( V[0][0] );
+								outputs.Vy[g] = static_cast<float>( V[1][0] );
+								outputs.Vz[g] = static_cast<float>( V[2][0] );
+							}
+						}
+					}
+				}
+			}
+		} );
+	}
+}
+
+} // end namespace medimg
@@ -0,0 +1,97 @@
+//
+//  vesselness.h
+//  Common
+//
+//  Native multiscale Frangi vesselness. Unlike FrangiFilter3D.m, which
+//  materializes the six Hessian components, three eigenvalue volumes and
+//  every intermediate ratio as full volumes per scale, the volume is
+//  processed in cache-sized tiles: each tile (plus a halo of the Gaussian
+//  support) is filtered into the Hessian, decomposed, turned into
+//  vesselness and max-reduced straight into the output. Apart from the
+//  input and the outputs, memory is a few tile buffers per thread.
+//
+
+#ifndef MEDIMG_VESSELNESS_H
+#define MEDIMG_VESSELNESS_H
+
+#include <vector>
+#include "threadPool.h"
+#include "volume.h"
+
+
+namespace medimg
+{
+
+// Options named after the fields of the FrangiFilter3D.m options struct,
+// with the same defaults.
+struct FrangiOptions
+{
+	double FrangiScaleRange[2];
+	double FrangiScaleRatio;
+	double FrangiAlpha;
+	double FrangiBeta;
+	double FrangiC;
+	bool BlackWhite;
+	bool verbose;
+
+	// Smooth with imgaussian and differentiate twice with gradient3, exactly
+	// like Hessian3D.m, instead of using Gaussian-derivative kernels. Slower,
+	// but reproduces the MATLAB reference up to floating point rounding.
+	bool CentralDifferenceHessian;
+
+	// Edge length of the cubic tiles processed by one thread at a time
+	unsigned int TileSize;
+	// 0 uses every core
+	unsigned int NumberOfThreads;
+
+	FrangiOptions()
+	{
+		FrangiScaleRange[0] = 1.0;
+		FrangiScaleRange[1] = 10.0;
+		FrangiScaleRatio = 2.0;
+		FrangiAlpha = 0.5;
+		FrangiBeta = 0.5;
+		FrangiC = 500.0;
+		BlackWhite = true;
+		verbose = true;
+		CentralDifferenceHessian = false;
+		TileSize = 32;
+		NumberOfThreads = 0;
+	}
+};
+
+// Sigmas visited by the filter, FrangiScaleRange(1):FrangiScaleRatio:
+// FrangiScaleRange(2) as in the MATLAB code.
+std::vector<double> FrangiSigmas(const FrangiOptions &options);
+
+// Output buffers of the filter, each holding dims.Voxels() values and owned
+// by the caller. Only Iout is required; the others are filled when set.
+struct FrangiOutputs
+{
+	// Vessel enhanced image, the maximum response over all scales
+	float *Iout;
+	// 1-based index of the sigma at which the maximum was found
+	float *whatScale;
+	// Direction of the smallest eigenvector (along the vessel) at that sigma
+	float *Vx, *Vy, *Vz;
+
+	FrangiOutputs() : Iout(0), whatScale(0), Vx(0), Vy(0), Vz(0) {}
+};
+
+// Native equivalent of [Iout,whatScale,Vx,Vy,Vz] = FrangiFilter3D(I,options).
+// pool = 0 runs on a pool of options.NumberOfThreads created for the call.
+void FrangiFilter3D(const float *I, const Dims &dims,
+	const FrangiOptions &options, const FrangiOutputs &outputs, ThreadPool *pool = 0);
+
+inline void FrangiFilter3D(const float *I, const Dims &dims,
+	const FrangiOptions &options, float *Iout, float *whatScale = 0, ThreadPool *pool = 0)
+{
+	FrangiOutputs outputs;
+	outputs.Iout = Iout;
+	outputs.whatScale = whatScale;
+	FrangiFilter3D( I, dims, options, outputs, pool );
+}
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,127 @@
+//
+//  volume.h
+//  Common
+//
+//  Extent of a 3D volume held in a flat buffer. Voxels are stored with x
+//  varying fastest, which is the layout of both ITK image buffers and
+//  MATLAB's column-major arrays, so the same pointer can be handed over
+//  from either side without reordering.
+//
+
+#ifndef MEDIMG_VOLUME_H
+#define MEDIMG_VOLUME_H
+
+#include <cstddef>
+
+
+namespace medimg
+{
+
+struct Dims
+{
+	std::size_t nx, ny, nz;
+
+	Dims() : nx(0), ny(0), nz(0) {}
+	Dims(std::size_t x, std::size_t y, std::size_t z) : nx(x), ny(y), nz(z) {}
+
+	std::size_t Voxels() const { return nx * ny * nz; }
+	std::size_t Index(std::size_t x, std::size_t y, std::size_t z) const
+	{
+		return x + nx * (y + ny * z);
+	}
+};
+
+// Physical placement of a volume, as in an ITK image header: the world
+// position of voxel (i, j, k) is Origin + Direction * (Spacing .* (i, j, k)),
+// with Direction stored row-major.
+struct Geometry
+{
+	Dims dims;
+	double Spacing[3];
+	double Origin[3];
+	double Direction[9];
+
+	Geometry()
+	{
+		for( int a = 0; a < 3; ++a ) {
+			Spacing[a] = 1.0;
+			Origin[a] = 0.0;
+		}
+		for( int i = 0; i < 9; ++i ) {
+			Direction[i] = i % 4 == 0 ? 1.0 : 0.0;
+		}
+	}
+};
+
+// Axis-aligned box of voxels [lo, hi) in volume coordinates. Boxes may
+// extend past the volume, e.g. a tile grown by the halo of a kernel.
+struct Box
+{
+	long lo[3], hi[3];
+
+	std::size_t Size(int a) const { return static_cast<std::size_t>( hi[a] - lo[a] ); }
+	std::size_t Voxels() const { return Size(0) * Size(1) * Size(2); }
+	std::size_t Offset(long x, long y, long z) const
+	{
+		return (x - lo[0]) + Size(0) * ((y - lo[1]) + Size(1) * (z - lo[2]));
+	}
+
+	// Grown by n voxels on every side, clipped to the volume when given
+	Box Grow(long n, const Dims *clip = 0) const
+	{
+		const long ns[3] = { n, n, n };
+		return Grow( ns, clip );
+	}
+
+	// Grown by n[a] voxels on both sides along axis a
+	Box Grow(const long n[3], const Dims *clip = 0) const
+	{
+		Box b;
+		const long ext[3] = { clip ? static_cast<long>( clip->nx ) : 0,
+			clip ? static_cast<long>( clip->ny ) : 0, clip ? static_cast<long>( clip->nz ) : 0 };
+		for( int a = 0; a < 3; ++a ) {
+			b.lo[a] = lo[a] - n[a];
+			b.hi[a] = hi[a] + n[a];
+			if( clip ) {
+				if( b.lo[a] < 0 ) { b.lo[a] = 0; }
+				if( b.hi[a] > ext[a] ) { b.hi[a] = ext[a]; }
+			}
+		}
+		return b;
+	}
+};
+
+// Partition of a volume into cubic tiles of edge `tile`; the last tile
+// along each axis is cut short at the volume edge.
+struct TileGrid
+{
+	Dims dims;
+	std::size_t tile;
+	std::size_t tilesX, tilesY, tilesZ;
+
+	TileGrid(const Dims &d, std::size_t t) : dims(d), tile(t > 0 ? t : 1)
+	{
+		tilesX = (dims.nx + tile - 1) / tile;
+		tilesY = (dims.ny + tile - 1) / tile;
+		tilesZ = (dims.nz + tile - 1) / tile;
+	}
+
+	std::size_t Count() const { return tilesX * tilesY * tilesZ; }
+
+	Box operator[](std::size_t t) const
+	{
+		const std::size_t origin[3] = { (t % tilesX) * tile,
+			((t / tilesX) % tilesY) * tile, (t / (tilesX * tilesY)) * tile };
+		const std::size_t extent[3] = { dims.nx, dims.ny, dims.nz };
+		Box b;
+		for( int a = 0; a < 3; ++a ) {
+			b.lo[a] = static_cast<long>( origin[a] );
+			b.hi[a] = static_cast<long>( origin[a] + tile < extent[a] ? origin[a] + tile : extent[a] );
+		}
+		return b;
+	}
+};
+
+} // end namespace medimg
+
+#endif
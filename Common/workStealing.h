@@ -0,0 +1,140 @@
+//
+//  workStealing.h
+//  Common
+//
+//  Parallel loop for coarse work items of very uneven cost, such as whole
+//  2D segmentations of slices (a slice through the liver dome converges in
+//  a few iterations, one through the hilum takes hundreds). Every worker
+//  starts with a contiguous block of items, which keeps neighbouring items
+//  on one thread, and takes them from the front; a worker that runs out
+//  steals the back half of the fullest queue. Meant for hundreds to
+//  thousands of items; ParallelFor in parallel.h suits fine-grained loops.
+//
+
+#ifndef MEDIMG_WORKSTEALING_H
+#define MEDIMG_WORKSTEALING_H
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+
+namespace medimg
+{
+
+// Items run and items stolen by each worker
+struct WorkStealingStats
+{
+	std::vector<std::size_t> Items;
+	std::vector<std::size_t> Stolen;
+};
+
+// Calls body(item, worker) for every item in [0, count), worker in
+// [0, threads). A thread count of 0 uses all cores.
+template< class TBody >
+void WorkStealingFor(std::size_t count, unsigned int threads, TBody body, WorkStealingStats *stats = 0)
+{
+	if( threads == 0 ) {
+		threads = DefaultNumberOfThreads();
+	}
+	if( threads > count ) {
+		threads = count > 0 ? static_cast<unsigned int>( count ) : 1;
+	}
+	if( stats ) {
+		stats->Items.assign( threads, 0 );
+		stats->Stolen.assign( threads, 0 );
+	}
+
+	struct Queue
+	{
+		std::mutex Mutex;
+		std::deque<std::size_t> Items;
+	};
+	std::unique_ptr<Queue[]> queues( new Queue[threads] );
+	for( unsigned int w = 0; w < threads; ++w ) {
+		for( std::size_t i = count * w / threads; i < count * (w + 1) / threads; ++i ) {
+			queues[w].Items.push_back( i );
+		}
+	}
+
+	// Refills the queue of thief from the fullest other queue; false when
+	// every queue is empty, which is final since items are never added
+	auto steal = [&queues, threads, stats](unsigned int thief) -> bool {
+		for( ;; ) {
+			unsigned int victim = thief;
+			std::size_t most = 0;
+			for( unsigned int w = 0; w < threads; ++w ) {
+				std::lock_guard<std::mutex> lock( queues[w].Mutex );
+				if( w != thief && queues[w].Items.size() > most ) {
+					most = queues[w].Items.size();
+					victim = w;
+				}
+			}
+			if( most == 0 ) {
+				return false;
+			}
+			std::vector<std::size_t> loot;
+			{
+				std::lock_guard<std::mutex> lock( queues[victim].Mutex );
+				std::deque<std::size_t> &items = queues[victim].Items;
+				const std::size_t take = (items.size() + 1) / 2;
+				loot.assign( items.end() - take, items.end() );
+				items.erase( items.end() - take, items.end() );
+			}
+			if( loot.empty() ) {
+				// Emptied by its owner in the meantime
+				continue;
+			}
+			std::lock_guard<std::mutex> lock( queues[thief].Mutex );
+			queues[thief].Items.insert( queues[thief].Items.end(), loot.begin(), loot.end() );
+			if( stats ) {
+				stats->Stolen[thief] += loot.size();
+			}
+			return true;
+		}
+	};
+
+	auto work = [&queues, &body, &steal, stats](unsigned int w) {
+		for( ;; ) {
+			std::size_t item;
+			{
+				std::lock_guard<std::mutex> lock( queues[w].Mutex );
+				if( !queues[w].Items.empty() ) {
+					item = queues[w].Items.front();
+					queues[w].Items.pop_front();
+				}
+				else {
+					item = static_cast<std::size_t>( -1 );
+				}
+			}
+			if( item == static_cast<std::size_t>( -1 ) ) {
+				if( !steal( w ) ) {
+					return;
+				}
+				continue;
+			}
+			body( item, w );
+			if( stats ) {
+				++stats->Items[w];
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve( threads - 1 );
+	for( unsigned int w = 1; w < threads; ++w ) {
+		workers.push_back( std::thread( work, w ) );
+	}
+	work( 0 );
+	for( std::size_t w = 0; w < workers.size(); ++w ) {
+		workers[w].join();
+	}
+}
+
+} // end namespace medimg
+
+#endif
@@ -0,0 +1,163 @@
+//
+//  Assemble the 2D segmentations of the slice-by-slice notebooks into a 3D
+//  label map (the C++ replacement for build3Dlabelmap.py)
+//
+//  INPUT:
+//    - DICOM series directory, or a series header: the cache written by an
+//      earlier run, or any .mha/.mhd image of the series
+//    - directory of the .npy slices, with trailing slash; the first number
+//      in a file name is its slice number
+//    - output label map (e.g. labelmap.mha, written compressed; a .rle name
+//      writes runs)
+//    - optionally, the index of the series in the DICOM directory (default
+//      1, as in build3Dlabelmap.py)
+//    - optionally, the number of threads (default all cores)
+//
+//  Only the geometry of the series is needed. It is read from the DICOM
+//  headers once and cached as seriesHeader.txt in the slice directory;
+//  later runs for the same series read the cache instead. The slices are
+//  memory mapped and scattered into the int16 volume in parallel.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "itkImage.h"
+#include "itkGDCMImageIO.h"
+#include "itkGDCMSeriesFileNames.h"
+#include "itkImageSeriesReader.h"
+#include "compactImageIO.h"
+#include "seriesHeader.h"
+#include "sliceStack.h"
+
+
+typedef itk::Image< short, 3 > LabelImageType;
+
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+// Geometry of series number seriesIndex in directory, from the DICOM
+// headers only
+static bool ReadSeriesGeometry(const std::string &directory, unsigned int seriesIndex,
+	medimg::Geometry &geometry)
+{
+	typedef itk::GDCMSeriesFileNames NamesGeneratorType;
+	typedef itk::ImageSeriesReader< LabelImageType > ReaderType;
+
+	NamesGeneratorType::Pointer names = NamesGeneratorType::New();
+	names->SetDirectory( directory );
+	const std::vector< std::string > &seriesUIDs = names->GetSeriesUIDs();
+	if( seriesIndex >= seriesUIDs.size() ) {
+		std::cerr << "No DICOM series " << seriesIndex << " in " << directory << std::endl;
+		return false;
+	}
+
+	itk::GDCMImageIO::Pointer gdcmIO = itk::GDCMImageIO::New();
+	ReaderType::Pointer reader = ReaderType::New();
+	reader->SetImageIO( gdcmIO );
+	reader->SetFileNames( names->GetFileNames( seriesUIDs[seriesIndex] ) );
+	try {
+		reader->UpdateOutputInformation();
+	} catch (itk::ExceptionObject &excp) {
+		std::cerr << "Exception thrown while reading the series" << std::endl;
+		std::cerr << excp << std::endl;
+		return false;
+	}
+
+	const LabelImageType *series = reader->GetOutput();
+	const LabelImageType::SizeType size = series->GetLargestPossibleRegion().GetSize();
+	geometry.dims = medimg::Dims( size[0], size[1], size[2] );
+	for( int a = 0; a < 3; ++a ) {
+		geometry.Spacing[a] = series->GetSpacing()[a];
+		geometry.Origin[a] = series->GetOrigin()[a];
+		for( int b = 0; b < 3; ++b ) {
+			geometry.Direction[3 * a + b] = series->GetDirection()[a][b];
+		}
+	}
+	return true;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if (argc < 4) {
+		std::cerr << "Usage:" << std::endl;
+		std::cerr << argv[0];
+		std::cerr << " <DicomDirOrSeriesHeader> <SliceDir> <OutputLabelMap> [seriesIndex] [threads]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string series = argv[1];
+	const std::string sliceDirectory = argv[2];
+	const std::string outputLabelMap = argv[3];
+	// The series build3Dlabelmap.py assembled onto
+	const unsigned int seriesIndex = argc > 4 ? static_cast<unsigned int>( std::max( 0, atoi( argv[4] ) ) ) : 1;
+	const unsigned int threads = argc > 5 ? static_cast<unsigned int>( std::max( 0, atoi( argv[5] ) ) ) : 0;
+
+	////////////////////////////////////////////////
+	// 1) Geometry of the series, from the cache if possible
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	medimg::Geometry geometry;
+	std::string source, error;
+	struct stat info;
+	if( stat( series.c_str(), &info ) == 0 && S_ISDIR( info.st_mode ) ) {
+		const std::string cache = sliceDirectory + "seriesHeader.txt";
+		const std::string wanted = series + " " + std::to_string( seriesIndex );
+		if( medimg::ReadSeriesHeader( cache, geometry, source, error ) && source == wanted ) {
+			std::cout << "Series geometry from " << cache << std::endl;
+		}
+		else {
+			if( !ReadSeriesGeometry( series, seriesIndex, geometry ) ) {
+				return EXIT_FAILURE;
+			}
+			if( !medimg::WriteSeriesHeader( cache, geometry, wanted, error ) ) {
+				std::cerr << "Warning: " << error << std::endl;
+			}
+			std::cout << "Series geometry from the DICOM headers, cached in " << cache << std::endl;
+		}
+	}
+	else if( !medimg::ReadSeriesHeader( series, geometry, source, error ) ) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	const medimg::Dims &dims = geometry.dims;
+	std::cout << dims.nx << " x " << dims.ny << " x " << dims.nz << " in "
+		<< Seconds( start ) << " s" << std::endl;
+
+	////////////////////////////////////////////////
+	// 2) Scatter the slices into the label map
+
+	start = std::chrono::steady_clock::now();
+	std::vector< std::string > slices;
+	if( !medimg::FindNumberedSlices( sliceDirectory, ".npy", dims.nz, slices, error ) ) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	LabelImageType::Pointer labelMap = medimg::AllocateImage< LabelImageType >( geometry );
+	if( !medimg::ScatterNpySlices( slices, dims, labelMap->GetBufferPointer(), error, threads ) ) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::size_t found = dims.nz - std::count( slices.begin(), slices.end(), std::string() );
+	std::cout << found << " segmented slices assembled in " << Seconds( start ) << " s" << std::endl;
+
+	////////////////////////////////////////////////
+	// 3) Write the label map
+
+	start = std::chrono::steady_clock::now();
+	try {
+		medimg::WriteImageFile( labelMap.GetPointer(), outputLabelMap, true );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Written to " << outputLabelMap << " in " << Seconds( start ) << " s" << std::endl;
+	return EXIT_SUCCESS;
+}
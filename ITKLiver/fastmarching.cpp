@@ -4,101 +4,182 @@
 //  INPUT: 
 //    - read/write directory with trailing slash
 //    - region-of-interest as single image file
-//    - output file name
+//    - output file name (a .bits name writes a bit-packed mask)
 //    - (x,y,z) seed coordinates
 //    - sigma, sigmoid K1, K2 for gradient and sigmoid mapping
 //    - stopping time, binary threshold for fast marching
+//    - optionally, a memory budget in MB
 //  
 //  Code copied from ITK examples
 //  Created on 3 February 2016
+//
+//  The pipeline is instantiated for the pixel type stored in the input
+//  file; smoothing onwards runs in float.
+//
+//  The memory of every stage is predicted before the pipeline runs and
+//  printed at the end next to the measured peak (memoryPlan.h). With a
+//  budget each intermediate is released as soon as the next filter has
+//  read it and the sigmoid runs in place. If the whole-volume speed image
+//  still exceeds the budget it is computed in z-slabs (speedImage.h), and
+//  the run is refused only when even that does not fit.
+//
+//  With MEDIMG_PROFILE or MEDIMG_TRACE set, the time and memory of every
+//  stage are reported (Common/stageProfiler.h).
 //  
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include "itkImage.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
-#include "itkCurvatureAnisotropicDiffusionImageFilter.h"
-#include "itkGradientMagnitudeRecursiveGaussianImageFilter.h"
-#include "itkSigmoidImageFilter.h"
 #include "itkFastMarchingImageFilter.h"
 #include "itkBinaryThresholdImageFilter.h"
+#include "compactImageIO.h"
+#include "memoryPlan.h"
+#include "pipelineProfiler.h"
+#include "pixelTypeDispatch.h"
+#include "speedImage.h"
 
 
-int main(int argc, const char *argv[])
+// Bytes per voxel of the fast marching filter: its output and the label
+// image; the output stays
+const double FastMarchingBytesPerVoxel = sizeof(float) + 1.0;
+
+
+// Pipeline for one input pixel type; argc and argv as passed to main
+struct FastMarchingSegmentation
+{
+	int argc;
+	const char **argv;
+
+	template< class TInputPixel >
+	int Run() const;
+};
+
+
+template< class TInputPixel >
+int FastMarchingSegmentation::Run() const
 {
-	// Validate input parameters
-	if (argc < 12) {
-		std::cerr << "Usage:" << std::endl;
-		std::cerr << argv[0];
-		std::cerr << " <Read/WriteDir> <InputImg> <OutputImg> ";
-		std::cerr << "[seedX] [seedY] [seedZ] ";
-		std::cerr << "[sigma] [sigmoid K1] [sigmoid K2] ";
-		std::cerr << "[stopping time] [binary threshold]" << std::endl;
-		return EXIT_FAILURE;
-	}
-	
 	const unsigned int Dimension = 3;
-	typedef unsigned short InputPixelType;
+	typedef TInputPixel InputPixelType;
 	typedef float InternalPixelType;
 	typedef unsigned char OutputPixelType;
     typedef itk::Image< InputPixelType, Dimension > InputImageType;
 	typedef itk::Image< InternalPixelType, Dimension > InternalImageType;
 	typedef itk::Image< OutputPixelType, Dimension > OutputImageType;
 	
+	medimg::StageProfiler profiler( "fastmarching" );
+	medimg::UseITKThreads( profiler );
+	
+	// Peak resident memory before the pipeline, to report its growth
+	const std::size_t baseline = profiler.PeakResident();
+	const double budget = medimg::BudgetBytes( argc > 12 ? argv[12] : 0 );
+	
 	////////////////////////////////////////////////
     // 1) Read the input image
 
+	// ITK formats are read once the memory plan is made; the formats of
+	// compactImageIO.h have no header-only read and are read now
 	typedef itk::ImageFileReader< InputImageType > ReaderType;
-	ReaderType::Pointer reader = ReaderType::New();
+	typename ReaderType::Pointer reader = ReaderType::New();
+	typename InputImageType::Pointer input;
 	std::string readpath(argv[1]);
 	readpath.append(argv[2]);
-	reader->SetFileName( readpath );
+	try {
+		if( medimg::IsNativeImageName( readpath ) ) {
+			medimg::ScopedStage stage( profiler, "read" );
+			input = medimg::ReadImageFile< InputImageType >( readpath );
+		}
+		else {
+			medimg::ProfileFilter( profiler, reader, "read" );
+			reader->SetFileName( readpath );
+			reader->UpdateOutputInformation();
+			input = reader->GetOutput();
+		}
+	}
+	catch( itk::ExceptionObject & excep ) {
+		std::cerr << "Exception caught!" << std::endl;
+		std::cerr << excep << std::endl;
+		return EXIT_FAILURE;
+	}
 	
     ////////////////////////////////////////////////
-    // 2) Curvature anisotropic diffusion
+    // 2) Speed image: curvature anisotropic diffusion, gradient magnitude
+    //    recursive Gaussian and sigmoid mapping (speedImage.h)
 	
-	typedef itk::CurvatureAnisotropicDiffusionImageFilter< 
-		InputImageType, InternalImageType > SmoothingFilterType;
-	SmoothingFilterType::Pointer smoothing = SmoothingFilterType::New();
-	smoothing->SetInput( reader->GetOutput() );
-	smoothing->SetTimeStep(0.04);
-	smoothing->SetNumberOfIterations(5);
-	smoothing->SetConductanceParameter(9.0);
+	const double sigma = atof(argv[7]);
+	const double K1 = atof(argv[8]);
+	const double K2 = atof(argv[9]);
+	medimg::SpeedImageFilters< InputImageType, InternalImageType > speed( sigma, K1, K2 );
+	speed.Profile( profiler );
+	speed.SetInput( input );
 	
     ////////////////////////////////////////////////
-    // 3) Gradient magnitude recursive Gaussian
+    // 3) Memory plan, from the image header
 	
-	const double sigma = atof(argv[7]);
-	typedef itk::GradientMagnitudeRecursiveGaussianImageFilter< 
-		InternalImageType, InternalImageType > GradientFilterType;
-	GradientFilterType::Pointer gradMagnitude = GradientFilterType::New();
-	gradMagnitude->SetInput( smoothing->GetOutput() );
-	gradMagnitude->SetSigma( sigma );
+	const typename InputImageType::SizeType size = 
+		input->GetLargestPossibleRegion().GetSize();
+	const double N = static_cast<double>( size[0] ) * size[1] * size[2];
+	const double S = sizeof(InputPixelType);
+	const double F = sizeof(InternalPixelType);
+	const bool release = budget > 0.0;
+	medimg::MemoryPlan plan;
+	plan.Add( "read", N * S, N * S );
+	plan.Add( "diffusion", N * medimg::DiffusionBytesPerVoxel, N * F, release ? N * S : 0.0 );
+	plan.Add( "gradient magnitude", N * medimg::GradientBytesPerVoxel, N * F, release ? N * F : 0.0 );
+	plan.Add( "sigmoid", release ? 0.0 : N * medimg::SigmoidBytesPerVoxel, release ? 0.0 : N * F );
+	plan.Add( "fast marching", N * FastMarchingBytesPerVoxel, N * F, release ? N * F : 0.0 );
+	plan.Add( "threshold", N, N, release ? N * F : 0.0 );
 	
-    ////////////////////////////////////////////////
-    // 4) Sigmoid mapping
+	// Over budget, the speed image is computed in slabs into one image while
+	// the input is held: the input, the speed image and one slab with its
+	// diffusion output and gradient intermediates must fit
+	unsigned int slabPlanes = 0;
+	if( release && plan.Peak() > budget ) {
+		const unsigned int halo = speed.Halo( input.GetPointer() );
+		const double slabBytesPerVoxel = S + F + medimg::GradientBytesPerVoxel;
+		slabPlanes = SlabPlanes( input.GetPointer(), halo, slabBytesPerVoxel,
+			budget - N * ( S + F ) );
+		const double slabPlanesPadded = std::min< double >( slabPlanes + 2.0 * halo, size[2] );
+		medimg::MemoryPlan streamed;
+		streamed.Add( "read", N * S, N * S );
+		streamed.Add( "speed image in slabs", 
+			N * F + slabPlanesPadded * size[0] * size[1] * slabBytesPerVoxel, N * F, N * S );
+		streamed.Add( "fast marching", N * FastMarchingBytesPerVoxel, N * F, N * F );
+		streamed.Add( "threshold", N, N, N * F );
+		plan = streamed;
+		if( slabPlanes == 0 || plan.Peak() > budget ) {
+			plan.Report( std::cout, -1.0 );
+			std::cerr << "Predicted peak of " << plan.Peak() / ( 1024.0 * 1024.0 )
+				<< " MB exceeds the budget of " << budget / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	if( release ) {
+		input->ReleaseDataFlagOn();
+		speed.ReleaseIntermediates();
+		speed.sigmoid->ReleaseDataFlagOn();
+	}
 	
-	const double K1 = atof(argv[8]);
-	const double K2 = atof(argv[9]);
-	typedef itk::SigmoidImageFilter< InternalImageType, InternalImageType > 
-		SigmoidFilterType;
-	SigmoidFilterType::Pointer sigmoid = SigmoidFilterType::New();
-	sigmoid->SetInput( gradMagnitude->GetOutput() );
-	sigmoid->SetOutputMinimum(0.0);
-	sigmoid->SetOutputMaximum(1.0);
-	sigmoid->SetAlpha( (K2 - K1)/6 );
-	sigmoid->SetBeta( (K1 + K2)/2 );
+	try {
+		input->Update();
+	}
+	catch( itk::ExceptionObject & excep ) {
+		std::cerr << "Exception caught!" << std::endl;
+		std::cerr << excep << std::endl;
+		return EXIT_FAILURE;
+	}
 	
     ////////////////////////////////////////////////
-    // 5) Fast Marching
+    // 4) Fast Marching
 	
 	typedef itk::FastMarchingImageFilter< InternalImageType, InternalImageType > 
 		FastMarchingFilterType;
-	typedef FastMarchingFilterType::NodeContainer NodeContainer;
-	typedef FastMarchingFilterType::NodeType NodeType;
+	typedef typename FastMarchingFilterType::NodeContainer NodeContainer;
+	typedef typename FastMarchingFilterType::NodeType NodeType;
 	
-	InternalImageType::IndexType seedPosition;
+	typename InternalImageType::IndexType seedPosition;
 	seedPosition[0] = atoi( argv[4] );
 	seedPosition[1] = atoi( argv[5] );
 	seedPosition[2] = atoi( argv[6] );
@@ -106,42 +187,61 @@ int main(int argc, const char *argv[])
 	const double seedVal = 0.0;
 	node.SetValue( seedVal );
 	node.SetIndex( seedPosition );
-	NodeContainer::Pointer seeds = NodeContainer::New();
+	typename NodeContainer::Pointer seeds = NodeContainer::New();
 	seeds->Initialize();
 	seeds->InsertElement(0, node);
 	
 	const double stoppingTime = atof( argv[10] );
-	FastMarchingFilterType::Pointer fastMarching = FastMarchingFilterType::New();
-	fastMarching->SetInput( sigmoid->GetOutput() );
+	typename FastMarchingFilterType::Pointer fastMarching = FastMarchingFilterType::New();
+	fastMarching->SetInput( speed.GetOutput() );
 	fastMarching->SetTrialPoints( seeds );
-	fastMarching->SetOutputSize( 
-		reader->GetOutput()->GetBufferedRegion().GetSize() );
+	fastMarching->SetOutputSize( size );
 	fastMarching->SetStoppingValue( stoppingTime );
+	fastMarching->SetReleaseDataFlag( release );
+	medimg::ProfileFilter( profiler, fastMarching, "fast marching" );
+	
+	if( slabPlanes > 0 ) {
+		// Once the speed image is complete the input is no longer needed
+		typename InternalImageType::Pointer slabSpeed;
+		try {
+			medimg::ScopedStage stage( profiler, "speed image in slabs" );
+			slabSpeed = medimg::SpeedImageInSlabs< InputImageType, InternalImageType >(
+				input.GetPointer(), sigma, K1, K2, slabPlanes );
+		}
+		catch( itk::ExceptionObject & excep ) {
+			std::cerr << "Exception caught!" << std::endl;
+			std::cerr << excep << std::endl;
+			return EXIT_FAILURE;
+		}
+		input->ReleaseData();
+		slabSpeed->ReleaseDataFlagOn();
+		fastMarching->SetInput( slabSpeed );
+	}
 	
     ////////////////////////////////////////////////
-    // 6) Binary Thresholding
+    // 5) Binary Thresholding
 	
 	const InternalPixelType timeThreshold = atof( argv[11] );
 	typedef itk::BinaryThresholdImageFilter< InternalImageType, OutputImageType > 
 		ThresholdingFilterType;
-	ThresholdingFilterType::Pointer thresholder = ThresholdingFilterType::New();
+	typename ThresholdingFilterType::Pointer thresholder = ThresholdingFilterType::New();
 	thresholder->SetInput( fastMarching->GetOutput() );
 	thresholder->SetLowerThreshold( 0.0 );
 	thresholder->SetUpperThreshold( timeThreshold );
 	thresholder->SetOutsideValue( 0 );
 	thresholder->SetInsideValue( 255 );
+	medimg::ProfileFilter( profiler, thresholder, "threshold" );
 	
     ////////////////////////////////////////////////
-    // 7) Write output image
+    // 6) Write output image
 	
-	typedef itk::ImageFileWriter< OutputImageType > WriterType;
-	WriterType::Pointer writer = WriterType::New();
+	// .bits writes a bit-packed mask, see compactImageIO.h
 	std::string writepath(argv[1]);
 	writepath.append(argv[3]);
-	writer->SetFileName( writepath );
-	writer->SetInput( thresholder->GetOutput() );
 	try {
-		writer->Update();
+		thresholder->Update();
+		medimg::ScopedStage stage( profiler, "write" );
+		medimg::WriteImageFile( thresholder->GetOutput(), writepath );
 	}
 	catch( itk::ExceptionObject & excep ) {
 		std::cerr << "Exception caught!" << std::endl;
@@ -155,11 +255,36 @@ int main(int argc, const char *argv[])
 	//
 	/*
 	typedef itk::ImageFileWriter< InternalImageType > InternalWriterType;
-	InternalWriterType::Pointer speedWriter = InternalWriterType::New();
-	speedWriter->SetInput( sigmoid->GetOutput() );
+	typename InternalWriterType::Pointer speedWriter = InternalWriterType::New();
+	speedWriter->SetInput( speed.GetOutput() );
 	std::string sigmoidpath(argv[1]);
 	speedWriter->SetFileName( sigmoidpath.append("SigmoidOutput.mha") );
 	speedWriter->Update();
 	*/
+	plan.Report( std::cout, static_cast<double>( profiler.PeakResident() - baseline ) );
+	
 	return 0;
 }
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if (argc < 12) {
+		std::cerr << "Usage:" << std::endl;
+		std::cerr << argv[0];
+		std::cerr << " <Read/WriteDir> <InputImg> <OutputImg> ";
+		std::cerr << "[seedX] [seedY] [seedZ] ";
+		std::cerr << "[sigma] [sigmoid K1] [sigmoid K2] ";
+		std::cerr << "[stopping time] [binary threshold] ";
+		std::cerr << "[memoryBudgetMB]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	FastMarchingSegmentation segmentation;
+	segmentation.argc = argc;
+	segmentation.argv = argv;
+	std::string readpath(argv[1]);
+	readpath.append(argv[2]);
+	return medimg::DispatchOnPixelType( readpath.c_str(), segmentation );
+}
@@ -6,168 +6,408 @@
 //  INPUT:
 //    - read/write directory with trailing slash
 //    - region-of-interest as single image file
-//    - output file name
+//    - output file name (a .bits name writes a bit-packed mask)
 //    - (x,y,z) seed coordinates
 //    - sigma, sigmoid K1, K2 for gradient and sigmoid mapping
 //    - propagation, curvature, advection scaling, # iterations for geodesic 
 //      active contour
+//    - optionally, a memory budget in MB (0 for none)
+//    - optionally, a checkpoint file and the seconds between checkpoints
+//      (default 60)
+//    - optionally, the file name of the speed image (default
+//      SigmoidForGeodesic.mha)
 //  
 //  Created on 2 February 2016
+//
+//  The pipeline is instantiated for the pixel type stored in the input
+//  file; smoothing onwards runs in float.
+//
+//  The initial level set is the exact signed distance to a ball of radius
+//  initDist around the seed (Common/distanceTransform.h), which replaces
+//  the fast marching pass that used to compute it.
+//
+//  The memory of every stage is predicted before the pipeline runs and
+//  printed at the end next to the measured peak (memoryPlan.h). With a
+//  budget each intermediate is released as soon as the next filter has
+//  read it, the sigmoid runs in place and the speed image is written
+//  before the level set rather than kept to the end. The run is refused
+//  when the predicted peak still exceeds the budget: the level set filter
+//  needs the whole volume at once, so streaming the speed image in slabs
+//  would not lower it.
+//
+//  With a checkpoint file the narrow band of the level set, the iterations
+//  done and their RMS changes are saved every so often during the evolution
+//  (Common/levelSetCheckpoint.h), replacing the previous checkpoint. If the
+//  file exists when the tool starts and was made from the same speed image,
+//  the evolution resumes from it for the remaining iterations, so a
+//  preempted run only repeats the work since its last checkpoint. The file
+//  is removed once the output is written.
+//
+//  The speed image is saved as SigmoidForGeodesic.mha in the read/write
+//  directory. A .zvol name instead writes it compressed in chunks on all
+//  cores (Common/chunkedVolume.h), which the other tools read as well.
+//
+//  With MEDIMG_PROFILE or MEDIMG_TRACE set, the time and memory of every
+//  stage are reported (Common/stageProfiler.h).
 //  
 
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "itkImage.h"
 #include "itkImageFileReader.h"
-#include "itkImageFileWriter.h"
-#include "itkCurvatureAnisotropicDiffusionImageFilter.h"
-#include "itkGradientMagnitudeRecursiveGaussianImageFilter.h"
-#include "itkSigmoidImageFilter.h"
-#include "itkFastMarchingImageFilter.h"
 #include "itkGeodesicActiveContourLevelSetImageFilter.h"
 #include "itkBinaryThresholdImageFilter.h"
+#include "itkCommand.h"
+#include "compactImageIO.h"
+#include "distanceTransform.h"
+#include "levelSetCheckpoint.h"
+#include "memoryPlan.h"
+#include "pipelineProfiler.h"
+#include "pixelTypeDispatch.h"
+#include "speedImage.h"
 
 
-int main(int argc, const char *argv[])
+// Bytes per voxel of the level set filter while it runs: its output, the
+// copy of the feature image as speed, the advection field (3 floats) and
+// the gradient it is computed from, and the status image of the sparse
+// field; all but the gradient stay until the filter is destroyed
+const double LevelSetBytesPerVoxel = 9.0 * sizeof(float) + 1.0;
+const double LevelSetKeptBytesPerVoxel = 5.0 * sizeof(float) + 1.0;
+
+
+// Writes the speed image; a .zvol name writes a chunked volume, compressed
+// on all cores with the codec set in MEDIMG_CODEC (Common/chunkedVolume.h)
+template< class TSpeed >
+void WriteSpeedImage(TSpeed &speed, const std::string &filename, medimg::StageProfiler &profiler)
 {
-	// Validate input parameters
-	if (argc < 15) {
-		std::cerr << "Missing parameters! Usage:" << std::endl;
-		std::cerr << argv[0];
-		std::cerr << " <Read/WriteDir> <InputImg> <OutputImg> ";
-		std::cerr << "[seedX] [seedY] [seedZ] [initDist] ";
-		std::cerr << "[sigma] [sigmoid K1] [sigmoid K2] ";
-		std::cerr << "[propagation] [curvature] [advection] [iterations]";
-		std::cerr << std::endl;
-		return EXIT_FAILURE;
+	speed.sigmoid->Update();
+	medimg::ScopedStage stage( profiler, "write speed image" );
+	medimg::WriteImageFile( speed.GetOutput(), filename );
+}
+
+
+// Records the RMS change of every iteration of a level set filter and
+// writes a checkpoint once interval seconds have passed since the last
+template< class TFilter >
+class CheckpointCommand : public itk::Command
+{
+public:
+	typedef CheckpointCommand Self;
+	typedef itk::Command Superclass;
+	typedef itk::SmartPointer< Self > Pointer;
+	itkNewMacro( Self );
+
+	// checkpoint holds the speed hash, iterations done before this run and
+	// their RMS changes
+	void SetCheckpoint(const std::string &filename, double interval, const medimg::Dims &dims,
+		const medimg::LevelSetCheckpoint &checkpoint)
+	{
+		m_Filename = filename;
+		m_Interval = interval;
+		m_Dims = dims;
+		m_Checkpoint = checkpoint;
+		m_Resumed = checkpoint.Iterations;
+		m_Last = Clock::now();
 	}
-	
+
+	unsigned int Written() const { return m_Written; }
+	const std::vector<double> &RMSHistory() const { return m_Checkpoint.RMSHistory; }
+
+	void Execute(itk::Object *caller, const itk::EventObject &event)
+	{
+		Execute( const_cast< const itk::Object * >( caller ), event );
+	}
+
+	void Execute(const itk::Object *caller, const itk::EventObject &event)
+	{
+		if( !itk::IterationEvent().CheckEvent( &event ) ) {
+			return;
+		}
+		const TFilter *filter = static_cast< const TFilter * >( caller );
+		m_Checkpoint.RMSHistory.push_back( filter->GetRMSChange() );
+		if( std::chrono::duration<double>( Clock::now() - m_Last ).count() < m_Interval ) {
+			return;
+		}
+
+		// Beyond the outermost layer the filter holds constant values, in
+		// units of the smallest spacing; the checkpoint finds them itself
+		m_Checkpoint.Iterations = m_Resumed + filter->GetElapsedIterations();
+		m_Checkpoint.Capture( filter->GetOutput()->GetBufferPointer(), m_Dims );
+		std::string error;
+		if( m_Checkpoint.Write( m_Filename, error ) ) {
+			++m_Written;
+		}
+		else {
+			// The evolution goes on; only its resumability is lost
+			std::cerr << error << std::endl;
+		}
+		m_Last = Clock::now();
+	}
+
+protected:
+	CheckpointCommand() : m_Interval( 0.0 ), m_Resumed( 0 ), m_Written( 0 ) {}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::string m_Filename;
+	double m_Interval;
+	medimg::Dims m_Dims;
+	medimg::LevelSetCheckpoint m_Checkpoint;
+	unsigned int m_Resumed, m_Written;
+	Clock::time_point m_Last;
+};
+
+
+// Pipeline for one input pixel type; argc and argv as passed to main
+struct GeodesicActiveContourSegmentation
+{
+	int argc;
+	const char **argv;
+
+	template< class TInputPixel >
+	int Run() const;
+};
+
+
+template< class TInputPixel >
+int GeodesicActiveContourSegmentation::Run() const
+{
 	const unsigned int Dimension = 3;
-	typedef float InputPixelType;
+	typedef TInputPixel InputPixelType;
+	typedef float InternalPixelType;
 	typedef unsigned char OutputPixelType;
     typedef itk::Image< InputPixelType, Dimension > InputImageType;
+	typedef itk::Image< InternalPixelType, Dimension > InternalImageType;
 	typedef itk::Image< OutputPixelType, Dimension > OutputImageType;
 
-    ////////////////////////////////////////////////
-    // 1) Read the input image
+	medimg::StageProfiler profiler( "geodesic_active_contour" );
+	medimg::UseITKThreads( profiler );
 
+	// Peak resident memory before the pipeline, to report its growth
+	const std::size_t baseline = profiler.PeakResident();
+	const double budget = medimg::BudgetBytes( argc > 15 ? argv[15] : 0 );
+
+    ////////////////////////////////////////////////
+    // 1) Memory plan, from the image header
+	
+	// ITK formats are read once the plan is made; the formats of
+	// compactImageIO.h have no header-only read and are read now
 	typedef itk::ImageFileReader< InputImageType >  ReaderType;
-	ReaderType::Pointer reader = ReaderType::New();
+	typename ReaderType::Pointer reader = ReaderType::New();
+	typename InputImageType::Pointer input;
 	std::string readpath( argv[1] );
 	readpath.append( argv[2] );
-	reader->SetFileName( readpath );
-	reader->Update();
+	try {
+		if( medimg::IsNativeImageName( readpath ) ) {
+			medimg::ScopedStage stage( profiler, "read" );
+			input = medimg::ReadImageFile< InputImageType >( readpath );
+		}
+		else {
+			medimg::ProfileFilter( profiler, reader, "read" );
+			reader->SetFileName( readpath );
+			reader->UpdateOutputInformation();
+			input = reader->GetOutput();
+		}
+	}
+	catch( itk::ExceptionObject &excep ) {
+		std::cerr << "Exception caught!" << std::endl;
+		std::cerr << excep << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	// Under a budget every intermediate is released once read, the sigmoid
+	// runs in place and the speed image is written before the level set
+	// instead of being kept for the end
+	const double N = input->GetLargestPossibleRegion().GetNumberOfPixels();
+	const double F = sizeof(InternalPixelType);
+	const bool release = budget > 0.0;
+	medimg::MemoryPlan plan;
+	plan.Add( "read", N * sizeof(InputPixelType), N * sizeof(InputPixelType) );
+	plan.Add( "diffusion", N * medimg::DiffusionBytesPerVoxel, N * F,
+		release ? N * sizeof(InputPixelType) : 0.0 );
+	plan.Add( "gradient magnitude", N * medimg::GradientBytesPerVoxel, N * F, release ? N * F : 0.0 );
+	plan.Add( "sigmoid", release ? 0.0 : N * medimg::SigmoidBytesPerVoxel, release ? 0.0 : N * F );
+	plan.Add( "initial level set", 2.0 * N * F, N * F );
+	plan.Add( "geodesic active contour", N * LevelSetBytesPerVoxel, N * LevelSetKeptBytesPerVoxel,
+		release ? 2.0 * N * F : 0.0 );
+	plan.Add( "threshold", N * sizeof(OutputPixelType), N * sizeof(OutputPixelType),
+		release ? N * F : 0.0 );
+	if( release && plan.Peak() > budget ) {
+		// The level set holds the whole volume, so slabs would not help
+		plan.Report( std::cout, -1.0 );
+		std::cerr << "Predicted peak of " << plan.Peak() / ( 1024.0 * 1024.0 )
+			<< " MB exceeds the budget of " << budget / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+		return EXIT_FAILURE;
+	}
 	
     ////////////////////////////////////////////////
-    // 2) Curvature anisotropic diffusion
+    // 2) Read the input image
 	
-	typedef itk::CurvatureAnisotropicDiffusionImageFilter< 
-		InputImageType, InputImageType > SmoothingFilterType;
-	SmoothingFilterType::Pointer smoothing = SmoothingFilterType::New();
-	smoothing->SetTimeStep(0.04);
-	smoothing->SetNumberOfIterations(5);
-	smoothing->SetConductanceParameter(9.0);
-	smoothing->SetInput( reader->GetOutput() );
+	try {
+		input->Update();
+	}
+	catch( itk::ExceptionObject &excep ) {
+		std::cerr << "Exception caught!" << std::endl;
+		std::cerr << excep << std::endl;
+		return EXIT_FAILURE;
+	}
+	const medimg::Geometry geometry = medimg::ImageGeometry( input.GetPointer() );
 	
     ////////////////////////////////////////////////
-    // 3) Gradient magnitude recursive Gaussian
+    // 3) Speed image: curvature anisotropic diffusion, gradient magnitude
+    //    recursive Gaussian and sigmoid mapping (speedImage.h)
 	
 	const double sigma = atof(argv[8]);
-	typedef itk::GradientMagnitudeRecursiveGaussianImageFilter< 
-		InputImageType, InputImageType > GradientFilterType;
-	GradientFilterType::Pointer gradientMagnitude = GradientFilterType::New();
-	gradientMagnitude->SetSigma( sigma );
-	gradientMagnitude->SetInput( smoothing->GetOutput() );
+	const double K1 = atof(argv[9]);
+	const double K2 = atof(argv[10]);
+	medimg::SpeedImageFilters< InputImageType, InternalImageType > speed( sigma, K1, K2 );
+	speed.Profile( profiler );
+	speed.SetInput( input );
+	if( release ) {
+		input->ReleaseDataFlagOn();
+		speed.ReleaseIntermediates();
+	}
+	
+	// The output of the sigmoid mapping is saved as well
+	std::string sigmoidpath( argv[1] );
+	sigmoidpath.append( argc > 18 ? argv[18] : "SigmoidForGeodesic.mha" );
+	if( release ) {
+		// Released by the level set filter once it has run
+		try {
+			WriteSpeedImage( speed, sigmoidpath, profiler );
+		}
+		catch( itk::ExceptionObject &excep ) {
+			std::cerr << "Exception caught!" << std::endl;
+			std::cerr << excep << std::endl;
+			return EXIT_FAILURE;
+		}
+		speed.sigmoid->ReleaseDataFlagOn();
+	}
+	
+	// A checkpoint is resumed only if made from the same speed image
+	std::string checkpointpath;
+	medimg::LevelSetCheckpoint checkpoint;
+	bool resume = false;
+	if( argc > 16 ) {
+		checkpointpath.assign( argv[1] ).append( argv[16] );
+		try {
+			speed.sigmoid->Update();
+		}
+		catch( itk::ExceptionObject &excep ) {
+			std::cerr << "Exception caught!" << std::endl;
+			std::cerr << excep << std::endl;
+			return EXIT_FAILURE;
+		}
+		const std::uint64_t speedHash = medimg::HashVoxels( speed.GetOutput()->GetBufferPointer(),
+			geometry.dims.Voxels() );
+		std::FILE *existing = std::fopen( checkpointpath.c_str(), "rb" );
+		if( existing ) {
+			std::fclose( existing );
+			std::string error;
+			if( !checkpoint.Read( checkpointpath, error ) ) {
+				std::cerr << error << std::endl;
+				return EXIT_FAILURE;
+			}
+			const medimg::Dims &dims = checkpoint.GetDims();
+			resume = checkpoint.SpeedHash == speedHash && dims.nx == geometry.dims.nx
+				&& dims.ny == geometry.dims.ny && dims.nz == geometry.dims.nz;
+			if( !resume ) {
+				std::cout << checkpointpath << " was made from another speed image, starting afresh" << std::endl;
+				checkpoint = medimg::LevelSetCheckpoint();
+			}
+		}
+		checkpoint.SpeedHash = speedHash;
+	}
 	
     ////////////////////////////////////////////////
-    // 4) Sigmoid mapping
+    // 4) Initial level set: signed distance from the seed, or the level set
+    //    of the checkpoint
 	
-	const double K1 = atof(argv[9]);
-	const double K2 = atof(argv[10]);
-	typedef itk::SigmoidImageFilter< InputImageType, InputImageType > 
-		SigmoidFilterType;
-	SigmoidFilterType::Pointer sigmoid = SigmoidFilterType::New();
-	sigmoid->SetOutputMinimum(0.0);
-	sigmoid->SetOutputMaximum(1.0);
-	sigmoid->SetAlpha( (K2 - K1)/6 );
-	sigmoid->SetBeta( (K1 + K2)/2 );
-	sigmoid->SetInput( gradientMagnitude->GetOutput() );
+	profiler.Begin( "initial level set" );
+	typename InternalImageType::Pointer initialLevelSet = 
+		medimg::AllocateImage< InternalImageType >( geometry );
+	if( resume ) {
+		checkpoint.Restore( initialLevelSet->GetBufferPointer() );
+		std::cout << "Resuming from iteration " << checkpoint.Iterations << " of " << checkpointpath << std::endl;
+	}
+	else {
+		medimg::DistanceSeed seed;
+		seed.x = atoi( argv[4] );
+		seed.y = atoi( argv[5] );
+		seed.z = atoi( argv[6] );
+		seed.Radius = atof( argv[7] );
+		std::string error;
+		if( !medimg::SignedDistanceFromSeeds( std::vector< medimg::DistanceSeed >( 1, seed ), geometry.dims,
+			geometry.Spacing, initialLevelSet->GetBufferPointer(), error ) ) {
+			std::cerr << error << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	initialLevelSet->SetReleaseDataFlag( release );
+	profiler.End();
 	
     ////////////////////////////////////////////////
     // 5) Segmentation with geodesic active contour
 	
-	typedef itk::FastMarchingImageFilter< InputImageType, InputImageType > 
-		FastMarchingFilterType;
-	FastMarchingFilterType::Pointer fastMarching = FastMarchingFilterType::New();
-	
 	typedef itk::GeodesicActiveContourLevelSetImageFilter< 
-		InputImageType, InputImageType > GeodesicActiveContourFilterType;
-	GeodesicActiveContourFilterType::Pointer geodesicActiveContour = 
+		InternalImageType, InternalImageType > GeodesicActiveContourFilterType;
+	typename GeodesicActiveContourFilterType::Pointer geodesicActiveContour = 
 		GeodesicActiveContourFilterType::New();
 	
 	const double propagation = atof( argv[11] );
 	const double curvature = atof( argv[12] );
 	const double advection = atof( argv[13] );
-	const double iterations = atoi( argv[14] );
+	const unsigned int iterations = atoi( argv[14] );
 	geodesicActiveContour->SetPropagationScaling( propagation );
 	geodesicActiveContour->SetCurvatureScaling( curvature );
 	geodesicActiveContour->SetAdvectionScaling( advection );
 	geodesicActiveContour->SetMaximumRMSError(0.01);
-	geodesicActiveContour->SetNumberOfIterations( iterations );
+	geodesicActiveContour->SetNumberOfIterations( 
+		iterations > checkpoint.Iterations ? iterations - checkpoint.Iterations : 0 );
+	medimg::ProfileFilter( profiler, geodesicActiveContour, "geodesic active contour" );
 	
-	geodesicActiveContour->SetInput( fastMarching->GetOutput() );
-	geodesicActiveContour->SetFeatureImage( sigmoid->GetOutput() );
+	typedef CheckpointCommand< GeodesicActiveContourFilterType > CheckpointCommandType;
+	typename CheckpointCommandType::Pointer checkpointer;
+	if( argc > 16 ) {
+		checkpointer = CheckpointCommandType::New();
+		checkpointer->SetCheckpoint( checkpointpath, argc > 17 ? atof( argv[17] ) : 60.0,
+			geometry.dims, checkpoint );
+		geodesicActiveContour->AddObserver( itk::IterationEvent(), checkpointer );
+	}
+	
+	geodesicActiveContour->SetInput( initialLevelSet );
+	geodesicActiveContour->SetFeatureImage( speed.GetOutput() );
+	geodesicActiveContour->SetReleaseDataFlag( release );
+	initialLevelSet = 0;
 	
     ////////////////////////////////////////////////
     // 6) Binary thresholding
 	
-	typedef itk::BinaryThresholdImageFilter< InputImageType, OutputImageType > 
+	typedef itk::BinaryThresholdImageFilter< InternalImageType, OutputImageType > 
 		ThresholdingFilterType;
-	ThresholdingFilterType::Pointer thresholder = ThresholdingFilterType::New();
+	typename ThresholdingFilterType::Pointer thresholder = ThresholdingFilterType::New();
 	thresholder->SetLowerThreshold(-1000.0);
 	thresholder->SetUpperThreshold(0.0);
 	thresholder->SetOutsideValue(0);
 	thresholder->SetInsideValue(255);
+	medimg::ProfileFilter( profiler, thresholder, "threshold" );
 	thresholder->SetInput( geodesicActiveContour->GetOutput() );
 	
-    ////////////////////////////////////////////////
-    // 7) Finish setting up fast marching
-	
-	typedef FastMarchingFilterType::NodeContainer NodeContainer;
-	typedef FastMarchingFilterType::NodeType NodeType;
-	
-	NodeContainer::Pointer seeds = NodeContainer::New();
-	InputImageType::IndexType seedPosition;
-	seedPosition[0] = atoi( argv[4] );
-	seedPosition[1] = atoi( argv[5] );
-	seedPosition[2] = atoi( argv[6] );
-	const double initialDistance = atof( argv[7] );
-	const double seedValue = -initialDistance;
-	NodeType node;
-	node.SetValue( seedValue );
-	node.SetIndex( seedPosition );
-	seeds->Initialize();
-	seeds->InsertElement(0, node);
-	
-	fastMarching->SetTrialPoints( seeds );
-	fastMarching->SetSpeedConstant(1.0);
-	fastMarching->SetOutputSize( reader->GetOutput()->GetBufferedRegion().GetSize() );
-	fastMarching->SetOutputRegion( reader->GetOutput()->GetBufferedRegion() );
-	fastMarching->SetOutputSpacing( reader->GetOutput()->GetSpacing() );
-	fastMarching->SetOutputOrigin( reader->GetOutput()->GetOrigin() );
-	
 	////////////////////////////////////////////////
     // 7) Write output image
 	
-	typedef itk::ImageFileWriter< OutputImageType > WriterType;
-	WriterType::Pointer writer = WriterType::New();
+	// .bits writes a bit-packed mask, see compactImageIO.h
 	std::string writepath( argv[1] );
 	writepath.append( argv[3] );
-	writer->SetFileName( writepath );
-	writer->SetInput( thresholder->GetOutput() );
 	
 	try {
-		writer->Update();
+		thresholder->Update();
+		medimg::ScopedStage stage( profiler, "write" );
+		medimg::WriteImageFile( thresholder->GetOutput(), writepath );
 	}
 	catch( itk::ExceptionObject &excep ) {
 		std::cerr << "Exception caught!" << std::endl;
@@ -175,13 +415,51 @@ int main(int argc, const char *argv[])
 		return EXIT_FAILURE;
 	}
 	
-	// The following writer is used to save the output of the sigmoid mapping
-	typedef itk::ImageFileWriter< InputImageType > InternalWriterType;
-	InternalWriterType::Pointer speedWriter = InternalWriterType::New();
-	speedWriter->SetInput( sigmoid->GetOutput() );
-	std::string sigmoidpath( argv[1] );
-	speedWriter->SetFileName( sigmoidpath.append("SigmoidForGeodesic.mha"));
-	speedWriter->Update();
+	if( !release ) {
+		try {
+			WriteSpeedImage( speed, sigmoidpath, profiler );
+		}
+		catch( itk::ExceptionObject &excep ) {
+			std::cerr << "Exception caught!" << std::endl;
+			std::cerr << excep << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	if( checkpointer ) {
+		// The output is complete, the checkpoint no longer needed
+		std::remove( checkpointpath.c_str() );
+		const std::vector<double> &history = checkpointer->RMSHistory();
+		std::cout << history.size() << " iterations";
+		if( !history.empty() ) {
+			std::cout << ", last RMS change " << history.back();
+		}
+		std::cout << ", " << checkpointer->Written() << " checkpoints written" << std::endl;
+	}
+	plan.Report( std::cout, static_cast<double>( profiler.PeakResident() - baseline ) );
 	
 	return 0;
 }
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if (argc < 15) {
+		std::cerr << "Missing parameters! Usage:" << std::endl;
+		std::cerr << argv[0];
+		std::cerr << " <Read/WriteDir> <InputImg> <OutputImg> ";
+		std::cerr << "[seedX] [seedY] [seedZ] [initDist] ";
+		std::cerr << "[sigma] [sigmoid K1] [sigmoid K2] ";
+		std::cerr << "[propagation] [curvature] [advection] [iterations] ";
+		std::cerr << "[memoryBudgetMB] [checkpoint] [checkpoint seconds] [speedImg]";
+		std::cerr << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	GeodesicActiveContourSegmentation segmentation;
+	segmentation.argc = argc;
+	segmentation.argv = argv;
+	std::string readpath( argv[1] );
+	readpath.append( argv[2] );
+	return medimg::DispatchOnPixelType( readpath.c_str(), segmentation );
+}
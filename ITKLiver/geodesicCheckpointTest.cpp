@@ -0,0 +1,169 @@
+//
+//  geodesicCheckpointTest.cpp
+//  ITKLiver
+//
+//  Checks that a geodesic active contour resumed from a checkpoint
+//  (Common/levelSetCheckpoint.h) ends where an uninterrupted run does. On
+//  a synthetic speed image with anisotropic spacing, smaller than 1 mm in
+//  plane, the contour is evolved
+//
+//    - for all iterations at once, and
+//    - for part of them, captured as geodesic_active_contour does, written,
+//      read back and restored into the initial level set of a second
+//      filter that runs the remaining iterations.
+//
+//  The test fails when the restored level set differs from the captured
+//  one, when the checkpoint band covers more than half of the volume
+//  (the band must follow the filter's background value, which scales with
+//  the spacing), or when the two final masks differ at more than 0.5% of
+//  the voxels of the uninterrupted one.
+//
+//  Run by CTest, in the build directory (it writes
+//  geodesicCheckpointTest.lsc).
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "itkImage.h"
+#include "itkGeodesicActiveContourLevelSetImageFilter.h"
+#include "compactImageIO.h"
+#include "distanceTransform.h"
+#include "levelSetCheckpoint.h"
+
+
+typedef itk::Image< float, 3 > ImageType;
+typedef itk::GeodesicActiveContourLevelSetImageFilter< ImageType, ImageType >
+	GeodesicActiveContourFilterType;
+
+const unsigned int Iterations = 80;
+const unsigned int Interrupted = 30;
+
+
+// Speed close to 1 inside an ellipsoid and falling to 0 across its surface
+static ImageType::Pointer SpeedImage(const medimg::Geometry &geometry)
+{
+	ImageType::Pointer speed = medimg::AllocateImage< ImageType >( geometry );
+	const medimg::Dims &dims = geometry.dims;
+	const double semiAxes[3] = { 12.0, 9.0, 10.0 };
+	float *out = speed->GetBufferPointer();
+	for( std::size_t z = 0; z < dims.nz; ++z ) {
+		for( std::size_t y = 0; y < dims.ny; ++y ) {
+			for( std::size_t x = 0; x < dims.nx; ++x ) {
+				const std::size_t p[3] = { x, y, z };
+				double r2 = 0.0;
+				for( int a = 0; a < 3; ++a ) {
+					const double d = ( p[a] + 0.5 - 0.5 * ( a == 0 ? dims.nx : a == 1 ? dims.ny : dims.nz ) )
+						* geometry.Spacing[a] / semiAxes[a];
+					r2 += d * d;
+				}
+				// About 1 mm wide transition at the surface
+				const double distance = ( std::sqrt( r2 ) - 1.0 ) * semiAxes[0];
+				out[dims.Index( x, y, z )] = static_cast<float>( 1.0 / ( 1.0 + std::exp( 4.0 * distance ) ) );
+			}
+		}
+	}
+	return speed;
+}
+
+// Runs iterations of the contour from initial on speed
+static ImageType::Pointer Evolve(ImageType *initial, ImageType *speed, unsigned int iterations)
+{
+	GeodesicActiveContourFilterType::Pointer filter = GeodesicActiveContourFilterType::New();
+	filter->SetPropagationScaling( 2.0 );
+	filter->SetCurvatureScaling( 1.0 );
+	filter->SetAdvectionScaling( 1.0 );
+	// Every iteration runs, so that both paths do the same number
+	filter->SetMaximumRMSError( 0.0 );
+	filter->SetNumberOfIterations( iterations );
+	filter->SetInput( initial );
+	filter->SetFeatureImage( speed );
+	filter->Update();
+	ImageType::Pointer output = filter->GetOutput();
+	output->DisconnectPipeline();
+	return output;
+}
+
+
+int main()
+{
+	medimg::Geometry geometry;
+	geometry.dims = medimg::Dims( 48, 40, 24 );
+	geometry.Spacing[0] = geometry.Spacing[1] = 0.7;
+	geometry.Spacing[2] = 1.2;
+	const std::size_t voxels = geometry.dims.Voxels();
+
+	try {
+		const ImageType::Pointer speed = SpeedImage( geometry );
+		ImageType::Pointer initial = medimg::AllocateImage< ImageType >( geometry );
+		medimg::DistanceSeed seed;
+		seed.x = geometry.dims.nx / 2;
+		seed.y = geometry.dims.ny / 2;
+		seed.z = geometry.dims.nz / 2;
+		seed.Radius = 3.0;
+		std::string error;
+		if( !medimg::SignedDistanceFromSeeds( std::vector< medimg::DistanceSeed >( 1, seed ), geometry.dims,
+			geometry.Spacing, initial->GetBufferPointer(), error ) ) {
+			std::cerr << error << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		const ImageType::Pointer uninterrupted = Evolve( initial, speed, Iterations );
+
+		// Checkpoint after part of the iterations, through a file
+		const ImageType::Pointer first = Evolve( initial, speed, Interrupted );
+		medimg::LevelSetCheckpoint captured;
+		captured.Iterations = Interrupted;
+		captured.Capture( first->GetBufferPointer(), geometry.dims );
+		const std::string filename = "geodesicCheckpointTest.lsc";
+		medimg::LevelSetCheckpoint checkpoint;
+		if( !captured.Write( filename, error ) || !checkpoint.Read( filename, error ) ) {
+			std::cerr << error << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::remove( filename.c_str() );
+
+		ImageType::Pointer restored = medimg::AllocateImage< ImageType >( geometry );
+		checkpoint.Restore( restored->GetBufferPointer() );
+		std::size_t changed = 0;
+		for( std::size_t i = 0; i < voxels; ++i ) {
+			changed += restored->GetBufferPointer()[i] != first->GetBufferPointer()[i];
+		}
+		const ImageType::Pointer resumed = Evolve( restored, speed, Iterations - checkpoint.Iterations );
+
+		std::size_t inside = 0, differing = 0;
+		for( std::size_t i = 0; i < voxels; ++i ) {
+			const bool a = uninterrupted->GetBufferPointer()[i] <= 0.0f;
+			const bool b = resumed->GetBufferPointer()[i] <= 0.0f;
+			inside += a;
+			differing += a != b;
+		}
+
+		bool good = true;
+		std::cout << "Checkpoint band: " << checkpoint.BandVoxels() << " of " << voxels << " voxels" << std::endl;
+		if( checkpoint.BandVoxels() * 2 > voxels ) {
+			std::cout << "FAILED: the band does not follow the background of the level set" << std::endl;
+			good = false;
+		}
+		std::cout << "Restored level set: " << changed << " voxels differ from the captured one" << std::endl;
+		if( changed > 0 ) {
+			std::cout << "FAILED: the checkpoint does not restore the level set" << std::endl;
+			good = false;
+		}
+		std::cout << "Resumed at iteration " << Interrupted << " of " << Iterations << ": " << differing
+			<< " voxels differ from the uninterrupted mask of " << inside << std::endl;
+		if( inside == 0 || differing * 200 > inside ) {
+			std::cout << "FAILED: the resumed run does not end where the uninterrupted one does" << std::endl;
+			good = false;
+		}
+		return good ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch( itk::ExceptionObject &excep ) {
+		std::cerr << "Exception caught!" << std::endl;
+		std::cerr << excep << std::endl;
+		return EXIT_FAILURE;
+	}
+}
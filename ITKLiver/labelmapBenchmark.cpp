@@ -0,0 +1,143 @@
+//
+//  Compare the on-disk size and load time of a mask or label map stored as
+//  .mha (raw and compressed) and in the compact formats of
+//  Common/compactLabels.h: .bits for binary masks, .rle for label maps
+//
+//  INPUT:
+//    - mask or label map (e.g. the output of fastmarching, or labelmap.mha
+//      from build3Dlabelmap.py)
+//    - directory for the files written, with trailing slash
+//    - optionally, the number of loads to time (default 5; the fastest
+//      is reported)
+//
+//  The image is read with the pixel type stored in the file.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include "itkImage.h"
+#include "itkImageFileWriter.h"
+#include "compactImageIO.h"
+#include "pixelTypeDispatch.h"
+
+
+struct LabelmapBenchmark
+{
+	const char * inputImage;
+	const char * directory;
+	int loads;
+
+	template< class TPixel >
+	int Run() const;
+};
+
+
+static double FileMegabytes(const std::string &filename)
+{
+	std::ifstream file( filename.c_str(), std::ios::binary | std::ios::ate );
+	return file ? static_cast<double>( file.tellg() ) / (1024.0 * 1024.0) : 0.0;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+
+template< class TPixel >
+int LabelmapBenchmark::Run() const
+{
+	typedef itk::Image< TPixel, 3 > ImageType;
+	if( !std::numeric_limits<TPixel>::is_integer ) {
+		std::cerr << "Masks and label maps must have integer pixels" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	typename ImageType::Pointer image;
+	try {
+		image = medimg::ReadImageFile< ImageType >( inputImage );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	const medimg::Dims dims = medimg::ImageGeometry( image.GetPointer() ).dims;
+	const TPixel *buffer = image->GetBufferPointer();
+
+	// Binary when at most one nonzero value occurs
+	TPixel inside = TPixel( 0 );
+	bool binary = true;
+	for( std::size_t i = 0; i < dims.Voxels() && binary; ++i ) {
+		if( buffer[i] != TPixel( 0 ) ) {
+			binary = inside == TPixel( 0 ) || buffer[i] == inside;
+			inside = buffer[i];
+		}
+	}
+
+	const std::string base = std::string( directory ) + "labelmapBenchmark";
+	const std::string files[3] = { base + ".mha", base + "Compressed.mha",
+		base + ( binary ? ".bits" : ".rle" ) };
+	const char * names[3] = { "mha", "mha (compressed)", binary ? "bits" : "rle" };
+
+	std::cout << dims.nx << " x " << dims.ny << " x " << dims.nz << " "
+		<< ( binary ? "binary mask" : "label map" ) << ", "
+		<< sizeof(TPixel) << " byte(s) per voxel" << std::endl;
+	std::printf( "%-18s %10s %10s %10s %8s\n", "format", "size MB", "write s", "load s", "equal" );
+
+	for( int f = 0; f < 3; ++f ) {
+		double writeTime, loadTime = std::numeric_limits<double>::max();
+		bool equal = true;
+		try {
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if( f == 1 ) {
+				typedef itk::ImageFileWriter< ImageType > WriterType;
+				typename WriterType::Pointer writer = WriterType::New();
+				writer->SetInput( image );
+				writer->SetFileName( files[f] );
+				writer->SetUseCompression( true );
+				writer->Update();
+			}
+			else {
+				medimg::WriteImageFile( image.GetPointer(), files[f] );
+			}
+			writeTime = Seconds( start );
+
+			for( int l = 0; l < loads; ++l ) {
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				typename ImageType::Pointer loaded = medimg::ReadImageFile< ImageType >( files[f] );
+				loadTime = std::min( loadTime, Seconds( start ) );
+				if( l == 0 ) {
+					equal = std::equal( buffer, buffer + dims.Voxels(), loaded->GetBufferPointer() );
+				}
+			}
+		} catch (itk::ExceptionObject & error) {
+			std::cerr << "Error: " << error << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::printf( "%-18s %10.2f %10.3f %10.3f %8s\n", names[f], FileMegabytes( files[f] ),
+			writeTime, loadTime, equal ? "yes" : "NO" );
+	}
+	return EXIT_SUCCESS;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if (argc < 3) {
+		std::cerr << "Usage:" << std::endl;
+		std::cerr << argv[0];
+		std::cerr << " <MaskOrLabelMap> <WriteDir> [loads]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	LabelmapBenchmark benchmark;
+	benchmark.inputImage = argv[1];
+	benchmark.directory = argv[2];
+	benchmark.loads = argc > 3 ? std::max( 1, atoi( argv[3] ) ) : 5;
+	return medimg::DispatchOnPixelType( benchmark.inputImage, benchmark );
+}
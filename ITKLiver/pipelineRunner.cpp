@@ -0,0 +1,688 @@
+//
+//  Runs a whole segmentation flow in one process from a pipeline file
+//  (Common/pipelineGraph.h) instead of chaining extractROI, the vessel
+//  filters, fastmarching or geodesic_active_contour and the label assembly
+//  through .mha files on disk. Independent branches, e.g. the liver
+//  segmentation and the vessel filtering of the same ROI, run at the same
+//  time; intermediates stay in memory and are freed once their last reader
+//  has finished.
+//
+//  INPUT:
+//    - pipeline file
+//    - optionally, the number of stages run at once (default 0, every
+//      core); the ITK filters and native kernels in each stage are
+//      multithreaded themselves
+//    - optionally, a case list: the pipeline is run once per line, with
+//      $case replaced by the line, and the number above is the threads
+//      shared by the whole cohort
+//    - optionally, the number of cases run at once (default, as many as
+//      threads)
+//
+//  With a case list the cases run side by side within one thread budget
+//  (Common/cohortScheduler.h). Each case runs its stages one at a time on
+//  one worker; the Frangi and Sato kernels share their loops with the
+//  workers that have no case of their own, and the ITK filters get an even
+//  share of the threads. The wall time and voxels read per second of every
+//  case and the makespan of the cohort are printed.
+//
+//  Operations (inputs name stages; the other parameters are optional
+//  where a default is given):
+//    - read file= [type=image|mask|labels]
+//    - read_dicom directory=
+//    - roi input= start=x,y,z end=x,y,z (inclusive, as extractROI)
+//    - resample input= [spacing=0 kernel=linear|nearest|bspline|sinc]
+//      [like=]; onto an isotropic grid (0, the finest spacing of the
+//      input), or onto the grid of the stage like=, e.g. to map a result
+//      back onto the ROI (Common/resample.h)
+//    - speed_image input= sigma= K1= K2= [time_step=0.04 iterations=5
+//      conductance=9]
+//    - fast_marching speed= seed=x,y,z|seeds=file stopping_time=
+//      threshold=; a mask of the voxels reached within threshold
+//    - geodesic_active_contour speed= seed=x,y,z radius=|initial=mask
+//      propagation= curvature= advection= iterations= [rms=0.01]; a mask
+//    - frangi input= [scales=1,10 ratio=2 alpha=0.5 beta=0.5 c=500
+//      black_white=1], as FrangiFilter3D.m
+//    - sato input= [sigmas=1 alpha1=0.5 alpha2=2]
+//    - threshold input= [lower= upper= inside=255]; a mask
+//    - mask input= mask=; the image, 0 outside the mask
+//    - labels masks=a,b,... [values=1,2,...]; an int16 label map, later
+//      masks drawn over earlier ones
+//    - write input= file= [compress=0]
+//
+//  Images are float, masks unsigned char (0/255); float inputs also take
+//  masks and label maps.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkCastImageFilter.h"
+#include "itkGDCMImageIO.h"
+#include "itkGDCMSeriesFileNames.h"
+#include "itkImageSeriesReader.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkFastMarchingImageFilter.h"
+#include "itkGeodesicActiveContourLevelSetImageFilter.h"
+#include "cohortScheduler.h"
+#include "compactImageIO.h"
+#include "distanceTransform.h"
+#include "pipelineGraph.h"
+#include "resample.h"
+#include "sato.h"
+#include "seedFile.h"
+#include "speedImage.h"
+#include "vesselness.h"
+
+
+const unsigned int Dimension = 3;
+typedef itk::Image< float, Dimension > ImageType;
+typedef itk::Image< unsigned char, Dimension > MaskImageType;
+typedef itk::Image< short, Dimension > LabelImageType;
+
+using medimg::PipelineDataPointer;
+using medimg::PipelineInputs;
+using medimg::PipelineStage;
+
+
+// Output image of a stage
+template< class TImage >
+class ImageData : public medimg::PipelineData
+{
+public:
+	explicit ImageData(TImage *image) : Image( image ) {}
+
+	std::size_t Bytes() const
+	{
+		return Image->GetBufferedRegion().GetNumberOfPixels() * sizeof(typename TImage::PixelType);
+	}
+
+	typename TImage::Pointer Image;
+};
+
+template< class TImage >
+PipelineDataPointer Output(TImage *image)
+{
+	return PipelineDataPointer( new ImageData< TImage >( image ) );
+}
+
+// Output of a reader; its voxels are added to *voxels when given
+template< class TImage >
+PipelineDataPointer ReadOutput(TImage *image, double *voxels)
+{
+	if( voxels ) {
+		*voxels += image->GetBufferedRegion().GetNumberOfPixels();
+	}
+	return Output( image );
+}
+
+// Runs the pipeline ending in filter and detaches its output
+template< class TFilter >
+typename TFilter::OutputImageType::Pointer TakeOutput(TFilter *filter)
+{
+	filter->Update();
+	typename TFilter::OutputImageType::Pointer output = filter->GetOutput();
+	output->DisconnectPipeline();
+	return output;
+}
+
+// The one stage named by key
+const PipelineDataPointer &Input(const PipelineStage &stage, const PipelineInputs &inputs,
+	const std::string &key)
+{
+	PipelineInputs::const_iterator found = inputs.find( key );
+	if( found == inputs.end() || found->second.size() != 1 ) {
+		throw std::runtime_error( stage.Name + ": " + key + "= must name one stage" );
+	}
+	return found->second[0];
+}
+
+// Input as float; masks and label maps are cast
+ImageType::Pointer FloatInput(const PipelineStage &stage, const PipelineInputs &inputs,
+	const std::string &key)
+{
+	const medimg::PipelineData *data = Input( stage, inputs, key ).get();
+	if( const ImageData< ImageType > *image = dynamic_cast< const ImageData< ImageType > * >( data ) ) {
+		return image->Image;
+	}
+	if( const ImageData< MaskImageType > *mask = dynamic_cast< const ImageData< MaskImageType > * >( data ) ) {
+		typedef itk::CastImageFilter< MaskImageType, ImageType > CastFilterType;
+		CastFilterType::Pointer caster = CastFilterType::New();
+		caster->SetInput( mask->Image );
+		return TakeOutput( caster.GetPointer() );
+	}
+	if( const ImageData< LabelImageType > *labels = dynamic_cast< const ImageData< LabelImageType > * >( data ) ) {
+		typedef itk::CastImageFilter< LabelImageType, ImageType > CastFilterType;
+		CastFilterType::Pointer caster = CastFilterType::New();
+		caster->SetInput( labels->Image );
+		return TakeOutput( caster.GetPointer() );
+	}
+	throw std::runtime_error( stage.Name + ": " + key + "= does not name an image" );
+}
+
+MaskImageType::Pointer MaskInput(const medimg::PipelineData *data, const PipelineStage &stage,
+	const std::string &key)
+{
+	const ImageData< MaskImageType > *mask = dynamic_cast< const ImageData< MaskImageType > * >( data );
+	if( !mask ) {
+		throw std::runtime_error( stage.Name + ": " + key + "= does not name a mask" );
+	}
+	return mask->Image;
+}
+
+// x,y,z of key as an index into image
+ImageType::IndexType IndexParameter(const PipelineStage &stage, const std::string &key,
+	const ImageType *image)
+{
+	const std::vector<double> values = stage.Numbers( key );
+	const ImageType::SizeType size = image->GetBufferedRegion().GetSize();
+	ImageType::IndexType index;
+	for( unsigned int a = 0; a < Dimension; ++a ) {
+		if( values.size() != Dimension || values[a] < 0 || values[a] >= size[a] ) {
+			throw std::runtime_error( stage.Name + ": " + key + "= is not a voxel of the input" );
+		}
+		index[a] = static_cast<itk::IndexValueType>( values[a] );
+	}
+	return index;
+}
+
+// seed=x,y,z, or the seeds listed in the file seeds=
+std::vector< ImageType::IndexType > Seeds(const PipelineStage &stage, const ImageType *image)
+{
+	std::vector< ImageType::IndexType > seeds;
+	if( stage.Parameters.count( "seed" ) ) {
+		seeds.push_back( IndexParameter( stage, "seed", image ) );
+		return seeds;
+	}
+	const medimg::Dims dims = medimg::ImageGeometry( image ).dims;
+	std::vector<std::size_t> voxels;
+	std::string error;
+	if( !medimg::ReadSeedFile( stage.Parameter( "seeds" ).c_str(), dims, voxels, error ) ) {
+		throw std::runtime_error( stage.Name + ": " + error );
+	}
+	for( std::size_t s = 0; s < voxels.size(); ++s ) {
+		ImageType::IndexType index;
+		index[0] = voxels[s] % dims.nx;
+		index[1] = voxels[s] / dims.nx % dims.ny;
+		index[2] = voxels[s] / ( dims.nx * dims.ny );
+		seeds.push_back( index );
+	}
+	return seeds;
+}
+
+// 255 where lower <= value <= upper
+MaskImageType::Pointer Threshold(const ImageType *image, float lower, float upper,
+	unsigned char inside = 255)
+{
+	MaskImageType::Pointer mask = medimg::AllocateImage< MaskImageType >( medimg::ImageGeometry( image ) );
+	const float *in = image->GetBufferPointer();
+	unsigned char *out = mask->GetBufferPointer();
+	const std::size_t n = image->GetBufferedRegion().GetNumberOfPixels();
+	for( std::size_t i = 0; i < n; ++i ) {
+		out[i] = in[i] >= lower && in[i] <= upper ? inside : 0;
+	}
+	return mask;
+}
+
+
+////////////////////////////////////////////////
+// Operations
+
+PipelineDataPointer Read(const PipelineStage &stage, const PipelineInputs &, double *voxels)
+{
+	const std::string file = stage.Parameter( "file" );
+	const std::string type = stage.Parameter( "type", "image" );
+	if( type == "mask" ) {
+		return ReadOutput( medimg::ReadImageFile< MaskImageType >( file ).GetPointer(), voxels );
+	}
+	if( type == "labels" ) {
+		return ReadOutput( medimg::ReadImageFile< LabelImageType >( file ).GetPointer(), voxels );
+	}
+	if( type != "image" ) {
+		throw std::runtime_error( stage.Name + ": type= is image, mask or labels" );
+	}
+	return ReadOutput( medimg::ReadImageFile< ImageType >( file ).GetPointer(), voxels );
+}
+
+PipelineDataPointer ReadDICOM(const PipelineStage &stage, const PipelineInputs &, double *voxels)
+{
+	typedef itk::GDCMSeriesFileNames InputNamesGeneratorType;
+	InputNamesGeneratorType::Pointer inputNames = InputNamesGeneratorType::New();
+	inputNames->SetInputDirectory( stage.Parameter( "directory" ) );
+	const std::vector< std::string > &filenames = inputNames->GetInputFileNames();
+	if( filenames.empty() ) {
+		throw std::runtime_error( stage.Name + ": no DICOM series in " + stage.Parameter( "directory" ) );
+	}
+	typedef itk::ImageSeriesReader< ImageType > ReaderType;
+	ReaderType::Pointer reader = ReaderType::New();
+	reader->SetImageIO( itk::GDCMImageIO::New() );
+	reader->SetFileNames( filenames );
+	return ReadOutput( TakeOutput( reader.GetPointer() ).GetPointer(), voxels );
+}
+
+PipelineDataPointer ROI(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	const ImageType::Pointer image = FloatInput( stage, inputs, "input" );
+	ImageType::RegionType region;
+	region.SetIndex( IndexParameter( stage, "start", image ) );
+	region.SetUpperIndex( IndexParameter( stage, "end", image ) );
+
+	typedef itk::RegionOfInterestImageFilter< ImageType, ImageType > ROIfilter;
+	ROIfilter::Pointer roi = ROIfilter::New();
+	roi->SetInput( image );
+	roi->SetRegionOfInterest( region );
+	return Output( TakeOutput( roi.GetPointer() ).GetPointer() );
+}
+
+// Grid of the image, mask or label map named by key
+medimg::Geometry GridInput(const PipelineStage &stage, const PipelineInputs &inputs, const std::string &key)
+{
+	const medimg::PipelineData *data = Input( stage, inputs, key ).get();
+	if( const ImageData< ImageType > *image = dynamic_cast< const ImageData< ImageType > * >( data ) ) {
+		return medimg::ImageGeometry( image->Image.GetPointer() );
+	}
+	if( const ImageData< MaskImageType > *mask = dynamic_cast< const ImageData< MaskImageType > * >( data ) ) {
+		return medimg::ImageGeometry( mask->Image.GetPointer() );
+	}
+	if( const ImageData< LabelImageType > *labels = dynamic_cast< const ImageData< LabelImageType > * >( data ) ) {
+		return medimg::ImageGeometry( labels->Image.GetPointer() );
+	}
+	throw std::runtime_error( stage.Name + ": " + key + "= does not name an image" );
+}
+
+PipelineDataPointer ResampleImage(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	const ImageType::Pointer image = FloatInput( stage, inputs, "input" );
+	const medimg::Geometry geometry = medimg::ImageGeometry( image.GetPointer() );
+	medimg::ResampleOptions options;
+	if( !medimg::ResampleKernelFromName( stage.Parameter( "kernel", "linear" ), options.Kernel ) ) {
+		throw std::runtime_error( stage.Name + ": kernel= is nearest, linear, bspline or sinc" );
+	}
+	// The share of the threads the ITK filters get, in a cohort as well
+	options.NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+	const medimg::Geometry grid = inputs.count( "like" ) ? GridInput( stage, inputs, "like" )
+		: medimg::IsotropicGeometry( geometry, stage.Number( "spacing", 0.0 ) );
+
+	ImageType::Pointer resampled = medimg::AllocateImage< ImageType >( grid );
+	std::string error;
+	if( !medimg::Resample( image->GetBufferPointer(), geometry, resampled->GetBufferPointer(), grid,
+		options, error ) ) {
+		throw std::runtime_error( stage.Name + ": " + error );
+	}
+	return Output( resampled.GetPointer() );
+}
+
+PipelineDataPointer SpeedImage(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	medimg::SpeedImageFilters< ImageType, ImageType > speed( stage.Number( "sigma" ),
+		stage.Number( "K1" ), stage.Number( "K2" ) );
+	speed.smoothing->SetTimeStep( stage.Number( "time_step", 0.04 ) );
+	speed.smoothing->SetNumberOfIterations( static_cast<unsigned int>( stage.Number( "iterations", 5 ) ) );
+	speed.smoothing->SetConductanceParameter( stage.Number( "conductance", 9.0 ) );
+	speed.SetInput( FloatInput( stage, inputs, "input" ) );
+	return Output( TakeOutput( speed.sigmoid.GetPointer() ).GetPointer() );
+}
+
+PipelineDataPointer FastMarching(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	const ImageType::Pointer speed = FloatInput( stage, inputs, "speed" );
+	typedef itk::FastMarchingImageFilter< ImageType, ImageType > FastMarchingFilterType;
+	typedef FastMarchingFilterType::NodeContainer NodeContainer;
+	typedef FastMarchingFilterType::NodeType NodeType;
+	const std::vector< ImageType::IndexType > seeds = Seeds( stage, speed );
+	NodeContainer::Pointer trialPoints = NodeContainer::New();
+	trialPoints->Initialize();
+	for( std::size_t s = 0; s < seeds.size(); ++s ) {
+		NodeType node;
+		node.SetValue( 0.0 );
+		node.SetIndex( seeds[s] );
+		trialPoints->InsertElement( s, node );
+	}
+
+	FastMarchingFilterType::Pointer fastMarching = FastMarchingFilterType::New();
+	fastMarching->SetInput( speed );
+	fastMarching->SetTrialPoints( trialPoints );
+	fastMarching->SetOutputSize( speed->GetBufferedRegion().GetSize() );
+	fastMarching->SetStoppingValue( stage.Number( "stopping_time" ) );
+	const ImageType::Pointer arrival = TakeOutput( fastMarching.GetPointer() );
+	return Output( Threshold( arrival, 0.0f, static_cast<float>( stage.Number( "threshold" ) ) ).GetPointer() );
+}
+
+PipelineDataPointer GeodesicActiveContour(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	const ImageType::Pointer speed = FloatInput( stage, inputs, "speed" );
+	const medimg::Geometry geometry = medimg::ImageGeometry( speed.GetPointer() );
+
+	// Signed distance to the initial mask, or to balls around the seeds
+	ImageType::Pointer initialLevelSet = medimg::AllocateImage< ImageType >( geometry );
+	if( inputs.count( "initial" ) ) {
+		const MaskImageType::Pointer initial = MaskInput( Input( stage, inputs, "initial" ).get(),
+			stage, "initial" );
+		if( initial->GetBufferedRegion().GetSize() != speed->GetBufferedRegion().GetSize() ) {
+			throw std::runtime_error( stage.Name + ": initial= and speed= differ in size" );
+		}
+		medimg::SignedDistanceMap( initial->GetBufferPointer(), geometry.dims, geometry.Spacing,
+			initialLevelSet->GetBufferPointer() );
+	}
+	else {
+		const std::vector< ImageType::IndexType > seeds = Seeds( stage, speed );
+		std::vector< medimg::DistanceSeed > distanceSeeds( seeds.size() );
+		for( std::size_t s = 0; s < seeds.size(); ++s ) {
+			distanceSeeds[s].x = seeds[s][0];
+			distanceSeeds[s].y = seeds[s][1];
+			distanceSeeds[s].z = seeds[s][2];
+			distanceSeeds[s].Radius = stage.Number( "radius" );
+		}
+		std::string error;
+		if( !medimg::SignedDistanceFromSeeds( distanceSeeds, geometry.dims, geometry.Spacing,
+			initialLevelSet->GetBufferPointer(), error ) ) {
+			throw std::runtime_error( stage.Name + ": " + error );
+		}
+	}
+
+	typedef itk::GeodesicActiveContourLevelSetImageFilter< ImageType, ImageType >
+		GeodesicActiveContourFilterType;
+	GeodesicActiveContourFilterType::Pointer geodesicActiveContour = GeodesicActiveContourFilterType::New();
+	geodesicActiveContour->SetPropagationScaling( stage.Number( "propagation" ) );
+	geodesicActiveContour->SetCurvatureScaling( stage.Number( "curvature" ) );
+	geodesicActiveContour->SetAdvectionScaling( stage.Number( "advection" ) );
+	geodesicActiveContour->SetMaximumRMSError( stage.Number( "rms", 0.01 ) );
+	geodesicActiveContour->SetNumberOfIterations( static_cast<unsigned int>( stage.Number( "iterations" ) ) );
+	geodesicActiveContour->SetInput( initialLevelSet );
+	geodesicActiveContour->SetFeatureImage( speed );
+	const ImageType::Pointer levelSet = TakeOutput( geodesicActiveContour.GetPointer() );
+	return Output( Threshold( levelSet, -std::numeric_limits<float>::max(), 0.0f ).GetPointer() );
+}
+
+PipelineDataPointer Frangi(const PipelineStage &stage, const PipelineInputs &inputs,
+	medimg::ThreadPool *pool)
+{
+	const ImageType::Pointer image = FloatInput( stage, inputs, "input" );
+	medimg::FrangiOptions options;
+	if( stage.Parameters.count( "scales" ) ) {
+		const std::vector<double> scales = stage.Numbers( "scales" );
+		if( scales.size() != 2 ) {
+			throw std::runtime_error( stage.Name + ": scales= takes the first and last scale" );
+		}
+		options.FrangiScaleRange[0] = scales[0];
+		options.FrangiScaleRange[1] = scales[1];
+	}
+	options.FrangiScaleRatio = stage.Number( "ratio", options.FrangiScaleRatio );
+	options.FrangiAlpha = stage.Number( "alpha", options.FrangiAlpha );
+	options.FrangiBeta = stage.Number( "beta", options.FrangiBeta );
+	options.FrangiC = stage.Number( "c", options.FrangiC );
+	options.BlackWhite = stage.Number( "black_white", 1 ) != 0;
+	options.verbose = false;
+
+	const medimg::Geometry geometry = medimg::ImageGeometry( image.GetPointer() );
+	ImageType::Pointer vesselness = medimg::AllocateImage< ImageType >( geometry );
+	medimg::FrangiFilter3D( image->GetBufferPointer(), geometry.dims, options,
+		vesselness->GetBufferPointer(), 0, pool );
+	return Output( vesselness.GetPointer() );
+}
+
+PipelineDataPointer Sato(const PipelineStage &stage, const PipelineInputs &inputs,
+	medimg::ThreadPool *pool)
+{
+	const ImageType::Pointer image = FloatInput( stage, inputs, "input" );
+	const medimg::Geometry geometry = medimg::ImageGeometry( image.GetPointer() );
+	medimg::SatoOptions options;
+	options.Sigmas = stage.Parameters.count( "sigmas" ) ? stage.Numbers( "sigmas" )
+		: std::vector<double>( 1, 1.0 );
+	options.NormalizeAcrossScale = options.Sigmas.size() > 1;
+	options.Alpha1 = stage.Number( "alpha1", options.Alpha1 );
+	options.Alpha2 = stage.Number( "alpha2", options.Alpha2 );
+	for( int a = 0; a < 3; ++a ) {
+		options.Spacing[a] = geometry.Spacing[a];
+	}
+	options.verbose = false;
+
+	ImageType::Pointer vesselness = medimg::AllocateImage< ImageType >( geometry );
+	medimg::SatoFilter3D( image->GetBufferPointer(), geometry.dims, options,
+		vesselness->GetBufferPointer(), 0, pool );
+	return Output( vesselness.GetPointer() );
+}
+
+PipelineDataPointer ThresholdImage(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	const ImageType::Pointer image = FloatInput( stage, inputs, "input" );
+	const float lower = static_cast<float>( stage.Number( "lower", -std::numeric_limits<float>::max() ) );
+	const float upper = static_cast<float>( stage.Number( "upper", std::numeric_limits<float>::max() ) );
+	const unsigned char inside = static_cast<unsigned char>( stage.Number( "inside", 255 ) );
+	return Output( Threshold( image, lower, upper, inside ).GetPointer() );
+}
+
+PipelineDataPointer MaskImage(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	const ImageType::Pointer image = FloatInput( stage, inputs, "input" );
+	const MaskImageType::Pointer mask = MaskInput( Input( stage, inputs, "mask" ).get(), stage, "mask" );
+	if( mask->GetBufferedRegion().GetSize() != image->GetBufferedRegion().GetSize() ) {
+		throw std::runtime_error( stage.Name + ": input= and mask= differ in size" );
+	}
+	ImageType::Pointer masked = medimg::AllocateImage< ImageType >( medimg::ImageGeometry( image.GetPointer() ) );
+	const std::size_t n = image->GetBufferedRegion().GetNumberOfPixels();
+	for( std::size_t i = 0; i < n; ++i ) {
+		masked->GetBufferPointer()[i] = mask->GetBufferPointer()[i] ? image->GetBufferPointer()[i] : 0.0f;
+	}
+	return Output( masked.GetPointer() );
+}
+
+PipelineDataPointer Labels(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	PipelineInputs::const_iterator masks = inputs.find( "masks" );
+	if( masks == inputs.end() || masks->second.empty() ) {
+		throw std::runtime_error( stage.Name + ": masks= must name the masks to label" );
+	}
+	std::vector<double> values;
+	if( stage.Parameters.count( "values" ) ) {
+		values = stage.Numbers( "values" );
+	}
+	else {
+		for( std::size_t m = 0; m < masks->second.size(); ++m ) {
+			values.push_back( m + 1.0 );
+		}
+	}
+	if( values.size() != masks->second.size() ) {
+		throw std::runtime_error( stage.Name + ": values= needs one label per mask" );
+	}
+
+	LabelImageType::Pointer labels;
+	for( std::size_t m = 0; m < masks->second.size(); ++m ) {
+		const MaskImageType::Pointer mask = MaskInput( masks->second[m].get(), stage, "masks" );
+		if( !labels ) {
+			labels = medimg::AllocateImage< LabelImageType >( medimg::ImageGeometry( mask.GetPointer() ) );
+			labels->FillBuffer( 0 );
+		}
+		else if( mask->GetBufferedRegion().GetSize() != labels->GetBufferedRegion().GetSize() ) {
+			throw std::runtime_error( stage.Name + ": the masks differ in size" );
+		}
+		const short label = static_cast<short>( values[m] );
+		const std::size_t n = mask->GetBufferedRegion().GetNumberOfPixels();
+		for( std::size_t i = 0; i < n; ++i ) {
+			if( mask->GetBufferPointer()[i] ) {
+				labels->GetBufferPointer()[i] = label;
+			}
+		}
+	}
+	return Output( labels.GetPointer() );
+}
+
+PipelineDataPointer Write(const PipelineStage &stage, const PipelineInputs &inputs)
+{
+	const medimg::PipelineData *data = Input( stage, inputs, "input" ).get();
+	const std::string file = stage.Parameter( "file" );
+	const bool compress = stage.Number( "compress", 0 ) != 0;
+	if( const ImageData< ImageType > *image = dynamic_cast< const ImageData< ImageType > * >( data ) ) {
+		medimg::WriteImageFile( image->Image.GetPointer(), file, compress );
+	}
+	else if( const ImageData< MaskImageType > *mask = dynamic_cast< const ImageData< MaskImageType > * >( data ) ) {
+		medimg::WriteImageFile( mask->Image.GetPointer(), file, compress );
+	}
+	else if( const ImageData< LabelImageType > *labels = dynamic_cast< const ImageData< LabelImageType > * >( data ) ) {
+		medimg::WriteImageFile( labels->Image.GetPointer(), file, compress );
+	}
+	else {
+		throw std::runtime_error( stage.Name + ": input= does not name an image" );
+	}
+	return PipelineDataPointer();
+}
+
+
+// The operations above; the native kernels run on pool (0 for a pool of
+// their own per call), and the voxels read are added to *voxelsRead
+void AddOperations(medimg::PipelineGraph &pipeline, medimg::ThreadPool *pool, double *voxelsRead)
+{
+	using std::placeholders::_1;
+	using std::placeholders::_2;
+	std::vector< std::string > input( 1, "input" );
+	pipeline.AddOperation( "read", std::vector< std::string >(), std::bind( Read, _1, _2, voxelsRead ) );
+	pipeline.AddOperation( "read_dicom", std::vector< std::string >(),
+		std::bind( ReadDICOM, _1, _2, voxelsRead ) );
+	pipeline.AddOperation( "roi", input, ROI );
+	std::vector< std::string > resampleInputs( input );
+	resampleInputs.push_back( "like" );
+	pipeline.AddOperation( "resample", resampleInputs, ResampleImage );
+	pipeline.AddOperation( "speed_image", input, SpeedImage );
+	pipeline.AddOperation( "fast_marching", std::vector< std::string >( 1, "speed" ), FastMarching );
+	std::vector< std::string > gacInputs( 1, "speed" );
+	gacInputs.push_back( "initial" );
+	pipeline.AddOperation( "geodesic_active_contour", gacInputs, GeodesicActiveContour );
+	pipeline.AddOperation( "frangi", input, std::bind( Frangi, _1, _2, pool ) );
+	pipeline.AddOperation( "sato", input, std::bind( Sato, _1, _2, pool ) );
+	pipeline.AddOperation( "threshold", input, ThresholdImage );
+	std::vector< std::string > maskInputs( input );
+	maskInputs.push_back( "mask" );
+	pipeline.AddOperation( "mask", maskInputs, MaskImage );
+	pipeline.AddOperation( "labels", std::vector< std::string >( 1, "masks" ), Labels );
+	pipeline.AddOperation( "write", input, Write );
+}
+
+// Runs the pipeline in text for every case of the list in filename
+int RunCohort(const std::string &text, const char *filename, unsigned int threads,
+	unsigned int casesAtOnce)
+{
+	std::ifstream list( filename );
+	if( !list ) {
+		std::cerr << "Cannot open " << filename << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector< std::string > cases;
+	std::string line;
+	while( std::getline( list, line ) ) {
+		const std::size_t first = line.find_first_not_of( " \t\r" );
+		if( first != std::string::npos && line[first] != '#' ) {
+			cases.push_back( line.substr( first, line.find_last_not_of( " \t\r" ) + 1 - first ) );
+		}
+	}
+
+	medimg::CohortScheduler scheduler( threads, casesAtOnce );
+	itk::MultiThreader::SetGlobalDefaultNumberOfThreads(
+		std::max( 1u, scheduler.Pool().NumberOfThreads() / scheduler.CasesAtOnce() ) );
+	const bool succeeded = scheduler.Run( cases.size(),
+		[&text, &cases](std::size_t c, medimg::ThreadPool &pool) {
+			std::string caseText( text );
+			for( std::size_t at = caseText.find( "$case" ); at != std::string::npos;
+				at = caseText.find( "$case", at + cases[c].size() ) ) {
+				caseText.replace( at, 5, cases[c] );
+			}
+			double voxels = 0.0;
+			medimg::PipelineGraph pipeline;
+			AddOperations( pipeline, &pool, &voxels );
+			std::string error;
+			if( !pipeline.Parse( caseText, error ) || !pipeline.Run( 1, error ) ) {
+				throw std::runtime_error( error );
+			}
+			return voxels;
+		} );
+
+	////////////////////////////////////////////////
+	// Report the cases
+
+	std::cout << std::left << std::setw( 24 ) << "case" << std::right << std::setw( 9 ) << "start s"
+		<< std::setw( 9 ) << "wall s" << std::setw( 8 ) << "worker" << std::setw( 12 ) << "Mvoxel/s"
+		<< std::endl;
+	std::cout << std::fixed << std::setprecision( 2 );
+	double busy = 0.0;
+	for( std::size_t c = 0; c < cases.size(); ++c ) {
+		const medimg::CohortCaseTiming &timing = scheduler.Timings()[c];
+		std::cout << std::left << std::setw( 24 ) << cases[c] << std::right << std::setw( 9 ) << timing.Start
+			<< std::setw( 9 ) << timing.Wall << std::setw( 8 ) << timing.Worker
+			<< std::setw( 12 ) << timing.Throughput() / 1.0e6;
+		if( !timing.Error.empty() ) {
+			std::cout << "  failed: " << timing.Error;
+		}
+		std::cout << std::endl;
+		busy += timing.Wall;
+	}
+	const double makespan = scheduler.Makespan();
+	std::cout << cases.size() << " cases in " << makespan << " s on "
+		<< scheduler.Pool().NumberOfThreads() << " threads, "
+		<< ( makespan > 0.0 ? busy / makespan : 0.0 ) << " cases at once on average, "
+		<< ( makespan > 0.0 ? 3600.0 * cases.size() / makespan : 0.0 ) << " cases per hour" << std::endl;
+	return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0]
+			<< " <Pipeline> [stages at once] [Cases] [cases at once]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const unsigned int stagesAtOnce = argc > 2 ? atoi( argv[2] ) : 0;
+	if( argc > 3 ) {
+		std::ifstream file( argv[1] );
+		if( !file ) {
+			std::cerr << "Cannot open " << argv[1] << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::ostringstream text;
+		text << file.rdbuf();
+		return RunCohort( text.str(), argv[3], stagesAtOnce, argc > 4 ? atoi( argv[4] ) : 0 );
+	}
+
+	medimg::PipelineGraph pipeline;
+	AddOperations( pipeline, 0, 0 );
+
+	std::string error;
+	if( !pipeline.Read( argv[1], error ) ) {
+		std::cerr << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	const bool succeeded = pipeline.Run( stagesAtOnce, error );
+
+	////////////////////////////////////////////////
+	// Report the stages
+
+	std::cout << std::left << std::setw( 16 ) << "stage" << std::setw( 24 ) << "operation"
+		<< std::right << std::setw( 9 ) << "start s" << std::setw( 9 ) << "wall s"
+		<< std::setw( 8 ) << "worker" << std::setw( 12 ) << "held MB" << std::endl;
+	std::cout << std::fixed << std::setprecision( 2 );
+	for( std::size_t s = 0; s < pipeline.Stages().size(); ++s ) {
+		const PipelineStage &stage = pipeline.Stages()[s];
+		const medimg::PipelineStageTiming &timing = pipeline.Timings()[s];
+		std::cout << std::left << std::setw( 16 ) << stage.Name << std::setw( 24 ) << stage.Operation
+			<< std::right << std::setw( 9 ) << timing.Start << std::setw( 9 ) << timing.Wall
+			<< std::setw( 8 ) << timing.Worker
+			<< std::setw( 12 ) << timing.LiveBytes / ( 1024.0 * 1024.0 ) << std::endl;
+	}
+	std::cout << "Peak of the intermediates held: "
+		<< pipeline.PeakBytes() / ( 1024.0 * 1024.0 ) << " MB" << std::endl;
+
+	if( !succeeded ) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
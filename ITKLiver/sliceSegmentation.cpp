@@ -0,0 +1,351 @@
+//
+//  Segment every slice of a volume in 2D, concurrently, with the per-slice
+//  pipeline of liversegmentation.py, and stack the results into a 3D mask
+//
+//  INPUT:
+//    - volume (e.g. the ROI written by extractROI)
+//    - seed file, lines "z x y radius" (see Common/seedFile.h); slices
+//      without seeds are left empty
+//    - output mask (0/255; a .bits name writes a bit-packed mask)
+//    - method: fastmarching, shapedetection or geodesic
+//    - sigma, sigmoid K1, K2 for gradient and sigmoid mapping
+//    - optionally, the stopping value for fastmarching (default 100) or
+//      the number of iterations for the level sets (default 500 for shape
+//      detection, 600 for geodesic active contours); "" for the default
+//    - optionally, the number of threads (default all cores)
+//
+//  Each slice runs curvature anisotropic diffusion, gradient magnitude,
+//  sigmoid mapping and the chosen segmentation with the parameters of
+//  liversegmentation.py; the level sets start from the signed distance to
+//  disks of the seeds' radii (Common/distanceTransform.h). The ITK filters
+//  run single-threaded and the slices are spread over the threads with
+//  work stealing (Common/workStealing.h), since a level set may converge
+//  in a few iterations on one slice and run to the limit on the next.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkCurvatureAnisotropicDiffusionImageFilter.h"
+#include "itkGradientMagnitudeRecursiveGaussianImageFilter.h"
+#include "itkSigmoidImageFilter.h"
+#include "itkFastMarchingImageFilter.h"
+#include "itkShapeDetectionLevelSetImageFilter.h"
+#include "itkGeodesicActiveContourLevelSetImageFilter.h"
+#include "itkBinaryThresholdImageFilter.h"
+#include "compactImageIO.h"
+#include "distanceTransform.h"
+#include "pixelTypeDispatch.h"
+#include "seedFile.h"
+#include "workStealing.h"
+
+
+typedef itk::Image< float, 2 > SliceType;
+typedef itk::Image< unsigned char, 2 > SliceMaskType;
+typedef itk::Image< unsigned char, 3 > OutputImageType;
+
+enum SegmentationMethod
+{
+	FastMarchingMethod,
+	ShapeDetectionMethod,
+	GeodesicMethod
+};
+
+struct SliceParameters
+{
+	SegmentationMethod method;
+	double sigma, K1, K2;
+	double stoppingValue;
+	unsigned int iterations;
+};
+
+
+// Segments slice from seeds into mask (the pixels of slice, 0/255); throws
+// std::runtime_error when a level-set seed lies outside the slice
+static void SegmentSlice(SliceType *slice, const std::vector< medimg::SliceSeed > &seeds,
+	const SliceParameters &parameters, unsigned char *mask)
+{
+	////////////////////////////////////////////////
+	// 1) Curvature anisotropic diffusion
+
+	typedef itk::CurvatureAnisotropicDiffusionImageFilter< SliceType, SliceType > SmoothingFilterType;
+	SmoothingFilterType::Pointer smoothing = SmoothingFilterType::New();
+	smoothing->SetTimeStep( 0.06 );
+	smoothing->SetNumberOfIterations( 5 );
+	smoothing->SetConductanceParameter( 9.0 );
+	smoothing->SetInput( slice );
+
+	////////////////////////////////////////////////
+	// 2) Gradient magnitude and sigmoid mapping
+
+	typedef itk::GradientMagnitudeRecursiveGaussianImageFilter< SliceType, SliceType > GradientFilterType;
+	GradientFilterType::Pointer gradientMagnitude = GradientFilterType::New();
+	gradientMagnitude->SetSigma( parameters.sigma );
+	gradientMagnitude->SetInput( smoothing->GetOutput() );
+
+	typedef itk::SigmoidImageFilter< SliceType, SliceType > SigmoidFilterType;
+	SigmoidFilterType::Pointer sigmoid = SigmoidFilterType::New();
+	sigmoid->SetOutputMinimum( 0.0 );
+	sigmoid->SetOutputMaximum( 1.0 );
+	sigmoid->SetAlpha( (parameters.K2 - parameters.K1) / 6 );
+	sigmoid->SetBeta( (parameters.K1 + parameters.K2) / 2 );
+	sigmoid->SetInput( gradientMagnitude->GetOutput() );
+
+	////////////////////////////////////////////////
+	// 3) Segmentation
+
+	typedef itk::BinaryThresholdImageFilter< SliceType, SliceMaskType > ThresholdingFilterType;
+	ThresholdingFilterType::Pointer thresholder = ThresholdingFilterType::New();
+	thresholder->SetOutsideValue( 0 );
+	thresholder->SetInsideValue( 255 );
+
+	typedef itk::FastMarchingImageFilter< SliceType, SliceType > FastMarchingFilterType;
+	typedef itk::ShapeDetectionLevelSetImageFilter< SliceType, SliceType > ShapeDetectionFilterType;
+	typedef itk::GeodesicActiveContourLevelSetImageFilter< SliceType, SliceType > GeodesicActiveContourFilterType;
+	FastMarchingFilterType::Pointer fastMarching;
+	ShapeDetectionFilterType::Pointer shapeDetection;
+	GeodesicActiveContourFilterType::Pointer geodesicActiveContour;
+
+	const SliceType::SizeType size = slice->GetBufferedRegion().GetSize();
+	if( parameters.method == FastMarchingMethod ) {
+		// Arrival times from the seeds, as in fast_marching()
+		typedef FastMarchingFilterType::NodeContainer NodeContainer;
+		typedef FastMarchingFilterType::NodeType NodeType;
+		NodeContainer::Pointer trialPoints = NodeContainer::New();
+		trialPoints->Initialize();
+		for( std::size_t s = 0; s < seeds.size(); ++s ) {
+			SliceType::IndexType index;
+			index[0] = seeds[s].x;
+			index[1] = seeds[s].y;
+			NodeType node;
+			node.SetValue( 0.0 );
+			node.SetIndex( index );
+			trialPoints->InsertElement( s, node );
+		}
+		fastMarching = FastMarchingFilterType::New();
+		fastMarching->SetInput( sigmoid->GetOutput() );
+		fastMarching->SetTrialPoints( trialPoints );
+		fastMarching->SetStoppingValue( parameters.stoppingValue );
+		thresholder->SetLowerThreshold( 0.0 );
+		thresholder->SetUpperThreshold( parameters.stoppingValue );
+		thresholder->SetInput( fastMarching->GetOutput() );
+	}
+	else {
+		// Initial level set: signed distance (in pixels) from the disks
+		// input_level_set() drew
+		SliceType::Pointer initial = SliceType::New();
+		initial->SetRegions( slice->GetBufferedRegion() );
+		initial->CopyInformation( slice );
+		initial->Allocate();
+		std::vector< medimg::DistanceSeed > disks( seeds.size() );
+		for( std::size_t s = 0; s < seeds.size(); ++s ) {
+			disks[s].x = seeds[s].x;
+			disks[s].y = seeds[s].y;
+			disks[s].z = 0;
+			disks[s].Radius = seeds[s].Radius;
+		}
+		const double pixels[3] = { 1.0, 1.0, 1.0 };
+		std::string error;
+		if( !medimg::SignedDistanceFromSeeds( disks, medimg::Dims( size[0], size[1], 1 ), pixels,
+			initial->GetBufferPointer(), error, 1 ) ) {
+			throw std::runtime_error( error );
+		}
+		if( parameters.method == ShapeDetectionMethod ) {
+			shapeDetection = ShapeDetectionFilterType::New();
+			shapeDetection->SetMaximumRMSError( 0.02 );
+			shapeDetection->SetPropagationScaling( 1.0 );
+			shapeDetection->SetCurvatureScaling( 0.2 );
+			shapeDetection->SetNumberOfIterations( parameters.iterations );
+			shapeDetection->SetInput( initial );
+			shapeDetection->SetFeatureImage( sigmoid->GetOutput() );
+			thresholder->SetInput( shapeDetection->GetOutput() );
+		}
+		else {
+			geodesicActiveContour = GeodesicActiveContourFilterType::New();
+			geodesicActiveContour->SetPropagationScaling( 1.0 );
+			geodesicActiveContour->SetCurvatureScaling( 0.2 );
+			geodesicActiveContour->SetAdvectionScaling( 4.0 );
+			geodesicActiveContour->SetMaximumRMSError( 0.01 );
+			geodesicActiveContour->SetNumberOfIterations( parameters.iterations );
+			geodesicActiveContour->SetInput( initial );
+			geodesicActiveContour->SetFeatureImage( sigmoid->GetOutput() );
+			thresholder->SetInput( geodesicActiveContour->GetOutput() );
+		}
+		thresholder->SetLowerThreshold( -1000.0 );
+		thresholder->SetUpperThreshold( 0.0 );
+	}
+
+	thresholder->Update();
+	const unsigned char *result = thresholder->GetOutput()->GetBufferPointer();
+	std::copy( result, result + size[0] * size[1], mask );
+}
+
+
+struct SliceSegmentation
+{
+	const char * inputImage;
+	const char * seedFile;
+	const char * outputImage;
+	SliceParameters parameters;
+	unsigned int threads;
+
+	template< class TPixel >
+	int Run() const;
+};
+
+
+template< class TPixel >
+int SliceSegmentation::Run() const
+{
+	typedef itk::Image< TPixel, 3 > InputImageType;
+
+	////////////////////////////////////////////////
+	// 1) Read the volume and the seeds
+
+	typename InputImageType::Pointer image;
+	try {
+		image = medimg::ReadImageFile< InputImageType >( inputImage );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	const medimg::Geometry geometry = medimg::ImageGeometry( image.GetPointer() );
+	const medimg::Dims &dims = geometry.dims;
+
+	std::vector< std::vector< medimg::SliceSeed > > seeds;
+	std::string error;
+	if( !medimg::ReadSliceSeedFile( seedFile, dims, seeds, error ) ) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector< std::size_t > seeded;
+	for( std::size_t z = 0; z < dims.nz; ++z ) {
+		if( !seeds[z].empty() ) {
+			seeded.push_back( z );
+		}
+	}
+
+	OutputImageType::Pointer output = medimg::AllocateImage< OutputImageType >( geometry );
+	unsigned char *mask = output->GetBufferPointer();
+	std::fill( mask, mask + dims.Voxels(), 0 );
+
+	////////////////////////////////////////////////
+	// 2) Segment the seeded slices concurrently
+
+	const std::size_t sliceSize = dims.nx * dims.ny;
+	const TPixel *input = image->GetBufferPointer();
+	std::vector< double > seconds( dims.nz, 0.0 );
+	std::vector< std::string > failures( dims.nz );
+	medimg::WorkStealingStats stats;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	medimg::WorkStealingFor( seeded.size(), threads, [&](std::size_t item, unsigned int) {
+		const std::size_t z = seeded[item];
+		const std::chrono::steady_clock::time_point sliceStart = std::chrono::steady_clock::now();
+
+		SliceType::Pointer slice = SliceType::New();
+		SliceType::SizeType size;
+		SliceType::SpacingType spacing;
+		SliceType::PointType origin;
+		for( int a = 0; a < 2; ++a ) {
+			size[a] = a == 0 ? dims.nx : dims.ny;
+			spacing[a] = geometry.Spacing[a];
+			origin[a] = geometry.Origin[a];
+		}
+		slice->SetRegions( size );
+		slice->SetSpacing( spacing );
+		slice->SetOrigin( origin );
+		slice->Allocate();
+		const TPixel *in = input + z * sliceSize;
+		std::copy( in, in + sliceSize, slice->GetBufferPointer() );
+
+		try {
+			SegmentSlice( slice, seeds[z], parameters, mask + z * sliceSize );
+		} catch (itk::ExceptionObject & error) {
+			std::ostringstream message;
+			message << error;
+			failures[z] = message.str();
+		} catch (std::exception & error) {
+			failures[z] = error.what();
+		}
+		seconds[z] = std::chrono::duration<double>( std::chrono::steady_clock::now() - sliceStart ).count();
+	}, &stats );
+
+	const double total = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	for( std::size_t z = 0; z < dims.nz; ++z ) {
+		if( !failures[z].empty() ) {
+			std::cerr << "Slice " << z << " failed: " << failures[z] << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	const std::vector< double >::const_iterator slowest = std::max_element( seconds.begin(), seconds.end() );
+	std::printf( "%zu of %zu slices segmented in %.2f s, slowest slice %zu (%.2f s)\n",
+		seeded.size(), dims.nz, total, static_cast<std::size_t>( slowest - seconds.begin() ),
+		slowest == seconds.end() ? 0.0 : *slowest );
+	for( std::size_t w = 0; w < stats.Items.size(); ++w ) {
+		std::printf( "  thread %zu: %zu slices, %zu stolen\n", w, stats.Items[w], stats.Stolen[w] );
+	}
+
+	////////////////////////////////////////////////
+	// 3) Write the stacked mask
+
+	try {
+		medimg::WriteImageFile( output.GetPointer(), outputImage );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if (argc < 8) {
+		std::cerr << "Usage:" << std::endl;
+		std::cerr << argv[0];
+		std::cerr << " <InputImage> <SeedFile> <OutputImage> <fastmarching|shapedetection|geodesic> ";
+		std::cerr << "<sigma> <sigmoid K1> <sigmoid K2> [stoppingValue|iterations] [threads]";
+		std::cerr << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	SliceSegmentation segmentation;
+	segmentation.inputImage = argv[1];
+	segmentation.seedFile = argv[2];
+	segmentation.outputImage = argv[3];
+	const std::string method = argv[4];
+	SliceParameters &parameters = segmentation.parameters;
+	if( method == "fastmarching" ) {
+		parameters.method = FastMarchingMethod;
+	}
+	else if( method == "shapedetection" ) {
+		parameters.method = ShapeDetectionMethod;
+	}
+	else if( method == "geodesic" ) {
+		parameters.method = GeodesicMethod;
+	}
+	else {
+		std::cerr << "Unknown method " << method << std::endl;
+		return EXIT_FAILURE;
+	}
+	parameters.sigma = atof( argv[5] );
+	parameters.K1 = atof( argv[6] );
+	parameters.K2 = atof( argv[7] );
+	const bool given = argc > 8 && argv[8][0] != '\0';
+	parameters.stoppingValue = given ? atof( argv[8] ) : 100.0;
+	parameters.iterations = given ? atoi( argv[8] ) : ( parameters.method == GeodesicMethod ? 600 : 500 );
+	segmentation.threads = argc > 9 ? static_cast<unsigned int>( std::max( 0, atoi( argv[9] ) ) ) : 0;
+
+	// The slices are the unit of parallelism
+	itk::MultiThreader::SetGlobalDefaultNumberOfThreads( 1 );
+	return medimg::DispatchOnPixelType( segmentation.inputImage, segmentation );
+}
@@ -0,0 +1,130 @@
+//
+//  Extract the surface of a segmentation, or an isosurface of e.g. a
+//  vesselness image, as a triangle mesh for 3D models of the liver
+//
+//  INPUT:
+//    - mask or image (e.g. the output of geodesic_active_contour or
+//      fastmarching, a .bits mask, or frangiresult.mha)
+//    - output mesh file name, .stl or .ply
+//    - optionally, the iso value (default half the maximum, i.e. 127.5 for
+//      0/255 masks; "" for the default)
+//    - optionally, the edge length in mm of the cells vertices are merged
+//      in for decimation (default 0, no decimation)
+//    - optionally, the number of threads (default all cores)
+//
+//  Marching cubes runs in Common/surfaceMesh.cpp, in parallel over slabs;
+//  the mesh is in physical coordinates with outward facing triangles.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "itkImage.h"
+#include "compactImageIO.h"
+#include "pixelTypeDispatch.h"
+#include "surfaceMesh.h"
+
+
+struct SurfaceExtraction
+{
+	const char * inputImage;
+	std::string outputMesh;
+	std::string isoValue;
+	double cellSize;
+	unsigned int threads;
+
+	template< class TPixel >
+	int Run() const;
+};
+
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+
+template< class TPixel >
+int SurfaceExtraction::Run() const
+{
+	typedef itk::Image< TPixel, 3 > ImageType;
+
+	////////////////////////////////////////////////
+	// 1) Read the input image
+
+	typename ImageType::Pointer image;
+	try {
+		image = medimg::ReadImageFile< ImageType >( inputImage );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	const medimg::Geometry geometry = medimg::ImageGeometry( image.GetPointer() );
+	const TPixel *buffer = image->GetBufferPointer();
+
+	double iso;
+	if( isoValue.empty() ) {
+		iso = 0.5 * static_cast<double>( *std::max_element( buffer, buffer + geometry.dims.Voxels() ) );
+	}
+	else {
+		iso = atof( isoValue.c_str() );
+	}
+
+	////////////////////////////////////////////////
+	// 2) Marching cubes and decimation
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	medimg::TriangleMesh mesh;
+	medimg::MarchingCubes( buffer, geometry, iso, mesh, threads );
+	std::cout << "Marching cubes at " << iso << ": " << mesh.Vertices() << " vertices, "
+		<< mesh.Faces() << " triangles in " << Seconds( start ) << " s" << std::endl;
+
+	if( cellSize > 0 ) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		medimg::DecimateByClustering( mesh, cellSize );
+		std::cout << "Decimated to " << mesh.Vertices() << " vertices, "
+			<< mesh.Faces() << " triangles in " << Seconds( start ) << " s" << std::endl;
+	}
+	std::cout << "Enclosed volume " << medimg::MeshVolume( mesh ) / 1000.0 << " ml" << std::endl;
+
+	////////////////////////////////////////////////
+	// 3) Write the mesh
+
+	const std::string extension = outputMesh.size() > 4 ?
+		outputMesh.substr( outputMesh.size() - 4 ) : std::string();
+	std::string error;
+	bool written;
+	if( extension == ".ply" || extension == ".PLY" ) {
+		written = medimg::WritePLY( outputMesh, mesh, error );
+	}
+	else {
+		written = medimg::WriteSTL( outputMesh, mesh, error );
+	}
+	if( !written ) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	// Validate input parameters
+	if (argc < 3) {
+		std::cerr << "Usage:" << std::endl;
+		std::cerr << argv[0];
+		std::cerr << " <InputImage> <OutputMesh.stl|.ply> [isoValue] [decimationCellSize] [threads]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	SurfaceExtraction extraction;
+	extraction.inputImage = argv[1];
+	extraction.outputMesh = argv[2];
+	extraction.isoValue = argc > 3 ? argv[3] : "";
+	extraction.cellSize = argc > 4 ? atof( argv[4] ) : 0.0;
+	extraction.threads = argc > 5 ? static_cast<unsigned int>( std::max( 0, atoi( argv[5] ) ) ) : 0;
+
+	return medimg::DispatchOnPixelType( extraction.inputImage, extraction );
+}
@@ -0,0 +1,158 @@
+//
+//  connectedcomponents.cpp
+//  ITKVessel
+//
+//  Thresholded region growing and connected-component labeling of a
+//  vesselness (or any) image with the parallel engine in
+//  Common/connectedComponents.h, in place of growing regions in external
+//  tools.
+//
+//  With a seed file the voxels within [lower, upper] connected to a seed
+//  are written as a 0/255 mask, like ITK's ConnectedThresholdImageFilter.
+//  Without one, every connected component of the thresholded image gets
+//  its own label, and per-component statistics (size, bounding box, mean
+//  intensity) can be written as CSV. Components smaller than a minimum
+//  size, e.g. the blobs left where growing leaked onto the liver surface,
+//  are dropped and the rest renumbered.
+//
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "itkImage.h"
+#include "connectedComponents.h"
+#include "nativeImage.h"
+#include "seedFile.h"
+
+
+template< class TImage, class TReference >
+static typename TImage::Pointer AllocateLike(const TReference *reference)
+{
+	typename TImage::Pointer image = TImage::New();
+	image->CopyInformation( reference );
+	image->SetRegions( reference->GetBufferedRegion() );
+	image->Allocate();
+	return image;
+}
+
+
+static bool WriteStatistics(const char * filename,
+	const std::vector<medimg::ComponentStats> &stats)
+{
+	std::ofstream file( filename );
+	file << "label,voxels,xmin,ymin,zmin,xmax,ymax,zmax,mean\n";
+	for( std::size_t k = 0; k < stats.size(); ++k ) {
+		const medimg::ComponentStats &s = stats[k];
+		file << k + 1 << "," << s.Voxels;
+		for( int a = 0; a < 3; ++a ) {
+			file << "," << s.Bounds.lo[a];
+		}
+		// Inclusive, like ITK's bounding boxes
+		for( int a = 0; a < 3; ++a ) {
+			file << "," << s.Bounds.hi[a] - 1;
+		}
+		file << "," << s.Mean() << "\n";
+	}
+	return static_cast<bool>( file );
+}
+
+
+int main(int argc, const char * argv[])
+{
+	// Validate input parameters
+	if (argc < 5) {
+		std::cerr << "Usage: "
+			<< argv[0]
+			<< " <InputImage> <OutputImage> <lower> <upper> [6|18|26]"
+			<< " [SeedFile] [StatisticsCSV] [minVoxels]"
+			<< std::endl;
+		return EXIT_FAILURE;
+	}
+	const float lower = atof( argv[3] );
+	const float upper = atof( argv[4] );
+	medimg::Connectivity connectivity = medimg::Connect26;
+	if( argc > 5 ) {
+		const int n = atoi( argv[5] );
+		if( n != 6 && n != 18 && n != 26 ) {
+			std::cerr << "Connectivity must be 6, 18 or 26" << std::endl;
+			return EXIT_FAILURE;
+		}
+		connectivity = static_cast<medimg::Connectivity>( n );
+	}
+	const char * seedFile = NULL;
+	if( argc > 6 && argv[6][0] != '\0' ) {
+		seedFile = argv[6];
+	}
+	const char * statisticsFile = NULL;
+	if( argc > 7 && argv[7][0] != '\0' ) {
+		statisticsFile = argv[7];
+	}
+	std::size_t minVoxels = 0;
+	if( argc > 8 ) {
+		minVoxels = atol( argv[8] );
+	}
+
+	FloatImageType::Pointer input = ReadFloatImage( argv[1] );
+	if( !input ) {
+		return EXIT_FAILURE;
+	}
+	const medimg::Dims dims = NativeDims( input.GetPointer() );
+	const float *I = input->GetBufferPointer();
+
+	////////////////////////////////////////////////
+	// 1) Region growing from seeds
+
+	if( seedFile ) {
+		std::vector<std::size_t> seeds;
+		std::string error;
+		if( !medimg::ReadSeedFile( seedFile, dims, seeds, error ) ) {
+			std::cerr << error << std::endl;
+			return EXIT_FAILURE;
+		}
+		MaskImageType::Pointer mask = AllocateLike< MaskImageType >( input.GetPointer() );
+		const std::size_t voxels = medimg::ConnectedThreshold( I, dims, lower, upper, seeds,
+			connectivity, mask->GetBufferPointer() );
+		std::cout << "Region: " << voxels << " voxels from " << seeds.size() << " seeds" << std::endl;
+		return WriteImage( mask.GetPointer(), argv[2] );
+	}
+
+	////////////////////////////////////////////////
+	// 2) Labeling of all components
+
+	typedef itk::Image< unsigned int, 3 > LabelImageType;
+	LabelImageType::Pointer labels = AllocateLike< LabelImageType >( input.GetPointer() );
+	unsigned int components;
+	std::vector<medimg::ComponentStats> stats;
+	{
+		std::vector<unsigned char> B( dims.Voxels() );
+		for( std::size_t i = 0; i < dims.Voxels(); ++i ) {
+			B[i] = I[i] >= lower && I[i] <= upper;
+		}
+		components = medimg::LabelConnectedComponents( &B[0], dims, connectivity,
+			labels->GetBufferPointer(), &stats, I );
+	}
+	std::cout << "Components: " << components << std::endl;
+
+	if( minVoxels > 0 ) {
+		std::vector<unsigned int> map( components + 1, 0 );
+		std::vector<medimg::ComponentStats> kept;
+		for( unsigned int k = 0; k < components; ++k ) {
+			if( stats[k].Voxels >= minVoxels ) {
+				kept.push_back( stats[k] );
+				map[k + 1] = static_cast<unsigned int>( kept.size() );
+			}
+		}
+		medimg::RelabelComponents( labels->GetBufferPointer(), dims, map );
+		stats.swap( kept );
+		std::cout << "Kept " << stats.size() << " components of at least " << minVoxels
+			<< " voxels" << std::endl;
+	}
+
+	if( statisticsFile && !WriteStatistics( statisticsFile, stats ) ) {
+		std::cerr << "Error writing " << statisticsFile << std::endl;
+		return EXIT_FAILURE;
+	}
+	return WriteImage( labels.GetPointer(), argv[2] );
+}
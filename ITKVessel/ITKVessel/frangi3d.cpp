@@ -0,0 +1,157 @@
+//
+//  frangi3d.cpp
+//  ITKVessel
+//
+//  Command-line equivalent of FrangiFilter3D.m that runs the native tiled
+//  kernel in Common/vesselness.cpp, so no MATLAB runtime is needed. The
+//  options follow the MATLAB options struct and the outputs are Iout and,
+//  optionally, whatScale and the Vx/Vy/Vz vessel directions.
+//
+//  INPUT:
+//    - input image (any type readable by ITK, or a MATLAB .mat volume such as
+//      ExampleVolumeStent.mat, filtered as float)
+//    - output image for Iout
+//    - FrangiScaleRange start and end, FrangiScaleRatio
+//    - FrangiAlpha, FrangiBeta, FrangiC
+//    - BlackWhite (1 for black ridges, 0 for white ridges)
+//    - output image for whatScale
+//    - prefix for the direction images <prefix>Vx, Vy, Vz, written in the
+//      format of the output image (<prefix>Vx.mhd for J.mhd)
+//    - 1 to compute the Hessian like Hessian3D.m (for regression tests)
+//
+//  frangi3dRegression.m checks this mode against FrangiFilter3D.m on
+//  ExampleVolumeStent.mat; it is run by CTest when MATLAB is found.
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "itkImage.h"
+#include "itkImageFileWriter.h"
+#include "compactImageIO.h"
+#include "vesselness.h"
+
+
+typedef itk::Image< float, 3 > ImageType;
+
+static ImageType::Pointer AllocateLike(const ImageType *reference)
+{
+	ImageType::Pointer image = ImageType::New();
+	image->CopyInformation( reference );
+	image->SetRegions( reference->GetBufferedRegion() );
+	image->Allocate();
+	return image;
+}
+
+// Extension of filename, including a trailing .gz (".mhd", ".nii.gz")
+static std::string Extension(const std::string &filename)
+{
+	const std::string::size_type slash = filename.find_last_of( "/\\" );
+	const std::string name = slash == std::string::npos ? filename : filename.substr( slash + 1 );
+	std::string::size_type dot = name.rfind( '.' );
+	if( dot != std::string::npos && dot > 0 && name.compare( dot, std::string::npos, ".gz" ) == 0 ) {
+		const std::string::size_type inner = name.rfind( '.', dot - 1 );
+		if( inner != std::string::npos && inner > 0 ) {
+			dot = inner;
+		}
+	}
+	return dot == std::string::npos || dot == 0 ? std::string( ".mha" ) : name.substr( dot );
+}
+
+static int WriteImage(const ImageType *image, const std::string &filename)
+{
+	typedef itk::ImageFileWriter< ImageType > WriterType;
+	WriterType::Pointer writer = WriterType::New();
+	writer->SetInput( image );
+	writer->SetFileName( filename );
+	try {
+		writer->Update();
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+
+int main(int argc, const char * argv[])
+{
+	// Validate input parameters
+	if (argc < 3) {
+		std::cerr << "Usage: "
+			<< argv[0]
+			<< " <InputImage> <OutputImage> [scaleStart] [scaleEnd] [scaleRatio]"
+			<< " [alpha] [beta] [c] [blackWhite] [ScaleImage] [DirectionPrefix]"
+			<< " [matlabHessian]"
+			<< std::endl;
+		return EXIT_FAILURE;
+	}
+
+	medimg::FrangiOptions options;
+	if( argc > 3 ) { options.FrangiScaleRange[0] = atof( argv[3] ); }
+	if( argc > 4 ) { options.FrangiScaleRange[1] = atof( argv[4] ); }
+	if( argc > 5 ) { options.FrangiScaleRatio = atof( argv[5] ); }
+	if( argc > 6 ) { options.FrangiAlpha = atof( argv[6] ); }
+	if( argc > 7 ) { options.FrangiBeta = atof( argv[7] ); }
+	if( argc > 8 ) { options.FrangiC = atof( argv[8] ); }
+	if( argc > 9 ) { options.BlackWhite = atoi( argv[9] ) != 0; }
+	const char * scaleImage = argc > 10 && argv[10][0] ? argv[10] : NULL;
+	const char * directionPrefix = argc > 11 && argv[11][0] ? argv[11] : NULL;
+	if( argc > 12 ) { options.CentralDifferenceHessian = atoi( argv[12] ) != 0; }
+
+	////////////////////////////////////////////////
+	// 1) Read the input image
+
+	ImageType::Pointer input;
+	try {
+		input = medimg::ReadImageFile< ImageType >( argv[1] );
+	} catch (itk::ExceptionObject &excp) {
+		std::cerr << "Exception thrown while reading the image" << std::endl;
+		std::cerr << excp << std::endl;
+		return EXIT_FAILURE;
+	}
+	const ImageType::SizeType size = input->GetBufferedRegion().GetSize();
+	const medimg::Dims dims( size[0], size[1], size[2] );
+
+	////////////////////////////////////////////////
+	// 2) Frangi filter, writing straight into the output image buffers
+
+	ImageType::Pointer Iout = AllocateLike( input );
+	ImageType::Pointer whatScale, Vx, Vy, Vz;
+	medimg::FrangiOutputs outputs;
+	outputs.Iout = Iout->GetBufferPointer();
+	if( scaleImage ) {
+		whatScale = AllocateLike( input );
+		outputs.whatScale = whatScale->GetBufferPointer();
+	}
+	if( directionPrefix ) {
+		Vx = AllocateLike( input );
+		Vy = AllocateLike( input );
+		Vz = AllocateLike( input );
+		outputs.Vx = Vx->GetBufferPointer();
+		outputs.Vy = Vy->GetBufferPointer();
+		outputs.Vz = Vz->GetBufferPointer();
+	}
+	medimg::FrangiFilter3D( input->GetBufferPointer(), dims, options, outputs );
+
+	////////////////////////////////////////////////
+	// 3) Write output images
+
+	if( WriteImage( Iout, argv[2] ) != EXIT_SUCCESS ) {
+		return EXIT_FAILURE;
+	}
+	if( scaleImage && WriteImage( whatScale, scaleImage ) != EXIT_SUCCESS ) {
+		return EXIT_FAILURE;
+	}
+	if( directionPrefix ) {
+		const std::string prefix( directionPrefix );
+		const std::string extension = Extension( argv[2] );
+		if( WriteImage( Vx, prefix + "Vx" + extension ) != EXIT_SUCCESS ||
+			WriteImage( Vy, prefix + "Vy" + extension ) != EXIT_SUCCESS ||
+			WriteImage( Vz, prefix + "Vz" + extension ) != EXIT_SUCCESS ) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return 0;
+}
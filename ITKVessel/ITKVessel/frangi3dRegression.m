@@ -0,0 +1,77 @@
+function frangi3dRegression(frangi3d, referenceDir)
+% FRANGI3DREGRESSION  Checks the native frangi3d tool against FrangiFilter3D.m
+%
+%   frangi3dRegression(frangi3d, referenceDir) runs FrangiFilter3D from
+%   referenceDir (frangi_filter_version2a; its MEX files are compiled into
+%   the current directory when missing) on ExampleVolumeStent.mat, runs the
+%   frangi3d executable in its central-difference mode (Hessian like
+%   Hessian3D.m) on the same file, and raises an error when
+%
+%     - Iout differs by more than 1e-3 anywhere (both are in [0, 1]),
+%     - whatScale differs at more than 0.1% of the voxels (near ties between
+%       scales go either way between single and double precision),
+%     - Vx/Vy/Vz, where whatScale agrees and Iout > 1e-3, are further apart
+%       than 1 - |cos(angle)| = 1e-3 (eigenvectors have no sign).
+%
+%   Run by CTest (see CMakeLists.txt), or by hand from the build directory:
+%
+%     frangi3dRegression('./frangi3d', '../../frangi_filter_version2a')
+
+IoutTolerance = 1e-3;
+scaleTolerance = 1e-3;
+directionTolerance = 1e-3;
+
+addpath(referenceDir);
+if exist('eig3volume', 'file') ~= 3
+    mex(fullfile(referenceDir, 'eig3volume.c'));
+end
+if exist('imgaussian', 'file') ~= 3
+    mex(fullfile(referenceDir, 'imgaussian.c'));
+end
+
+% MATLAB reference
+volume = fullfile(referenceDir, 'ExampleVolumeStent.mat');
+load(volume, 'V');
+options = struct('FrangiScaleRange', [1 4], 'FrangiScaleRatio', 1, ...
+    'FrangiAlpha', 0.5, 'FrangiBeta', 0.5, 'FrangiC', 500, ...
+    'BlackWhite', false, 'verbose', false);
+[J, S, Vx, Vy, Vz] = FrangiFilter3D(V, options);
+
+% Native tool on the same file, written as MetaImage headers and raw data
+status = system(sprintf('"%s" "%s" J.mhd 1 4 1 0.5 0.5 500 0 S.mhd native 1', ...
+    frangi3d, volume));
+if status ~= 0
+    error('frangi3dRegression:tool', 'frangi3d failed with status %d', status);
+end
+Jn = readRaw('J.raw', size(V));
+Sn = readRaw('S.raw', size(V));
+Vxn = readRaw('nativeVx.raw', size(V));
+Vyn = readRaw('nativeVy.raw', size(V));
+Vzn = readRaw('nativeVz.raw', size(V));
+
+IoutError = max(abs(double(J(:)) - Jn(:)));
+scaleMismatch = mean(double(S(:)) ~= Sn(:));
+compared = S(:) == Sn(:) & J(:) > 1e-3;
+cosine = abs(double(Vx(:)) .* Vxn(:) + double(Vy(:)) .* Vyn(:) + double(Vz(:)) .* Vzn(:)) ...
+    ./ sqrt(double(Vx(:)).^2 + double(Vy(:)).^2 + double(Vz(:)).^2) ...
+    ./ sqrt(Vxn(:).^2 + Vyn(:).^2 + Vzn(:).^2);
+directionError = max([0; 1 - cosine(compared)]);
+
+fprintf('Iout max difference %g (tolerance %g)\n', IoutError, IoutTolerance);
+fprintf('whatScale differs at %g%% of voxels (tolerance %g%%)\n', ...
+    100 * scaleMismatch, 100 * scaleTolerance);
+fprintf('Vx/Vy/Vz max 1 - |cos| %g over %d voxels (tolerance %g)\n', ...
+    directionError, nnz(compared), directionTolerance);
+if IoutError > IoutTolerance || scaleMismatch > scaleTolerance || ...
+        directionError > directionTolerance
+    error('frangi3dRegression:mismatch', 'frangi3d does not reproduce FrangiFilter3D');
+end
+
+
+function values = readRaw(filename, dims)
+fid = fopen(filename, 'r');
+if fid < 0
+    error('frangi3dRegression:read', 'Cannot open %s', filename);
+end
+values = reshape(fread(fid, inf, 'single=>double'), dims);
+fclose(fid);
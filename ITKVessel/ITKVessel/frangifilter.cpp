@@ -4,46 +4,133 @@
 //
 //  Created by Jonathan Young on 1/15/16.
 //
+//  With a memory budget (in MB) the volume is filtered in overlapping
+//  z-slabs sized to fit it, see slabStreaming.h.
+//
+//  The pipeline is instantiated for the pixel type stored in the input
+//  file, so no cast is needed on load, and the Hessian can be kept in
+//  float instead of double (24 instead of 48 bytes per voxel). The
+//  objectness is computed into unsigned short, as it always was, before
+//  it is rescaled to the unsigned char output; with `float` as measure
+//  type its fractional part is kept, which changes the output.
+//
+//  Given a mask (e.g. livermap.mha), the same objectness is computed by
+//  the native kernel in Common/objectness.h instead, only for voxels within
+//  the kernel support of the mask; tiles without such voxels are skipped.
+//  Outside that region the output is 0. The native kernel samples the
+//  Gaussian derivatives, where ITK uses recursive Gaussians, so voxels
+//  inside the mask differ slightly from an unmasked run (a mask of ones
+//  gives the unmasked native result). It tiles the volume and keeps its
+//  Hessian tiles in float, so a memory budget or float Hessian given with
+//  a mask is ignored, with a warning.
+//
+//  The native kernel is also used when clamp limits are given: the input
+//  is clamped to [clampLow, clampHigh] before filtering, e.g. to the range
+//  of contrast-enhanced vessels so that the edges of bone and air do not
+//  respond. This is a choice that changes the vesselness wherever the input
+//  leaves the range, not an optimization. Independently of it, tiles whose
+//  (clamped) input is constant over the kernel support have a zero Hessian
+//  and are skipped from the per-brick intensity summary, which leaves the
+//  output unchanged.
+//
+//  With MEDIMG_PROFILE or MEDIMG_TRACE set, the time and memory of every
+//  stage are reported (Common/stageProfiler.h).
+//
 
+#include <cstring>
 #include <iostream>
+#include <vector>
 #include "itkImage.h"
-#include "itkImageFileReader.h"
+#include "itkCastImageFilter.h"
 #include "itkImageFileWriter.h"
 #include "itkHessianToObjectnessMeasureImageFilter.h"
 #include "itkMultiScaleHessianBasedMeasureImageFilter.h"
 #include "itkRescaleIntensityImageFilter.h"
+#include "nativeImage.h"
+#include "objectness.h"
+#include "pipelineProfiler.h"
+#include "pixelTypeDispatch.h"
+#include "slabStreaming.h"
 
 
-int main(int argc, const char * argv[])
+// Objectness of input with the settings of the ITK pipeline below,
+// restricted to the support of the mask and with the input clamped to
+// [clamp[0], clamp[1]] when given (either may be NULL)
+template< class TImage >
+static FloatImageType::Pointer NativeObjectness(const TImage *input,
+	const char * maskImage, const char * const clamp[2],
+	const std::vector<double> &sigmas, medimg::StageProfiler &profiler)
 {
-    // Validate input parameters
-    if (argc < 2) {
-        std::cerr << "Usage: "
-        << argv[0]
-        << " <InputImage> <OutputImage>"
-        << std::endl;
-        return EXIT_FAILURE;
-    }
+	profiler.Begin( "cast" );
+	const FloatImageType::Pointer image = CastToFloat( input );
+	profiler.End();
+	medimg::ObjectnessOptions options;
+	options.Sigmas = sigmas;
+	for( int a = 0; a < 3; ++a ) {
+		options.Spacing[a] = image->GetSpacing()[a];
+	}
+	MaskImageType::Pointer mask;
+	if( maskImage ) {
+		medimg::ScopedStage stage( profiler, "read mask" );
+		mask = ReadMask( maskImage, image.GetPointer() );
+		if( !mask ) {
+			return FloatImageType::Pointer();
+		}
+		options.Mask = mask->GetBufferPointer();
+	}
+	if( clamp[0] && clamp[1] ) {
+		options.IntensityClamp[0] = atof( clamp[0] );
+		options.IntensityClamp[1] = atof( clamp[1] );
+	}
+	options.Alpha = 0.5;
+	options.Beta = 0.5;
+	options.Gamma = 10.0;
+	options.BrightObject = true;
+	options.ScaleObjectnessMeasure = true;
+
+	medimg::ScopedStage stage( profiler, "objectness" );
+	FloatImageType::Pointer vesselness = AllocateFloatLike( image.GetPointer() );
+	medimg::ObjectnessFilter3D( image->GetBufferPointer(), NativeDims( image.GetPointer() ),
+		options, vesselness->GetBufferPointer() );
+	return vesselness;
+}
 
+
+template< class TInputPixel, class THessianValue, class TMeasurePixel >
+int FrangiFilter(const char * inputImage, const char * outputImage,
+	const char * memoryBudget, const char * maskImage, const char * const clamp[2])
+{
     const unsigned int Dimension = 3;
-    typedef unsigned short PixelType;
+    typedef TInputPixel PixelType;
+    typedef TMeasurePixel MeasurePixelType;
     typedef itk::Image< PixelType, Dimension > ImageType;
+    typedef itk::Image< MeasurePixelType, Dimension > MeasureImageType;
+
+	medimg::StageProfiler profiler( "frangifilter" );
+	medimg::UseITKThreads( profiler );
 
     ////////////////////////////////////////////////
     // 1) Read the input image
 
-	typedef itk::ImageFileReader< ImageType >  ReaderType;
-	ReaderType::Pointer reader = ReaderType::New();
-	reader->SetFileName( argv[1] );
+	// Through compactImageIO.h, so that MAT-files can be read as well
+	typename ImageType::Pointer input;
+	try {
+		medimg::ScopedStage stage( profiler, "read" );
+		input = medimg::ReadImageFile< ImageType >( inputImage );
+	} catch (itk::ExceptionObject &excp) {
+		std::cerr << "Exception thrown while reading the image" << std::endl;
+		std::cerr << excp << std::endl;
+		return EXIT_FAILURE;
+	}
 
     ////////////////////////////////////////////////
     // 2) Antiga (Frangi-based) filter
 
-	typedef itk::SymmetricSecondRankTensor< double, Dimension > HessianPixelType;
+	typedef itk::SymmetricSecondRankTensor< THessianValue, Dimension > HessianPixelType;
 	typedef itk::Image< HessianPixelType, Dimension > HessianImageType;
 	typedef itk::HessianToObjectnessMeasureImageFilter<HessianImageType,
-	ImageType> ObjectnessFilterType;
-	ObjectnessFilterType::Pointer objectnessFilter = ObjectnessFilterType::New();
+	MeasureImageType> ObjectnessFilterType;
+	typename ObjectnessFilterType::Pointer objectnessFilter = ObjectnessFilterType::New();
 	objectnessFilter->SetBrightObject( true );
 	objectnessFilter->SetScaleObjectnessMeasure( false );
 	objectnessFilter->SetAlpha( 0.5 );
@@ -52,39 +139,174 @@ int main(int argc, const char * argv[])
 	objectnessFilter->SetScaleObjectnessMeasure(1);
 
 	typedef itk::MultiScaleHessianBasedMeasureImageFilter<ImageType,
-	HessianImageType, ImageType> MultiScaleEnhancementFilterType;
-	MultiScaleEnhancementFilterType::Pointer multiScaleEnhancementFilter =
+	HessianImageType, MeasureImageType> MultiScaleEnhancementFilterType;
+	typename MultiScaleEnhancementFilterType::Pointer multiScaleEnhancementFilter =
 		MultiScaleEnhancementFilterType::New();
-	multiScaleEnhancementFilter->SetInput(reader->GetOutput());
+	const double sigmaMaximum = 3.0;
 	multiScaleEnhancementFilter->SetHessianToMeasureFilter( objectnessFilter );
 	multiScaleEnhancementFilter->SetSigmaStepMethodToEquispaced();
 	multiScaleEnhancementFilter->SetSigmaMinimum( 1.0 );
-	multiScaleEnhancementFilter->SetSigmaMaximum( 3.0 );
+	multiScaleEnhancementFilter->SetSigmaMaximum( sigmaMaximum );
 	multiScaleEnhancementFilter->SetNumberOfSigmaSteps( 3 );
+	medimg::ProfileFilter( profiler, multiScaleEnhancementFilter, "multiscale objectness" );
+
+	typename MeasureImageType::Pointer vesselness;
+	try {
+		if( maskImage || clamp[0] ) {
+			// Equispaced sigmas as set above
+			std::vector<double> sigmas;
+			for( double sigma = 1.0; sigma <= sigmaMaximum; sigma += 1.0 ) {
+				sigmas.push_back( sigma );
+			}
+			const FloatImageType::Pointer objectness =
+				NativeObjectness( input.GetPointer(), maskImage, clamp, sigmas, profiler );
+			if( !objectness ) {
+				return EXIT_FAILURE;
+			}
+			// Truncated like the output of the objectness filter
+			typedef itk::CastImageFilter< FloatImageType, MeasureImageType > CastFilterType;
+			typename CastFilterType::Pointer caster = CastFilterType::New();
+			caster->SetInput( objectness );
+			caster->InPlaceOn();
+			caster->Update();
+			vesselness = caster->GetOutput();
+		}
+		else if( memoryBudget ) {
+			// The whole input, the assembled output and its rescaled copy stay
+			// in memory; the rest of the budget goes to the slab pipeline
+			const double voxels = input->GetLargestPossibleRegion().GetNumberOfPixels();
+			const double budget = atof( memoryBudget ) * 1024.0 * 1024.0
+				- voxels * ( sizeof(PixelType) + sizeof(MeasurePixelType) + sizeof(unsigned char) );
+			// The tensor image is 48 of the budgeted bytes per voxel in double
+			const double bytesPerVoxel = HessianPipelineBytesPerVoxel
+				- 6 * ( sizeof(double) - sizeof(THessianValue) );
+			const unsigned int halo = SlabHalo( input.GetPointer(), sigmaMaximum );
+			const unsigned int planes = SlabPlanes( input.GetPointer(), halo, bytesPerVoxel, budget );
+			if( planes == 0 ) {
+				std::cerr << "Memory budget too small for a single slab" << std::endl;
+				return EXIT_FAILURE;
+			}
+			medimg::ScopedStage stage( profiler, "slabs" );
+			vesselness = ProcessInSlabs< ImageType, MeasureImageType >( input.GetPointer(), planes, halo,
+				[&](ImageType *slab) {
+					multiScaleEnhancementFilter->SetInput( slab );
+					multiScaleEnhancementFilter->Update();
+					return typename MeasureImageType::Pointer(
+						multiScaleEnhancementFilter->GetOutput() );
+				} );
+		}
+		else {
+			multiScaleEnhancementFilter->SetInput( input.GetPointer() );
+			multiScaleEnhancementFilter->Update();
+			vesselness = multiScaleEnhancementFilter->GetOutput();
+		}
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
 
     ////////////////////////////////////////////////
     // 3) Rescale image intensity
 
 	typedef itk::Image< unsigned char, Dimension > OutputImageType;
-	typedef itk::RescaleIntensityImageFilter< ImageType, OutputImageType >
+	typedef itk::RescaleIntensityImageFilter< MeasureImageType, OutputImageType >
 		RescaleFilterType;
-	RescaleFilterType::Pointer rescaleFilter = RescaleFilterType::New();
-	rescaleFilter->SetInput( multiScaleEnhancementFilter->GetOutput() );
+	typename RescaleFilterType::Pointer rescaleFilter = RescaleFilterType::New();
+	rescaleFilter->SetInput( vesselness );
+	medimg::ProfileFilter( profiler, rescaleFilter, "rescale" );
 
     ////////////////////////////////////////////////
     // 4) Write output image
 
-	const char * outputImage = argv[2];
 	typedef itk::ImageFileWriter< OutputImageType > WriterType;
-    WriterType::Pointer writer = WriterType::New();
+    typename WriterType::Pointer writer = WriterType::New();
     writer->SetInput( rescaleFilter->GetOutput() );
     writer->SetFileName( outputImage );
+	medimg::ProfileFilter( profiler, writer, "write" );
     try {
         writer->Update();
     } catch (itk::ExceptionObject & error) {
         std::cerr << "Error: " << error << std::endl;
         return EXIT_FAILURE;
     }
-	
+
 	return 0;
 }
+
+
+// Picks the instantiation for the input pixel type, Hessian precision and
+// measure type
+struct FrangiFilterDispatch
+{
+	const char * inputImage;
+	const char * outputImage;
+	const char * memoryBudget;
+	const char * maskImage;
+	const char * clamp[2];
+	bool floatHessian;
+	bool floatMeasure;
+
+	template< class TInputPixel, class THessianValue >
+	int RunWithHessian() const
+	{
+		if( floatMeasure ) {
+			return FrangiFilter< TInputPixel, THessianValue, float >( inputImage, outputImage,
+				memoryBudget, maskImage, clamp );
+		}
+		return FrangiFilter< TInputPixel, THessianValue, unsigned short >( inputImage, outputImage,
+			memoryBudget, maskImage, clamp );
+	}
+
+	template< class TInputPixel >
+	int Run() const
+	{
+		if( floatHessian ) {
+			return RunWithHessian< TInputPixel, float >();
+		}
+		return RunWithHessian< TInputPixel, double >();
+	}
+};
+
+
+int main(int argc, const char * argv[])
+{
+    // Validate input parameters
+    if (argc < 3) {
+        std::cerr << "Usage: "
+        << argv[0]
+        << " <InputImage> <OutputImage> [memoryBudgetMB] [float|double Hessian]"
+        << " [MaskImage] [clampLow clampHigh] [ushort|float measure]"
+        << std::endl;
+        return EXIT_FAILURE;
+    }
+	FrangiFilterDispatch dispatch;
+	dispatch.inputImage = argv[1];
+	dispatch.outputImage = argv[2];
+	dispatch.memoryBudget = NULL;
+	if( argc > 3 && atof( argv[3] ) > 0 ) {
+		dispatch.memoryBudget = argv[3];
+	}
+	dispatch.floatHessian = argc > 4 && strcmp( argv[4], "float" ) == 0;
+	dispatch.maskImage = NULL;
+	if( argc > 5 && argv[5][0] != '\0' ) {
+		dispatch.maskImage = argv[5];
+	}
+	dispatch.clamp[0] = dispatch.clamp[1] = NULL;
+	if( argc > 7 && argv[6][0] != '\0' && argv[7][0] != '\0' ) {
+		dispatch.clamp[0] = argv[6];
+		dispatch.clamp[1] = argv[7];
+	}
+	dispatch.floatMeasure = argc > 8 && strcmp( argv[8], "float" ) == 0;
+	if( dispatch.maskImage || dispatch.clamp[0] ) {
+		if( dispatch.memoryBudget ) {
+			std::cout << "Native mode keeps only its outputs; memory budget ignored"
+				<< std::endl;
+		}
+		if( dispatch.floatHessian ) {
+			std::cout << "Native mode keeps its Hessian tiles in float; float Hessian ignored"
+				<< std::endl;
+		}
+	}
+
+	return medimg::DispatchOnPixelType( argv[1], dispatch );
+}
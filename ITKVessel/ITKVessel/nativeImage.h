@@ -0,0 +1,120 @@
+//
+//  nativeImage.h
+//  ITKVessel
+//
+//  Glue between ITK images and the native kernels in Common, which work on
+//  plain float and byte buffers with x varying fastest (the ITK layout).
+//
+
+#ifndef NATIVEIMAGE_H
+#define NATIVEIMAGE_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "itkCastImageFilter.h"
+#include "itkImage.h"
+#include "compactImageIO.h"
+#include "volume.h"
+
+
+typedef itk::Image< float, 3 > FloatImageType;
+typedef itk::Image< unsigned char, 3 > MaskImageType;
+
+// The input as float; the image itself (no copy) when it already is float.
+// Throws itk::ExceptionObject like the filter it runs.
+template< class TImage >
+FloatImageType::Pointer CastToFloat(const TImage *image)
+{
+	typedef itk::CastImageFilter< TImage, FloatImageType > CastFilterType;
+	typename CastFilterType::Pointer caster = CastFilterType::New();
+	caster->SetInput( image );
+	caster->InPlaceOn();
+	caster->Update();
+	FloatImageType::Pointer output = caster->GetOutput();
+	output->DisconnectPipeline();
+	return output;
+}
+
+// Reads filename as float, whatever its pixel type (.bits and .rle files
+// included). Returns a null pointer after printing the error if it cannot
+// be read.
+inline FloatImageType::Pointer ReadFloatImage(const char * filename)
+{
+	try {
+		return medimg::ReadImageFile< FloatImageType >( filename );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return FloatImageType::Pointer();
+	}
+}
+
+// Writes image, in the compact formats for .bits and .rle (see
+// compactImageIO.h). EXIT_SUCCESS, or EXIT_FAILURE after printing the error.
+template< class TImage >
+int WriteImage(const TImage *image, const char * filename)
+{
+	try {
+		medimg::WriteImageFile( image, filename );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Empty float image with the geometry of reference
+template< class TImage >
+FloatImageType::Pointer AllocateFloatLike(const TImage *reference)
+{
+	FloatImageType::Pointer image = FloatImageType::New();
+	image->CopyInformation( reference );
+	image->SetRegions( reference->GetBufferedRegion() );
+	image->Allocate();
+	return image;
+}
+
+template< class TImage >
+medimg::Dims NativeDims(const TImage *image)
+{
+	const typename TImage::SizeType size = image->GetBufferedRegion().GetSize();
+	return medimg::Dims( size[0], size[1], size[2] );
+}
+
+// Sigmas of a comma-separated list (a single sigma gives one)
+inline std::vector<double> ParseSigmaList(const char * list)
+{
+	std::vector<double> sigmas;
+	for( const char * p = list; p && *p; ) {
+		char * end;
+		sigmas.push_back( strtod( p, &end ) );
+		p = *end == ',' ? end + 1 : end + strlen( end );
+	}
+	return sigmas;
+}
+
+// Reads a binary mask (nonzero = inside; any image file or a .bits mask)
+// and checks that it covers the same voxels as reference. Returns a null
+// pointer after printing the error otherwise.
+template< class TImage >
+MaskImageType::Pointer ReadMask(const char * filename, const TImage *reference)
+{
+	MaskImageType::Pointer mask;
+	try {
+		mask = medimg::ReadImageFile< MaskImageType >( filename );
+	} catch (itk::ExceptionObject &excp) {
+		std::cerr << "Exception thrown while reading the mask" << std::endl;
+		std::cerr << excp << std::endl;
+		return MaskImageType::Pointer();
+	}
+	if( mask->GetBufferedRegion().GetSize() != reference->GetBufferedRegion().GetSize() ) {
+		std::cerr << "Mask size " << mask->GetBufferedRegion().GetSize()
+			<< " differs from image size " << reference->GetBufferedRegion().GetSize()
+			<< std::endl;
+		return MaskImageType::Pointer();
+	}
+	return mask;
+}
+
+#endif
@@ -7,75 +7,189 @@
 //
 //  Created by Jonathan Young on 1/14/16.
 //
+//  With a memory budget (in MB) the volume is filtered in overlapping
+//  z-slabs sized to fit it, see slabStreaming.h. The pipeline is
+//  instantiated for the pixel type stored in the input file.
+//
+//  A comma-separated sigma list (e.g. 1,2,4,6) selects the native
+//  multiscale filter in Common/sato.h instead: the scales share one thread
+//  pool, and only the maximum response and, optionally, the 1-based index
+//  of the winning sigma are kept as volumes. The native filter is also
+//  used when a mask (e.g. livermap.mha) is given, and then only computes
+//  voxels within the kernel support of the mask, skipping empty tiles, and
+//  with clamp limits, which clamp the input to [clampLow, clampHigh] before
+//  filtering. Clamping changes the response wherever the input leaves the
+//  range; it is a choice (e.g. the range of contrast-enhanced vessels), not
+//  an optimization. Tiles whose (clamped) input is constant over the kernel
+//  support are skipped either way, which leaves the output unchanged. The
+//  native filter samples the Gaussian
+//  derivatives, where ITK uses recursive Gaussians, so a masked run
+//  differs slightly from an unmasked one with a single sigma; with a sigma
+//  list both use the native kernels and agree inside the mask. The native
+//  filter ignores a memory budget, and the ITK filter (a single sigma
+//  without mask) writes no scale image; both say so when given one.
+//
+//  With MEDIMG_PROFILE or MEDIMG_TRACE set, the time and memory of every
+//  stage are reported (Common/stageProfiler.h).
+//
 
+#include <cstdlib>
 #include <iostream>
+#include <vector>
 #include "itkImage.h"
-#include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkHessianRecursiveGaussianImageFilter.h"
 #include "itkHessian3DToVesselnessMeasureImageFilter.h"
+#include "nativeImage.h"
+#include "pipelineProfiler.h"
+#include "pixelTypeDispatch.h"
+#include "sato.h"
+#include "slabStreaming.h"
 
 
-int main(int argc, const char * argv[])
+// Command-line parameters; also picks the instantiation for the input
+// pixel type
+struct SatoFilterParameters
 {
-    // Validate input parameters
-    if (argc < 3) {
-        std::cerr << "Usage: " 
-			<< argv[0]
-            << " <InputImage> <OutputImage> [sigma] [alpha1] [alpha2]"
-            << std::endl;
-        return EXIT_FAILURE;
-    }
-	const char * inputImage = argv[1];
-	const char * outputImage = argv[2];
-	const char * sigma = NULL;
-	if( argc > 3 ) {
-		sigma = argv[3];
+	const char * inputImage;
+	const char * outputImage;
+	const char * sigma;
+	const char * alpha1;
+	const char * alpha2;
+	const char * memoryBudget;
+	const char * scaleImage;
+	const char * maskImage;
+	const char * clamp[2];
+
+	template< class TInputPixel >
+	int Run() const;
+};
+
+
+// Native Sato on a float copy of input (none is made when the input
+// already is float); writes the maximum and the scale index.
+template< class TInputImage >
+static int NativeSato(const TInputImage *input, const SatoFilterParameters &p,
+	const std::vector<double> &sigmas, medimg::StageProfiler &profiler)
+{
+	FloatImageType::Pointer image;
+	try {
+		medimg::ScopedStage stage( profiler, "cast" );
+		image = CastToFloat( input );
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
 	}
-	const char * alpha1 = NULL;
-	if( argc > 4 ) {
-		alpha1 = argv[4];
+
+	medimg::SatoOptions options;
+	options.Sigmas = sigmas;
+	// A single scale matches the ITK filter, which does not normalize
+	options.NormalizeAcrossScale = sigmas.size() > 1;
+	if( p.alpha1 ) {
+		options.Alpha1 = atof( p.alpha1 );
 	}
-	const char * alpha2 = NULL;
-	if( argc > 5 ) {
-		alpha2 = argv[5];
+	if( p.alpha2 ) {
+		options.Alpha2 = atof( p.alpha2 );
 	}
-    
+	for( int a = 0; a < 3; ++a ) {
+		options.Spacing[a] = image->GetSpacing()[a];
+	}
+	MaskImageType::Pointer mask;
+	if( p.maskImage ) {
+		medimg::ScopedStage stage( profiler, "read mask" );
+		mask = ReadMask( p.maskImage, image.GetPointer() );
+		if( !mask ) {
+			return EXIT_FAILURE;
+		}
+		options.Mask = mask->GetBufferPointer();
+	}
+	if( p.clamp[0] && p.clamp[1] ) {
+		options.IntensityClamp[0] = atof( p.clamp[0] );
+		options.IntensityClamp[1] = atof( p.clamp[1] );
+	}
+
+	FloatImageType::Pointer vesselness = AllocateFloatLike( image.GetPointer() );
+	FloatImageType::Pointer scale;
+	if( p.scaleImage ) {
+		scale = AllocateFloatLike( image.GetPointer() );
+	}
+	profiler.Begin( "sato" );
+	medimg::SatoFilter3D( image->GetBufferPointer(), NativeDims( image.GetPointer() ),
+		options, vesselness->GetBufferPointer(), scale ? scale->GetBufferPointer() : 0 );
+	profiler.End();
+
+	medimg::ScopedStage stage( profiler, "write" );
+	if( WriteImage( vesselness.GetPointer(), p.outputImage ) != EXIT_SUCCESS ) {
+		return EXIT_FAILURE;
+	}
+	if( scale ) {
+		return WriteImage( scale.GetPointer(), p.scaleImage );
+	}
+	return EXIT_SUCCESS;
+}
+
+
+template< class TInputPixel >
+int SatoFilterParameters::Run() const
+{
     const unsigned int Dimension = 3;
-    typedef unsigned short InputPixelType;
+    typedef TInputPixel InputPixelType;
 	typedef float OutputPixelType;
     typedef itk::Image< InputPixelType, Dimension > InputImageType;
     typedef itk::Image< OutputPixelType, Dimension > OutputImageType;
+    // Hessian3DToVesselnessMeasureImageFilter only accepts double tensors
+    typedef itk::Image< itk::SymmetricSecondRankTensor< double, Dimension >,
+        Dimension > HessianImageType;
+    
+	medimg::StageProfiler profiler( "satofilter" );
+	medimg::UseITKThreads( profiler );
     
     ////////////////////////////////////////////////
     // 1) Read the input series
     
-	typedef itk::ImageFileReader< InputImageType >  ReaderType;
-	ReaderType::Pointer reader = ReaderType::New();
-	reader->SetFileName( inputImage );
-
-    try {
-        reader->Update();
-    } catch (itk::ExceptionObject &excp) {
-        std::cerr << "Exception thrown while reading the series" << std::endl;
-        std::cerr << excp << std::endl;
-        return EXIT_FAILURE;
-    }
+	// Through compactImageIO.h, so that MAT-files can be read as well
+	typename InputImageType::Pointer input;
+	try {
+		medimg::ScopedStage stage( profiler, "read" );
+		input = medimg::ReadImageFile< InputImageType >( inputImage );
+	} catch (itk::ExceptionObject &excp) {
+		std::cerr << "Exception thrown while reading the series" << std::endl;
+		std::cerr << excp << std::endl;
+		return EXIT_FAILURE;
+	}
 	
     ////////////////////////////////////////////////
     // 2) Sato filter
 	
-	typedef itk::HessianRecursiveGaussianImageFilter< InputImageType > 
+	std::vector<double> sigmas = ParseSigmaList( sigma );
+	if( sigmas.size() > 1 || maskImage || clamp[0] ) {
+		if( memoryBudget ) {
+			std::cout << "Native mode keeps only its outputs; memory budget ignored"
+				<< std::endl;
+		}
+		if( sigmas.empty() ) {
+			// The default of the ITK Hessian filter
+			sigmas.push_back( 1.0 );
+		}
+		return NativeSato( input.GetPointer(), *this, sigmas, profiler );
+	}
+	
+	if( scaleImage ) {
+		std::cout << "A single sigma has no scale image; " << scaleImage << " not written"
+			<< std::endl;
+	}
+	
+	typedef itk::HessianRecursiveGaussianImageFilter< InputImageType, HessianImageType >
 		HessianFilterType;
-	HessianFilterType::Pointer hessianFilter = HessianFilterType::New();
-	hessianFilter->SetInput( reader->GetOutput() );
+	typename HessianFilterType::Pointer hessianFilter = HessianFilterType::New();
 	if( sigma ) {
 		hessianFilter->SetSigma( atof( sigma ) );
 	}
+	medimg::ProfileFilter( profiler, hessianFilter, "hessian" );
 	
 	typedef itk::Hessian3DToVesselnessMeasureImageFilter< OutputPixelType > 
 		VesselnessMeasureFilterType;
-	VesselnessMeasureFilterType::Pointer vesselnessFilter = 
+	typename VesselnessMeasureFilterType::Pointer vesselnessFilter = 
 		VesselnessMeasureFilterType::New();
 	vesselnessFilter->SetInput( hessianFilter->GetOutput() );
 	if( alpha1 ) {
@@ -84,14 +198,49 @@ int main(int argc, const char * argv[])
 	if( alpha2 ) {
 		vesselnessFilter->SetAlpha2( atof( alpha2 ) );
 	}
+	medimg::ProfileFilter( profiler, vesselnessFilter, "vesselness measure" );
+
+	typename OutputImageType::Pointer vesselness;
+	try {
+		if( memoryBudget ) {
+			// The whole input and the assembled output stay in memory; the rest
+			// of the budget goes to the slab pipeline
+			const double voxels = input->GetLargestPossibleRegion().GetNumberOfPixels();
+			const double budget = atof( memoryBudget ) * 1024.0 * 1024.0
+				- voxels * ( sizeof(InputPixelType) + sizeof(OutputPixelType) );
+			const unsigned int halo = SlabHalo( input.GetPointer(), hessianFilter->GetSigma() );
+			const unsigned int planes = SlabPlanes( input.GetPointer(), halo,
+				HessianPipelineBytesPerVoxel, budget );
+			if( planes == 0 ) {
+				std::cerr << "Memory budget too small for a single slab" << std::endl;
+				return EXIT_FAILURE;
+			}
+			medimg::ScopedStage stage( profiler, "slabs" );
+			vesselness = ProcessInSlabs< InputImageType, OutputImageType >( input.GetPointer(),
+				planes, halo, [&](InputImageType *slab) {
+					hessianFilter->SetInput( slab );
+					vesselnessFilter->Update();
+					return typename OutputImageType::Pointer( vesselnessFilter->GetOutput() );
+				} );
+		}
+		else {
+			hessianFilter->SetInput( input.GetPointer() );
+			vesselnessFilter->Update();
+			vesselness = vesselnessFilter->GetOutput();
+		}
+	} catch (itk::ExceptionObject & error) {
+		std::cerr << "Error: " << error << std::endl;
+		return EXIT_FAILURE;
+	}
 	
 	////////////////////////////////////////////////
     // 3) Write output image
     
 	typedef itk::ImageFileWriter< OutputImageType > WriterType;
-    WriterType::Pointer writer = WriterType::New();
-    writer->SetInput( vesselnessFilter->GetOutput() );
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( vesselness );
     writer->SetFileName( outputImage );
+	medimg::ProfileFilter( profiler, writer, "write" );
     
     try {
         writer->Update();
@@ -99,4 +248,53 @@ int main(int argc, const char * argv[])
         std::cerr << "Error: " << error << std::endl;
         return EXIT_FAILURE;
     }
+	return 0;
+}
+
+
+int main(int argc, const char * argv[])
+{
+    // Validate input parameters
+    if (argc < 3) {
+        std::cerr << "Usage: " 
+			<< argv[0]
+            << " <InputImage> <OutputImage> [sigma|sigma1,sigma2,...] [alpha1] [alpha2]"
+            << " [memoryBudgetMB] [ScaleImage] [MaskImage] [clampLow clampHigh]"
+            << std::endl;
+        return EXIT_FAILURE;
+    }
+	SatoFilterParameters parameters;
+	parameters.inputImage = argv[1];
+	parameters.outputImage = argv[2];
+	parameters.sigma = NULL;
+	if( argc > 3 ) {
+		parameters.sigma = argv[3];
+	}
+	parameters.alpha1 = NULL;
+	if( argc > 4 ) {
+		parameters.alpha1 = argv[4];
+	}
+	parameters.alpha2 = NULL;
+	if( argc > 5 ) {
+		parameters.alpha2 = argv[5];
+	}
+	parameters.memoryBudget = NULL;
+	if( argc > 6 && atof( argv[6] ) > 0 ) {
+		parameters.memoryBudget = argv[6];
+	}
+	parameters.scaleImage = NULL;
+	if( argc > 7 && argv[7][0] != '\0' ) {
+		parameters.scaleImage = argv[7];
+	}
+	parameters.maskImage = NULL;
+	if( argc > 8 && argv[8][0] != '\0' ) {
+		parameters.maskImage = argv[8];
+	}
+	parameters.clamp[0] = parameters.clamp[1] = NULL;
+	if( argc > 10 ) {
+		parameters.clamp[0] = argv[9];
+		parameters.clamp[1] = argv[10];
+	}
+
+	return medimg::DispatchOnPixelType( parameters.inputImage, parameters );
 }
@@ -0,0 +1,138 @@
+//
+//  vesselgraph.cpp
+//  ITKVessel
+//
+//  Vessel centerlines and their graph from a vesselness image (the output
+//  of frangifilter, satofilter or frangi3d). The image is thresholded
+//  inside the bounding box of the vessels only, thinned to a curve
+//  skeleton (Common/skeleton.h) and traced into nodes and branches that
+//  are streamed to a compact binary file (Common/vesselGraph.h). With the
+//  scale image written by the multiscale filters and their sigma list,
+//  every centerline voxel carries the radius estimated from the scale of
+//  its maximum response.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "itkImage.h"
+#include "nativeImage.h"
+#include "skeleton.h"
+#include "vesselGraph.h"
+
+
+// Radius of a cylinder whose normalized vesselness peaks at sigma
+static const double RadiusPerSigma = std::sqrt( 2.0 );
+
+
+int main(int argc, const char * argv[])
+{
+	// Validate input parameters
+	if (argc < 4) {
+		std::cerr << "Usage: "
+			<< argv[0]
+			<< " <VesselnessImage> <threshold> <OutputGraph> [ScaleImage sigma1,sigma2,...]"
+			<< std::endl;
+		return EXIT_FAILURE;
+	}
+	const float threshold = atof( argv[2] );
+	const char * scaleImage = NULL;
+	std::vector<double> sigmas;
+	if( argc > 5 ) {
+		scaleImage = argv[4];
+		sigmas = ParseSigmaList( argv[5] );
+	}
+
+	////////////////////////////////////////////////
+	// 1) Read the vesselness and threshold it within the vessels' bounding box
+
+	FloatImageType::Pointer vesselness = ReadFloatImage( argv[1] );
+	if( !vesselness ) {
+		return EXIT_FAILURE;
+	}
+	const medimg::Geometry geometry = medimg::ImageGeometry( vesselness.GetPointer() );
+	const medimg::Dims &dims = geometry.dims;
+	const float *V = vesselness->GetBufferPointer();
+
+	medimg::Box region;
+	for( int a = 0; a < 3; ++a ) {
+		region.lo[a] = 0;
+		region.hi[a] = -1;
+	}
+	bool any = false;
+	for( std::size_t z = 0; z < dims.nz; ++z ) {
+		for( std::size_t y = 0; y < dims.ny; ++y ) {
+			const float *row = V + dims.Index( 0, y, z );
+			for( std::size_t x = 0; x < dims.nx; ++x ) {
+				if( row[x] > threshold ) {
+					const long p[3] = { static_cast<long>( x ), static_cast<long>( y ),
+						static_cast<long>( z ) };
+					for( int a = 0; a < 3; ++a ) {
+						region.lo[a] = any ? std::min( region.lo[a], p[a] ) : p[a];
+						region.hi[a] = any ? std::max( region.hi[a], p[a] + 1 ) : p[a] + 1;
+					}
+					any = true;
+				}
+			}
+		}
+	}
+	if( !any ) {
+		std::cerr << "No voxel above the threshold " << threshold << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<unsigned char> skeleton( region.Voxels() );
+	for( long z = region.lo[2]; z < region.hi[2]; ++z ) {
+		for( long y = region.lo[1]; y < region.hi[1]; ++y ) {
+			const float *row = V + dims.Index( 0, y, z );
+			unsigned char *out = &skeleton[region.Offset( region.lo[0], y, z )];
+			for( long x = region.lo[0]; x < region.hi[0]; ++x ) {
+				*out++ = row[x] > threshold;
+			}
+		}
+	}
+	// Only the binary crop is needed from here on
+	vesselness = NULL;
+	V = NULL;
+
+	////////////////////////////////////////////////
+	// 2) Thin to centerlines
+
+	const medimg::Dims cropDims( region.Size( 0 ), region.Size( 1 ), region.Size( 2 ) );
+	const std::size_t voxels = medimg::Skeletonize3D( &skeleton[0], cropDims );
+	std::cout << "Skeleton: " << voxels << " voxels in a " << cropDims.nx << " x "
+		<< cropDims.ny << " x " << cropDims.nz << " box" << std::endl;
+
+	////////////////////////////////////////////////
+	// 3) Trace the graph, reading radii from the scale image
+
+	FloatImageType::Pointer scale;
+	if( scaleImage ) {
+		scale = ReadFloatImage( scaleImage );
+		if( !scale ) {
+			return EXIT_FAILURE;
+		}
+		if( NativeDims( scale.GetPointer() ).Voxels() != dims.Voxels() ) {
+			std::cerr << "Scale image size " << scale->GetBufferedRegion().GetSize()
+				<< " differs from image size" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	medimg::VesselGraphWriter writer;
+	if( !writer.Open( argv[3], geometry ) ) {
+		std::cerr << "Cannot create " << argv[3] << std::endl;
+		return EXIT_FAILURE;
+	}
+	medimg::ExtractVesselGraph( &skeleton[0], region, geometry,
+		scale ? scale->GetBufferPointer() : NULL, sigmas, RadiusPerSigma, writer );
+	const std::size_t nodes = writer.Nodes(), branches = writer.Branches();
+	if( !writer.Close() ) {
+		std::cerr << "Error writing " << argv[3] << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Graph: " << nodes << " nodes, " << branches << " branches" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+//
+//  vesselgraphTest.cpp
+//  ITKVessel
+//
+//  Checks the graph that vesselgraph extracts (Common/skeleton.h and
+//  Common/vesselGraph.h) on binary phantoms with a known topology: a
+//  straight tube, an oblique one and a Y of three tubes, each smooth and
+//  with one-voxel bumps on its surface. A tube must give 2 nodes and 1
+//  branch and the Y 4 nodes and 3 branches, with the junction of the Y
+//  within a radius of where the tubes meet; thinning spurs to the bumps
+//  or to the corners of the tube ends must not become branches.
+//
+//  Run by CTest, in the build directory (it writes vesselgraphTest.vgr).
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "skeleton.h"
+#include "vesselGraph.h"
+
+
+// Sets the voxels within radius of the segment from a to b
+static void AddTube(std::vector<unsigned char> &B, const medimg::Dims &dims,
+	const double a[3], const double b[3], double radius)
+{
+	double ab[3], length2 = 0.0;
+	for( int k = 0; k < 3; ++k ) {
+		ab[k] = b[k] - a[k];
+		length2 += ab[k] * ab[k];
+	}
+	for( std::size_t z = 0; z < dims.nz; ++z ) {
+		for( std::size_t y = 0; y < dims.ny; ++y ) {
+			for( std::size_t x = 0; x < dims.nx; ++x ) {
+				const double ap[3] = { x - a[0], y - a[1], z - a[2] };
+				double t = ( ap[0] * ab[0] + ap[1] * ab[1] + ap[2] * ab[2] ) / length2;
+				t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+				double d2 = 0.0;
+				for( int k = 0; k < 3; ++k ) {
+					const double d = ap[k] - t * ab[k];
+					d2 += d * d;
+				}
+				if( d2 <= radius * radius ) {
+					B[dims.Index( x, y, z )] = 1;
+				}
+			}
+		}
+	}
+}
+
+// A voxel on top of every fifth surface voxel found scanning along x,
+// 6-adjacent to the tube
+static void AddBumps(std::vector<unsigned char> &B, const medimg::Dims &dims)
+{
+	const std::vector<unsigned char> tube( B );
+	std::size_t surface = 0;
+	for( std::size_t z = 1; z + 1 < dims.nz; ++z ) {
+		for( std::size_t y = 1; y + 1 < dims.ny; ++y ) {
+			for( std::size_t x = 1; x + 1 < dims.nx; ++x ) {
+				const std::size_t i = dims.Index( x, y, z );
+				if( tube[i] || !tube[i - dims.nx * dims.ny] ) {
+					continue;
+				}
+				if( surface++ % 5 == 0 ) {
+					B[i] = 1;
+				}
+			}
+		}
+	}
+}
+
+struct GraphCounts
+{
+	std::size_t Nodes, Branches;
+	// Node with the most branches, and their number
+	const medimg::GraphNode *Junction;
+	std::size_t Degree;
+};
+
+// Skeleton and graph of B; false if the graph cannot be written or read
+static bool ExtractGraph(std::vector<unsigned char> B, const medimg::Dims &dims, double radius,
+	medimg::VesselGraph &graph, GraphCounts &counts)
+{
+	medimg::Skeletonize3D( &B[0], dims );
+	medimg::Geometry geometry;
+	geometry.dims = dims;
+	medimg::Box region;
+	for( int a = 0; a < 3; ++a ) {
+		region.lo[a] = 0;
+	}
+	region.hi[0] = dims.nx;
+	region.hi[1] = dims.ny;
+	region.hi[2] = dims.nz;
+	// One scale whose radius is that of the tubes
+	const std::vector<float> whatScale( dims.Voxels(), 1.0f );
+	const std::vector<double> sigmas( 1, radius / std::sqrt( 2.0 ) );
+
+	const char *filename = "vesselgraphTest.vgr";
+	medimg::VesselGraphWriter writer;
+	if( !writer.Open( filename, geometry ) ) {
+		std::cerr << "Cannot create " << filename << std::endl;
+		return false;
+	}
+	medimg::ExtractVesselGraph( &B[0], region, geometry, &whatScale[0], sigmas, std::sqrt( 2.0 ), writer );
+	if( !writer.Close() || !medimg::ReadVesselGraph( filename, graph ) ) {
+		std::cerr << "Cannot write or read " << filename << std::endl;
+		return false;
+	}
+	std::remove( filename );
+
+	counts.Nodes = graph.Nodes.size();
+	counts.Branches = graph.Branches.size();
+	counts.Junction = 0;
+	counts.Degree = 0;
+	for( std::size_t n = 0; n < graph.Nodes.size(); ++n ) {
+		std::size_t degree = 0;
+		for( std::size_t b = 0; b < graph.Branches.size(); ++b ) {
+			degree += ( graph.Branches[b].Nodes[0] == graph.Nodes[n].Id )
+				+ ( graph.Branches[b].Nodes[1] == graph.Nodes[n].Id );
+		}
+		if( degree > counts.Degree ) {
+			counts.Junction = &graph.Nodes[n];
+			counts.Degree = degree;
+		}
+	}
+	return true;
+}
+
+// Whether the graph of B has the expected counts, and for a Y its junction
+// within radius of center
+static bool Check(const std::string &name, const std::vector<unsigned char> &B,
+	const medimg::Dims &dims, double radius, std::size_t nodes, std::size_t branches,
+	const double *center = 0)
+{
+	medimg::VesselGraph graph;
+	GraphCounts counts = GraphCounts();
+	if( !ExtractGraph( B, dims, radius, graph, counts ) ) {
+		return false;
+	}
+	bool good = counts.Nodes == nodes && counts.Branches == branches;
+	double distance = 0.0;
+	if( good && center ) {
+		for( int a = 0; a < 3; ++a ) {
+			const double d = counts.Junction->Position[a] - center[a];
+			distance += d * d;
+		}
+		distance = std::sqrt( distance );
+		good = counts.Degree == 3 && distance <= radius;
+	}
+	std::cout << ( good ? "passed: " : "FAILED: " ) << name << ", radius " << radius << ": "
+		<< counts.Nodes << " nodes, " << counts.Branches << " branches (expected "
+		<< nodes << " and " << branches << ")";
+	if( center && counts.Junction ) {
+		std::cout << ", junction " << distance << " voxels from the center";
+	}
+	std::cout << std::endl;
+	return good;
+}
+
+
+int main()
+{
+	bool good = true;
+	const double radii[3] = { 2.0, 3.0, 4.5 };
+	for( int r = 0; r < 3; ++r ) {
+		const double radius = radii[r];
+		for( int bumpy = 0; bumpy < 2; ++bumpy ) {
+			const std::string surface = bumpy ? "bumpy " : "";
+
+			const medimg::Dims tubeDims( 64, 40, 40 );
+			std::vector<unsigned char> tube( tubeDims.Voxels() ), oblique( tubeDims.Voxels() );
+			const double a[3] = { 6.0, 20.0, 20.0 }, b[3] = { 57.0, 20.0, 20.0 };
+			AddTube( tube, tubeDims, a, b, radius );
+			const double c[3] = { 6.0, 12.3, 14.7 }, d[3] = { 57.0, 27.6, 24.1 };
+			AddTube( oblique, tubeDims, c, d, radius );
+
+			const medimg::Dims yDims( 64, 64, 32 );
+			std::vector<unsigned char> y( yDims.Voxels() );
+			const double center[3] = { 32.0, 32.0, 16.0 };
+			const double ends[3][3] = { { 6.0, 32.0, 16.0 }, { 57.0, 10.0, 16.0 }, { 57.0, 54.0, 16.0 } };
+			for( int e = 0; e < 3; ++e ) {
+				AddTube( y, yDims, ends[e], center, radius );
+			}
+
+			if( bumpy ) {
+				AddBumps( tube, tubeDims );
+				AddBumps( oblique, tubeDims );
+				AddBumps( y, yDims );
+			}
+			good = Check( surface + "tube", tube, tubeDims, radius, 2, 1 ) && good;
+			good = Check( surface + "oblique tube", oblique, tubeDims, radius, 2, 1 ) && good;
+			good = Check( surface + "Y", y, yDims, radius, 4, 3, center ) && good;
+		}
+	}
+	return good ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+//
+//  itkPipelines.cpp
+//  Python
+//
+
+#include "itkPipelines.h"
+
+#include <stdexcept>
+#include "itkImage.h"
+#include "itkImportImageFilter.h"
+#include "itkFastMarchingImageFilter.h"
+#include "itkGeodesicActiveContourLevelSetImageFilter.h"
+#include "speedImage.h"
+
+
+namespace medimg
+{
+
+namespace
+{
+
+typedef itk::Image< float, 3 > ImageType;
+typedef itk::ImportImageFilter< float, 3 > ImportFilterType;
+
+// Keeps the output image of a pipeline alive for the volume viewing it
+class ImageStorage : public VolumeStorage
+{
+public:
+	explicit ImageStorage(ImageType *image) : m_Image( image ) {}
+	void *Data() { return m_Image->GetBufferPointer(); }
+
+private:
+	ImageType::Pointer m_Image;
+};
+
+// ITK image over buffer (geometry.dims.Voxels() values), which stays owned
+// by the caller
+ImportFilterType::Pointer Import(const float *buffer, const Geometry &geometry)
+{
+	ImportFilterType::Pointer import = ImportFilterType::New();
+	ImportFilterType::SizeType size;
+	size[0] = geometry.dims.nx;
+	size[1] = geometry.dims.ny;
+	size[2] = geometry.dims.nz;
+	ImportFilterType::RegionType region;
+	region.SetSize( size );
+	import->SetRegion( region );
+	double spacing[3], origin[3];
+	ImportFilterType::DirectionType direction;
+	for( int a = 0; a < 3; ++a ) {
+		spacing[a] = geometry.Spacing[a];
+		origin[a] = geometry.Origin[a];
+		for( int b = 0; b < 3; ++b ) {
+			direction[a][b] = geometry.Direction[3 * a + b];
+		}
+	}
+	import->SetSpacing( spacing );
+	import->SetOrigin( origin );
+	import->SetDirection( direction );
+	import->SetImportPointer( const_cast<float *>( buffer ), geometry.dims.Voxels(), false );
+	return import;
+}
+
+// Runs the pipeline ending in filter and takes its output
+template< class TFilter >
+VolumeStorage *TakeOutput(TFilter *filter)
+{
+	try {
+		filter->Update();
+	} catch (itk::ExceptionObject &error) {
+		throw std::runtime_error( error.GetDescription() );
+	}
+	ImageType::Pointer output = filter->GetOutput();
+	output->DisconnectPipeline();
+	return new ImageStorage( output );
+}
+
+} // end anonymous namespace
+
+
+VolumeStorage *SpeedImage(const float *I, const Geometry &geometry, double sigma,
+	double K1, double K2)
+{
+	ImportFilterType::Pointer import = Import( I, geometry );
+	SpeedImageFilters< ImageType, ImageType > speed( sigma, K1, K2 );
+	speed.SetInput( import->GetOutput() );
+	return TakeOutput( speed.sigmoid.GetPointer() );
+}
+
+VolumeStorage *FastMarching(const float *speed, const Geometry &geometry,
+	const std::vector<SeedIndex> &seeds, double stoppingTime)
+{
+	ImportFilterType::Pointer import = Import( speed, geometry );
+
+	typedef itk::FastMarchingImageFilter< ImageType, ImageType > FastMarchingFilterType;
+	typedef FastMarchingFilterType::NodeContainer NodeContainer;
+	typedef FastMarchingFilterType::NodeType NodeType;
+	NodeContainer::Pointer trialPoints = NodeContainer::New();
+	trialPoints->Initialize();
+	for( std::size_t s = 0; s < seeds.size(); ++s ) {
+		ImageType::IndexType index;
+		index[0] = seeds[s].x;
+		index[1] = seeds[s].y;
+		index[2] = seeds[s].z;
+		NodeType node;
+		node.SetValue( 0.0 );
+		node.SetIndex( index );
+		trialPoints->InsertElement( s, node );
+	}
+
+	FastMarchingFilterType::Pointer fastMarching = FastMarchingFilterType::New();
+	fastMarching->SetInput( import->GetOutput() );
+	fastMarching->SetTrialPoints( trialPoints );
+	fastMarching->SetOutputSize( import->GetOutput()->GetLargestPossibleRegion().GetSize() );
+	fastMarching->SetStoppingValue( stoppingTime );
+	return TakeOutput( fastMarching.GetPointer() );
+}
+
+VolumeStorage *GeodesicActiveContour(const float *speed, const float *initial,
+	const Geometry &geometry, const GeodesicActiveContourParameters &parameters)
+{
+	ImportFilterType::Pointer importSpeed = Import( speed, geometry );
+	ImportFilterType::Pointer importInitial = Import( initial, geometry );
+
+	typedef itk::GeodesicActiveContourLevelSetImageFilter< ImageType, ImageType >
+		GeodesicActiveContourFilterType;
+	GeodesicActiveContourFilterType::Pointer geodesicActiveContour = GeodesicActiveContourFilterType::New();
+	geodesicActiveContour->SetPropagationScaling( parameters.Propagation );
+	geodesicActiveContour->SetCurvatureScaling( parameters.Curvature );
+	geodesicActiveContour->SetAdvectionScaling( parameters.Advection );
+	geodesicActiveContour->SetMaximumRMSError( parameters.MaximumRMSError );
+	geodesicActiveContour->SetNumberOfIterations( parameters.Iterations );
+	geodesicActiveContour->SetInput( importInitial->GetOutput() );
+	geodesicActiveContour->SetFeatureImage( importSpeed->GetOutput() );
+	return TakeOutput( geodesicActiveContour.GetPointer() );
+}
+
+} // end namespace medimg
@@ -0,0 +1,53 @@
+//
+//  itkPipelines.h
+//  Python
+//
+//  The ITK pipelines of the ITKLiver tools on caller-owned float buffers,
+//  for the Python module. Inputs are imported into ITK without copying and
+//  the outputs are handed back as the ITK images themselves. Failures are
+//  thrown as std::runtime_error so that the module needs no ITK headers.
+//
+
+#ifndef MEDIMG_ITKPIPELINES_H
+#define MEDIMG_ITKPIPELINES_H
+
+#include <cstddef>
+#include <vector>
+#include "volume.h"
+#include "volumeStorage.h"
+
+
+namespace medimg
+{
+
+struct SeedIndex
+{
+	std::size_t x, y, z;
+};
+
+// Speed image of fastmarching and geodesic_active_contour: curvature
+// anisotropic diffusion, gradient magnitude at sigma and sigmoid mapping
+// with alpha = (K2 - K1) / 6, beta = (K1 + K2) / 2
+VolumeStorage *SpeedImage(const float *I, const Geometry &geometry, double sigma,
+	double K1, double K2);
+
+// Arrival times of a front started at the seeds (time 0) on speed, up to
+// stoppingTime
+VolumeStorage *FastMarching(const float *speed, const Geometry &geometry,
+	const std::vector<SeedIndex> &seeds, double stoppingTime);
+
+struct GeodesicActiveContourParameters
+{
+	double Propagation, Curvature, Advection;
+	double MaximumRMSError;
+	unsigned int Iterations;
+};
+
+// Level set evolved from initial (e.g. a signed distance map) on the
+// feature image speed; negative inside
+VolumeStorage *GeodesicActiveContour(const float *speed, const float *initial,
+	const Geometry &geometry, const GeodesicActiveContourParameters &parameters);
+
+} // end namespace medimg
+
+#endif
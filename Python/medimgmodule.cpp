@@ -0,0 +1,580 @@
+//
+//  medimgmodule.cpp
+//  Python
+//
+//  The medimg extension module: the speed image, fast marching and geodesic
+//  active contour pipelines of ITKLiver, the native Frangi and Sato
+//  vesselness filters and signed distance maps, callable on NumPy arrays.
+//
+//  Arrays are taken through the buffer protocol without copying; they must
+//  be 3D and C-contiguous, indexed [z, y, x] like the arrays of
+//  sitk.GetArrayFromImage, so x varies fastest as in the native kernels.
+//  Results are medimg.Volume objects, which export their voxels through the
+//  buffer protocol as well (numpy.asarray(volume) is a view) and carry the
+//  spacing, origin and direction of their input in x, y, z order. The GIL
+//  is released while a pipeline runs.
+//
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "distanceTransform.h"
+#include "itkPipelines.h"
+#include "sato.h"
+#include "vesselness.h"
+#include "volumeStorage.h"
+
+
+namespace
+{
+
+using medimg::Geometry;
+using medimg::VolumeStorage;
+
+////////////////////////////////////////////////
+// medimg.Volume
+
+struct VolumeObject
+{
+	PyObject_HEAD
+	VolumeStorage *storage;
+	// Buffer protocol format: "f" (float32) or "B" (uint8)
+	char format[2];
+	Py_ssize_t itemsize;
+	Py_ssize_t shape[3];
+	Py_ssize_t strides[3];
+	Geometry geometry;
+};
+
+PyTypeObject VolumeType = { PyVarObject_HEAD_INIT( 0, 0 ) };
+
+// Views the buffer of an object passed to Volume(), which stays alive and
+// locked (e.g. against resizing a NumPy array) while the volume exists
+class BufferStorage : public VolumeStorage
+{
+public:
+	explicit BufferStorage(const Py_buffer &view) : m_View( view ) {}
+	~BufferStorage() { PyBuffer_Release( &m_View ); }
+	void *Data() { return m_View.buf; }
+
+private:
+	Py_buffer m_View;
+};
+
+// New volume taking ownership of storage
+PyObject *NewVolume(VolumeStorage *storage, char format, const Geometry &geometry)
+{
+	VolumeObject *volume = PyObject_New( VolumeObject, &VolumeType );
+	if( !volume ) {
+		delete storage;
+		return 0;
+	}
+	volume->storage = storage;
+	volume->format[0] = format;
+	volume->format[1] = '\0';
+	volume->itemsize = format == 'f' ? 4 : 1;
+	volume->shape[0] = geometry.dims.nz;
+	volume->shape[1] = geometry.dims.ny;
+	volume->shape[2] = geometry.dims.nx;
+	volume->strides[2] = volume->itemsize;
+	volume->strides[1] = volume->itemsize * geometry.dims.nx;
+	volume->strides[0] = volume->strides[1] * geometry.dims.ny;
+	new( &volume->geometry ) Geometry( geometry );
+	return reinterpret_cast<PyObject *>( volume );
+}
+
+void VolumeDealloc(PyObject *self)
+{
+	delete reinterpret_cast<VolumeObject *>( self )->storage;
+	PyObject_Del( self );
+}
+
+int VolumeGetBuffer(PyObject *self, Py_buffer *view, int)
+{
+	VolumeObject *volume = reinterpret_cast<VolumeObject *>( self );
+	view->buf = volume->storage->Data();
+	view->obj = self;
+	Py_INCREF( self );
+	view->len = volume->itemsize * volume->shape[0] * volume->shape[1] * volume->shape[2];
+	view->readonly = 0;
+	view->itemsize = volume->itemsize;
+	view->format = volume->format;
+	view->ndim = 3;
+	view->shape = volume->shape;
+	view->strides = volume->strides;
+	view->suboffsets = 0;
+	view->internal = 0;
+	return 0;
+}
+
+PyBufferProcs VolumeBufferProcs = { VolumeGetBuffer, 0 };
+
+PyObject *Triple(const double *values)
+{
+	return Py_BuildValue( "(ddd)", values[0], values[1], values[2] );
+}
+
+PyObject *VolumeSpacing(PyObject *self, void *)
+{
+	return Triple( reinterpret_cast<VolumeObject *>( self )->geometry.Spacing );
+}
+
+PyObject *VolumeOrigin(PyObject *self, void *)
+{
+	return Triple( reinterpret_cast<VolumeObject *>( self )->geometry.Origin );
+}
+
+PyObject *VolumeDirection(PyObject *self, void *)
+{
+	const double *D = reinterpret_cast<VolumeObject *>( self )->geometry.Direction;
+	return Py_BuildValue( "((ddd)(ddd)(ddd))", D[0], D[1], D[2], D[3], D[4], D[5], D[6], D[7], D[8] );
+}
+
+PyObject *VolumeShape(PyObject *self, void *)
+{
+	const Py_ssize_t *shape = reinterpret_cast<VolumeObject *>( self )->shape;
+	return Py_BuildValue( "(nnn)", shape[0], shape[1], shape[2] );
+}
+
+PyGetSetDef VolumeGetSet[] = {
+	{ const_cast<char *>( "spacing" ), VolumeSpacing, 0, const_cast<char *>( "Voxel spacing (x, y, z)" ), 0 },
+	{ const_cast<char *>( "origin" ), VolumeOrigin, 0, const_cast<char *>( "Position of voxel 0 (x, y, z)" ), 0 },
+	{ const_cast<char *>( "direction" ), VolumeDirection, 0, const_cast<char *>( "Direction cosines, rows of the ITK matrix" ), 0 },
+	{ const_cast<char *>( "shape" ), VolumeShape, 0, const_cast<char *>( "(nz, ny, nx)" ), 0 },
+	{ 0, 0, 0, 0, 0 }
+};
+
+////////////////////////////////////////////////
+// Arguments
+
+// 3 numbers from a sequence into values; true if sequence is None
+bool ParseTriple(PyObject *sequence, double *values, const char *name)
+{
+	if( !sequence || sequence == Py_None ) {
+		return true;
+	}
+	PyObject *fast = PySequence_Fast( sequence, name );
+	if( !fast ) {
+		return false;
+	}
+	bool parsed = PySequence_Fast_GET_SIZE( fast ) == 3;
+	for( int a = 0; a < 3 && parsed; ++a ) {
+		values[a] = PyFloat_AsDouble( PySequence_Fast_GET_ITEM( fast, a ) );
+		parsed = !PyErr_Occurred();
+	}
+	Py_DECREF( fast );
+	if( !parsed && !PyErr_Occurred() ) {
+		PyErr_Format( PyExc_ValueError, "%s must have 3 elements", name );
+	}
+	return parsed;
+}
+
+// Buffer of a 3D C-contiguous array of the format given ('f' or 'B'), with
+// the geometry of the array if it is a Volume, overridden by spacing and
+// origin when those are not None. Releases the buffer when done.
+class ArrayArgument
+{
+public:
+	ArrayArgument() : m_Valid( false ) {}
+	~ArrayArgument() { if( m_Valid ) PyBuffer_Release( &m_View ); }
+
+	bool Parse(PyObject *array, char format, const char *name, PyObject *spacing = 0, PyObject *origin = 0)
+	{
+		if( PyObject_GetBuffer( array, &m_View, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT ) != 0 ) {
+			return false;
+		}
+		m_Valid = true;
+		const char *f = m_View.format ? m_View.format : "B";
+		if( *f == '<' || *f == '=' || *f == '@' ) {
+			++f;
+		}
+		const bool matches = format == 'f' ? std::strcmp( f, "f" ) == 0
+			: std::strcmp( f, "B" ) == 0 || std::strcmp( f, "?" ) == 0;
+		if( m_View.ndim != 3 || !matches ) {
+			PyErr_Format( PyExc_TypeError, "%s must be a 3D %s array", name,
+				format == 'f' ? "float32" : "uint8 or bool" );
+			return false;
+		}
+		Geometry &g = m_Geometry;
+		g.dims = medimg::Dims( m_View.shape[2], m_View.shape[1], m_View.shape[0] );
+		if( PyObject_TypeCheck( array, &VolumeType ) ) {
+			g = reinterpret_cast<VolumeObject *>( array )->geometry;
+		}
+		return ParseTriple( spacing, g.Spacing, "spacing" ) && ParseTriple( origin, g.Origin, "origin" );
+	}
+
+	template< class T >
+	const T *Data() const { return static_cast<const T *>( m_View.buf ); }
+	const Geometry &GetGeometry() const { return m_Geometry; }
+
+private:
+	Py_buffer m_View;
+	bool m_Valid;
+	Geometry m_Geometry;
+};
+
+// Seeds (x, y, z) inside dims
+bool ParseSeeds(PyObject *sequence, const medimg::Dims &dims, std::vector<medimg::SeedIndex> &seeds)
+{
+	PyObject *fast = PySequence_Fast( sequence, "seeds must be a sequence of (x, y, z)" );
+	if( !fast ) {
+		return false;
+	}
+	bool parsed = true;
+	for( Py_ssize_t s = 0; s < PySequence_Fast_GET_SIZE( fast ) && parsed; ++s ) {
+		long x, y, z;
+		parsed = PyArg_ParseTuple( PySequence_Fast_GET_ITEM( fast, s ), "lll", &x, &y, &z ) != 0;
+		if( parsed && ( x < 0 || y < 0 || z < 0 || x >= static_cast<long>( dims.nx )
+			|| y >= static_cast<long>( dims.ny ) || z >= static_cast<long>( dims.nz ) ) ) {
+			PyErr_Format( PyExc_ValueError, "seed (%ld, %ld, %ld) outside the volume", x, y, z );
+			parsed = false;
+		}
+		if( parsed ) {
+			const medimg::SeedIndex seed = { static_cast<std::size_t>( x ), static_cast<std::size_t>( y ),
+				static_cast<std::size_t>( z ) };
+			seeds.push_back( seed );
+		}
+	}
+	Py_DECREF( fast );
+	return parsed;
+}
+
+// Runs compute with the GIL released; C++ exceptions become RuntimeError
+template< class TCompute >
+bool RunWithoutGIL(TCompute compute)
+{
+	std::string error;
+	Py_BEGIN_ALLOW_THREADS
+	try {
+		compute();
+	} catch (std::exception &e) {
+		error = e.what();
+		if( error.empty() ) {
+			error = "unknown error";
+		}
+	}
+	Py_END_ALLOW_THREADS
+	if( !error.empty() ) {
+		PyErr_SetString( PyExc_RuntimeError, error.c_str() );
+		return false;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////
+// Functions
+
+PyObject *SpeedImage(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "image", "sigma", "k1", "k2", "spacing", "origin", 0 };
+	PyObject *array, *spacing = Py_None, *origin = Py_None;
+	double sigma, K1, K2;
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "Oddd|OO", const_cast<char **>( keywords ),
+		&array, &sigma, &K1, &K2, &spacing, &origin ) ) {
+		return 0;
+	}
+	ArrayArgument image;
+	if( !image.Parse( array, 'f', "image", spacing, origin ) ) {
+		return 0;
+	}
+	VolumeStorage *speed = 0;
+	if( !RunWithoutGIL( [&]() {
+		speed = medimg::SpeedImage( image.Data<float>(), image.GetGeometry(), sigma, K1, K2 );
+	} ) ) {
+		return 0;
+	}
+	return NewVolume( speed, 'f', image.GetGeometry() );
+}
+
+PyObject *FastMarching(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "speed", "seeds", "stopping_time", "spacing", "origin", 0 };
+	PyObject *array, *seedList, *spacing = Py_None, *origin = Py_None;
+	double stoppingTime;
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "OOd|OO", const_cast<char **>( keywords ),
+		&array, &seedList, &stoppingTime, &spacing, &origin ) ) {
+		return 0;
+	}
+	ArrayArgument speed;
+	std::vector<medimg::SeedIndex> seeds;
+	if( !speed.Parse( array, 'f', "speed", spacing, origin )
+		|| !ParseSeeds( seedList, speed.GetGeometry().dims, seeds ) ) {
+		return 0;
+	}
+	VolumeStorage *arrival = 0;
+	if( !RunWithoutGIL( [&]() {
+		arrival = medimg::FastMarching( speed.Data<float>(), speed.GetGeometry(), seeds, stoppingTime );
+	} ) ) {
+		return 0;
+	}
+	return NewVolume( arrival, 'f', speed.GetGeometry() );
+}
+
+PyObject *GeodesicActiveContour(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "speed", "seeds", "radius", "propagation", "curvature",
+		"advection", "iterations", "rms", "spacing", "origin", 0 };
+	PyObject *array, *seedList, *spacing = Py_None, *origin = Py_None;
+	double radius;
+	medimg::GeodesicActiveContourParameters parameters;
+	parameters.Propagation = 1.0;
+	parameters.Curvature = 0.2;
+	parameters.Advection = 4.0;
+	parameters.Iterations = 600;
+	parameters.MaximumRMSError = 0.01;
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "OOd|dddIdOO", const_cast<char **>( keywords ),
+		&array, &seedList, &radius, &parameters.Propagation, &parameters.Curvature,
+		&parameters.Advection, &parameters.Iterations, &parameters.MaximumRMSError, &spacing, &origin ) ) {
+		return 0;
+	}
+	ArrayArgument speed;
+	std::vector<medimg::SeedIndex> seeds;
+	if( !speed.Parse( array, 'f', "speed", spacing, origin )
+		|| !ParseSeeds( seedList, speed.GetGeometry().dims, seeds ) ) {
+		return 0;
+	}
+	const Geometry &geometry = speed.GetGeometry();
+	VolumeStorage *levelSet = 0;
+	if( !RunWithoutGIL( [&]() {
+		// Signed distance from the seeds' balls as the initial level set,
+		// as geodesic_active_contour does
+		std::vector<medimg::DistanceSeed> balls( seeds.size() );
+		for( std::size_t s = 0; s < seeds.size(); ++s ) {
+			balls[s].x = seeds[s].x;
+			balls[s].y = seeds[s].y;
+			balls[s].z = seeds[s].z;
+			balls[s].Radius = radius;
+		}
+		std::unique_ptr< medimg::VectorStorage<float> > initial(
+			new medimg::VectorStorage<float>( geometry.dims.Voxels() ) );
+		std::string error;
+		if( !medimg::SignedDistanceFromSeeds( balls, geometry.dims, geometry.Spacing, initial->Values(), error ) ) {
+			throw std::runtime_error( error );
+		}
+		levelSet = medimg::GeodesicActiveContour( speed.Data<float>(), initial->Values(), geometry, parameters );
+	} ) ) {
+		return 0;
+	}
+	return NewVolume( levelSet, 'f', geometry );
+}
+
+// (vesselness, scale) volumes
+PyObject *VesselnessResult(VolumeStorage *vesselness, VolumeStorage *scale, const Geometry &geometry)
+{
+	PyObject *first = NewVolume( vesselness, 'f', geometry );
+	if( !first ) {
+		delete scale;
+		return 0;
+	}
+	PyObject *second = NewVolume( scale, 'f', geometry );
+	if( !second ) {
+		Py_DECREF( first );
+		return 0;
+	}
+	return Py_BuildValue( "(NN)", first, second );
+}
+
+PyObject *Frangi(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "image", "scale_range", "scale_ratio", "alpha", "beta", "c",
+		"black_white", "threads", 0 };
+	PyObject *array, *range = Py_None;
+	medimg::FrangiOptions options;
+	options.verbose = false;
+	int blackWhite = options.BlackWhite;
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "O|OddddpI", const_cast<char **>( keywords ),
+		&array, &range, &options.FrangiScaleRatio, &options.FrangiAlpha, &options.FrangiBeta,
+		&options.FrangiC, &blackWhite, &options.NumberOfThreads ) ) {
+		return 0;
+	}
+	options.BlackWhite = blackWhite != 0;
+	if( range != Py_None && !PyArg_ParseTuple( range, "dd", &options.FrangiScaleRange[0],
+		&options.FrangiScaleRange[1] ) ) {
+		return 0;
+	}
+	ArrayArgument image;
+	if( !image.Parse( array, 'f', "image" ) ) {
+		return 0;
+	}
+	const Geometry &geometry = image.GetGeometry();
+	std::unique_ptr< medimg::VectorStorage<float> > vesselness, scale;
+	if( !RunWithoutGIL( [&]() {
+		vesselness.reset( new medimg::VectorStorage<float>( geometry.dims.Voxels() ) );
+		scale.reset( new medimg::VectorStorage<float>( geometry.dims.Voxels() ) );
+		medimg::FrangiFilter3D( image.Data<float>(), geometry.dims, options, vesselness->Values(), scale->Values() );
+	} ) ) {
+		return 0;
+	}
+	return VesselnessResult( vesselness.release(), scale.release(), geometry );
+}
+
+PyObject *Sato(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "image", "sigmas", "alpha1", "alpha2", "threads", "spacing", 0 };
+	PyObject *array, *sigmaList, *spacing = Py_None;
+	medimg::SatoOptions options;
+	options.verbose = false;
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "OO|ddIO", const_cast<char **>( keywords ),
+		&array, &sigmaList, &options.Alpha1, &options.Alpha2, &options.NumberOfThreads, &spacing ) ) {
+		return 0;
+	}
+	PyObject *fast = PySequence_Fast( sigmaList, "sigmas must be a sequence" );
+	if( !fast ) {
+		return 0;
+	}
+	for( Py_ssize_t s = 0; s < PySequence_Fast_GET_SIZE( fast ); ++s ) {
+		options.Sigmas.push_back( PyFloat_AsDouble( PySequence_Fast_GET_ITEM( fast, s ) ) );
+	}
+	Py_DECREF( fast );
+	if( PyErr_Occurred() ) {
+		return 0;
+	}
+	if( options.Sigmas.empty() ) {
+		PyErr_SetString( PyExc_ValueError, "sigmas must not be empty" );
+		return 0;
+	}
+	// As satofilter: normalized only to compare several scales
+	options.NormalizeAcrossScale = options.Sigmas.size() > 1;
+
+	ArrayArgument image;
+	if( !image.Parse( array, 'f', "image", spacing ) ) {
+		return 0;
+	}
+	const Geometry &geometry = image.GetGeometry();
+	for( int a = 0; a < 3; ++a ) {
+		options.Spacing[a] = geometry.Spacing[a];
+	}
+	std::unique_ptr< medimg::VectorStorage<float> > vesselness, scale;
+	if( !RunWithoutGIL( [&]() {
+		vesselness.reset( new medimg::VectorStorage<float>( geometry.dims.Voxels() ) );
+		scale.reset( new medimg::VectorStorage<float>( geometry.dims.Voxels() ) );
+		medimg::SatoFilter3D( image.Data<float>(), geometry.dims, options, vesselness->Values(), scale->Values() );
+	} ) ) {
+		return 0;
+	}
+	return VesselnessResult( vesselness.release(), scale.release(), geometry );
+}
+
+PyObject *SignedDistance(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "mask", "threads", "spacing", "origin", 0 };
+	PyObject *array, *spacing = Py_None, *origin = Py_None;
+	unsigned int threads = 0;
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "O|IOO", const_cast<char **>( keywords ),
+		&array, &threads, &spacing, &origin ) ) {
+		return 0;
+	}
+	ArrayArgument mask;
+	if( !mask.Parse( array, 'B', "mask", spacing, origin ) ) {
+		return 0;
+	}
+	const Geometry &geometry = mask.GetGeometry();
+	std::unique_ptr< medimg::VectorStorage<float> > distance;
+	if( !RunWithoutGIL( [&]() {
+		distance.reset( new medimg::VectorStorage<float>( geometry.dims.Voxels() ) );
+		medimg::SignedDistanceMap( mask.Data<unsigned char>(), geometry.dims, geometry.Spacing,
+			distance->Values(), threads );
+	} ) ) {
+		return 0;
+	}
+	return NewVolume( distance.release(), 'f', geometry );
+}
+
+PyObject *VolumeNew(PyTypeObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "array", "spacing", "origin", 0 };
+	PyObject *array, *spacing = Py_None, *origin = Py_None;
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "O|OO", const_cast<char **>( keywords ),
+		&array, &spacing, &origin ) ) {
+		return 0;
+	}
+	Py_buffer view;
+	if( PyObject_GetBuffer( array, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE ) != 0 ) {
+		return 0;
+	}
+	std::unique_ptr<BufferStorage> storage( new BufferStorage( view ) );
+	const char *f = view.format ? view.format : "B";
+	if( *f == '<' || *f == '=' || *f == '@' ) {
+		++f;
+	}
+	const char format = std::strcmp( f, "f" ) == 0 ? 'f' : std::strcmp( f, "B" ) == 0 ? 'B' : '\0';
+	if( view.ndim != 3 || !format ) {
+		PyErr_SetString( PyExc_TypeError, "array must be a 3D float32 or uint8 array" );
+		return 0;
+	}
+	Geometry geometry;
+	geometry.dims = medimg::Dims( view.shape[2], view.shape[1], view.shape[0] );
+	if( !ParseTriple( spacing, geometry.Spacing, "spacing" ) || !ParseTriple( origin, geometry.Origin, "origin" ) ) {
+		return 0;
+	}
+	return NewVolume( storage.release(), format, geometry );
+}
+
+PyMethodDef Methods[] = {
+	{ "speed_image", reinterpret_cast<PyCFunction>( SpeedImage ), METH_VARARGS | METH_KEYWORDS,
+		"speed_image(image, sigma, k1, k2, spacing=None, origin=None)\n\n"
+		"Anisotropic diffusion, gradient magnitude and sigmoid mapping, as in fastmarching." },
+	{ "fast_marching", reinterpret_cast<PyCFunction>( FastMarching ), METH_VARARGS | METH_KEYWORDS,
+		"fast_marching(speed, seeds, stopping_time, spacing=None, origin=None)\n\n"
+		"Arrival times from the (x, y, z) seeds." },
+	{ "geodesic_active_contour", reinterpret_cast<PyCFunction>( GeodesicActiveContour ), METH_VARARGS | METH_KEYWORDS,
+		"geodesic_active_contour(speed, seeds, radius, propagation=1.0, curvature=0.2, advection=4.0,\n"
+		"    iterations=600, rms=0.01, spacing=None, origin=None)\n\n"
+		"Level set (negative inside) grown from balls of radius around the (x, y, z) seeds." },
+	{ "frangi", reinterpret_cast<PyCFunction>( Frangi ), METH_VARARGS | METH_KEYWORDS,
+		"frangi(image, scale_range=(1, 10), scale_ratio=2, alpha=0.5, beta=0.5, c=500,\n"
+		"    black_white=True, threads=0)\n\n"
+		"(vesselness, scale) as FrangiFilter3D.m computes them." },
+	{ "sato", reinterpret_cast<PyCFunction>( Sato ), METH_VARARGS | METH_KEYWORDS,
+		"sato(image, sigmas, alpha1=0.5, alpha2=2.0, threads=0, spacing=None)\n\n"
+		"(vesselness, scale) of the multiscale Sato line filter." },
+	{ "signed_distance", reinterpret_cast<PyCFunction>( SignedDistance ), METH_VARARGS | METH_KEYWORDS,
+		"signed_distance(mask, threads=0, spacing=None, origin=None)\n\n"
+		"Exact signed distance to the boundary of the mask, negative inside." },
+	{ 0, 0, 0, 0 }
+};
+
+PyModuleDef Module = {
+	PyModuleDef_HEAD_INIT,
+	"medimg",
+	"Native liver and vessel segmentation pipelines on NumPy arrays, without copies.",
+	-1,
+	Methods,
+	0, 0, 0, 0
+};
+
+} // end anonymous namespace
+
+
+PyMODINIT_FUNC PyInit_medimg()
+{
+	VolumeType.tp_name = "medimg.Volume";
+	VolumeType.tp_basicsize = sizeof(VolumeObject);
+	VolumeType.tp_flags = Py_TPFLAGS_DEFAULT;
+	VolumeType.tp_doc = "Volume(array, spacing=None, origin=None)\n\n"
+		"3D float32 or uint8 voxels, indexed [z, y, x], with their geometry. Wraps array without\n"
+		"copying; numpy.asarray(volume) views the voxels.";
+	VolumeType.tp_new = VolumeNew;
+	VolumeType.tp_dealloc = VolumeDealloc;
+	VolumeType.tp_as_buffer = &VolumeBufferProcs;
+	VolumeType.tp_getset = VolumeGetSet;
+	if( PyType_Ready( &VolumeType ) < 0 ) {
+		return 0;
+	}
+	PyObject *module = PyModule_Create( &Module );
+	if( !module ) {
+		return 0;
+	}
+	Py_INCREF( &VolumeType );
+	if( PyModule_AddObject( module, "Volume", reinterpret_cast<PyObject *>( &VolumeType ) ) < 0 ) {
+		Py_DECREF( &VolumeType );
+		Py_DECREF( module );
+		return 0;
+	}
+	return module;
+}
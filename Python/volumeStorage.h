@@ -0,0 +1,41 @@
+//
+//  volumeStorage.h
+//  Python
+//
+//  Owner of the voxels behind a medimg.Volume. A volume's buffer is either
+//  a vector filled by a native kernel or the buffer of the ITK image a
+//  pipeline produced; in both cases NumPy arrays made from the volume view
+//  this memory directly, and it lives as long as the volume does.
+//
+
+#ifndef MEDIMG_VOLUMESTORAGE_H
+#define MEDIMG_VOLUMESTORAGE_H
+
+#include <vector>
+
+
+namespace medimg
+{
+
+class VolumeStorage
+{
+public:
+	virtual ~VolumeStorage() {}
+	virtual void *Data() = 0;
+};
+
+template< class T >
+class VectorStorage : public VolumeStorage
+{
+public:
+	explicit VectorStorage(std::size_t n) : m_Values( n ) {}
+	void *Data() { return m_Values.data(); }
+	T *Values() { return m_Values.data(); }
+
+private:
+	std::vector<T> m_Values;
+};
+
+} // end namespace medimg
+
+#endif
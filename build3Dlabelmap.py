@@ -2,6 +2,9 @@
 """
 Assembles 2D segmentations into a 3D label map.
 
+Superseded by assemble_labelmap in ITKLiver, which caches the series
+geometry and assembles the slices in parallel.
+
 Created on Sat Dec 12 14:03:23 2015
 
 @author: jyoung
@@ -4,50 +4,59 @@
 //  
 //  Created by Jonathan Young on 28 January 2016.
 //
+//  The series is read with the pixel type GDCM reports for its first slice
+//  (e.g. short for rescaled CT), so the ROI is written without conversion.
+//
+//  With MEDIMG_PROFILE or MEDIMG_TRACE set, the time and memory of every
+//  stage are reported (Common/stageProfiler.h).
+//
 
 #include <iostream>
+#include <string>
+#include <vector>
 #include "itkImage.h"
 #include "itkGDCMImageIO.h"
 #include "itkGDCMSeriesFileNames.h"
 #include "itkImageSeriesReader.h"
 #include "itkImageSeriesWriter.h"
 #include "itkRegionOfInterestImageFilter.h"
+#include "pipelineProfiler.h"
+#include "pixelTypeDispatch.h"
 
 
-int main(int argc, const char * argv[])
+typedef itk::GDCMImageIO ImageIOType;
+typedef std::vector< std::string > FileNamesContainer;
+
+
+// Reads the series as the dispatched pixel type and writes the ROI
+// entered by the user
+struct ExtractROI
+{
+	ImageIOType * gdcmIO;
+	const FileNamesContainer * filenames;
+	const char * outputImage;
+
+	template< class TPixel >
+	int Run() const;
+};
+
+
+template< class TPixel >
+int ExtractROI::Run() const
 {
-	// Validate input parameters
-	if (argc < 2) {
-		std::cerr << "Usage: "
-		<< argv[0]
-		<< " <InputDir> <OutputImage>"
-		<< std::endl;
-		return EXIT_FAILURE;
-	}
-	
 	const unsigned int Dimension = 3;
-    typedef unsigned short PixelType;
+    typedef TPixel PixelType;
     typedef itk::Image< PixelType, Dimension > ImageType;
     typedef itk::ImageSeriesReader< ImageType > ReaderType;
-    typedef itk::GDCMImageIO ImageIOType;
-    typedef itk::GDCMSeriesFileNames InputNamesGeneratorType;
-    const char * outputImage = argv[2];
-		
-    ////////////////////////////////////////////////
-    // 1) Read the input series
     
-    ImageIOType::Pointer gdcmIO = ImageIOType::New();
-    InputNamesGeneratorType::Pointer inputNames = 
-		InputNamesGeneratorType::New();
-    inputNames->SetInputDirectory( argv[1] );
-    
-    const ReaderType::FileNamesContainer &filenames =
-      inputNames->GetInputFileNames();
-    
-    ReaderType::Pointer reader = ReaderType::New();
+	medimg::StageProfiler profiler( "extractROI" );
+	medimg::UseITKThreads( profiler );
+	
+    typename ReaderType::Pointer reader = ReaderType::New();
+	medimg::ProfileFilter( profiler, reader, "read series" );
     
     reader->SetImageIO( gdcmIO );
-    reader->SetFileNames( filenames );
+    reader->SetFileNames( *filenames );
     try {
         reader->Update();
     } catch (itk::ExceptionObject &excp) {
@@ -82,32 +91,34 @@ int main(int argc, const char * argv[])
     const itk::IndexValueType startz = static_cast<itk::IndexValueType>(z_i);
     const itk::IndexValueType endz = static_cast<itk::IndexValueType>(z_f);
     
-    ImageType::IndexType start;
+    typename ImageType::IndexType start;
     start[0] = startx;
     start[1] = starty;
     start[2] = startz;
     
-    ImageType::IndexType end;
+    typename ImageType::IndexType end;
     end[0] = endx;
     end[1] = endy;
     end[2] = endz;
     
-    ImageType::RegionType region;
+    typename ImageType::RegionType region;
     region.SetIndex( start );
     region.SetUpperIndex( end );
     
     typedef itk::RegionOfInterestImageFilter<ImageType, ImageType> ROIfilter;
-    ROIfilter::Pointer ROI = ROIfilter::New();
+    typename ROIfilter::Pointer ROI = ROIfilter::New();
     ROI->SetInput( reader->GetOutput() );
     ROI->SetRegionOfInterest( region );
+	medimg::ProfileFilter( profiler, ROI, "extract" );
 	
     ////////////////////////////////////////////////
     // 3) Write output image
     
 	typedef itk::ImageFileWriter< ImageType > WriterType;
-    WriterType::Pointer writer = WriterType::New();
+    typename WriterType::Pointer writer = WriterType::New();
     writer->SetInput( ROI->GetOutput() );
     writer->SetFileName( outputImage );
+	medimg::ProfileFilter( profiler, writer, "write" );
     
     try {
         writer->Update();
@@ -115,4 +126,48 @@ int main(int argc, const char * argv[])
         std::cerr << "Error: " << error << std::endl;
         return EXIT_FAILURE;
     }
-}
\ No newline at end of file
+	return 0;
+}
+
+
+int main(int argc, const char * argv[])
+{
+	// Validate input parameters
+	if (argc < 3) {
+		std::cerr << "Usage: "
+		<< argv[0]
+		<< " <InputDir> <OutputImage>"
+		<< std::endl;
+		return EXIT_FAILURE;
+	}
+	
+    typedef itk::GDCMSeriesFileNames InputNamesGeneratorType;
+		
+    ////////////////////////////////////////////////
+    // 1) Read the input series
+    
+    ImageIOType::Pointer gdcmIO = ImageIOType::New();
+    InputNamesGeneratorType::Pointer inputNames = 
+		InputNamesGeneratorType::New();
+    inputNames->SetInputDirectory( argv[1] );
+    
+    const FileNamesContainer &filenames = inputNames->GetInputFileNames();
+    if( filenames.empty() ) {
+        std::cerr << "No DICOM series found in " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    try {
+        gdcmIO->SetFileName( filenames[0] );
+        gdcmIO->ReadImageInformation();
+    } catch (itk::ExceptionObject &excp) {
+        std::cerr << "Exception thrown while reading the series" << std::endl;
+        std::cerr << excp << std::endl;
+        return EXIT_FAILURE;
+    }
+    
+    ExtractROI extract;
+    extract.gdcmIO = gdcmIO;
+    extract.filenames = &filenames;
+    extract.outputImage = argv[2];
+    return medimg::DispatchOnComponentType( gdcmIO.GetPointer(), extract );
+}